@@ -52,6 +52,12 @@ struct after_by_srcport_ipc *afterbysrcport_ipc;
 struct after_by_dstport_ipc *afterbydstport_ipc;
 struct after_by_username_ipc *afterbyusername_ipc;
 
+struct _Sagan_IPC_Index *afterbysrc_index;
+struct _Sagan_IPC_Index *afterbydst_index;
+struct _Sagan_IPC_Index *afterbysrcport_index;
+struct _Sagan_IPC_Index *afterbydstport_index;
+struct _Sagan_IPC_Index *afterbyusername_index;
+
 struct _SaganCounters *counters;
 struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
@@ -63,230 +69,288 @@ struct _Sagan_IPC_Counters *counters_ipc;
 /* After by source */
 /*******************/
 
-bool After_By_Src ( int rule_position, char *ip_src, unsigned char *ip_src_bits, char *selector, char *syslog_message )
-{
-
-    bool after_log_flag = true;
+/* The after by source record for the event,  or -1.  Caller holds the
+   stripe "hash" falls in */
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+static int After_By_Src_Find( int rule_position, unsigned char *ip_src_bits, char *selector, uint32_t hash )
+{
 
     int i;
 
-    uint64_t after_oldtime;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    uint32_t slot = 0;
 
-    for (i = 0; i < counters_ipc->after_count_by_src; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(afterbysrc_index, hash, &slot) ) != -1; )
         {
 
             if ( !memcmp(afterbysrc_ipc[i].ipsrc, ip_src_bits, sizeof(afterbysrc_ipc[i].ipsrc)) &&
                     !strcmp(afterbysrc_ipc[i].sid, rulestruct[rule_position].s_sid) &&
                     ( selector == NULL || !strcmp(selector, afterbysrc_ipc[i].selector)) )
                 {
+                    return(i);
+                }
+        }
+
+    return(-1);
+}
 
-                    File_Lock(config->shm_after_by_src);
-                    pthread_mutex_lock(&After_By_Src_Mutex);
+bool After_By_Src ( int rule_position, char *ip_src, unsigned char *ip_src_bits, char *selector, char *syslog_message )
+{
 
-                    afterbysrc_ipc[i].count++;
-                    afterbysrc_ipc[i].total_count++;
+    bool after_log_flag = true;
 
-                    after_oldtime = atol(timet) - afterbysrc_ipc[i].utime;
+    uint64_t utime = time(NULL);
 
-                    strlcpy(afterbysrc_ipc[i].syslog_message, syslog_message, sizeof(afterbysrc_ipc[i].syslog_message));
-                    strlcpy(afterbysrc_ipc[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(afterbysrc_ipc[i].signature_msg));
+    int i;
 
+    uint32_t hash = 0;
 
-                    /* Reset counter if it's expired */
+    bool locked = false;
 
-                    if ( after_oldtime > rulestruct[rule_position].after_seconds ||
-                            afterbysrc_ipc[i].count == 0 )
-                        {
+    uint64_t after_oldtime;
 
-                            afterbysrc_ipc[i].count=1;
-                            afterbysrc_ipc[i].utime = atol(timet);
+    /* Find the matching src / sid via the hash index (see ipc.c) */
 
-                            after_log_flag = true;
-                        }
+    hash = IPC_Index_Hash(ip_src_bits, MAXIPBIT, rulestruct[rule_position].s_sid, selector);
 
-                    if ( rulestruct[rule_position].after_count < afterbysrc_ipc[i].count )
-                        {
+    IPC_Index_Lock(afterbysrc_index, hash);
 
-                            after_log_flag = false;
+    i = After_By_Src_Find(rule_position, ip_src_bits, selector, hash);
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "After SID %s by source IP address. [%s]", afterbysrc_ipc[i].sid, ip_src);
-                                }
+    /* If not found,  add it to the array.  Adding takes File_Lock() and
+       the mutex,  which come before the stripe (as in IPC_Reaper()),  so
+       let go of it and look again once they are held.  Another thread or
+       Sagan might have added the record,  or filled the table,  in
+       between */
 
-                            counters->after_total++;
-                        }
+    if ( i == -1 )
+        {
 
-                    pthread_mutex_unlock(&After_By_Src_Mutex);
-                    File_Unlock(config->shm_after_by_src);
+            IPC_Index_Unlock(afterbysrc_index, hash);
+
+            Clean_IPC_Object(AFTER_BY_SRC);
+
+            File_Lock(config->shm_after_by_src);
+            pthread_mutex_lock(&After_By_Src_Mutex);
+            IPC_Index_Lock(afterbysrc_index, hash);
 
-                    return(after_log_flag);
+            locked = true;
+
+            i = After_By_Src_Find(rule_position, ip_src_bits, selector, hash);
+
+            if ( i == -1 && counters_ipc->after_count_by_src < IPC_Max(AFTER_BY_SRC) )
+                {
+
+                    memcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].ipsrc, ip_src_bits, sizeof(afterbysrc_ipc[counters_ipc->after_count_by_src].ipsrc));
+                    strlcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].sid, rulestruct[rule_position].s_sid, sizeof(afterbysrc_ipc[counters_ipc->after_count_by_src].sid));
+                    selector == NULL ? afterbysrc_ipc[counters_ipc->after_count_by_src].selector[0] = '\0' : strlcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].selector, selector, MAXSELECTOR);
+                    afterbysrc_ipc[counters_ipc->after_count_by_src].count = 1;
+                    afterbysrc_ipc[counters_ipc->after_count_by_src].utime = utime;
+                    afterbysrc_ipc[counters_ipc->after_count_by_src].expire = rulestruct[rule_position].after_seconds;
+
+                    afterbysrc_ipc[counters_ipc->after_count_by_src].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
+
+                    IPC_Index_Add(afterbysrc_index, hash, counters_ipc->after_count_by_src, utime + rulestruct[rule_position].after_seconds);
+                    counters_ipc->after_count_by_src++;
 
                 }
+
         }
 
+    if ( i != -1 )
+        {
 
-    /* If not found,  add it to the array */
+            afterbysrc_ipc[i].count++;
+            afterbysrc_ipc[i].total_count++;
 
-    if ( Clean_IPC_Object(AFTER_BY_SRC) == 0 )
-        {
+            after_oldtime = utime - afterbysrc_ipc[i].utime;
 
-            File_Lock(config->shm_after_by_src);
-            pthread_mutex_lock(&After_By_Src_Mutex);
+            afterbysrc_ipc[i].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
-            memcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].ipsrc, ip_src_bits, sizeof(afterbysrc_ipc[counters_ipc->after_count_by_src].ipsrc));
-            strlcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].sid, rulestruct[rule_position].s_sid, sizeof(afterbysrc_ipc[counters_ipc->after_count_by_src].sid));
-            selector == NULL ? afterbysrc_ipc[counters_ipc->after_count_by_src].selector[0] = '\0' : strlcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].selector, selector, MAXSELECTOR);
-            afterbysrc_ipc[counters_ipc->after_count_by_src].count = 1;
-            afterbysrc_ipc[counters_ipc->after_count_by_src].utime = atol(timet);
-            afterbysrc_ipc[counters_ipc->after_count_by_src].expire = rulestruct[rule_position].after_seconds;
 
-            strlcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].syslog_message, syslog_message, sizeof(afterbysrc_ipc[counters_ipc->after_count_by_src].syslog_message));
-            strlcpy(afterbysrc_ipc[counters_ipc->after_count_by_src].signature_msg, rulestruct[rule_position].s_msg, sizeof(afterbysrc_ipc[counters_ipc->after_count_by_src].signature_msg));
+            /* Reset counter if it's expired */
+
+            if ( after_oldtime > rulestruct[rule_position].after_seconds ||
+                    afterbysrc_ipc[i].count == 0 )
+                {
 
-            counters_ipc->after_count_by_src++;
+                    afterbysrc_ipc[i].count=1;
+                    afterbysrc_ipc[i].utime = utime;
+
+                    after_log_flag = true;
+                }
+
+            if ( rulestruct[rule_position].after_count < afterbysrc_ipc[i].count )
+                {
+
+                    after_log_flag = false;
+
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "After SID %s by source IP address. [%s]", afterbysrc_ipc[i].sid, ip_src);
+                        }
+
+                    __atomic_add_fetch(&counters->after_total, 1, __ATOMIC_RELAXED);
+                }
+
+        }
 
+    IPC_Index_Unlock(afterbysrc_index, hash);
+
+    if ( locked == true )
+        {
             pthread_mutex_unlock(&After_By_Src_Mutex);
             File_Unlock(config->shm_after_by_src);
-
         }
 
-    return(true);
+    return(after_log_flag);
 }
 
 /************************/
 /* After by Destination */
 /************************/
 
+/* The after by destination record for the event,  or -1 */
+
+static int After_By_Dst_Find( int rule_position, unsigned char *ip_dst_bits, char *selector, uint32_t hash )
+{
+
+    int i;
+
+    uint32_t slot = 0;
+
+    for ( slot = hash; ( i = IPC_Index_Next(afterbydst_index, hash, &slot) ) != -1; )
+        {
+
+            if ( !memcmp(afterbydst_ipc[i].ipdst, ip_dst_bits, sizeof(afterbydst_ipc[i].ipdst)) &&
+                    !strcmp(afterbydst_ipc[i].sid, rulestruct[rule_position].s_sid ) &&
+                    ( selector == NULL || !strcmp(selector, afterbydst_ipc[i].selector)) )
+                {
+                    return(i);
+                }
+        }
+
+    return(-1);
+}
+
 bool After_By_Dst ( int rule_position, char *ip_dst, unsigned char *ip_dst_bits, char *selector, char *syslog_message )
 {
 
     bool after_log_flag = true;
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    uint64_t utime = time(NULL);
 
     int i;
 
+    uint32_t hash = 0;
+
+    bool locked = false;
+
     uint64_t after_oldtime;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    /* Find the matching dst / sid via the hash index (see ipc.c) */
 
-    for (i = 0; i < counters_ipc->after_count_by_dst; i++ )
-        {
+    hash = IPC_Index_Hash(ip_dst_bits, MAXIPBIT, rulestruct[rule_position].s_sid, selector);
 
-            if ( !memcmp(afterbydst_ipc[i].ipdst, ip_dst, sizeof(afterbydst_ipc[i].ipdst)) &&
-                    !strcmp(afterbydst_ipc[i].sid, rulestruct[rule_position].s_sid ) &&
-                    ( selector == NULL || !strcmp(selector, afterbydst_ipc[i].selector)) )
-                {
+    IPC_Index_Lock(afterbydst_index, hash);
 
-                    File_Lock(config->shm_after_by_dst);
-                    pthread_mutex_lock(&After_By_Dst_Mutex);
+    i = After_By_Dst_Find(rule_position, ip_dst_bits, selector, hash);
 
-                    afterbydst_ipc[i].count++;
-                    afterbydst_ipc[i].total_count++;
+    /* If not found,  add it to the array.  See After_By_Src() */
 
-                    after_oldtime = atol(timet) - afterbydst_ipc[i].utime;
+    if ( i == -1 )
+        {
 
-                    strlcpy(afterbydst_ipc[i].syslog_message, syslog_message, sizeof(afterbydst_ipc[i].syslog_message));
-                    strlcpy(afterbydst_ipc[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(afterbydst_ipc[i].signature_msg));
+            IPC_Index_Unlock(afterbydst_index, hash);
 
-                    if ( after_oldtime > rulestruct[rule_position].after_seconds ||
-                            afterbydst_ipc[i].count == 0 )
-                        {
+            Clean_IPC_Object(AFTER_BY_DST);
 
-                            afterbydst_ipc[i].count=1;
-                            afterbydst_ipc[i].utime = atol(timet);
-                            after_log_flag = true;
-                        }
+            File_Lock(config->shm_after_by_dst);
+            pthread_mutex_lock(&After_By_Dst_Mutex);
+            IPC_Index_Lock(afterbydst_index, hash);
 
-                    if ( rulestruct[rule_position].after_count < afterbydst_ipc[i].count )
-                        {
+            locked = true;
 
-                            after_log_flag = false;
+            i = After_By_Dst_Find(rule_position, ip_dst_bits, selector, hash);
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "After SID %s by destination IP address. [%s]", afterbydst_ipc[i].sid, ip_dst);
-                                }
+            if ( i == -1 && counters_ipc->after_count_by_dst < IPC_Max(AFTER_BY_DST) )
+                {
 
-                            counters->after_total++;
-                        }
+                    memcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].ipdst, ip_dst_bits, sizeof(afterbydst_ipc[counters_ipc->after_count_by_dst].ipdst));
+                    strlcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].sid, rulestruct[rule_position].s_sid, sizeof(afterbydst_ipc[counters_ipc->after_count_by_dst].sid));
+                    selector == NULL ? afterbydst_ipc[counters_ipc->after_count_by_dst].selector[0] = '\0' : strlcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].selector, selector, MAXSELECTOR);
+                    afterbydst_ipc[counters_ipc->after_count_by_dst].count = 1;
+                    afterbydst_ipc[counters_ipc->after_count_by_dst].utime = utime;
+                    afterbydst_ipc[counters_ipc->after_count_by_dst].expire = rulestruct[rule_position].after_seconds;
 
-                    pthread_mutex_unlock(&After_By_Dst_Mutex);
-                    File_Unlock(config->shm_after_by_dst);
+                    afterbydst_ipc[counters_ipc->after_count_by_dst].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
-                    return(after_log_flag);
+
+                    IPC_Index_Add(afterbydst_index, hash, counters_ipc->after_count_by_dst, utime + rulestruct[rule_position].after_seconds);
+                    counters_ipc->after_count_by_dst++;
 
                 }
+
         }
 
+    if ( i != -1 )
+        {
 
-    /* If not found,  add it to the array */
+            afterbydst_ipc[i].count++;
+            afterbydst_ipc[i].total_count++;
 
-    if ( Clean_IPC_Object(AFTER_BY_DST) == 0 )
-        {
+            after_oldtime = utime - afterbydst_ipc[i].utime;
 
-            File_Lock(config->shm_after_by_dst);
-            pthread_mutex_lock(&After_By_Dst_Mutex);
+            afterbydst_ipc[i].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
-            memcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].ipdst, ip_dst_bits, sizeof(afterbydst_ipc[counters_ipc->after_count_by_dst].ipdst));
-            strlcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].sid, rulestruct[rule_position].s_sid, sizeof(afterbydst_ipc[counters_ipc->after_count_by_dst].sid));
-            selector == NULL ? afterbydst_ipc[counters_ipc->after_count_by_dst].selector[0] = '\0' : strlcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].selector, selector, MAXSELECTOR);
-            afterbydst_ipc[counters_ipc->after_count_by_dst].count = 1;
-            afterbydst_ipc[counters_ipc->after_count_by_dst].utime = atol(timet);
-            afterbydst_ipc[counters_ipc->after_count_by_dst].expire = rulestruct[rule_position].after_seconds;
+            if ( after_oldtime > rulestruct[rule_position].after_seconds ||
+                    afterbydst_ipc[i].count == 0 )
+                {
 
-            strlcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].syslog_message, syslog_message, sizeof(afterbydst_ipc[counters_ipc->after_count_by_dst].syslog_message));
-            strlcpy(afterbydst_ipc[counters_ipc->after_count_by_dst].signature_msg, rulestruct[rule_position].s_msg, sizeof(afterbydst_ipc[counters_ipc->after_count_by_dst].signature_msg));
+                    afterbydst_ipc[i].count=1;
+                    afterbydst_ipc[i].utime = utime;
+                    after_log_flag = true;
+                }
 
+            if ( rulestruct[rule_position].after_count < afterbydst_ipc[i].count )
+                {
 
-            counters_ipc->after_count_by_dst++;
+                    after_log_flag = false;
 
-            pthread_mutex_unlock(&After_By_Dst_Mutex);
-            File_Unlock(config->shm_after_by_dst);
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "After SID %s by destination IP address. [%s]", afterbydst_ipc[i].sid, ip_dst);
+                        }
+
+                    __atomic_add_fetch(&counters->after_total, 1, __ATOMIC_RELAXED);
+                }
 
         }
 
-    return(true);
+    IPC_Index_Unlock(afterbydst_index, hash);
 
+    if ( locked == true )
+        {
+            pthread_mutex_unlock(&After_By_Dst_Mutex);
+            File_Unlock(config->shm_after_by_dst);
+        }
+
+    return(after_log_flag);
 }
 
 /*********************/
 /* After by username */
 /*********************/
 
-bool After_By_Username( int rule_position, char *normalize_username, char *selector, char *syslog_message )
-{
+/* The after by username record for the event,  or -1 */
 
-    bool after_log_flag = true;
-
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+static int After_By_Username_Find( int rule_position, char *normalize_username, char *selector, uint32_t hash )
+{
 
     int i;
 
-    uint64_t after_oldtime;
+    uint32_t slot = 0;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
-    /* Check array for matching username / sid */
-
-    for (i = 0; i < counters_ipc->after_count_by_username; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(afterbyusername_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -303,100 +367,140 @@ bool After_By_Username( int rule_position, char *normalize_username, char *selec
             if ( !strcmp(afterbyusername_ipc[i].username, normalize_username) &&
                     !strcmp(afterbyusername_ipc[i].sid, rulestruct[rule_position].s_sid))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_after_by_username);
-                    pthread_mutex_lock(&After_By_Username_Mutex);
+    return(-1);
+}
 
-                    afterbyusername_ipc[i].count++;
-                    afterbyusername_ipc[i].total_count++;
+bool After_By_Username( int rule_position, char *normalize_username, char *selector, char *syslog_message )
+{
 
-                    after_oldtime = atol(timet) - afterbyusername_ipc[i].utime;
+    bool after_log_flag = true;
 
-                    strlcpy(afterbyusername_ipc[i].syslog_message, syslog_message, sizeof(afterbyusername_ipc[i].syslog_message));
-                    strlcpy(afterbyusername_ipc[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(afterbyusername_ipc[i].signature_msg));
+    uint64_t utime = time(NULL);
 
-                    if ( after_oldtime > rulestruct[rule_position].after_seconds ||
-                            afterbysrc_ipc[i].count == 0 )
-                        {
+    int i;
 
-                            afterbyusername_ipc[i].count=1;
-                            afterbyusername_ipc[i].utime = atol(timet);
+    uint32_t hash = 0;
 
-                            after_log_flag = true;
-                        }
+    char username[sizeof(afterbyusername_ipc[0].username)] = { 0 };
 
-                    if ( rulestruct[rule_position].after_count < afterbyusername_ipc[i].count )
-                        {
-                            after_log_flag = false;
+    bool locked = false;
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "After SID %s by_username. [%s]", afterbyusername_ipc[i].sid, normalize_username);
-                                }
+    uint64_t after_oldtime;
 
-                            counters->after_total++;
+    /* Hash,  compare and store the username as the record holds it.  A
+       longer one would hash to a different slot than the reaper finds */
 
-                        }
+    strlcpy(username, normalize_username, sizeof(username));
+    normalize_username = username;
 
-                    pthread_mutex_unlock(&After_By_Username_Mutex);
-                    File_Unlock(config->shm_after_by_username);
+    /* Find the matching username / sid via the hash index (see ipc.c) */
 
-                    return(after_log_flag);
+    hash = IPC_Index_Hash(normalize_username, strlen(normalize_username), rulestruct[rule_position].s_sid, selector);
 
-                }
-        }
+    IPC_Index_Lock(afterbyusername_index, hash);
 
-    /* If not found, add to the username array */
+    i = After_By_Username_Find(rule_position, normalize_username, selector, hash);
 
-    if ( Clean_IPC_Object(AFTER_BY_DST) == 0 )
+    /* If not found,  add it to the array.  See After_By_Src() */
+
+    if ( i == -1 )
         {
 
+            IPC_Index_Unlock(afterbyusername_index, hash);
+
+            Clean_IPC_Object(AFTER_BY_USERNAME);
+
             File_Lock(config->shm_after_by_username);
             pthread_mutex_lock(&After_By_Username_Mutex);
+            IPC_Index_Lock(afterbyusername_index, hash);
+
+            locked = true;
+
+            i = After_By_Username_Find(rule_position, normalize_username, selector, hash);
+
+            if ( i == -1 && counters_ipc->after_count_by_username < IPC_Max(AFTER_BY_USERNAME) )
+                {
+
+                    strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].username, normalize_username, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].username));
+                    strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].sid, rulestruct[rule_position].s_sid, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].sid));
+                    selector == NULL ? afterbyusername_ipc[counters_ipc->after_count_by_username].selector[0] = '\0' : strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].selector, selector, MAXSELECTOR);
+                    afterbyusername_ipc[counters_ipc->after_count_by_username].count = 1;
+                    afterbyusername_ipc[counters_ipc->after_count_by_username].utime = utime;
+                    afterbyusername_ipc[counters_ipc->after_count_by_username].expire = rulestruct[rule_position].after_seconds;
 
-            strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].username, normalize_username, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].username));
-            strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].sid, rulestruct[rule_position].s_sid, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].sid));
-            selector == NULL ? afterbyusername_ipc[counters_ipc->after_count_by_username].selector[0] = '\0' : strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].selector, selector, MAXSELECTOR);
-            afterbyusername_ipc[counters_ipc->after_count_by_username].count = 1;
-            afterbyusername_ipc[counters_ipc->after_count_by_username].utime = atol(timet);
-            afterbyusername_ipc[counters_ipc->after_count_by_username].expire = rulestruct[rule_position].after_seconds;
+                    afterbyusername_ipc[counters_ipc->after_count_by_username].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
-            strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].syslog_message, syslog_message, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].syslog_message));
-            strlcpy(afterbyusername_ipc[counters_ipc->after_count_by_username].signature_msg, rulestruct[rule_position].s_msg, sizeof(afterbyusername_ipc[counters_ipc->after_count_by_username].signature_msg));
+                    IPC_Index_Add(afterbyusername_index, hash, counters_ipc->after_count_by_username, utime + rulestruct[rule_position].after_seconds);
+                    counters_ipc->after_count_by_username++;
 
-            counters_ipc->after_count_by_username++;
+                }
+
+        }
+
+    if ( i != -1 )
+        {
+
+            afterbyusername_ipc[i].count++;
+            afterbyusername_ipc[i].total_count++;
+
+            after_oldtime = utime - afterbyusername_ipc[i].utime;
+
+            afterbyusername_ipc[i].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
+
+            if ( after_oldtime > rulestruct[rule_position].after_seconds ||
+                    afterbyusername_ipc[i].count == 0 )
+                {
+
+                    afterbyusername_ipc[i].count=1;
+                    afterbyusername_ipc[i].utime = utime;
+
+                    after_log_flag = true;
+                }
+
+            if ( rulestruct[rule_position].after_count < afterbyusername_ipc[i].count )
+                {
+                    after_log_flag = false;
+
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "After SID %s by_username. [%s]", afterbyusername_ipc[i].sid, normalize_username);
+                        }
+
+                    __atomic_add_fetch(&counters->after_total, 1, __ATOMIC_RELAXED);
 
+                }
+
+        }
+
+    IPC_Index_Unlock(afterbyusername_index, hash);
+
+    if ( locked == true )
+        {
             pthread_mutex_unlock(&After_By_Username_Mutex);
             File_Unlock(config->shm_after_by_username);
         }
 
-    return(true);
-
+    return(after_log_flag);
 } /* End of After */
 
 /***************************/
 /* After by source IP port */
 /***************************/
 
-bool After_By_SrcPort( int rule_position, uint32_t ip_srcport_u32, char *selector )
-{
-
-    bool after_log_flag = true;
+/* The after by source port record for the event,  or -1 */
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+static int After_By_SrcPort_Find( int rule_position, uint32_t ip_srcport_u32, char *selector, uint32_t hash )
+{
 
     int i;
 
-    uint64_t after_oldtime;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
-
+    uint32_t slot = 0;
 
-    for (i = 0; i < counters_ipc->after_count_by_srcport; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(afterbysrcport_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -412,93 +516,126 @@ bool After_By_SrcPort( int rule_position, uint32_t ip_srcport_u32, char *selecto
             if ( afterbysrcport_ipc[i].ipsrcport == ip_srcport_u32 &&
                     !strcmp(afterbysrcport_ipc[i].sid, rulestruct[rule_position].s_sid ))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_after_by_srcport);
-                    pthread_mutex_lock(&After_By_Src_Port_Mutex);
+    return(-1);
+}
 
-                    afterbysrcport_ipc[i].count++;
-                    afterbysrcport_ipc[i].total_count++;
+bool After_By_SrcPort( int rule_position, uint32_t ip_srcport_u32, char *selector )
+{
 
-                    after_oldtime = atol(timet) - afterbysrcport_ipc[i].utime;
+    bool after_log_flag = true;
 
-                    if ( after_oldtime > rulestruct[rule_position].after_seconds ||
-                            afterbysrc_ipc[i].count == 0 )
-                        {
+    uint64_t utime = time(NULL);
 
-                            afterbysrcport_ipc[i].count=1;
-                            afterbysrcport_ipc[i].utime = atol(timet);
-                            after_log_flag = true;
-                        }
+    int i;
 
-                    if ( rulestruct[rule_position].after_count < afterbysrcport_ipc[i].count )
-                        {
-                            after_log_flag = false;
+    uint32_t hash = 0;
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "After SID %s by source IP port. [%d]", afterbysrcport_ipc[i].sid, ip_srcport_u32);
-                                }
+    bool locked = false;
 
-                            counters->after_total++;
-                        }
+    uint64_t after_oldtime;
 
-                    pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-                    File_Unlock(config->shm_after_by_srcport);
+    /* Find the matching src port / sid via the hash index (see ipc.c) */
 
-                    return(after_log_flag);
+    hash = IPC_Index_Hash(&ip_srcport_u32, sizeof(uint32_t), rulestruct[rule_position].s_sid, selector);
 
-                }
-        }
+    IPC_Index_Lock(afterbysrcport_index, hash);
+
+    i = After_By_SrcPort_Find(rule_position, ip_srcport_u32, selector, hash);
 
-    /* If not found,  add it to the array */
+    /* If not found,  add it to the array.  See After_By_Src() */
 
-    if ( Clean_IPC_Object(AFTER_BY_SRCPORT) == 0 )
+    if ( i == -1 )
         {
 
+            IPC_Index_Unlock(afterbysrcport_index, hash);
+
+            Clean_IPC_Object(AFTER_BY_SRCPORT);
+
             File_Lock(config->shm_after_by_srcport);
             pthread_mutex_lock(&After_By_Src_Port_Mutex);
+            IPC_Index_Lock(afterbysrcport_index, hash);
 
-            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].ipsrcport = ip_srcport_u32;
-            strlcpy(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid, rulestruct[rule_position].s_sid, sizeof(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid));
-            selector == NULL ? afterbysrcport_ipc[counters_ipc->after_count_by_srcport].selector[0] = '\0' : strlcpy(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].selector, selector, MAXSELECTOR);
-            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].count = 1;
-            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].utime = atol(timet);
-            afterbysrcport_ipc[counters_ipc->after_count_by_srcport].expire = rulestruct[rule_position].after_seconds;
+            locked = true;
 
-            counters_ipc->after_count_by_srcport++;
+            i = After_By_SrcPort_Find(rule_position, ip_srcport_u32, selector, hash);
 
-            pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-            File_Unlock(config->shm_after_by_srcport);
+            if ( i == -1 && counters_ipc->after_count_by_srcport < IPC_Max(AFTER_BY_SRCPORT) )
+                {
+
+                    afterbysrcport_ipc[counters_ipc->after_count_by_srcport].ipsrcport = ip_srcport_u32;
+                    strlcpy(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid, rulestruct[rule_position].s_sid, sizeof(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].sid));
+                    selector == NULL ? afterbysrcport_ipc[counters_ipc->after_count_by_srcport].selector[0] = '\0' : strlcpy(afterbysrcport_ipc[counters_ipc->after_count_by_srcport].selector, selector, MAXSELECTOR);
+                    afterbysrcport_ipc[counters_ipc->after_count_by_srcport].count = 1;
+                    afterbysrcport_ipc[counters_ipc->after_count_by_srcport].utime = utime;
+                    afterbysrcport_ipc[counters_ipc->after_count_by_srcport].expire = rulestruct[rule_position].after_seconds;
+
+                    IPC_Index_Add(afterbysrcport_index, hash, counters_ipc->after_count_by_srcport, utime + rulestruct[rule_position].after_seconds);
+                    counters_ipc->after_count_by_srcport++;
+
+                }
+
+        }
+
+    if ( i != -1 )
+        {
+
+            afterbysrcport_ipc[i].count++;
+            afterbysrcport_ipc[i].total_count++;
+
+            after_oldtime = utime - afterbysrcport_ipc[i].utime;
+
+            if ( after_oldtime > rulestruct[rule_position].after_seconds ||
+                    afterbysrcport_ipc[i].count == 0 )
+                {
+
+                    afterbysrcport_ipc[i].count=1;
+                    afterbysrcport_ipc[i].utime = utime;
+                    after_log_flag = true;
+                }
+
+            if ( rulestruct[rule_position].after_count < afterbysrcport_ipc[i].count )
+                {
+                    after_log_flag = false;
+
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "After SID %s by source IP port. [%d]", afterbysrcport_ipc[i].sid, ip_srcport_u32);
+                        }
+
+                    __atomic_add_fetch(&counters->after_total, 1, __ATOMIC_RELAXED);
+                }
 
         }
 
-    return(true);
+    IPC_Index_Unlock(afterbysrcport_index, hash);
 
+    if ( locked == true )
+        {
+            pthread_mutex_unlock(&After_By_Src_Port_Mutex);
+            File_Unlock(config->shm_after_by_srcport);
+        }
+
+    return(after_log_flag);
 }
 
 /********************************/
 /* After by destination IP port */
 /********************************/
 
-bool After_By_DstPort( int rule_position, uint32_t ip_dstport_u32, char *selector )
-{
-
-    bool after_log_flag = true;
+/* The after by destination port record for the event,  or -1 */
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+static int After_By_DstPort_Find( int rule_position, uint32_t ip_dstport_u32, char *selector, uint32_t hash )
+{
 
     int i;
 
-    uint64_t after_oldtime;
-
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    uint32_t slot = 0;
 
-
-    for (i = 0; i < counters_ipc->after_count_by_dstport; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(afterbydstport_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -514,67 +651,109 @@ bool After_By_DstPort( int rule_position, uint32_t ip_dstport_u32, char *selecto
             if ( afterbydstport_ipc[i].ipdstport == ip_dstport_u32 &&
                     !strcmp(afterbydstport_ipc[i].sid, rulestruct[rule_position].s_sid ))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_after_by_dstport);
-                    pthread_mutex_lock(&After_By_Dst_Port_Mutex);
+    return(-1);
+}
 
-                    afterbydstport_ipc[i].count++;
-                    afterbydstport_ipc[i].total_count++;
+bool After_By_DstPort( int rule_position, uint32_t ip_dstport_u32, char *selector )
+{
 
-                    after_oldtime = atol(timet) - afterbydstport_ipc[i].utime;
+    bool after_log_flag = true;
 
-                    if ( after_oldtime > rulestruct[rule_position].after_seconds ||
-                            afterbysrc_ipc[i].count == 0 )
-                        {
+    uint64_t utime = time(NULL);
 
-                            afterbydstport_ipc[i].count=1;
-                            afterbydstport_ipc[i].utime = atol(timet);
-                            after_log_flag = true;
+    int i;
 
-                        }
+    uint32_t hash = 0;
 
-                    if ( rulestruct[rule_position].after_count < afterbydstport_ipc[i].count )
-                        {
-                            after_log_flag = false;
+    bool locked = false;
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "After SID %s by destination IP port. [%d]", afterbydstport_ipc[i].sid, ip_dstport_u32);
-                                }
+    uint64_t after_oldtime;
 
-                            counters->after_total++;
-                        }
+    /* Find the matching dst port / sid via the hash index (see ipc.c) */
 
-                    pthread_mutex_unlock(&After_By_Dst_Port_Mutex);
-                    File_Unlock(config->shm_after_by_dstport);
+    hash = IPC_Index_Hash(&ip_dstport_u32, sizeof(uint32_t), rulestruct[rule_position].s_sid, selector);
 
-                    return(after_log_flag);
+    IPC_Index_Lock(afterbydstport_index, hash);
 
-                }
-        }
+    i = After_By_DstPort_Find(rule_position, ip_dstport_u32, selector, hash);
 
-    /* If not found,  add it to the array */
+    /* If not found,  add it to the array.  See After_By_Src() */
 
-    if ( Clean_IPC_Object(AFTER_BY_DSTPORT) == 0 )
+    if ( i == -1 )
         {
 
+            IPC_Index_Unlock(afterbydstport_index, hash);
+
+            Clean_IPC_Object(AFTER_BY_DSTPORT);
+
             File_Lock(config->shm_after_by_dstport);
             pthread_mutex_lock(&After_By_Dst_Port_Mutex);
+            IPC_Index_Lock(afterbydstport_index, hash);
 
-            afterbydstport_ipc[counters_ipc->after_count_by_dstport].ipdstport = ip_dstport_u32;
-            strlcpy(afterbydstport_ipc[counters_ipc->after_count_by_dstport].sid, rulestruct[rule_position].s_sid, sizeof(afterbydstport_ipc[counters_ipc->after_count_by_dstport].sid));
-            selector == NULL ? afterbydstport_ipc[counters_ipc->after_count_by_dstport].selector[0] = '\0' : strlcpy(afterbydstport_ipc[counters_ipc->after_count_by_dstport].selector, selector, MAXSELECTOR);
-            afterbydstport_ipc[counters_ipc->after_count_by_dstport].count = 1;
-            afterbydstport_ipc[counters_ipc->after_count_by_dstport].utime = atol(timet);
-            afterbydstport_ipc[counters_ipc->after_count_by_dstport].expire = rulestruct[rule_position].after_seconds;
+            locked = true;
 
-            counters_ipc->after_count_by_dstport++;
+            i = After_By_DstPort_Find(rule_position, ip_dstport_u32, selector, hash);
 
-            pthread_mutex_unlock(&After_By_Dst_Port_Mutex);
-            File_Unlock(config->shm_after_by_dstport);
+            if ( i == -1 && counters_ipc->after_count_by_dstport < IPC_Max(AFTER_BY_DSTPORT) )
+                {
+
+                    afterbydstport_ipc[counters_ipc->after_count_by_dstport].ipdstport = ip_dstport_u32;
+                    strlcpy(afterbydstport_ipc[counters_ipc->after_count_by_dstport].sid, rulestruct[rule_position].s_sid, sizeof(afterbydstport_ipc[counters_ipc->after_count_by_dstport].sid));
+                    selector == NULL ? afterbydstport_ipc[counters_ipc->after_count_by_dstport].selector[0] = '\0' : strlcpy(afterbydstport_ipc[counters_ipc->after_count_by_dstport].selector, selector, MAXSELECTOR);
+                    afterbydstport_ipc[counters_ipc->after_count_by_dstport].count = 1;
+                    afterbydstport_ipc[counters_ipc->after_count_by_dstport].utime = utime;
+                    afterbydstport_ipc[counters_ipc->after_count_by_dstport].expire = rulestruct[rule_position].after_seconds;
+
+                    IPC_Index_Add(afterbydstport_index, hash, counters_ipc->after_count_by_dstport, utime + rulestruct[rule_position].after_seconds);
+                    counters_ipc->after_count_by_dstport++;
+
+                }
 
         }
 
-    return(true);
+    if ( i != -1 )
+        {
+
+            afterbydstport_ipc[i].count++;
+            afterbydstport_ipc[i].total_count++;
+
+            after_oldtime = utime - afterbydstport_ipc[i].utime;
+
+            if ( after_oldtime > rulestruct[rule_position].after_seconds ||
+                    afterbydstport_ipc[i].count == 0 )
+                {
+
+                    afterbydstport_ipc[i].count=1;
+                    afterbydstport_ipc[i].utime = utime;
+                    after_log_flag = true;
+
+                }
+
+            if ( rulestruct[rule_position].after_count < afterbydstport_ipc[i].count )
+                {
+                    after_log_flag = false;
+
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "After SID %s by destination IP port. [%d]", afterbydstport_ipc[i].sid, ip_dstport_u32);
+                        }
+
+                    __atomic_add_fetch(&counters->after_total, 1, __ATOMIC_RELAXED);
+                }
+
+        }
+
+    IPC_Index_Unlock(afterbydstport_index, hash);
+
+    if ( locked == true )
+        {
+            pthread_mutex_unlock(&After_By_Dst_Port_Mutex);
+            File_Unlock(config->shm_after_by_dstport);
+        }
 
+    return(after_log_flag);
 }
@@ -39,12 +39,14 @@
 #include "sagan-defs.h"
 #include "config-yaml.h"
 #include "rules.h"
+#include "rules-index.h"
 #include "sagan-config.h"
 #include "classifications.h"
 #include "gen-msg.h"
 #include "protocol-map.h"
 #include "references.h"
 #include "parsers/parsers.h"
+#include "input.h"
 
 /* Processors */
 
@@ -140,7 +142,7 @@ void Load_YAML_Config( char *yaml_file )
             config->sagan_host[0] = '\0';
             config->sagan_port = 514;
 
-            /* Defaults for Parse_IP(); */
+            /* Defaults for Parse_Extract() / Parse_IP_Token(); */
 
             config->parse_ip_ipv6 = true;
             config->parse_ip_ipv4_mapped_ipv6 = false;
@@ -158,10 +160,29 @@ void Load_YAML_Config( char *yaml_file )
             config->max_after_by_username = DEFAULT_IPC_AFTER_BY_USERNAME;
 
             config->max_track_clients = DEFAULT_IPC_CLIENT_TRACK_IPC;
+            config->max_samples = DEFAULT_IPC_SAMPLES;
             config->pp_sagan_track_clients = TRACK_TIME;
 
             config->sagan_proto = 17;           /* Default to UDP */
             config->max_processor_threads = MAX_PROCESSOR_THREADS;
+            config->queue_depth = DEFAULT_QUEUE_DEPTH;
+            config->pcre_jit_stack = PCRE_JIT_STACK_MAX;
+
+            /* JIT is on unless 'pcre-jit' or the OS says otherwise.  Reset here so
+               dropping 'pcre-jit: no' and reloading turns it back on */
+
+#ifdef PCRE_HAVE_JIT
+            config->pcre_jit = PageSupportsRWX() ? true : false;
+#endif
+            config->rule_reorder_interval = DEFAULT_RULE_REORDER_INTERVAL;
+
+            strlcpy(config->listener_address, LISTENER_ADDRESS, sizeof(config->listener_address));
+            config->listener_udp_port = LISTENER_PORT;
+            config->listener_tcp_port = 0;
+            config->listener_udp_threads = LISTENER_THREADS;
+            config->listener_batch = LISTENER_BATCH;
+            config->listener_reuseport = true;
+            config->listener_max_connections = LISTENER_MAX_CONNECTIONS;
 
             config->eve_fd              = -1;
             config->sagan_alert_fd      = -1;
@@ -544,6 +565,16 @@ void Load_YAML_Config( char *yaml_file )
                                     sub_type = YAML_SAGAN_CORE_PLOG;
                                 }
 
+                            else if (!strcmp(value, "syslog-listener" ))
+                                {
+                                    sub_type = YAML_SAGAN_CORE_LISTENER;
+                                }
+
+                            else if (!strcmp(value, "inputs" ))
+                                {
+                                    sub_type = YAML_SAGAN_CORE_INPUTS;
+                                }
+
                             /* Enter sub-types */
 
                             if ( sub_type == YAML_SAGAN_CORE_CORE )
@@ -658,6 +689,67 @@ void Load_YAML_Config( char *yaml_file )
 
                                         }
 
+                                    else if (!strcmp(last_pass, "queue-depth"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+                                            config->queue_depth = strtoull(tmp, NULL, 10);
+
+                                            if ( config->queue_depth == 0 || config->queue_depth > MAX_QUEUE_DEPTH )
+                                                {
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan:core 'queue-depth' must be between 1 and %d. Abort!", __FILE__, __LINE__, MAX_QUEUE_DEPTH);
+                                                }
+
+                                        }
+
+                                    else if (!strcmp(last_pass, "pcre-jit"))
+                                        {
+
+                                            /* JIT is on by default if PCRE & the OS support it */
+
+                                            if (!strcasecmp(value, "no") || !strcasecmp(value, "false") || !strcasecmp(value, "disabled") )
+                                                {
+                                                    config->pcre_jit = false;
+                                                }
+
+                                        }
+
+                                    else if (!strcmp(last_pass, "pcre-jit-stack"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+                                            config->pcre_jit_stack = atoi(tmp);
+
+                                            if ( config->pcre_jit_stack < PCRE_JIT_STACK_START )
+                                                {
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan:core 'pcre-jit-stack' must be at least %d. Abort!", __FILE__, __LINE__, PCRE_JIT_STACK_START);
+                                                }
+
+                                        }
+
+                                    else if (!strcmp(last_pass, "rule-reorder"))
+                                        {
+
+                                            if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") || !strcasecmp(value, "enabled") )
+                                                {
+                                                    config->rule_reorder = true;
+                                                }
+
+                                        }
+
+                                    else if (!strcmp(last_pass, "rule-reorder-interval"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+                                            config->rule_reorder_interval = strtoull(tmp, NULL, 10);
+
+                                            if ( config->rule_reorder_interval < RULE_REORDER_SAMPLE )
+                                                {
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan:core 'rule-reorder-interval' must be at least %d. Abort!", __FILE__, __LINE__, RULE_REORDER_SAMPLE);
+                                                }
+
+                                        }
+
                                     else if (!strcmp(last_pass, "classification"))
                                         {
 
@@ -825,6 +917,18 @@ void Load_YAML_Config( char *yaml_file )
                                                 }
                                         }
 
+                                    else if (!strcmp(last_pass, "samples"))
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+                                            config->max_samples = atoi(tmp);
+
+                                            if ( config->max_samples < 0 )
+                                                {
+                                                    Sagan_Log(ERROR, "[%s, line %d] sagan-core|mmap-ipc - 'samples' is less than zero.  Abort!", __FILE__, __LINE__);
+                                                }
+                                        }
+
                                 } /* if sub_type == YAML_SAGAN_CORE_MMAP_IPC */
 
                             if ( sub_type == YAML_SAGAN_CORE_IGNORE_LIST )
@@ -1111,6 +1215,131 @@ void Load_YAML_Config( char *yaml_file )
 #endif
 
 
+                            /* Additional FIFOs/files.  Reader threads can't be added on a
+                               reload,  so these are only loaded at start up */
+
+                            if ( sub_type == YAML_SAGAN_CORE_INPUTS && strcmp(value, "inputs") && config->sagan_reload == false )
+                                {
+
+                                    Var_To_Value(value, tmp, sizeof(tmp));
+
+                                    if (!strncmp(tmp, "file:", 5))
+                                        {
+                                            Sagan_Input_Add(tmp + 5, true);
+                                        }
+
+                                    else if (!strncmp(tmp, "fifo:", 5))
+                                        {
+                                            Sagan_Input_Add(tmp + 5, false);
+                                        }
+
+                                    else
+                                        {
+                                            Sagan_Input_Add(tmp, false);
+                                        }
+
+                                } /* if sub_type == YAML_SAGAN_CORE_INPUTS */
+
+                            if ( sub_type == YAML_SAGAN_CORE_LISTENER )
+                                {
+
+                                    if (!strcmp(last_pass, "enabled"))
+                                        {
+
+                                            if (!strcasecmp(value, "yes") || !strcasecmp(value, "true") )
+                                                {
+                                                    config->listener_flag = true;
+                                                }
+                                        }
+
+                                    if ( config->listener_flag == true )
+                                        {
+
+                                            if (!strcmp(last_pass, "address"))
+                                                {
+
+                                                    Var_To_Value(value, tmp, sizeof(tmp));
+                                                    strlcpy(config->listener_address, tmp, sizeof(config->listener_address));
+
+                                                }
+
+                                            else if (!strcmp(last_pass, "udp-port"))
+                                                {
+
+                                                    Var_To_Value(value, tmp, sizeof(tmp));
+                                                    config->listener_udp_port = atoi(tmp);
+
+                                                    if ( config->listener_udp_port < 0 || config->listener_udp_port > 65535 )
+                                                        {
+                                                            Sagan_Log(ERROR, "[%s, line %d] sagan-core|syslog-listener - 'udp-port' is invalid. Abort!", __FILE__, __LINE__);
+                                                        }
+
+                                                }
+
+                                            else if (!strcmp(last_pass, "tcp-port"))
+                                                {
+
+                                                    Var_To_Value(value, tmp, sizeof(tmp));
+                                                    config->listener_tcp_port = atoi(tmp);
+
+                                                    if ( config->listener_tcp_port < 0 || config->listener_tcp_port > 65535 )
+                                                        {
+                                                            Sagan_Log(ERROR, "[%s, line %d] sagan-core|syslog-listener - 'tcp-port' is invalid. Abort!", __FILE__, __LINE__);
+                                                        }
+
+                                                }
+
+                                            else if (!strcmp(last_pass, "udp-threads"))
+                                                {
+
+                                                    Var_To_Value(value, tmp, sizeof(tmp));
+                                                    config->listener_udp_threads = atoi(tmp);
+
+                                                    if ( config->listener_udp_threads < 1 || config->listener_udp_threads > MAX_LISTENER_THREADS )
+                                                        {
+                                                            Sagan_Log(ERROR, "[%s, line %d] sagan-core|syslog-listener - 'udp-threads' must be between 1 and %d. Abort!", __FILE__, __LINE__, MAX_LISTENER_THREADS);
+                                                        }
+
+                                                }
+
+                                            else if (!strcmp(last_pass, "batch"))
+                                                {
+
+                                                    Var_To_Value(value, tmp, sizeof(tmp));
+                                                    config->listener_batch = atoi(tmp);
+
+                                                    if ( config->listener_batch < 1 || config->listener_batch > MAX_LISTENER_BATCH )
+                                                        {
+                                                            Sagan_Log(ERROR, "[%s, line %d] sagan-core|syslog-listener - 'batch' must be between 1 and %d. Abort!", __FILE__, __LINE__, MAX_LISTENER_BATCH);
+                                                        }
+
+                                                }
+
+                                            else if (!strcmp(last_pass, "max-connections"))
+                                                {
+
+                                                    Var_To_Value(value, tmp, sizeof(tmp));
+                                                    config->listener_max_connections = atoi(tmp);
+
+                                                    if ( config->listener_max_connections < 1 || config->listener_max_connections > MAX_LISTENER_CONNECTIONS )
+                                                        {
+                                                            Sagan_Log(ERROR, "[%s, line %d] sagan-core|syslog-listener - 'max-connections' must be between 1 and %d. Abort!", __FILE__, __LINE__, MAX_LISTENER_CONNECTIONS);
+                                                        }
+
+                                                }
+
+                                            else if (!strcmp(last_pass, "reuseport"))
+                                                {
+
+                                                    if (!strcasecmp(value, "no") || !strcasecmp(value, "false") )
+                                                        {
+                                                            config->listener_reuseport = false;
+                                                        }
+                                                }
+                                        }
+
+                                } /* if sub_type == YAML_SAGAN_CORE_LISTENER */
+
                             if ( sub_type == YAML_SAGAN_CORE_PARSE_IP )
                                 {
 
@@ -1200,6 +1429,11 @@ void Load_YAML_Config( char *yaml_file )
                                     sub_type = YAML_PROCESSORS_DYNAMIC_LOAD;
                                 }
 
+                            else if (!strcmp(value, "rule-profile"))
+                                {
+                                    sub_type = YAML_PROCESSORS_RULE_PROFILE;
+                                }
+
                             if ( sub_type == YAML_PROCESSORS_TRACK_CLIENTS )
                                 {
 
@@ -1543,6 +1777,38 @@ void Load_YAML_Config( char *yaml_file )
 
                                 } /* if sub_type == YAML_PROCESSORS_DYNAMIC_LOAD */
 
+                            else if ( sub_type == YAML_PROCESSORS_RULE_PROFILE )
+                                {
+
+                                    if (!strcmp(last_pass, "enabled"))
+                                        {
+
+                                            if ( !strcasecmp(value, "yes") || !strcasecmp(value, "true") )
+                                                {
+                                                    config->rule_profile_flag = true;
+                                                }
+                                        }
+
+                                    /* 0 == only on SIGUSR2 */
+
+                                    else if (!strcmp(last_pass, "time") && config->rule_profile_flag == true )
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+                                            config->rule_profile_time = atoi(tmp);
+
+                                        }
+
+                                    else if (!strcmp(last_pass, "filename") && config->rule_profile_flag == true )
+                                        {
+
+                                            Var_To_Value(value, tmp, sizeof(tmp));
+                                            strlcpy(config->rule_profile_file_name, tmp, sizeof(config->rule_profile_file_name));
+
+                                        }
+
+                                } /* if sub_type == YAML_PROCESSORS_RULE_PROFILE */
+
                         } /* else if ( type == YAML_TYPE_PROCESSORS */
 
                     else if ( type == YAML_TYPE_OUTPUT )
@@ -2477,6 +2743,14 @@ void Load_YAML_Config( char *yaml_file )
 
 #endif
 
+    /* All rules (including those from included files) are loaded.  Index
+       them for the engine */
+
+    if (!strcmp(config->sagan_config, yaml_file))
+        {
+            Rules_Index_Build(true);
+        }
+
     reload_rules = false;
 
 }
@@ -57,6 +57,8 @@
 #define		YAML_SAGAN_CORE_REDIS		7
 #define		YAML_SAGAN_CORE_SELECTOR        8
 #define		YAML_SAGAN_CORE_PARSE_IP	9
+#define		YAML_SAGAN_CORE_LISTENER	10
+#define		YAML_SAGAN_CORE_INPUTS		11
 
 
 /* Processors */
@@ -67,6 +69,7 @@
 #define		YAML_PROCESSORS_BLUEDOT		10
 #define		YAML_PROCESSORS_BROINTEL	11
 #define		YAML_PROCESSORS_DYNAMIC_LOAD	12
+#define		YAML_PROCESSORS_RULE_PROFILE	21
 
 /* Outputs */
 
@@ -48,6 +48,7 @@
 #include "rules.h"
 #include "geoip2.h"
 #include "sagan-config.h"
+#include "util-memo.h"
 
 struct _SaganConfig *config;
 struct _Rule_Struct *rulestruct;
@@ -87,26 +88,22 @@ void Open_GeoIP2_Database( void )
 }
 
 /*****************************************************************************
- * GeoIP2_Lookup_Country - Looks up the country and determines if
- * it is in/out of HOME_COUNTRY
+ * GeoIP2_Country_Code - Looks up the country code for an IP address.
+ * Returns false if there isn't one.
  ****************************************************************************/
 
-int GeoIP2_Lookup_Country( char *ipaddr, unsigned char *ip_bits, int rule_position )
+static bool GeoIP2_Country_Code( char *ipaddr, unsigned char *ip_bits, char *country, size_t size )
 {
 
-
     int gai_error;
     int mmdb_error;
     int res;
 
-    char *ptmp = NULL;
-    char *tok = NULL;
-
-    char country[2];
-    char tmp[1024];
+    size_t len = 0;
 
     if ( is_notroutable(ip_bits) )
         {
+
             if (debug->debuggeoip2)
                 {
                     Sagan_Log(DEBUG, "[%s, line %d] IP address %s is not routable. Skipping GeoIP2 lookup.", __FILE__, __LINE__, ipaddr);
@@ -128,12 +125,10 @@ int GeoIP2_Lookup_Country( char *ipaddr, unsigned char *ip_bits, int rule_positi
 
             Sagan_Log(WARN, "Country code MMDB_get_value failure (%s) for %s.", MMDB_strerror(res), ipaddr);
             return(false);
-
         }
 
     if (!entry_data.has_data || entry_data.type != MMDB_DATA_TYPE_UTF8_STRING)
         {
-
             pthread_mutex_lock(&CountGeoIP2MissMutex);
             counters->geoip2_miss++;
             pthread_mutex_unlock(&CountGeoIP2MissMutex);
@@ -142,10 +137,58 @@ int GeoIP2_Lookup_Country( char *ipaddr, unsigned char *ip_bits, int rule_positi
                 {
                     Sagan_Log(DEBUG, "Country code for %s not found in GeoIP2 DB", ipaddr);
                 }
+
+            return(false);
+        }
+
+    /* utf8_string isn't NUL terminated */
+
+    len = entry_data.data_size < size - 1 ? entry_data.data_size : size - 1;
+
+    memcpy(country, entry_data.utf8_string, len);
+    country[len] = '\0';
+
+    return(true);
+}
+
+/*****************************************************************************
+ * GeoIP2_Lookup_Country - Looks up the country and determines if
+ * it is in/out of HOME_COUNTRY.  The country is only looked up once
+ * per event (see util-memo.c),  no matter how many rules ask.
+ ****************************************************************************/
+
+int GeoIP2_Lookup_Country( char *ipaddr, unsigned char *ip_bits, int rule_position )
+{
+
+    char *ptmp = NULL;
+    char *tok = NULL;
+
+    char country[3] = { 0 };
+    char tmp[1024];
+
+    int memo_result = 0;
+
+    if ( Sagan_Memo_Get(MEMO_GEOIP2, 0, ip_bits, MAXIPBIT, &memo_result) == true )
+        {
+            country[0] = ( memo_result >> 8 ) & 0xff;
+            country[1] = memo_result & 0xff;
+        }
+    else
+        {
+
+            if ( GeoIP2_Country_Code(ipaddr, ip_bits, country, sizeof(country)) == false )
+                {
+                    country[0] = '\0';
+                }
+
+            Sagan_Memo_Set(MEMO_GEOIP2, 0, ip_bits, MAXIPBIT, ( (unsigned char)country[0] << 8 ) | (unsigned char)country[1]);
+        }
+
+    if ( country[0] == '\0' )
+        {
             return(false);
         }
 
-    strlcpy(country, entry_data.utf8_string, 3);
     strlcpy(tmp, rulestruct[rule_position].geoip2_country_codes, sizeof(tmp));
 
     if (debug->debuggeoip2)
@@ -155,11 +198,11 @@ int GeoIP2_Lookup_Country( char *ipaddr, unsigned char *ip_bits, int rule_positi
             Sagan_Log(DEBUG, "Found in GeoIP DB: %s", country);
         }
 
-
     ptmp = strtok_r(tmp, ",", &tok);
 
     while (ptmp != NULL )
         {
+
             if (debug->debuggeoip2)
                 {
                     Sagan_Log(DEBUG, "GeoIP2 rule string parsing %s|%s", ptmp, country);
@@ -167,6 +210,7 @@ int GeoIP2_Lookup_Country( char *ipaddr, unsigned char *ip_bits, int rule_positi
 
             if (!strcmp(ptmp, country))
                 {
+
                     if (debug->debuggeoip2)
                         {
                             Sagan_Log(DEBUG, "GeoIP Status: Found in user defined values [%s].", country);
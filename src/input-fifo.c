@@ -0,0 +1,682 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* input-fifo.c
+ *
+ * FIFO/file readers.  Each input configured (the primary FIFO or '-F'
+ * file plus any in the sagan-core 'inputs' list) gets its own reader
+ * thread.  Readers split lines in place and feed the shared worker queue.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#ifdef HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "util-ring.h"
+#include "input-slab.h"
+#include "input.h"
+#include "input-fifo.h"
+#include "lockfile.h"
+
+struct _SaganCounters *counters;
+struct _SaganConfig *config;
+struct _SaganDebug *debug;
+
+_Sagan_Ring *SaganProcRing;
+
+pthread_mutex_t SaganMalformedCounter;
+
+/* The DNS cache is shared by all the readers */
+
+static struct _SaganDNSCache *dnscache = NULL;
+static pthread_mutex_t SaganDNSCacheMutex=PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Input_FIFO_DNS - Resolves "host" into "str",  using (and filling) the DNS
+ * cache.  Lookups are done outside of the lock so one slow lookup doesn't
+ * hold up the other readers.
+ ****************************************************************************/
+
+static void Input_FIFO_DNS( char *host, char *str, size_t size )
+{
+
+    uint64_t i = 0;
+
+    pthread_mutex_lock(&SaganDNSCacheMutex);
+
+    for (i = 0; i < counters->dns_cache_count; i++)  			/* Check cache first */
+        {
+            if (!strcmp( dnscache[i].hostname, host))
+                {
+                    strlcpy(str, dnscache[i].src_ip, size);
+                    pthread_mutex_unlock(&SaganDNSCacheMutex);
+                    return;
+                }
+        }
+
+    pthread_mutex_unlock(&SaganDNSCacheMutex);
+
+    /* Invalid lookups get the config->sagan_host value */
+
+    if ( DNS_Lookup(host, str, size) == -1 )
+        {
+            strlcpy(str, config->sagan_host, size);
+            __atomic_add_fetch(&counters->dns_miss_count, 1, __ATOMIC_RELAXED);
+        }
+
+    /* Add entry to DNS Cache */
+
+    pthread_mutex_lock(&SaganDNSCacheMutex);
+
+    dnscache = (_SaganDNSCache *) realloc(dnscache, (counters->dns_cache_count+1) * sizeof(_SaganDNSCache));
+
+    if ( dnscache == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for dnscache. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(&dnscache[counters->dns_cache_count], 0, sizeof(_SaganDNSCache));
+
+    strlcpy(dnscache[counters->dns_cache_count].hostname, host, sizeof(dnscache[counters->dns_cache_count].hostname));
+    strlcpy(dnscache[counters->dns_cache_count].src_ip, str, sizeof(dnscache[counters->dns_cache_count].src_ip));
+    counters->dns_cache_count++;
+
+    pthread_mutex_unlock(&SaganDNSCacheMutex);
+
+}
+
+/****************************************************************************
+ * Input_FIFO_Thread - Reads one FIFO/file.  FIFOs are re-opened when the
+ * writer goes away.  Files are read once and the thread exits at EOF.
+ ****************************************************************************/
+
+static void Input_FIFO_Thread( _Sagan_Input *input )
+{
+
+    char src_dns_lookup[20] = { 0 };
+
+    bool fifoerr = false;
+
+    char *syslog_host=NULL;
+    char *syslog_facility=NULL;
+    char *syslog_priority=NULL;
+    char *syslog_level=NULL;
+    char *syslog_tag=NULL;
+    char *syslog_date=NULL;
+    char *syslog_time=NULL;
+    char *syslog_program=NULL;
+    char *syslog_msg=NULL;
+
+    _Sagan_Slab *slab = NULL;
+    _Sagan_Slab *new_slab = NULL;
+    size_t slab_offset = 0;
+
+    ssize_t input_bytes = 0;
+    bool input_skip = false;
+    bool input_eof = false;
+
+    char *line = NULL;
+    char *line_end = NULL;
+    char *next_line = NULL;
+
+    char *fields[MAX_SYSLOG_FIELDS] = { NULL };
+    size_t fields_len[MAX_SYSLOG_FIELDS] = { 0 };
+    int field_count = 0;
+
+    bool host_resolved = false;
+
+    struct _Sagan_Proc_Syslog SaganProcSyslog_IN;
+
+    FILE *fd;
+
+    int i;
+
+    (void)SetThreadName("SaganInput");
+
+    memset(&SaganProcSyslog_IN, 0, sizeof(struct _Sagan_Proc_Syslog));
+
+    if ( !input->is_file )
+        {
+
+            Sagan_Log(NORMAL, "Attempting to open syslog FIFO (%s).", input->path);
+
+        }
+    else
+        {
+
+            Sagan_Log(NORMAL, "Attempting to open syslog FILE (%s).", input->path);
+
+        }
+
+    while(true)
+        {
+
+            if (( fd = fopen(input->path, "r" )) == NULL )
+                {
+
+                    if ( input->is_file == false )
+                        {
+
+                            /* try to create it */
+
+                            Sagan_Log(NORMAL, "Fifo not found, creating it (%s).", input->path);
+
+                            if (mkfifo(input->path, 0700) == -1)
+                                {
+                                    Sagan_Log(ERROR, "Could not create FIFO '%s'. Abort!", input->path);
+                                }
+
+                            fd = fopen(input->path, "r");
+
+                            if ( fd == NULL )
+                                {
+                                    Sagan_Log(ERROR, "Error opening %s. Abort!", input->path);
+                                }
+
+                        }
+                    else
+                        {
+
+                            Sagan_Log(ERROR, "Could not open file '%s'. Abort!", input->path);
+                        }
+
+                }
+
+            if ( input->is_file == false )
+                {
+                    Sagan_Log(NORMAL, "Successfully opened FIFO (%s).", input->path);
+
+#if defined(HAVE_GETPIPE_SZ) && defined(HAVE_SETPIPE_SZ)
+
+                    Set_Pipe_Size(fd);
+
+#endif
+
+                }
+            else
+                {
+                    Sagan_Log(NORMAL, "Successfully opened FILE (%s) and processing events.....", input->path);
+                }
+
+            if ( slab == NULL )
+                {
+                    slab = Sagan_Slab_Get();
+                }
+
+            while(fd != NULL)
+                {
+
+
+                    while(true)
+                        {
+
+                            input_bytes = read(fileno(fd), slab->data + slab->len, INPUT_SLAB_SIZE - slab->len);
+
+                            if ( input_bytes < 0 && errno == EINTR )
+                                {
+                                    continue;
+                                }
+
+                            if ( input_bytes <= 0 )
+                                {
+
+                                    /* EOF/error. If there's a partial line without a \n,  fgets()
+                                       would have handed it back so we do too */
+
+                                    if ( slab->len == slab_offset || input_skip == true )
+                                        {
+                                            break;
+                                        }
+
+                                    slab->data[slab->len] = '\n';
+                                    input_bytes = 1;
+                                    input_eof = true;
+                                }
+
+                            /* If the FIFO was in a error state,  let user know the FIFO writer has resumed */
+
+                            if ( fifoerr == true )
+                                {
+
+                                    Sagan_Log(NORMAL, "FIFO writer has restarted. Processing events.");
+
+#if defined(HAVE_GETPIPE_SZ) && defined(HAVE_SETPIPE_SZ)
+
+                                    Set_Pipe_Size(fd);
+
+#endif
+                                    fifoerr = false;
+                                }
+
+                            slab->len += input_bytes;
+                            input->bytes += input_bytes;
+
+                            line = slab->data + slab_offset;
+                            line_end = slab->data + slab->len;
+
+                            while ( line < line_end )
+                                {
+
+                                    /* Throwing away the rest of an over sized line */
+
+                                    if ( input_skip == true )
+                                        {
+
+                                            next_line = memchr(line, '\n', line_end - line);
+
+                                            if ( next_line == NULL )
+                                                {
+                                                    line = line_end;
+                                                    break;
+                                                }
+
+                                            line = next_line + 1;
+                                            input_skip = false;
+                                            continue;
+                                        }
+
+                                    next_line = memchr(line, '\n', line_end - line);
+
+                                    if ( next_line == NULL )
+                                        {
+
+                                            /* Partial line.  Wait for the rest of it */
+
+                                            if ( line_end - line < MAX_SYSLOGMSG - 1 )
+                                                {
+                                                    break;
+                                                }
+
+                                            /* Longer than we handle.  Keep what fits and skip the rest */
+
+                                            next_line = line + MAX_SYSLOGMSG - 1;
+                                            input_skip = true;
+                                        }
+
+                                    *next_line = '\0';
+
+                                    field_count = Sagan_Slab_Split(line, next_line - line, fields, fields_len, MAX_SYSLOG_FIELDS);
+
+                                    /* Every line we hand on counts as received.  Short of the
+                                       9 | delimited fields,  it's also malformed */
+
+                                    input->received++;
+
+                                    if ( field_count < MAX_SYSLOG_FIELDS )
+                                        {
+                                            input->malformed++;
+                                        }
+
+                                    line = next_line + 1;
+
+                                    /* Fields used to be copied into 50 byte buffers.  Keep the
+                                       same limit by terminating them in place */
+
+                                    for ( i = 0; i < field_count && i < MAX_SYSLOG_FIELDS - 1; i++ )
+                                        {
+                                            if ( fields_len[i] >= MAX_SYSLOG_FIELD )
+                                                {
+                                                    fields[i][MAX_SYSLOG_FIELD - 1] = '\0';
+                                                    fields_len[i] = MAX_SYSLOG_FIELD - 1;
+                                                }
+                                        }
+
+                                    syslog_host = field_count > 0 ? fields[0] : NULL;
+
+                                    /* If we're using DNS (and we shouldn't be!),  we start DNS checks and lookups
+                                     * here.  We cache both good and bad lookups to not over load our DNS server(s).
+                                     * The only way DNS cache can be cleared is to restart Sagan */
+
+                                    host_resolved = false;
+
+                                    if (config->syslog_src_lookup )
+                                        {
+
+                                            if ( !Is_IP(syslog_host, IPv4) || !Is_IP(syslog_host, IPv6) )   	/* Is inbound a valid IP? */
+                                                {
+                                                    Input_FIFO_DNS(syslog_host, src_dns_lookup, sizeof(src_dns_lookup));
+                                                    syslog_host = src_dns_lookup;
+                                                    host_resolved = true;
+                                                }
+
+                                        }
+                                    else
+                                        {
+
+                                            /* We check to see if values from our FIFO are valid.  If we aren't doing DNS related
+                                            * stuff (above),  we start basic check with the syslog_host */
+
+                                            if (syslog_host == NULL || !Is_IP(syslog_host, IPv4) || !Is_IP(syslog_host, IPv6) )
+                                                {
+                                                    syslog_host = config->sagan_host;
+
+                                                    pthread_mutex_lock(&SaganMalformedCounter);
+                                                    counters->malformed_host++;
+                                                    pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                                    if ( debug->debugmalformed )
+                                                        {
+                                                            Sagan_Log(DEBUG, "Sagan received a malformed 'host': '%s' (replaced with %s)", syslog_host, config->sagan_host);
+                                                        }
+                                                }
+                                        }
+
+                                    /* We now check the rest of the values */
+
+                                    syslog_facility = field_count > 1 ? fields[1] : NULL;
+                                    if ( syslog_facility == NULL )
+                                        {
+
+                                            syslog_facility = "SAGAN: FACILITY ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_facility++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'facility'");
+                                                }
+                                        }
+
+                                    syslog_priority = field_count > 2 ? fields[2] : NULL;
+                                    if ( syslog_priority == NULL )
+                                        {
+
+                                            syslog_priority = "SAGAN: PRIORITY ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_priority++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'priority'");
+                                                }
+                                        }
+
+                                    syslog_level = field_count > 3 ? fields[3] : NULL;
+                                    if ( syslog_level == NULL )
+                                        {
+
+                                            syslog_level = "SAGAN: LEVEL ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_level++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'level'");
+                                                }
+                                        }
+
+                                    syslog_tag = field_count > 4 ? fields[4] : NULL;
+                                    if ( syslog_tag == NULL )
+                                        {
+
+                                            syslog_tag = "SAGAN: TAG ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_tag++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'tag'");
+                                                }
+                                        }
+
+                                    syslog_date = field_count > 5 ? fields[5] : NULL;
+                                    if ( syslog_date == NULL )
+                                        {
+
+                                            syslog_date = "SAGAN: DATE ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_date++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'date'");
+                                                }
+                                        }
+
+                                    syslog_time = field_count > 6 ? fields[6] : NULL;
+                                    if ( syslog_time == NULL )
+                                        {
+
+                                            syslog_time = "SAGAN: TIME ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_time++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'time'");
+                                                }
+                                        }
+
+
+                                    syslog_program = field_count > 7 ? fields[7] : NULL;
+                                    if ( syslog_program == NULL )
+                                        {
+
+                                            syslog_program = "SAGAN: PROGRAM ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_program++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'program'");
+                                                }
+                                        }
+                                    syslog_msg = field_count > 8 ? fields[8] : NULL; /* The message gets everything after the 8th |,  it may have | in it */
+
+                                    if ( syslog_msg == NULL )
+                                        {
+
+                                            syslog_msg = "SAGAN: MESSAGE ERROR";
+
+                                            pthread_mutex_lock(&SaganMalformedCounter);
+                                            counters->malformed_message++;
+                                            pthread_mutex_unlock(&SaganMalformedCounter);
+
+                                            if ( debug->debugmalformed )
+                                                {
+                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'message' [Syslog Host: %s]", syslog_host);
+                                                }
+
+                                            /* If the message is lost,  all is lost.  Typically,  you don't lose part of the message,
+                                             * it's more likely to lose all  - Champ Clark III 11/17/2011 */
+
+                                            __atomic_add_fetch(&counters->sagan_log_drop, 1, __ATOMIC_RELAXED);
+
+                                        }
+
+                                    /* DNS results live in the reader's cache which can move,  so
+                                       those get their own copy.  Everything else points into the slab */
+
+                                    if ( host_resolved == true )
+                                        {
+                                            strlcpy(SaganProcSyslog_IN.syslog_host_lookup, syslog_host, sizeof(SaganProcSyslog_IN.syslog_host_lookup));
+                                            SaganProcSyslog_IN.syslog_host = SaganProcSyslog_IN.syslog_host_lookup;
+                                        }
+                                    else
+                                        {
+                                            SaganProcSyslog_IN.syslog_host = syslog_host;
+                                        }
+
+                                    SaganProcSyslog_IN.syslog_facility = syslog_facility;
+                                    SaganProcSyslog_IN.syslog_priority = syslog_priority;
+                                    SaganProcSyslog_IN.syslog_level = syslog_level;
+                                    SaganProcSyslog_IN.syslog_tag = syslog_tag;
+                                    SaganProcSyslog_IN.syslog_date = syslog_date;
+                                    SaganProcSyslog_IN.syslog_time = syslog_time;
+                                    SaganProcSyslog_IN.syslog_program = syslog_program;
+                                    SaganProcSyslog_IN.syslog_message = syslog_msg;
+                                    SaganProcSyslog_IN.syslog_message_len = field_count > 8 ? fields_len[8] : strlen(syslog_msg);
+
+                                    if ( Sagan_Input_Queue(&SaganProcSyslog_IN, slab) == false )
+                                        {
+                                            input->dropped++;
+                                        }
+
+                                    if (debug->debugthreads)
+                                        {
+                                            Sagan_Log(DEBUG, "[%s, line %d] Current queue depth: %" PRIu64 "", __FILE__, __LINE__, Sagan_Ring_Count(SaganProcRing));
+                                        }
+
+                                    if (debug->debugsyslog)
+                                        {
+
+                                            Sagan_Log(DEBUG, "[%s, line %d] **[RAW Syslog]*********************************", __FILE__, __LINE__);
+                                            Sagan_Log(DEBUG, "[%s, line %d] Host: %s | Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, syslog_host, syslog_program, syslog_facility, syslog_priority, syslog_level, syslog_tag);
+                                            Sagan_Log(DEBUG, "[%s, line %d] Raw message: %s", __FILE__, __LINE__, syslog_msg);
+
+                                        }
+
+
+                                } /* while ( line < line_end ) */
+
+                            if ( line > line_end )
+                                {
+                                    line = line_end;
+                                }
+
+                            slab_offset = line - slab->data;
+
+                            if ( input_eof == true )
+                                {
+                                    input_eof = false;
+                                    break;
+                                }
+
+                            /* Not enough room left for a full line.  Move the partial line
+                               (if any) to a fresh slab.  The old one goes back to the pool
+                               once the workers are done with it. */
+
+                            if ( INPUT_SLAB_SIZE - slab->len < MAX_SYSLOGMSG )
+                                {
+
+                                    new_slab = Sagan_Slab_Get();
+                                    new_slab->len = slab->len - slab_offset;
+                                    memcpy(new_slab->data, slab->data + slab_offset, new_slab->len);
+
+                                    Sagan_Slab_Release(slab);
+
+                                    slab = new_slab;
+                                    slab_offset = 0;
+                                }
+
+                        } /* while(read) */
+
+                    /* read() has returned EOF or an error,  likely due to the FIFO writer leaving */
+
+                    /* RMEOVE LOCK */
+
+                    if ( fifoerr == false )
+                        {
+
+                            if ( input->is_file != 0 )
+                                {
+                                    Sagan_Log(NORMAL, "EOF reached on %s.", input->path);
+
+                                    fclose(fd);
+                                    Sagan_Slab_Release(slab);
+
+                                    __atomic_store_n(&input->eof, true, __ATOMIC_SEQ_CST);
+                                    return;
+
+                                }
+                            else
+                                {
+
+                                    Sagan_Log(WARN, "FIFO writer closed (%s).  Waiting for FIFO writer to restart....", input->path);
+                                    fifoerr = true; 			/* Set flag so our while(read) knows */
+                                }
+                        }
+                    sleep(1);		/* So we don't eat 100% CPU */
+
+                } /* while(fd != NULL)  */
+
+            fclose(fd); 			/* ???? */
+
+        } /* End of while(1) */
+
+}
+
+/****************************************************************************
+ * Sagan_Input_FIFO_Start - Spawn a reader thread for each input
+ ****************************************************************************/
+
+void Sagan_Input_FIFO_Start( void )
+{
+
+    pthread_t input_thread;
+    pthread_attr_t thread_input_attr;
+
+    int i = 0;
+    int rc = 0;
+
+    pthread_attr_init(&thread_input_attr);
+    pthread_attr_setdetachstate(&thread_input_attr,  PTHREAD_CREATE_DETACHED);
+
+    Sagan_Log(NORMAL, "Spawning %d Input Thread(s).", config->input_count);
+
+    for (i = 0; i < config->input_count; i++)
+        {
+
+            rc = pthread_create( &input_thread, &thread_input_attr, (void *)Input_FIFO_Thread, &config->inputs[i] );
+
+            if ( rc != 0 )
+                {
+                    Remove_Lock_File();
+                    Sagan_Log(ERROR, "[%s, line %d] Error creating input thread for %s. [error: %d]", __FILE__, __LINE__, config->inputs[i].path, rc);
+                }
+        }
+
+}
+
@@ -0,0 +1,923 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* input-listener.c
+ *
+ * Native UDP/TCP syslog listener.  This lets Sagan receive syslog directly
+ * rather than through a syslog daemon writing to the FIFO.  UDP datagrams
+ * are received in batches with recvmmsg() (where available) straight into
+ * an input slab,  so like the FIFO path,  messages are parsed in place.
+ * With SO_REUSEPORT each receive thread gets its own socket and the kernel
+ * spreads datagrams between them.
+ *
+ * TCP accepts newline and octet-counted (RFC6587) framing.  Each
+ * connection gets its own thread,  up to 'max-connections' of them.  A
+ * connection only holds a slab while it has data coming in,  so idle
+ * connections don't starve the other inputs of slabs.
+ *
+ * The "host" is the address of the sender.  The "date" and "time" are
+ * when we received the message.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "input-slab.h"
+#include "input.h"
+#include "input-listener.h"
+#include "lockfile.h"
+#include "parsers/parsers.h"
+
+struct _SaganConfig *config;
+struct _SaganDebug *debug;
+
+static int listener_udp_fd[MAX_LISTENER_THREADS];
+static int listener_udp_count = 0;
+static int listener_tcp_fd = -1;
+static int listener_tcp_connections = 0;
+
+/* Listener counters are shared by all the receive threads,  so unlike the
+   FIFO inputs they are updated atomically */
+
+static _Sagan_Input listener_udp_input;
+static _Sagan_Input listener_tcp_input;
+
+/* Keeps a failing socket call from spinning and flooding the log */
+
+typedef struct _Listener_Backoff _Listener_Backoff;
+struct _Listener_Backoff
+{
+    int errors;				/* In a row.  Sets the delay */
+    uint64_t suppressed;		/* Not logged since last_log */
+    time_t last_log;
+};
+
+/****************************************************************************
+ * Listener_Socket - Creates and binds a socket of "type" to the configured
+ * address/port.
+ ****************************************************************************/
+
+static int Listener_Socket( int type, int port, bool reuseport )
+{
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+
+    struct sockaddr_in *addr4 = (struct sockaddr_in *)&addr;
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+
+    int fd = -1;
+    int on = 1;
+
+    memset(&addr, 0, sizeof(addr));
+
+    if ( inet_pton(AF_INET, config->listener_address, &addr4->sin_addr) == 1 )
+        {
+            addr4->sin_family = AF_INET;
+            addr4->sin_port = htons(port);
+            addr_len = sizeof(struct sockaddr_in);
+        }
+
+    else if ( inet_pton(AF_INET6, config->listener_address, &addr6->sin6_addr) == 1 )
+        {
+            addr6->sin6_family = AF_INET6;
+            addr6->sin6_port = htons(port);
+            addr_len = sizeof(struct sockaddr_in6);
+        }
+
+    else
+        {
+            Sagan_Log(ERROR, "[%s, line %d] syslog-listener 'address' %s is not a valid IP address. Abort!", __FILE__, __LINE__, config->listener_address);
+        }
+
+    fd = socket(addr.ss_family, type, 0);
+
+    if ( fd == -1 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot create syslog listener socket. [%s]", __FILE__, __LINE__, strerror(errno));
+        }
+
+    if ( setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1 )
+        {
+            Sagan_Log(WARN, "[%s, line %d] Cannot set SO_REUSEADDR on syslog listener. [%s]", __FILE__, __LINE__, strerror(errno));
+        }
+
+#ifdef SO_REUSEPORT
+
+    if ( reuseport == true && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot set SO_REUSEPORT on syslog listener. [%s]", __FILE__, __LINE__, strerror(errno));
+        }
+
+#endif
+
+    if ( bind(fd, (struct sockaddr *)&addr, addr_len) == -1 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot bind syslog listener to %s:%d. [%s]", __FILE__, __LINE__, config->listener_address, port, strerror(errno));
+        }
+
+    return(fd);
+}
+
+/****************************************************************************
+ * Listener_Peer - Stores the sender's address as the "host"
+ ****************************************************************************/
+
+static void Listener_Peer( struct sockaddr_storage *addr, struct _Sagan_Proc_Syslog *SaganProcSyslog_IN )
+{
+
+    const char *rc = NULL;
+
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)addr;
+
+    if ( addr->ss_family == AF_INET )
+        {
+            rc = inet_ntop(AF_INET, &((struct sockaddr_in *)addr)->sin_addr, SaganProcSyslog_IN->syslog_host_lookup, sizeof(SaganProcSyslog_IN->syslog_host_lookup));
+        }
+
+    /* IPv4 senders on a dual stack socket show up as ::ffff:x.x.x.x */
+
+    else if ( addr->ss_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&addr6->sin6_addr) )
+        {
+            rc = inet_ntop(AF_INET, &addr6->sin6_addr.s6_addr[12], SaganProcSyslog_IN->syslog_host_lookup, sizeof(SaganProcSyslog_IN->syslog_host_lookup));
+        }
+
+    else if ( addr->ss_family == AF_INET6 )
+        {
+            rc = inet_ntop(AF_INET6, &addr6->sin6_addr, SaganProcSyslog_IN->syslog_host_lookup, sizeof(SaganProcSyslog_IN->syslog_host_lookup));
+        }
+
+    if ( rc == NULL )
+        {
+            strlcpy(SaganProcSyslog_IN->syslog_host_lookup, config->sagan_host, sizeof(SaganProcSyslog_IN->syslog_host_lookup));
+        }
+
+    SaganProcSyslog_IN->syslog_host = SaganProcSyslog_IN->syslog_host_lookup;
+
+}
+
+/****************************************************************************
+ * Listener_Error - Called when a socket call fails.  Reports the error at
+ * most once every LISTENER_ERROR_INTERVAL seconds and sleeps a little
+ * longer each time it fails in a row (up to about a second).
+ ****************************************************************************/
+
+static void Listener_Error( _Listener_Backoff *backoff, const char *what, int error )
+{
+
+    time_t now = time(NULL);
+    int shift = backoff->errors < 10 ? backoff->errors : 10;
+
+    if ( now - backoff->last_log >= LISTENER_ERROR_INTERVAL )
+        {
+            Sagan_Log(WARN, "[%s, line %d] Error %s. [%s] (%" PRIu64 " more since the last report)", __FILE__, __LINE__, what, strerror(error), backoff->suppressed);
+
+            backoff->last_log = now;
+            backoff->suppressed = 0;
+        }
+    else
+        {
+            backoff->suppressed++;
+        }
+
+    backoff->errors++;
+
+    usleep( 1000 << shift );
+
+}
+
+/****************************************************************************
+ * Listener_Time - Sets the receive date/time.  The strings are only rebuilt
+ * when the second changes.
+ ****************************************************************************/
+
+static void Listener_Time( struct _Sagan_Proc_Syslog *SaganProcSyslog_IN, time_t *last )
+{
+
+    time_t now = time(NULL);
+    struct tm tm;
+
+    if ( now != *last )
+        {
+
+            localtime_r(&now, &tm);
+            strftime(SaganProcSyslog_IN->syslog_date_buf, sizeof(SaganProcSyslog_IN->syslog_date_buf), "%Y-%m-%d", &tm);
+            strftime(SaganProcSyslog_IN->syslog_time_buf, sizeof(SaganProcSyslog_IN->syslog_time_buf), "%H:%M:%S", &tm);
+
+            *last = now;
+        }
+
+    SaganProcSyslog_IN->syslog_date = SaganProcSyslog_IN->syslog_date_buf;
+    SaganProcSyslog_IN->syslog_time = SaganProcSyslog_IN->syslog_time_buf;
+
+}
+
+/****************************************************************************
+ * Listener_Queue - Parse a received message in place and queue it
+ ****************************************************************************/
+
+static void Listener_Queue( char *msg, size_t len, struct _Sagan_Proc_Syslog *SaganProcSyslog_IN, _Sagan_Slab *slab, _Sagan_Input *input )
+{
+
+    __atomic_add_fetch(&input->received, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&input->bytes, len, __ATOMIC_RELAXED);
+
+    if ( Parse_Syslog(msg, len, SaganProcSyslog_IN) == false )
+        {
+
+            __atomic_add_fetch(&input->malformed, 1, __ATOMIC_RELAXED);
+
+            if ( debug->debugmalformed )
+                {
+                    Sagan_Log(WARN, "[%s, line %d] Syslog message from %s has no <PRI>: %s", __FILE__, __LINE__, SaganProcSyslog_IN->syslog_host, SaganProcSyslog_IN->syslog_message);
+                }
+        }
+
+    if (debug->debugsyslog)
+        {
+
+            Sagan_Log(DEBUG, "[%s, line %d] **[RAW Syslog (listener)]************************", __FILE__, __LINE__);
+            Sagan_Log(DEBUG, "[%s, line %d] Host: %s | Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, SaganProcSyslog_IN->syslog_host, SaganProcSyslog_IN->syslog_program, SaganProcSyslog_IN->syslog_facility, SaganProcSyslog_IN->syslog_priority, SaganProcSyslog_IN->syslog_level, SaganProcSyslog_IN->syslog_tag);
+            Sagan_Log(DEBUG, "[%s, line %d] Raw message: %s", __FILE__, __LINE__, SaganProcSyslog_IN->syslog_message);
+
+        }
+
+    if ( Sagan_Input_Queue(SaganProcSyslog_IN, slab) == false )
+        {
+            __atomic_add_fetch(&input->dropped, 1, __ATOMIC_RELAXED);
+        }
+
+}
+
+/****************************************************************************
+ * Listener_UDP_Thread - Receives datagrams from one UDP socket.  Each
+ * datagram is received into a MAX_SYSLOGMSG sized stride of the free part
+ * of the slab,  then slid down against the one before it.  The slab ends up
+ * packed by the datagrams' real lengths rather than by the stride.
+ ****************************************************************************/
+
+static void Listener_UDP_Thread( void *arg )
+{
+
+    int fd = listener_udp_fd[(intptr_t)arg];
+    int batch = config->listener_batch;
+    int vlen = 0;
+    int rc = 0;
+    int i = 0;
+
+    size_t len = 0;
+    size_t packed = 0;
+
+    time_t last = 0;
+    char *base = NULL;
+    char *msg = NULL;
+
+    _Listener_Backoff backoff;
+
+    _Sagan_Slab *slab = NULL;
+    struct _Sagan_Proc_Syslog SaganProcSyslog_IN;
+
+    struct sockaddr_storage *addrs = NULL;
+    struct iovec *iov = NULL;
+
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr *msgs = NULL;
+#else
+    socklen_t addr_len = 0;
+    batch = 1;
+#endif
+
+    (void)SetThreadName("SaganListenUDP");
+
+    memset(&SaganProcSyslog_IN, 0, sizeof(struct _Sagan_Proc_Syslog));
+    memset(&backoff, 0, sizeof(backoff));
+
+    addrs = malloc(batch * sizeof(struct sockaddr_storage));
+    iov = malloc(batch * sizeof(struct iovec));
+
+#ifdef HAVE_RECVMMSG
+    msgs = malloc(batch * sizeof(struct mmsghdr));
+
+    if ( msgs == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for msgs. Abort!", __FILE__, __LINE__);
+        }
+#endif
+
+    if ( addrs == NULL || iov == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the UDP listener. Abort!", __FILE__, __LINE__);
+        }
+
+    slab = Sagan_Slab_Get();
+
+    while(true)
+        {
+
+            vlen = ( INPUT_SLAB_SIZE - slab->len ) / MAX_SYSLOGMSG;
+
+            if ( vlen < 1 )
+                {
+                    Sagan_Slab_Release(slab);
+                    slab = Sagan_Slab_Get();
+                    continue;
+                }
+
+            if ( vlen > batch )
+                {
+                    vlen = batch;
+                }
+
+            base = slab->data + slab->len;
+
+            /* One byte short of the stride so Parse_Syslog() always has
+               room to terminate the message */
+
+            for ( i = 0; i < vlen; i++ )
+                {
+                    iov[i].iov_base = base + ( i * MAX_SYSLOGMSG );
+                    iov[i].iov_len = MAX_SYSLOGMSG - 1;
+                }
+
+#ifdef HAVE_RECVMMSG
+
+            memset(msgs, 0, vlen * sizeof(struct mmsghdr));
+
+            for ( i = 0; i < vlen; i++ )
+                {
+                    msgs[i].msg_hdr.msg_iov = &iov[i];
+                    msgs[i].msg_hdr.msg_iovlen = 1;
+                    msgs[i].msg_hdr.msg_name = &addrs[i];
+                    msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+                }
+
+            rc = recvmmsg(fd, msgs, vlen, MSG_WAITFORONE, NULL);
+
+#else
+
+            addr_len = sizeof(struct sockaddr_storage);
+            rc = recvfrom(fd, iov[0].iov_base, iov[0].iov_len, 0, (struct sockaddr *)&addrs[0], &addr_len);
+
+            if ( rc >= 0 )
+                {
+                    iov[0].iov_len = rc;
+                    rc = 1;
+                }
+
+#endif
+
+            if ( rc < 0 )
+                {
+
+                    if ( errno != EINTR && errno != EAGAIN )
+                        {
+                            Listener_Error(&backoff, "receiving from the UDP syslog listener", errno);
+                        }
+
+                    continue;
+                }
+
+            backoff.errors = 0;
+
+            Listener_Time(&SaganProcSyslog_IN, &last);
+
+            packed = 0;
+
+            for ( i = 0; i < rc; i++ )
+                {
+
+#ifdef HAVE_RECVMMSG
+                    len = msgs[i].msg_len;
+#else
+                    len = iov[0].iov_len;
+#endif
+
+                    /* Datagram "i" starts at least one stride in,  so this never
+                       overlaps anything that is still to be read */
+
+                    msg = base + packed;
+
+                    if ( i > 0 )
+                        {
+                            memmove(msg, base + ( i * MAX_SYSLOGMSG ), len);
+                        }
+
+                    Listener_Peer(&addrs[i], &SaganProcSyslog_IN);
+                    Listener_Queue(msg, len, &SaganProcSyslog_IN, slab, &listener_udp_input);
+
+                    /* One more for the NULL Parse_Syslog() put on the end */
+
+                    packed += len + 1;
+
+                }
+
+            slab->len += packed;
+
+        }
+
+}
+
+/****************************************************************************
+ * Listener_TCP_Frame - Pulls complete messages out of [*p, end).  Returns
+ * when more data is needed.  "skip" and "skip_line" carry the state of a
+ * truncated message between reads.
+ ****************************************************************************/
+
+static void Listener_TCP_Frame( char **p, char *end, size_t *skip, bool *skip_line, struct _Sagan_Proc_Syslog *SaganProcSyslog_IN, _Sagan_Slab *slab )
+{
+
+    char *q = NULL;
+    char *nl = NULL;
+
+    size_t count = 0;
+    size_t n = 0;
+
+    while ( *p < end )
+        {
+
+            /* Remainder of a truncated octet-counted message */
+
+            if ( *skip > 0 )
+                {
+                    n = (size_t)(end - *p) < *skip ? (size_t)(end - *p) : *skip;
+                    *p += n;
+                    *skip -= n;
+                    continue;
+                }
+
+            /* Remainder of a truncated line */
+
+            if ( *skip_line == true )
+                {
+
+                    nl = memchr(*p, '\n', end - *p);
+
+                    if ( nl == NULL )
+                        {
+                            *p = end;
+                            return;
+                        }
+
+                    *p = nl + 1;
+                    *skip_line = false;
+                    continue;
+                }
+
+            if ( **p == '\n' || **p == '\r' || **p == '\0' )
+                {
+                    (*p)++;
+                    continue;
+                }
+
+            /* RFC6587 octet counting.  "MSG-LEN SP SYSLOG-MSG" */
+
+            if ( isdigit((unsigned char)**p) )
+                {
+
+                    count = 0;
+
+                    for ( q = *p; q < end && q - *p < 8 && isdigit((unsigned char)*q); q++ )
+                        {
+                            count = ( count * 10 ) + ( *q - '0' );
+                        }
+
+                    if ( q == end )
+                        {
+                            return;
+                        }
+
+                    if ( *q == ' ' && count > 0 )
+                        {
+
+                            q++;
+
+                            if ( count >= MAX_SYSLOGMSG )
+                                {
+
+                                    if ( end - q < MAX_SYSLOGMSG - 1 )
+                                        {
+                                            return;
+                                        }
+
+                                    Listener_Queue(q, MAX_SYSLOGMSG - 1, SaganProcSyslog_IN, slab, &listener_tcp_input);
+
+                                    *skip = count - ( MAX_SYSLOGMSG - 1 );
+                                    *p = q + MAX_SYSLOGMSG - 1;
+                                    continue;
+                                }
+
+                            if ( (size_t)(end - q) < count )
+                                {
+                                    return;
+                                }
+
+                            /* The next frame starts right after this one,  so slide
+                               the message back over the space to make room for the
+                               NULL */
+
+                            memmove(q - 1, q, count);
+                            Listener_Queue(q - 1, count, SaganProcSyslog_IN, slab, &listener_tcp_input);
+
+                            *p = q + count;
+                            continue;
+                        }
+
+                    /* Not octet counted after all.  Fall through as a line */
+
+                }
+
+            nl = memchr(*p, '\n', end - *p);
+
+            if ( nl == NULL )
+                {
+
+                    if ( end - *p >= MAX_SYSLOGMSG - 1 )
+                        {
+
+                            Listener_Queue(*p, MAX_SYSLOGMSG - 1, SaganProcSyslog_IN, slab, &listener_tcp_input);
+
+                            *p += MAX_SYSLOGMSG - 1;
+                            *skip_line = true;
+                            continue;
+
+                        }
+
+                    return;
+                }
+
+            Listener_Queue(*p, nl - *p, SaganProcSyslog_IN, slab, &listener_tcp_input);
+            *p = nl + 1;
+
+        }
+
+}
+
+/****************************************************************************
+ * Listener_TCP_Connection - Reads one TCP connection until it is closed.
+ * The slab is handed back whenever the connection goes quiet with no
+ * partial message in it,  and a new one is only taken once data arrives.
+ ****************************************************************************/
+
+static void Listener_TCP_Connection( void *arg )
+{
+
+    int fd = (int)(intptr_t)arg;
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+
+    struct _Sagan_Proc_Syslog SaganProcSyslog_IN;
+
+    _Sagan_Slab *slab = NULL;
+    _Sagan_Slab *new_slab = NULL;
+
+    ssize_t input_bytes = 0;
+    size_t offset = 0;
+    size_t skip = 0;
+    bool skip_line = false;
+
+    time_t last = 0;
+    char *p = NULL;
+
+    struct pollfd pfd;
+
+    (void)SetThreadName("SaganListenTCP");
+
+    memset(&SaganProcSyslog_IN, 0, sizeof(struct _Sagan_Proc_Syslog));
+    memset(&addr, 0, sizeof(addr));
+
+    if ( getpeername(fd, (struct sockaddr *)&addr, &addr_len) == -1 )
+        {
+            addr.ss_family = AF_UNSPEC;
+        }
+
+    Listener_Peer(&addr, &SaganProcSyslog_IN);
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while(true)
+        {
+
+            /* Everything in the slab has been queued.  If nothing more shows
+               up for a while,  give it back */
+
+            if ( slab != NULL && offset == slab->len && poll(&pfd, 1, LISTENER_IDLE_MS) == 0 )
+                {
+                    Sagan_Slab_Release(slab);
+                    slab = NULL;
+                }
+
+            if ( slab == NULL )
+                {
+
+                    if ( poll(&pfd, 1, -1) == -1 )
+                        {
+
+                            if ( errno == EINTR )
+                                {
+                                    continue;
+                                }
+
+                            break;
+                        }
+
+                    slab = Sagan_Slab_Get();
+                    offset = 0;
+                }
+
+            input_bytes = read(fd, slab->data + slab->len, INPUT_SLAB_SIZE - slab->len);
+
+            if ( input_bytes < 0 && errno == EINTR )
+                {
+                    continue;
+                }
+
+            if ( input_bytes <= 0 )
+                {
+                    break;
+                }
+
+            slab->len += input_bytes;
+
+            Listener_Time(&SaganProcSyslog_IN, &last);
+
+            p = slab->data + offset;
+            Listener_TCP_Frame(&p, slab->data + slab->len, &skip, &skip_line, &SaganProcSyslog_IN, slab);
+            offset = p - slab->data;
+
+            /* Not enough room left for a full message.  Move the partial
+               message (if any) to a fresh slab */
+
+            if ( INPUT_SLAB_SIZE - slab->len < MAX_SYSLOGMSG )
+                {
+
+                    new_slab = Sagan_Slab_Get();
+
+                    new_slab->len = slab->len - offset;
+                    memcpy(new_slab->data, slab->data + offset, new_slab->len);
+
+                    Sagan_Slab_Release(slab);
+
+                    slab = new_slab;
+                    offset = 0;
+
+                }
+        }
+
+    if ( slab != NULL )
+        {
+            Sagan_Slab_Release(slab);
+        }
+
+    close(fd);
+
+    __atomic_sub_fetch(&listener_tcp_connections, 1, __ATOMIC_SEQ_CST);
+
+}
+
+/****************************************************************************
+ * Listener_TCP_Thread - Accepts TCP connections
+ ****************************************************************************/
+
+static void Listener_TCP_Thread( void )
+{
+
+    pthread_t connection_thread;
+    pthread_attr_t thread_attr;
+
+    int fd = -1;
+    int rc = 0;
+
+    _Listener_Backoff backoff;
+    _Listener_Backoff refused;
+
+    (void)SetThreadName("SaganListenAcc");
+
+    memset(&backoff, 0, sizeof(backoff));
+    memset(&refused, 0, sizeof(refused));
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr,  PTHREAD_CREATE_DETACHED);
+
+    while(true)
+        {
+
+            fd = accept(listener_tcp_fd, NULL, NULL);
+
+            if ( fd == -1 )
+                {
+
+                    if ( errno != EINTR && errno != ECONNABORTED )
+                        {
+                            Listener_Error(&backoff, "accepting TCP syslog connection", errno);
+                        }
+
+                    continue;
+                }
+
+            backoff.errors = 0;
+
+            /* Each connection can hold a slab.  Past the limit,  new
+               connections are turned away rather than letting them starve the
+               other inputs */
+
+            if ( __atomic_add_fetch(&listener_tcp_connections, 1, __ATOMIC_SEQ_CST) > config->listener_max_connections )
+                {
+                    __atomic_sub_fetch(&listener_tcp_connections, 1, __ATOMIC_SEQ_CST);
+                    close(fd);
+
+                    Listener_Error(&refused, "refusing TCP syslog connection ('max-connections' reached)", EAGAIN);
+                    refused.errors = 0;
+
+                    continue;
+                }
+
+            rc = pthread_create( &connection_thread, &thread_attr, (void *)Listener_TCP_Connection, (void *)(intptr_t)fd );
+
+            if ( rc != 0 )
+                {
+                    __atomic_sub_fetch(&listener_tcp_connections, 1, __ATOMIC_SEQ_CST);
+                    Listener_Error(&backoff, "creating TCP syslog connection thread", rc);
+                    close(fd);
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Listener_Init - Create and bind the listener sockets.  This is
+ * done before we drop privileges so port 514 can be used.
+ ****************************************************************************/
+
+void Sagan_Listener_Init( void )
+{
+
+    int i = 0;
+    bool reuseport = false;
+
+    if ( config->listener_udp_port != 0 )
+        {
+
+            snprintf(listener_udp_input.path, sizeof(listener_udp_input.path), "udp://%s:%d", config->listener_address, config->listener_udp_port);
+
+            listener_udp_count = 1;
+
+#ifdef SO_REUSEPORT
+
+            if ( config->listener_reuseport == true )
+                {
+                    listener_udp_count = config->listener_udp_threads;
+                    reuseport = true;
+                }
+
+#endif
+
+            for ( i = 0; i < listener_udp_count; i++ )
+                {
+                    listener_udp_fd[i] = Listener_Socket(SOCK_DGRAM, config->listener_udp_port, reuseport);
+                }
+
+            /* Without SO_REUSEPORT,  all the threads share one socket */
+
+            for ( i = listener_udp_count; i < config->listener_udp_threads; i++ )
+                {
+                    listener_udp_fd[i] = listener_udp_fd[0];
+                }
+
+        }
+
+    if ( config->listener_tcp_port != 0 )
+        {
+
+            snprintf(listener_tcp_input.path, sizeof(listener_tcp_input.path), "tcp://%s:%d", config->listener_address, config->listener_tcp_port);
+
+            listener_tcp_fd = Listener_Socket(SOCK_STREAM, config->listener_tcp_port, false);
+
+            if ( listen(listener_tcp_fd, LISTENER_BACKLOG) == -1 )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Cannot listen on TCP port %d. [%s]", __FILE__, __LINE__, config->listener_tcp_port, strerror(errno));
+                }
+
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Listener_Start - Spawn the receive threads
+ ****************************************************************************/
+
+void Sagan_Listener_Start( void )
+{
+
+    pthread_t listener_thread;
+    pthread_attr_t thread_attr;
+
+    int i = 0;
+    int rc = 0;
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr,  PTHREAD_CREATE_DETACHED);
+
+    if ( config->listener_udp_port != 0 )
+        {
+
+            Sagan_Log(NORMAL, "Spawning %d UDP syslog listener thread(s) on %s:%d (%d socket(s)).", config->listener_udp_threads, config->listener_address, config->listener_udp_port, listener_udp_count);
+
+            for ( i = 0; i < config->listener_udp_threads; i++ )
+                {
+
+                    rc = pthread_create( &listener_thread, &thread_attr, (void *)Listener_UDP_Thread, (void *)(intptr_t)i );
+
+                    if ( rc != 0 )
+                        {
+                            Remove_Lock_File();
+                            Sagan_Log(ERROR, "[%s, line %d] Error creating UDP syslog listener thread. [error: %d]", __FILE__, __LINE__, rc);
+                        }
+                }
+        }
+
+    if ( config->listener_tcp_port != 0 )
+        {
+
+            Sagan_Log(NORMAL, "Spawning TCP syslog listener on %s:%d.", config->listener_address, config->listener_tcp_port);
+
+            rc = pthread_create( &listener_thread, &thread_attr, (void *)Listener_TCP_Thread, NULL );
+
+            if ( rc != 0 )
+                {
+                    Remove_Lock_File();
+                    Sagan_Log(ERROR, "[%s, line %d] Error creating TCP syslog listener thread. [error: %d]", __FILE__, __LINE__, rc);
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Listener_Statistics - Adds the listener to the input statistics
+ ****************************************************************************/
+
+void Sagan_Listener_Statistics( void )
+{
+
+    _Sagan_Input *input[2] = { &listener_udp_input, &listener_tcp_input };
+    int i = 0;
+
+    for ( i = 0; i < 2; i++ )
+        {
+
+            if ( input[i]->path[0] == '\0' )
+                {
+                    continue;
+                }
+
+            Sagan_Log(NORMAL, "           %s (listener)", input[i]->path);
+            Sagan_Log(NORMAL, "             Received               : %" PRIu64 " (%" PRIu64 " bytes)", input[i]->received, input[i]->bytes);
+            Sagan_Log(NORMAL, "             Malformed              : %" PRIu64 " (%.3f%%)", input[i]->malformed, CalcPct(input[i]->malformed, input[i]->received) );
+            Sagan_Log(NORMAL, "             Dropped                : %" PRIu64 " (%.3f%%)", input[i]->dropped, CalcPct(input[i]->dropped, input[i]->received) );
+        }
+
+}
@@ -0,0 +1,232 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* input-slab.c
+ *
+ * Reusable input buffers ("slabs") and the in-place splitting of the
+ * "host|facility|priority|level|tag|date|time|program|msg" FIFO format.
+ *
+ * Rather than fgets() a line at a time and copy each field into the work
+ * queue (and then again into the workers local copy), readers read() big
+ * chunks into a slab, terminate the fields in place and queue pointers to
+ * them.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "util-ring.h"
+#include "input-slab.h"
+
+static _Sagan_Ring *SaganSlabFree = NULL;
+static uint32_t slab_allocated = 0;
+
+/****************************************************************************
+ * Sagan_Slab_Init - Sets up the free slab pool.  Slabs are allocated on
+ * demand (up to INPUT_MAX_SLABS) and recycled through this ring.
+ ****************************************************************************/
+
+void Sagan_Slab_Init( void )
+{
+    SaganSlabFree = Sagan_Ring_Init(INPUT_MAX_SLABS, sizeof(_Sagan_Slab *));
+}
+
+/****************************************************************************
+ * Sagan_Slab_Get - Returns an empty slab with one reference held by the
+ * caller.  If all slabs are in use,  this waits for the workers to give
+ * one back.
+ ****************************************************************************/
+
+_Sagan_Slab *Sagan_Slab_Get( void )
+{
+
+    _Sagan_Ring_Slot *slot = NULL;
+    _Sagan_Slab *slab = NULL;
+
+    for (;;)
+        {
+
+            slot = Sagan_Ring_Dequeue_Claim(SaganSlabFree);
+
+            if ( slot != NULL )
+                {
+                    memcpy(&slab, slot->data, sizeof(_Sagan_Slab *));
+                    Sagan_Ring_Dequeue_Commit(SaganSlabFree, slot);
+                    break;
+                }
+
+            if ( __atomic_add_fetch(&slab_allocated, 1, __ATOMIC_SEQ_CST) <= INPUT_MAX_SLABS )
+                {
+
+                    slab = malloc(sizeof(_Sagan_Slab));
+
+                    if ( slab == NULL )
+                        {
+                            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Slab. Abort!", __FILE__, __LINE__);
+                        }
+
+                    slab->data = malloc(INPUT_SLAB_SIZE + 1);
+
+                    if ( slab->data == NULL )
+                        {
+                            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for slab data. Abort!", __FILE__, __LINE__);
+                        }
+
+                    break;
+                }
+
+            __atomic_sub_fetch(&slab_allocated, 1, __ATOMIC_SEQ_CST);
+
+            /* Every slab is pinned by queued lines.  Wait for one back. */
+
+            Sagan_Ring_Wait(SaganSlabFree);
+
+        }
+
+    slab->len = 0;
+    __atomic_store_n(&slab->refcount, 1, __ATOMIC_RELEASE);
+
+    return(slab);
+}
+
+/****************************************************************************
+ * Sagan_Slab_Ref - Takes a reference on behalf of a queued line.
+ ****************************************************************************/
+
+void Sagan_Slab_Ref( _Sagan_Slab *slab )
+{
+    __atomic_add_fetch(&slab->refcount, 1, __ATOMIC_RELAXED);
+}
+
+/****************************************************************************
+ * Sagan_Slab_Release - Drops a reference.  The last one out returns the
+ * slab to the pool.
+ ****************************************************************************/
+
+void Sagan_Slab_Release( _Sagan_Slab *slab )
+{
+
+    _Sagan_Ring_Slot *slot = NULL;
+
+    if ( __atomic_sub_fetch(&slab->refcount, 1, __ATOMIC_ACQ_REL) != 0 )
+        {
+            return;
+        }
+
+    /* The free ring is sized for every slab that can exist,  so this
+       can't fail */
+
+    slot = Sagan_Ring_Enqueue_Claim(SaganSlabFree);
+    memcpy(slot->data, &slab, sizeof(_Sagan_Slab *));
+    Sagan_Ring_Enqueue_Commit(SaganSlabFree, slot);
+
+}
+
+/****************************************************************************
+ * Sagan_Slab_Split - Splits a NULL terminated line on '|' in place.  Up to
+ * max_fields fields are returned.  The last field gets the remainder of
+ * the line (the message may contain '|').  Returns the number of fields
+ * found.
+ *
+ * With SSE2,  16 bytes are compared at a time and the '|' positions are
+ * pulled from the resulting bit mask.
+ ****************************************************************************/
+
+int Sagan_Slab_Split( char *line, size_t len, char **fields, size_t *fields_len, int max_fields )
+{
+
+    char *start = line;
+    char *end = line + len;
+    char *p = line;
+    int count = 0;
+
+#ifdef __SSE2__
+
+    const __m128i pipe = _mm_set1_epi8('|');
+    __m128i block;
+    unsigned int mask = 0;
+    int bit = 0;
+
+    while ( count < max_fields - 1 && p + 16 <= end )
+        {
+
+            block = _mm_loadu_si128((const __m128i *)p);
+            mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, pipe));
+
+            while ( mask != 0 && count < max_fields - 1 )
+                {
+
+                    bit = __builtin_ctz(mask);
+                    mask &= mask - 1;
+
+                    fields[count] = start;
+                    fields_len[count] = ( p + bit ) - start;
+                    p[bit] = '\0';
+                    count++;
+
+                    start = p + bit + 1;
+                }
+
+            if ( count >= max_fields - 1 )
+                {
+                    break;
+                }
+
+            p += 16;
+
+        }
+
+#endif
+
+    /* Whatever is left (or everything without SSE2) */
+
+    while ( count < max_fields - 1 && ( p = memchr(start, '|', end - start) ) != NULL )
+        {
+
+            fields[count] = start;
+            fields_len[count] = p - start;
+            *p = '\0';
+            count++;
+
+            start = p + 1;
+        }
+
+    fields[count] = start;
+    fields_len[count] = end - start;
+    count++;
+
+    return(count);
+}
+
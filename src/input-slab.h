@@ -0,0 +1,45 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+/* Input "slabs" are large reusable buffers that readers read() into.
+ * Log lines are split in place and handed to the workers as pointers
+ * into the slab.  Each queued line holds a reference on its slab; the
+ * slab goes back to the pool when the last line is done with it. */
+
+typedef struct _Sagan_Slab _Sagan_Slab;
+struct _Sagan_Slab
+{
+    uint32_t refcount;
+    size_t len;				/* Bytes of data[] in use */
+    char *data;				/* INPUT_SLAB_SIZE + 1 bytes */
+};
+
+void Sagan_Slab_Init( void );
+_Sagan_Slab *Sagan_Slab_Get( void );
+void Sagan_Slab_Ref( _Sagan_Slab *slab );
+void Sagan_Slab_Release( _Sagan_Slab *slab );
+int Sagan_Slab_Split( char *line, size_t len, char **fields, size_t *fields_len, int max_fields );
+
@@ -0,0 +1,196 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* input.c
+ *
+ * Common hand off from the inputs (FIFO/file reader,  syslog listener)
+ * to the worker queue.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "util-ring.h"
+#include "input-slab.h"
+#include "input.h"
+
+struct _SaganConfig *config;
+struct _SaganCounters *counters;
+
+_Sagan_Ring *SaganProcRing;		/* Comes from sagan.c */
+
+unsigned char dynamic_rule_flag;	/* Comes from sagan.c */
+bool reload_rules;
+
+pthread_mutex_t SaganDynamicFlag;
+pthread_mutex_t SaganRulesLoadedMutex;
+
+static int dynamic_line_count = 0;
+
+/****************************************************************************
+ * Sagan_Input_Add - Adds a FIFO/file to read from
+ ****************************************************************************/
+
+void Sagan_Input_Add( const char *path, bool is_file )
+{
+
+    int i = 0;
+
+    for (i = 0; i < config->input_count; i++)
+        {
+            if (!strcmp(config->inputs[i].path, path))
+                {
+                    Sagan_Log(WARN, "[%s, line %d] Input %s is listed more than once. Ignoring duplicate.", __FILE__, __LINE__, path);
+                    return;
+                }
+        }
+
+    config->inputs = (_Sagan_Input *) realloc(config->inputs, (config->input_count+1) * sizeof(_Sagan_Input));
+
+    if ( config->inputs == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for inputs. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(&config->inputs[config->input_count], 0, sizeof(_Sagan_Input));
+
+    strlcpy(config->inputs[config->input_count].path, path, sizeof(config->inputs[config->input_count].path));
+    config->inputs[config->input_count].is_file = is_file;
+
+    config->input_count++;
+
+}
+
+/****************************************************************************
+ * Sagan_Input_Files_Done - Returns true if every input is a file and they
+ * have all been read.  FIFOs never finish.
+ ****************************************************************************/
+
+bool Sagan_Input_Files_Done( void )
+{
+
+    int i = 0;
+
+    for (i = 0; i < config->input_count; i++)
+        {
+            if ( config->inputs[i].is_file == false || __atomic_load_n(&config->inputs[i].eof, __ATOMIC_SEQ_CST) == false )
+                {
+                    return(false);
+                }
+        }
+
+    return(true);
+}
+
+/****************************************************************************
+ * Sagan_Input_Queue - Copies the (small) line descriptor into the next free
+ * queue slot and takes a reference on the slab its fields point into.
+ * Fields pointing at the descriptor's own buffers are re-pointed at the
+ * slot's copy.  Returns false if the queue was full and the line dropped.
+ ****************************************************************************/
+
+bool Sagan_Input_Queue( struct _Sagan_Proc_Syslog *SaganProcSyslog_IN, _Sagan_Slab *slab )
+{
+
+    _Sagan_Ring_Slot *proc_slot = NULL;
+    struct _Sagan_Proc_Syslog *proc_syslog = NULL;
+
+    __atomic_add_fetch(&counters->sagantotal, 1, __ATOMIC_RELAXED);
+
+    /* If Dynamic rules are loaded,  keep track of line count */
+
+    if ( config->dynamic_load_flag == true )
+        {
+
+            if ( __atomic_add_fetch(&dynamic_line_count, 1, __ATOMIC_RELAXED) >= config->dynamic_load_sample_rate )
+                {
+
+                    pthread_mutex_lock(&SaganDynamicFlag);
+                    dynamic_rule_flag = DYNAMIC_RULE;
+                    pthread_mutex_unlock(&SaganDynamicFlag);
+
+                    __atomic_store_n(&dynamic_line_count, 0, __ATOMIC_RELAXED);
+                }
+
+            /* Thread holds here if rule load is in progress */
+
+            pthread_mutex_lock(&SaganRulesLoadedMutex);
+            reload_rules = true;
+            pthread_mutex_unlock(&SaganRulesLoadedMutex);
+
+        }
+
+    proc_slot = Sagan_Ring_Enqueue_Claim(SaganProcRing);
+
+    if ( proc_slot == NULL )
+        {
+
+            /* Queue is full.  The workers can't keep up */
+
+            __atomic_add_fetch(&counters->worker_thread_exhaustion, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&counters->sagan_log_drop, 1, __ATOMIC_RELAXED);
+
+            return(false);
+        }
+
+    proc_syslog = (struct _Sagan_Proc_Syslog *)proc_slot->data;
+
+    memcpy(proc_syslog, SaganProcSyslog_IN, sizeof(struct _Sagan_Proc_Syslog));
+
+    if ( SaganProcSyslog_IN->syslog_host == SaganProcSyslog_IN->syslog_host_lookup )
+        {
+            proc_syslog->syslog_host = proc_syslog->syslog_host_lookup;
+        }
+
+    if ( SaganProcSyslog_IN->syslog_date == SaganProcSyslog_IN->syslog_date_buf )
+        {
+            proc_syslog->syslog_date = proc_syslog->syslog_date_buf;
+        }
+
+    if ( SaganProcSyslog_IN->syslog_time == SaganProcSyslog_IN->syslog_time_buf )
+        {
+            proc_syslog->syslog_time = proc_syslog->syslog_time_buf;
+        }
+
+    proc_syslog->syslog_message_lower = NULL;
+    proc_syslog->slab = slab;
+
+    if ( slab != NULL )
+        {
+            Sagan_Slab_Ref(slab);
+        }
+
+    Sagan_Ring_Enqueue_Commit(SaganProcRing, proc_slot);
+
+    return(true);
+}
+
@@ -0,0 +1,44 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* A FIFO or file we read from.  The counters are only updated by the
+   input's reader thread */
+
+typedef struct _Sagan_Input _Sagan_Input;
+struct _Sagan_Input
+{
+    char path[MAXPATH];
+    bool is_file;
+    bool eof;				/* Files only.  Set once fully read */
+
+    uint64_t received;
+    uint64_t bytes;
+    uint64_t malformed;
+    uint64_t dropped;			/* Worker queue was full */
+};
+
+void Sagan_Input_Add( const char *path, bool is_file );
+bool Sagan_Input_Files_Done( void );
+bool Sagan_Input_Queue( struct _Sagan_Proc_Syslog *SaganProcSyslog_IN, struct _Sagan_Slab *slab );
+
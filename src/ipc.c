@@ -32,17 +32,25 @@
 #endif
 
 #include <stdio.h>
+#include <stddef.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <arpa/inet.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <unistd.h>
 #include <string.h>
 #include <time.h>
 
+#ifdef HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
 #include "version.h"
 #include "sagan.h"
 #include "sagan-defs.h"
@@ -86,993 +94,898 @@ struct after_by_srcport_ipc *afterbysrcport_ipc;
 struct after_by_dstport_ipc *afterbydstport_ipc;
 struct after_by_username_ipc *afterbyusername_ipc;
 
-struct _Sagan_Track_Clients_IPC *SaganTrackClients_ipc;
-
-struct _SaganDebug *debug;
-
-/*****************************************************************************
- * Clean_IPC_Object - If the max IPC is hit,  we attempt to "clean" out
- * any stale IPC entries.
- *****************************************************************************/
-
-bool Clean_IPC_Object( int type )
-{
+struct _Sagan_IPC_Index *threshbysrc_index;
+struct _Sagan_IPC_Index *threshbydst_index;
+struct _Sagan_IPC_Index *threshbydstport_index;
+struct _Sagan_IPC_Index *threshbysrcport_index;
+struct _Sagan_IPC_Index *threshbyusername_index;
 
-    /* After by src */
+struct _Sagan_IPC_Index *afterbysrc_index;
+struct _Sagan_IPC_Index *afterbydst_index;
+struct _Sagan_IPC_Index *afterbysrcport_index;
+struct _Sagan_IPC_Index *afterbydstport_index;
+struct _Sagan_IPC_Index *afterbyusername_index;
 
-    if ( type == AFTER_BY_SRC && config->max_after_by_src < counters_ipc->after_count_by_src )
-        {
+struct _Sagan_IPC_Index *xbit_index;
 
-            time_t t;
-            struct tm *now;
+struct _Sagan_Thresh_State *threshbysrc_state;
+struct _Sagan_Thresh_State *threshbydst_state;
+struct _Sagan_Thresh_State *threshbydstport_state;
+struct _Sagan_Thresh_State *threshbysrcport_state;
+struct _Sagan_Thresh_State *threshbyusername_state;
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+struct _Sagan_Track_Clients_IPC *SaganTrackClients_ipc;
 
-            char timet[20];
+struct _Sagan_IPC_Samples *samples_ipc;
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+struct _SaganDebug *debug;
 
+static uint32_t ipc_pid = 0;		/* What our stripe locks hold */
 
-            if ( debug->debugipc )
-                {
-                    Sagan_Log(DEBUG, "[%s, %d line] Cleaning IPC data. Type: %d", __FILE__, __LINE__, type);
-                }
-
-            File_Lock(config->shm_after_by_src);
-            pthread_mutex_lock(&After_By_Src_Mutex);
+/*****************************************************************************
+ * The threshold,  after and xbit tables.  The index,  the expiry wheel and
+ * the reaper below work on any of them through this.  Xbits are looked up
+ * by scanning them,  so they aren't hashed and only use the wheel.
+ *****************************************************************************/
 
-            struct after_by_src_ipc *temp_afterbysrc_ipc;
-            temp_afterbysrc_ipc = malloc(sizeof(struct after_by_src_ipc) * config->max_after_by_src);
+typedef struct _IPC_Table _IPC_Table;
+struct _IPC_Table
+{
+    int type;
+    const char *name;
+    const char *file;
+    void **records;
+    _Sagan_IPC_Index **index;
+    pthread_mutex_t *mutex;
+    size_t record_size;
+    size_t utime;			/* offsetof() in the record */
+    size_t expire;
+    size_t count;			/* offsetof() in _Sagan_IPC_Counters */
+    size_t max;				/* offsetof() in _SaganConfig */
+    size_t shm;
+    bool hashed;			/* Has a hash index,  not just the wheel */
+    void **side;			/* Per record data kept after the index */
+    size_t side_size;
+    int records_max;			/* What the file holds.  See IPC_Table_Map() */
+};
+
+static _IPC_Table ipc_tables[] =
+{
 
-            memset(temp_afterbysrc_ipc, 0, sizeof(sizeof(struct after_by_src_ipc) * config->max_after_by_src));
+    {
+        THRESH_BY_SRC, "thresh_by_src", THRESH_BY_SRC_IPC_FILE, (void **)&threshbysrc_ipc, &threshbysrc_index, &Thresh_By_Src_Mutex, sizeof(struct thresh_by_src_ipc),
+        offsetof(struct thresh_by_src_ipc, utime), offsetof(struct thresh_by_src_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, thresh_count_by_src), offsetof(_SaganConfig, max_threshold_by_src), offsetof(_SaganConfig, shm_thresh_by_src), true,
+        (void **)&threshbysrc_state, sizeof(struct _Sagan_Thresh_State), 0
+    },
+
+    {
+        THRESH_BY_DST, "thresh_by_dst", THRESH_BY_DST_IPC_FILE, (void **)&threshbydst_ipc, &threshbydst_index, &Thresh_By_Dst_Mutex, sizeof(struct thresh_by_dst_ipc),
+        offsetof(struct thresh_by_dst_ipc, utime), offsetof(struct thresh_by_dst_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, thresh_count_by_dst), offsetof(_SaganConfig, max_threshold_by_dst), offsetof(_SaganConfig, shm_thresh_by_dst), true,
+        (void **)&threshbydst_state, sizeof(struct _Sagan_Thresh_State), 0
+    },
+
+    {
+        THRESH_BY_SRCPORT, "thresh_by_srcport", THRESH_BY_SRCPORT_IPC_FILE, (void **)&threshbysrcport_ipc, &threshbysrcport_index, &Thresh_By_Src_Port_Mutex, sizeof(struct thresh_by_srcport_ipc),
+        offsetof(struct thresh_by_srcport_ipc, utime), offsetof(struct thresh_by_srcport_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, thresh_count_by_srcport), offsetof(_SaganConfig, max_threshold_by_srcport), offsetof(_SaganConfig, shm_thresh_by_srcport), true,
+        (void **)&threshbysrcport_state, sizeof(struct _Sagan_Thresh_State), 0
+    },
+
+    {
+        THRESH_BY_DSTPORT, "thresh_by_dstport", THRESH_BY_DSTPORT_IPC_FILE, (void **)&threshbydstport_ipc, &threshbydstport_index, &Thresh_By_Dst_Port_Mutex, sizeof(struct thresh_by_dstport_ipc),
+        offsetof(struct thresh_by_dstport_ipc, utime), offsetof(struct thresh_by_dstport_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, thresh_count_by_dstport), offsetof(_SaganConfig, max_threshold_by_dstport), offsetof(_SaganConfig, shm_thresh_by_dstport), true,
+        (void **)&threshbydstport_state, sizeof(struct _Sagan_Thresh_State), 0
+    },
+
+    {
+        THRESH_BY_USERNAME, "thresh_by_username", THRESH_BY_USERNAME_IPC_FILE, (void **)&threshbyusername_ipc, &threshbyusername_index, &Thresh_By_Username_Mutex, sizeof(struct thresh_by_username_ipc),
+        offsetof(struct thresh_by_username_ipc, utime), offsetof(struct thresh_by_username_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, thresh_count_by_username), offsetof(_SaganConfig, max_threshold_by_username), offsetof(_SaganConfig, shm_thresh_by_username), true,
+        (void **)&threshbyusername_state, sizeof(struct _Sagan_Thresh_State), 0
+    },
+
+    {
+        AFTER_BY_SRC, "after_by_src", AFTER_BY_SRC_IPC_FILE, (void **)&afterbysrc_ipc, &afterbysrc_index, &After_By_Src_Mutex, sizeof(struct after_by_src_ipc),
+        offsetof(struct after_by_src_ipc, utime), offsetof(struct after_by_src_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, after_count_by_src), offsetof(_SaganConfig, max_after_by_src), offsetof(_SaganConfig, shm_after_by_src), true, NULL, 0, 0
+    },
+
+    {
+        AFTER_BY_DST, "after_by_dst", AFTER_BY_DST_IPC_FILE, (void **)&afterbydst_ipc, &afterbydst_index, &After_By_Dst_Mutex, sizeof(struct after_by_dst_ipc),
+        offsetof(struct after_by_dst_ipc, utime), offsetof(struct after_by_dst_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, after_count_by_dst), offsetof(_SaganConfig, max_after_by_dst), offsetof(_SaganConfig, shm_after_by_dst), true, NULL, 0, 0
+    },
+
+    {
+        AFTER_BY_SRCPORT, "after_by_srcport", AFTER_BY_SRCPORT_IPC_FILE, (void **)&afterbysrcport_ipc, &afterbysrcport_index, &After_By_Src_Port_Mutex, sizeof(struct after_by_srcport_ipc),
+        offsetof(struct after_by_srcport_ipc, utime), offsetof(struct after_by_srcport_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, after_count_by_srcport), offsetof(_SaganConfig, max_after_by_srcport), offsetof(_SaganConfig, shm_after_by_srcport), true, NULL, 0, 0
+    },
+
+    {
+        AFTER_BY_DSTPORT, "after_by_dstport", AFTER_BY_DSTPORT_IPC_FILE, (void **)&afterbydstport_ipc, &afterbydstport_index, &After_By_Dst_Port_Mutex, sizeof(struct after_by_dstport_ipc),
+        offsetof(struct after_by_dstport_ipc, utime), offsetof(struct after_by_dstport_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, after_count_by_dstport), offsetof(_SaganConfig, max_after_by_dstport), offsetof(_SaganConfig, shm_after_by_dstport), true, NULL, 0, 0
+    },
+
+    {
+        AFTER_BY_USERNAME, "after_by_username", AFTER_BY_USERNAME_IPC_FILE, (void **)&afterbyusername_ipc, &afterbyusername_index, &After_By_Username_Mutex, sizeof(struct after_by_username_ipc),
+        offsetof(struct after_by_username_ipc, utime), offsetof(struct after_by_username_ipc, expire),
+        offsetof(_Sagan_IPC_Counters, after_count_by_username), offsetof(_SaganConfig, max_after_by_username), offsetof(_SaganConfig, shm_after_by_username), true, NULL, 0, 0
+    },
+
+    {
+        XBIT, "xbit", XBIT_IPC_FILE, (void **)&xbit_ipc, &xbit_index, &Xbit_Mutex, sizeof(struct _Sagan_IPC_Xbit),
+        offsetof(struct _Sagan_IPC_Xbit, xbit_expire), offsetof(struct _Sagan_IPC_Xbit, expire),
+        offsetof(_Sagan_IPC_Counters, xbit_count), offsetof(_SaganConfig, max_xbits), offsetof(_SaganConfig, shm_xbit), false, NULL, 0, 0
+    }
+
+};
+
+#define IPC_TABLES	( sizeof(ipc_tables) / sizeof(ipc_tables[0]) )
+
+static _IPC_Table *IPC_Table_Lookup( int type )
+{
 
-            old_count = counters_ipc->after_count_by_src;
+    uint32_t i = 0;
 
-            for (i = 0; i < counters_ipc->after_count_by_src; i++)
+    for ( i = 0; i < IPC_TABLES; i++ )
+        {
+            if ( ipc_tables[i].type == type )
                 {
-                    if ( (utime - afterbysrc_ipc[i].utime) < afterbysrc_ipc[i].expire )
-                        {
-
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Afterbysrc_IPC : Keeping 0x%.08X%.08X%.08X%.08X.", __FILE__, __LINE__,
-                                              htonl(((unsigned int *)&afterbysrc_ipc[i].ipsrc)[0]),
-                                              htonl(((unsigned int *)&afterbysrc_ipc[i].ipsrc)[1]),
-                                              htonl(((unsigned int *)&afterbysrc_ipc[i].ipsrc)[2]),
-                                              htonl(((unsigned int *)&afterbysrc_ipc[i].ipsrc)[3]));
-                                }
-
-                            memcpy(temp_afterbysrc_ipc[new_count].ipsrc, afterbysrc_ipc[i].ipsrc, sizeof(afterbysrc_ipc[i].ipsrc));
-                            temp_afterbysrc_ipc[new_count].count = afterbysrc_ipc[i].count;
-                            temp_afterbysrc_ipc[new_count].utime = afterbysrc_ipc[i].utime;
-                            temp_afterbysrc_ipc[new_count].expire = afterbysrc_ipc[i].expire;
-                            strlcpy(temp_afterbysrc_ipc[new_count].sid, afterbysrc_ipc[i].sid, sizeof(temp_afterbysrc_ipc[new_count].sid));
-                            new_count++;
-                        }
+                    return(&ipc_tables[i]);
                 }
+        }
 
-            if ( new_count > 0 )
-                {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            memcpy(afterbysrc_ipc[i].ipsrc, temp_afterbysrc_ipc[i].ipsrc, sizeof(temp_afterbysrc_ipc[i].ipsrc));
-                            afterbysrc_ipc[i].count = temp_afterbysrc_ipc[i].count;
-                            afterbysrc_ipc[i].utime = temp_afterbysrc_ipc[i].utime;
-                            afterbysrc_ipc[i].expire = temp_afterbysrc_ipc[i].expire;
-                            strlcpy(afterbysrc_ipc[i].sid, temp_afterbysrc_ipc[i].sid, sizeof(afterbysrc_ipc[i].sid));
-                        }
-
-                    counters_ipc->after_count_by_src = new_count;
+    return(NULL);
+}
 
-                }
-            else
-                {
+static int *IPC_Table_Count( _IPC_Table *table )
+{
+    return( (int *)( (char *)counters_ipc + table->count ) );
+}
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean after_by_src.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_afterbysrc_ipc);
-                    pthread_mutex_unlock(&After_By_Src_Mutex);
-                    File_Unlock(config->shm_after_by_src);
-                    return(1);
+static int IPC_Table_Max( _IPC_Table *table )
+{
+    return( table->records_max );
+}
 
-                }
+/* Records a threshold/after table holds.  Adding checks this under the
+   table's mutex and File_Lock() */
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for after_by_src", __FILE__, __LINE__, new_count, old_count);
-            free(temp_afterbysrc_ipc);
+int IPC_Max( int type )
+{
 
-            pthread_mutex_unlock(&After_By_Src_Mutex);
-            File_Unlock(config->shm_after_by_src);
-            return(0);
+    _IPC_Table *table = IPC_Table_Lookup(type);
 
-        }
+    return( table != NULL ? IPC_Table_Max(table) : 0 );
+}
 
-    /* Afterbydst_IPC */
+/* The configured max.  Only used when a file is made,  and reset by a
+   SIGHUP,  so nothing else goes by it */
 
-    else if ( type == AFTER_BY_DST && config->max_after_by_dst < counters_ipc->after_count_by_dst )
-        {
+static int IPC_Table_Config_Max( _IPC_Table *table )
+{
+    return( *(int *)( (char *)config + table->max ) );
+}
 
-            time_t t;
-            struct tm *now;
+static int IPC_Table_Shm( _IPC_Table *table )
+{
+    return( *(int *)( (char *)config + table->shm ) );
+}
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+static char *IPC_Table_Record( _IPC_Table *table, int position )
+{
+    return( (char *)*table->records + (size_t)position * table->record_size );
+}
 
-            char timet[20];
+/* When the record expires.  A record is kept while "now - utime < expire".
+   Xbits keep "xbit_expire" in "utime",  so an xbit is kept (turned off by
+   Xbit_Cleanup_MMAP()) for another "expire" after it runs out,  as the
+   old clean up did */
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+static uint64_t IPC_Table_Expire( _IPC_Table *table, int position )
+{
 
-            new_count = 0;
-            old_count = 0;
+    char *record = IPC_Table_Record(table, position);
 
-            File_Lock(config->shm_after_by_dst);
-            pthread_mutex_lock(&After_By_Dst_Mutex);
+    return( *(uint64_t *)( record + table->utime ) + *(int *)( record + table->expire ) );
+}
 
-            struct after_by_dst_ipc *temp_afterbydst_ipc;
-            temp_afterbydst_ipc = malloc(sizeof(struct after_by_dst_ipc) * config->max_after_by_dst);
+/*****************************************************************************
+ * IPC_Index_Size - Bytes needed for the hash index and expiry wheel of a
+ * table with "max" records.  The index is at least twice the size of the
+ * table so probes stay short and it never fills up.  A table that isn't
+ * hashed gets one (empty) slot.
+ *****************************************************************************/
 
-            memset(temp_afterbydst_ipc, 0, sizeof(sizeof(struct after_by_dst_ipc) * config->max_after_by_dst));
+static uint32_t IPC_Index_Slots( int max, bool hashed )
+{
 
-            old_count = counters_ipc->after_count_by_dst;
+    uint32_t slots = 16;
 
-            for (i = 0; i < counters_ipc->after_count_by_dst; i++)
-                {
-                    if ( (utime - afterbydst_ipc[i].utime) < afterbydst_ipc[i].expire )
-                        {
+    if ( hashed == false )
+        {
+            return(1);
+        }
 
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Afterbydst_IPC : Keeping 0x%.08X%.08X%.08X%.08X.", __FILE__, __LINE__,
-                                              htonl(((unsigned int *)&afterbydst_ipc[i].ipdst)[0]),
-                                              htonl(((unsigned int *)&afterbydst_ipc[i].ipdst)[1]),
-                                              htonl(((unsigned int *)&afterbydst_ipc[i].ipdst)[2]),
-                                              htonl(((unsigned int *)&afterbydst_ipc[i].ipdst)[3]));
-                                }
+    while ( slots < (uint32_t)max * 2 )
+        {
+            slots = slots << 1;
+        }
 
+    return(slots);
+}
 
-                            memcpy(temp_afterbydst_ipc[new_count].ipdst, afterbydst_ipc[i].ipdst, sizeof(afterbydst_ipc[i].ipdst));
-                            temp_afterbydst_ipc[new_count].count = afterbydst_ipc[i].count;
-                            temp_afterbydst_ipc[new_count].utime = afterbydst_ipc[i].utime;
-                            temp_afterbydst_ipc[new_count].expire = afterbydst_ipc[i].expire;
-                            strlcpy(temp_afterbydst_ipc[new_count].sid, afterbydst_ipc[i].sid, sizeof(temp_afterbydst_ipc[new_count].sid));
-                            new_count++;
-                        }
-                }
+size_t IPC_Index_Size( int max, bool hashed )
+{
+    return( sizeof(_Sagan_IPC_Index) + IPC_Index_Slots(max, hashed) * sizeof(_Sagan_IPC_Index_Slot) + (size_t)max * sizeof(_Sagan_IPC_Wheel_Link) );
+}
 
-            if ( new_count > 0 )
-                {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            memcpy(afterbydst_ipc[i].ipdst, temp_afterbydst_ipc[i].ipdst, sizeof(temp_afterbydst_ipc[i].ipdst));
-                            afterbydst_ipc[i].count = temp_afterbydst_ipc[i].count;
-                            afterbydst_ipc[i].utime = temp_afterbydst_ipc[i].utime;
-                            afterbydst_ipc[i].expire = temp_afterbydst_ipc[i].expire;
-                            strlcpy(afterbydst_ipc[i].sid, temp_afterbydst_ipc[i].sid, sizeof(afterbydst_ipc[i].sid));
-                        }
+/* The wheel links,  one per record,  follow the slots */
 
-                    counters_ipc->after_count_by_dst = new_count;
+static _Sagan_IPC_Wheel_Link *IPC_Wheel_Links( _Sagan_IPC_Index *index )
+{
+    return( (_Sagan_IPC_Wheel_Link *)&index->slots[index->mask + 1] );
+}
 
-                }
-            else
-                {
+/*****************************************************************************
+ * IPC_Index_Hash - FNV-1a of the key,  sid and selector.  sid and selector
+ * are hashed as they'd be stored (truncated to the size of the record
+ * field),  so a rebuild from the records gets the same hash.
+ *****************************************************************************/
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean after_by_dst.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_afterbydst_ipc);
-                    pthread_mutex_unlock(&After_By_Dst_Mutex);
-                    File_Unlock(config->shm_after_by_dst);
-                    return(1);
+uint32_t IPC_Index_Hash( const void *key, size_t key_len, const char *sid, const char *selector )
+{
 
-                }
+    const unsigned char *p = key;
+    uint32_t hash = 2166136261U;
+    size_t i = 0;
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for after_by_dst", __FILE__, __LINE__, new_count, old_count);
-            free(temp_afterbydst_ipc);
+    for ( i = 0; i < key_len; i++ )
+        {
+            hash = ( hash ^ p[i] ) * 16777619U;
+        }
 
-            pthread_mutex_unlock(&After_By_Dst_Mutex);
-            File_Unlock(config->shm_after_by_dst);
-            return(0);
+    hash = hash * 16777619U;
 
+    for ( i = 0; sid[i] != '\0' && i < sizeof(((thresh_by_src_ipc *)0)->sid) - 1; i++ )
+        {
+            hash = ( hash ^ (unsigned char)sid[i] ) * 16777619U;
         }
 
-    /* Afterbysrcport_IPC */
+    hash = hash * 16777619U;
 
-    else if ( type == AFTER_BY_SRCPORT && config->max_after_by_srcport < counters_ipc->after_count_by_srcport )
+    for ( i = 0; selector != NULL && selector[i] != '\0' && i < MAXSELECTOR - 1; i++ )
         {
+            hash = ( hash ^ (unsigned char)selector[i] ) * 16777619U;
+        }
 
+    return(hash);
+}
 
-            time_t t;
-            struct tm *now;
+/* The hash of a record already in a table */
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+static uint32_t IPC_Index_Record_Hash( int type, int i )
+{
 
-            char timet[20];
+    switch ( type )
+        {
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+        case(THRESH_BY_SRC):
+            return( IPC_Index_Hash(threshbysrc_ipc[i].ipsrc, MAXIPBIT, threshbysrc_ipc[i].sid, threshbysrc_ipc[i].selector) );
 
-            new_count = 0;
-            old_count = 0;
+        case(THRESH_BY_DST):
+            return( IPC_Index_Hash(threshbydst_ipc[i].ipdst, MAXIPBIT, threshbydst_ipc[i].sid, threshbydst_ipc[i].selector) );
 
-            File_Lock(config->shm_after_by_srcport);
-            pthread_mutex_lock(&After_By_Src_Port_Mutex);
+        case(THRESH_BY_SRCPORT):
+            return( IPC_Index_Hash(&threshbysrcport_ipc[i].ipsrcport, sizeof(uint32_t), threshbysrcport_ipc[i].sid, threshbysrcport_ipc[i].selector) );
 
-            struct after_by_srcport_ipc *temp_afterbysrcport_ipc;
-            temp_afterbysrcport_ipc = malloc(sizeof(struct after_by_srcport_ipc) * config->max_after_by_srcport);
+        case(THRESH_BY_DSTPORT):
+            return( IPC_Index_Hash(&threshbydstport_ipc[i].ipdstport, sizeof(uint32_t), threshbydstport_ipc[i].sid, threshbydstport_ipc[i].selector) );
 
-            memset(temp_afterbysrcport_ipc, 0, sizeof(sizeof(struct after_by_srcport_ipc) * config->max_after_by_srcport));
+        case(THRESH_BY_USERNAME):
+            return( IPC_Index_Hash(threshbyusername_ipc[i].username, strlen(threshbyusername_ipc[i].username), threshbyusername_ipc[i].sid, threshbyusername_ipc[i].selector) );
 
-            old_count = counters_ipc->after_count_by_srcport;
+        case(AFTER_BY_SRC):
+            return( IPC_Index_Hash(afterbysrc_ipc[i].ipsrc, MAXIPBIT, afterbysrc_ipc[i].sid, afterbysrc_ipc[i].selector) );
 
-            for (i = 0; i < counters_ipc->after_count_by_srcport; i++)
-                {
-                    if ( (utime - afterbysrcport_ipc[i].utime) < afterbysrcport_ipc[i].expire )
-                        {
+        case(AFTER_BY_DST):
+            return( IPC_Index_Hash(afterbydst_ipc[i].ipdst, MAXIPBIT, afterbydst_ipc[i].sid, afterbydst_ipc[i].selector) );
 
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Afterbysrcport_IPC : Keeping %u.", __FILE__, __LINE__, afterbysrcport_ipc[i].ipsrcport);
-                                }
+        case(AFTER_BY_SRCPORT):
+            return( IPC_Index_Hash(&afterbysrcport_ipc[i].ipsrcport, sizeof(uint32_t), afterbysrcport_ipc[i].sid, afterbysrcport_ipc[i].selector) );
 
-                            temp_afterbysrcport_ipc[new_count].ipsrcport = afterbysrcport_ipc[i].ipsrcport;
-                            temp_afterbysrcport_ipc[new_count].count = afterbysrcport_ipc[i].count;
-                            temp_afterbysrcport_ipc[new_count].utime = afterbysrcport_ipc[i].utime;
-                            temp_afterbysrcport_ipc[new_count].expire = afterbysrcport_ipc[i].expire;
-                            strlcpy(temp_afterbysrcport_ipc[new_count].sid, afterbysrcport_ipc[i].sid, sizeof(temp_afterbysrcport_ipc[new_count].sid));
-                            new_count++;
-                        }
-                }
+        case(AFTER_BY_DSTPORT):
+            return( IPC_Index_Hash(&afterbydstport_ipc[i].ipdstport, sizeof(uint32_t), afterbydstport_ipc[i].sid, afterbydstport_ipc[i].selector) );
 
-            if ( new_count > 0 )
-                {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            afterbysrcport_ipc[i].ipsrcport = temp_afterbysrcport_ipc[i].ipsrcport;
-                            afterbysrcport_ipc[i].count = temp_afterbysrcport_ipc[i].count;
-                            afterbysrcport_ipc[i].utime = temp_afterbysrcport_ipc[i].utime;
-                            afterbysrcport_ipc[i].expire = temp_afterbysrcport_ipc[i].expire;
-                            strlcpy(afterbysrcport_ipc[i].sid, temp_afterbysrcport_ipc[i].sid, sizeof(afterbysrcport_ipc[i].sid));
-                        }
+        case(AFTER_BY_USERNAME):
+            return( IPC_Index_Hash(afterbyusername_ipc[i].username, strlen(afterbyusername_ipc[i].username), afterbyusername_ipc[i].sid, afterbyusername_ipc[i].selector) );
 
-                    counters_ipc->after_count_by_srcport = new_count;
+        }
 
-                }
-            else
-                {
+    return(0);
+}
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean after_by_srcport.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_afterbysrcport_ipc);
-                    pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-                    File_Unlock(config->shm_after_by_srcport);
-                    return(1);
+/*****************************************************************************
+ * IPC_Wheel_Link/Unlink/Move - The expiry wheel.  Every record is on the
+ * list of the second it expires (mod IPC_WHEEL_SLOTS).  Updates that push
+ * the expiry back don't touch the wheel.  The reaper finds out when it
+ * gets to the record and puts it back on the list of its new second.
+ * Caller holds the table's mutex and File_Lock().
+ *****************************************************************************/
 
-                }
+void IPC_Wheel_Link( _Sagan_IPC_Index *index, int position, uint64_t expire_at )
+{
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for after_by_srcport", __FILE__, __LINE__, new_count, old_count);
-            free(temp_afterbysrcport_ipc);
+    _Sagan_IPC_Wheel_Link *links = IPC_Wheel_Links(index);
+    _Sagan_IPC_Wheel_Link *link = &links[position];
 
-            pthread_mutex_unlock(&After_By_Src_Port_Mutex);
-            File_Unlock(config->shm_after_by_srcport);
-            return(0);
+    /* Seconds the reaper already went by are looked at next */
 
+    if ( expire_at <= index->wheel_tick )
+        {
+            expire_at = index->wheel_tick + 1;
         }
 
-    /* Afterbydstport_IPC */
+    link->slot = expire_at % IPC_WHEEL_SLOTS;
+    link->prev = 0;
+    link->next = index->wheel[link->slot];
 
-    else if ( type == AFTER_BY_DSTPORT && config->max_after_by_dstport < counters_ipc->after_count_by_dstport )
+    if ( link->next != 0 )
         {
+            links[link->next - 1].prev = position + 1;
+        }
 
-            time_t t;
-            struct tm *now;
+    index->wheel[link->slot] = position + 1;
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+}
 
-            char timet[20];
+static void IPC_Wheel_Unlink( _Sagan_IPC_Index *index, int position )
+{
 
+    _Sagan_IPC_Wheel_Link *links = IPC_Wheel_Links(index);
+    _Sagan_IPC_Wheel_Link *link = &links[position];
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+    if ( link->prev != 0 )
+        {
+            links[link->prev - 1].next = link->next;
+        }
+    else
+        {
+            index->wheel[link->slot] = link->next;
+        }
 
-            new_count = 0;
-            old_count = 0;
+    if ( link->next != 0 )
+        {
+            links[link->next - 1].prev = link->prev;
+        }
 
-            File_Lock(config->shm_after_by_dstport);
-            pthread_mutex_lock(&After_By_Dst_Port_Mutex);
+    link->next = 0;
+    link->prev = 0;
 
-            struct after_by_dstport_ipc *temp_afterbydstport_ipc;
-            temp_afterbydstport_ipc = malloc(sizeof(struct after_by_dstport_ipc) * config->max_after_by_dstport);
+}
 
-            memset(temp_afterbydstport_ipc, 0, sizeof(sizeof(struct after_by_dstport_ipc) * config->max_after_by_dstport));
+/* Record "from" was copied to "to" */
 
-            old_count = counters_ipc->after_count_by_dstport;
+static void IPC_Wheel_Move( _Sagan_IPC_Index *index, int from, int to )
+{
 
-            for (i = 0; i < counters_ipc->after_count_by_dstport; i++)
-                {
-                    if ( (utime - afterbydstport_ipc[i].utime) < afterbydstport_ipc[i].expire )
-                        {
+    _Sagan_IPC_Wheel_Link *links = IPC_Wheel_Links(index);
+    _Sagan_IPC_Wheel_Link *link = &links[to];
 
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Afterbydstport_IPC : Keeping %u.", __FILE__, __LINE__, afterbydstport_ipc[i].ipdstport);
-                                }
+    *link = links[from];
 
-                            temp_afterbydstport_ipc[new_count].ipdstport = afterbydstport_ipc[i].ipdstport;
-                            temp_afterbydstport_ipc[new_count].count = afterbydstport_ipc[i].count;
-                            temp_afterbydstport_ipc[new_count].utime = afterbydstport_ipc[i].utime;
-                            temp_afterbydstport_ipc[new_count].expire = afterbydstport_ipc[i].expire;
-                            strlcpy(temp_afterbydstport_ipc[new_count].sid, afterbydstport_ipc[i].sid, sizeof(temp_afterbydstport_ipc[new_count].sid));
-                            new_count++;
-                        }
-                }
+    if ( link->prev != 0 )
+        {
+            links[link->prev - 1].next = to + 1;
+        }
+    else
+        {
+            index->wheel[link->slot] = to + 1;
+        }
 
-            if ( new_count > 0 )
-                {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            afterbydstport_ipc[i].ipdstport = temp_afterbydstport_ipc[i].ipdstport;
-                            afterbydstport_ipc[i].count = temp_afterbydstport_ipc[i].count;
-                            afterbydstport_ipc[i].utime = temp_afterbydstport_ipc[i].utime;
-                            afterbydstport_ipc[i].expire = temp_afterbydstport_ipc[i].expire;
-                            strlcpy(afterbydstport_ipc[i].sid, temp_afterbydstport_ipc[i].sid, sizeof(afterbydstport_ipc[i].sid));
-                        }
+    if ( link->next != 0 )
+        {
+            links[link->next - 1].prev = to + 1;
+        }
 
-                    counters_ipc->after_count_by_dstport = new_count;
+}
 
-                }
-            else
-                {
+/*****************************************************************************
+ * IPC_Index_Add - Adds record "position",  expiring at "expire_at",  to
+ * the index and wheel.  Caller holds the table's mutex and File_Lock().
+ * Lookups under a stripe lock can be running,  so the position is stored
+ * last.
+ *****************************************************************************/
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean after_by_dstport.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_afterbydstport_ipc);
-                    pthread_mutex_unlock(&After_By_Dst_Port_Mutex);
-                    File_Unlock(config->shm_after_by_dstport);
-                    return(1);
+void IPC_Index_Add( _Sagan_IPC_Index *index, uint32_t hash, int position, uint64_t expire_at )
+{
 
-                }
+    uint32_t i = 0;
+    uint32_t probes = 0;
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for after_by_dstport", __FILE__, __LINE__, new_count, old_count);
-            free(temp_afterbydstport_ipc);
+    for ( i = hash & index->mask; index->slots[i].position != 0; i = ( i + 1 ) & index->mask )
+        {
 
-            pthread_mutex_unlock(&After_By_Dst_Port_Mutex);
-            File_Unlock(config->shm_after_by_dstport);
-            return(0);
+            /* The index is twice the size of the table,  so this only
+               happens if slots have leaked.  The record still expires off
+               the wheel,  it just can't be looked up */
 
+            if ( ++probes > index->mask )
+                {
+                    Sagan_Log(WARN, "[%s, line %d] IPC hash index is full,  record %d isn't indexed.", __FILE__, __LINE__, position);
+                    IPC_Wheel_Link(index, position, expire_at);
+                    return;
+                }
         }
 
-    /* AfterbyUsername_IPC */
-
-    else if ( type == AFTER_BY_USERNAME && config->max_after_by_username < counters_ipc->after_count_by_username )
-        {
-
-            time_t t;
-            struct tm *now;
+    index->slots[i].hash = hash;
+    __atomic_store_n(&index->slots[i].position, position + 1, __ATOMIC_RELEASE);
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+    IPC_Wheel_Link(index, position, expire_at);
 
-            char timet[20];
+}
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+/*****************************************************************************
+ * IPC_Index_Next - Returns the next record with the same hash,  or -1.
+ * Start with "slot" set to the hash,  it counts up one per slot probed so
+ * a walk never goes round the index more than once.  The caller compares
+ * the record itself,  hashes can collide.
+ *****************************************************************************/
 
-            new_count = 0;
-            old_count = 0;
+int IPC_Index_Next( _Sagan_IPC_Index *index, uint32_t hash, uint32_t *slot )
+{
 
-            File_Lock(config->shm_after_by_username);
-            pthread_mutex_lock(&After_By_Username_Mutex);
+    uint32_t i = 0;
 
-            struct after_by_username_ipc *temp_afterbyusername_ipc;
-            temp_afterbyusername_ipc = malloc(sizeof(struct after_by_username_ipc) * config->max_after_by_username);
+    uint32_t position = 0;
 
-            memset(temp_afterbyusername_ipc, 0, sizeof(sizeof(struct after_by_username_ipc) * config->max_after_by_username));
+    for ( ; *slot - hash <= index->mask; (*slot)++ )
+        {
 
-            old_count = counters_ipc->after_count_by_username;
+            i = *slot & index->mask;
 
-            for (i = 0; i < counters_ipc->after_count_by_username; i++)
+            if ( ( position = __atomic_load_n(&index->slots[i].position, __ATOMIC_ACQUIRE) ) == 0 )
                 {
-                    if ( (utime - afterbyusername_ipc[i].utime) < afterbyusername_ipc[i].expire )
-                        {
-
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Afterbyusername_IPC : Keeping '%s'.", __FILE__, __LINE__, afterbyusername_ipc[i].username);
-                                }
-
-                            temp_afterbyusername_ipc[new_count].count = afterbyusername_ipc[i].count;
-                            temp_afterbyusername_ipc[new_count].utime = afterbyusername_ipc[i].utime;
-                            temp_afterbyusername_ipc[new_count].expire = afterbyusername_ipc[i].expire;
-                            strlcpy(temp_afterbyusername_ipc[new_count].sid, afterbyusername_ipc[i].sid, sizeof(temp_afterbyusername_ipc[new_count].sid));
-                            strlcpy(temp_afterbyusername_ipc[new_count].username, afterbyusername_ipc[i].username, sizeof(temp_afterbyusername_ipc[new_count].username));
-
-                            new_count++;
-                        }
+                    break;
                 }
 
-            if ( new_count > 0 )
+            if ( index->slots[i].hash == hash )
                 {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            afterbyusername_ipc[i].count = temp_afterbyusername_ipc[i].count;
-                            afterbyusername_ipc[i].utime = temp_afterbyusername_ipc[i].utime;
-                            afterbyusername_ipc[i].expire = temp_afterbyusername_ipc[i].expire;
-                            strlcpy(afterbyusername_ipc[i].sid, temp_afterbyusername_ipc[i].sid, sizeof(afterbyusername_ipc[i].sid));
-                            strlcpy(afterbyusername_ipc[i].username, temp_afterbyusername_ipc[i].username, sizeof(afterbyusername_ipc[i].username));
-                        }
-
-                    counters_ipc->after_count_by_username = new_count;
-
+                    (*slot)++;
+                    return( position - 1 );
                 }
-            else
-                {
-
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean after_by_username.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_afterbyusername_ipc);
-                    pthread_mutex_unlock(&After_By_Username_Mutex);
-                    File_Unlock(config->shm_after_by_username);
-                    return(1);
-
-                }
-
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for after_by_username", __FILE__, __LINE__, new_count, old_count);
-            free(temp_afterbyusername_ipc);
-
-            pthread_mutex_unlock(&After_By_Username_Mutex);
-            File_Unlock(config->shm_after_by_username);
-            return(0);
         }
 
-    /* Threshbysrc_IPC */
-
-    else if ( type == THRESH_BY_SRC && config->max_threshold_by_src < counters_ipc->thresh_count_by_src )
-        {
-
-            time_t t;
-            struct tm *now;
-
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
-
-            char timet[20];
-
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
-
-            new_count = 0;
-            old_count = 0;
-
-            File_Lock(config->shm_thresh_by_src);
-            pthread_mutex_lock(&Thresh_By_Src_Mutex);
+    return(-1);
+}
 
-            struct thresh_by_src_ipc *temp_threshbysrc_ipc;
-            temp_threshbysrc_ipc = malloc(sizeof(struct thresh_by_src_ipc) * config->max_threshold_by_src);
+/*****************************************************************************
+ * IPC_Index_Remove/Move - Drop record "position" from the index,  or point
+ * its slot at the record's new position.  Remove shifts the rest of the
+ * probe run back,  so no "deleted" markers build up.  Caller holds the
+ * table's mutex,  File_Lock() and every stripe.
+ *****************************************************************************/
 
-            memset(temp_threshbysrc_ipc, 0, sizeof(sizeof(struct thresh_by_src_ipc) * config->max_threshold_by_src));
+static uint32_t IPC_Index_Find( _Sagan_IPC_Index *index, uint32_t hash, int position )
+{
 
-            old_count = counters_ipc->thresh_count_by_src;
+    uint32_t i = 0;
+    uint32_t probes = 0;
 
-            for (i = 0; i < counters_ipc->thresh_count_by_src; i++)
+    for ( i = hash & index->mask; index->slots[i].position != 0 && probes <= index->mask; i = ( i + 1 ) & index->mask, probes++ )
+        {
+            if ( index->slots[i].position == (uint32_t)position + 1 )
                 {
-                    if ( (utime - threshbysrc_ipc[i].utime) < threshbysrc_ipc[i].expire )
-                        {
-
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Threshbysrc_IPC : Keeping 0x%.08X%.08X%.08X%.08X.", __FILE__, __LINE__,
-                                              htonl(((unsigned int *)&threshbysrc_ipc[i].ipsrc)[0]),
-                                              htonl(((unsigned int *)&threshbysrc_ipc[i].ipsrc)[1]),
-                                              htonl(((unsigned int *)&threshbysrc_ipc[i].ipsrc)[2]),
-                                              htonl(((unsigned int *)&threshbysrc_ipc[i].ipsrc)[3]));
-                                }
-
-                            memcpy(temp_threshbysrc_ipc[new_count].ipsrc, threshbysrc_ipc[i].ipsrc, sizeof(threshbysrc_ipc[i].ipsrc));
-                            temp_threshbysrc_ipc[new_count].count = threshbysrc_ipc[i].count;
-                            temp_threshbysrc_ipc[new_count].utime = threshbysrc_ipc[i].utime;
-                            temp_threshbysrc_ipc[new_count].expire = threshbysrc_ipc[i].expire;
-                            strlcpy(temp_threshbysrc_ipc[new_count].sid, threshbysrc_ipc[i].sid, sizeof(temp_threshbysrc_ipc[new_count].sid));
-                            new_count++;
-                        }
+                    return(i);
                 }
+        }
 
-            if ( new_count > 0 )
-                {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            memcpy(threshbysrc_ipc[i].ipsrc, temp_threshbysrc_ipc[i].ipsrc, sizeof(temp_threshbysrc_ipc[i].ipsrc));
-                            threshbysrc_ipc[i].count = temp_threshbysrc_ipc[i].count;
-                            threshbysrc_ipc[i].utime = temp_threshbysrc_ipc[i].utime;
-                            threshbysrc_ipc[i].expire = temp_threshbysrc_ipc[i].expire;
-                            strlcpy(threshbysrc_ipc[i].sid, temp_threshbysrc_ipc[i].sid, sizeof(threshbysrc_ipc[i].sid));
-                        }
+    return(UINT32_MAX);
+}
 
-                    counters_ipc->thresh_count_by_src = new_count;
+static void IPC_Index_Remove( _Sagan_IPC_Index *index, uint32_t hash, int position )
+{
 
-                }
-            else
-                {
+    uint32_t i = IPC_Index_Find(index, hash, position);
+    uint32_t j = i;
+    uint32_t home = 0;
+    uint32_t probes = 0;
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean thresh_by_src.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_threshbysrc_ipc);
-                    pthread_mutex_unlock(&Thresh_By_Src_Mutex);
-                    File_Unlock(config->shm_thresh_by_src);
-                    return(1);
+    if ( i == UINT32_MAX )
+        {
+            return;
+        }
 
-                }
+    for ( j = ( i + 1 ) & index->mask; index->slots[j].position != 0 && probes < index->mask; j = ( j + 1 ) & index->mask, probes++ )
+        {
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for thresh_by_src", __FILE__, __LINE__, new_count, old_count);
-            free(temp_threshbysrc_ipc);
+            /* Slot "j" can fill the hole if its home isn't between the
+               hole and "j" */
 
-            pthread_mutex_unlock(&Thresh_By_Src_Mutex);
-            File_Unlock(config->shm_thresh_by_src);
-            return(0);
+            home = index->slots[j].hash & index->mask;
 
+            if ( ( i <= j ) ? ( home <= i || home > j ) : ( home <= i && home > j ) )
+                {
+                    index->slots[i] = index->slots[j];
+                    i = j;
+                }
         }
 
-    /* Threshbydst_IPC */
+    index->slots[i].position = 0;
+    index->slots[i].hash = 0;
 
-    else if ( type == THRESH_BY_SRC && config->max_threshold_by_dst < counters_ipc->thresh_count_by_dst )
-        {
+}
 
-            time_t t;
-            struct tm *now;
+static void IPC_Index_Move( _Sagan_IPC_Index *index, uint32_t hash, int from, int to )
+{
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+    uint32_t i = IPC_Index_Find(index, hash, from);
 
-            char timet[20];
+    if ( i != UINT32_MAX )
+        {
+            index->slots[i].position = to + 1;
+        }
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+}
 
-            new_count = 0;
-            old_count = 0;
+/*****************************************************************************
+ * IPC_Index_Lock/Unlock - Lock the stripe "hash" falls in.  Updates to a
+ * record are a few stores,  so waiters spin (yielding) rather than sleep.
+ * Lock_All() is for the reaper,  which moves records around.  The stripe
+ * holds the pid of the Sagan that has it.  Every so often a waiter checks
+ * that pid is still around and takes the stripe over if it isn't,  so a
+ * Sagan killed while holding one doesn't hang the others.
+ *****************************************************************************/
 
-            File_Lock(config->shm_thresh_by_dst);
-            pthread_mutex_lock(&Thresh_By_Dst_Mutex);
+void IPC_Index_Lock( _Sagan_IPC_Index *index, uint32_t hash )
+{
 
-            struct thresh_by_dst_ipc *temp_threshbydst_ipc;
-            temp_threshbydst_ipc = malloc(sizeof(struct thresh_by_dst_ipc) * config->max_threshold_by_dst);
+    uint32_t *lock = &index->locks[hash & ( IPC_INDEX_LOCKS - 1 )].lock;
+    uint32_t holder = 0;
+    uint32_t spins = 0;
 
-            memset(temp_threshbydst_ipc, 0, sizeof(sizeof(struct thresh_by_dst_ipc) * config->max_threshold_by_dst));
+    while (1)
+        {
 
-            old_count = counters_ipc->thresh_count_by_dst;
+            holder = 0;
 
-            for (i = 0; i < counters_ipc->thresh_count_by_dst; i++)
+            if ( __atomic_compare_exchange_n(lock, &holder, ipc_pid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
                 {
-                    if ( (utime - threshbydst_ipc[i].utime) < threshbydst_ipc[i].expire )
-                        {
-
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Threshbydst_IPC : Keeping 0x%.08X%.08X%.08X%.08X.", __FILE__, __LINE__,
-                                              htonl(((unsigned int *)&threshbydst_ipc[i].ipdst)[0]),
-                                              htonl(((unsigned int *)&threshbydst_ipc[i].ipdst)[1]),
-                                              htonl(((unsigned int *)&threshbydst_ipc[i].ipdst)[2]),
-                                              htonl(((unsigned int *)&threshbydst_ipc[i].ipdst)[3]));
-                                }
-
-                            memcpy(temp_threshbydst_ipc[new_count].ipdst, threshbydst_ipc[i].ipdst, sizeof(threshbydst_ipc[i].ipdst));
-                            temp_threshbydst_ipc[new_count].count = threshbydst_ipc[i].count;
-                            temp_threshbydst_ipc[new_count].utime = threshbydst_ipc[i].utime;
-                            temp_threshbydst_ipc[new_count].expire = threshbydst_ipc[i].expire;
-                            strlcpy(temp_threshbydst_ipc[new_count].sid, threshbydst_ipc[i].sid, sizeof(temp_threshbydst_ipc[new_count].sid));
-                            new_count++;
-                        }
+                    return;
                 }
 
-            if ( new_count > 0 )
+            if ( ++spins % IPC_INDEX_LOCK_CHECK == 0 && holder != 0 && holder != ipc_pid &&
+                    kill(holder, 0) == -1 && errno == ESRCH &&
+                    __atomic_compare_exchange_n(lock, &holder, 0, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
                 {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            memcpy(threshbydst_ipc[i].ipdst, temp_threshbydst_ipc[i].ipdst, sizeof(temp_threshbydst_ipc[i].ipdst));
-                            threshbydst_ipc[i].count = temp_threshbydst_ipc[i].count;
-                            threshbydst_ipc[i].utime = temp_threshbydst_ipc[i].utime;
-                            threshbydst_ipc[i].expire = temp_threshbydst_ipc[i].expire;
-                            strlcpy(threshbydst_ipc[i].sid, temp_threshbydst_ipc[i].sid, sizeof(threshbydst_ipc[i].sid));
-                        }
-
-                    counters_ipc->thresh_count_by_dst = new_count;
-
+                    Sagan_Log(WARN, "[%s, line %d] Took over an IPC lock held by pid %u,  which is gone.", __FILE__, __LINE__, holder);
+                    continue;
                 }
-            else
-                {
-
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean thresh_by_dst.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_threshbydst_ipc);
-                    pthread_mutex_unlock(&Thresh_By_Dst_Mutex);
-                    File_Unlock(config->shm_thresh_by_dst);
-                    return(1);
 
-                }
+            sched_yield();
+        }
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for thresh_by_dst", __FILE__, __LINE__, new_count, old_count);
-            free(temp_threshbydst_ipc);
+}
 
-            pthread_mutex_unlock(&Thresh_By_Dst_Mutex);
-            File_Unlock(config->shm_thresh_by_dst);
-            return(0);
+void IPC_Index_Unlock( _Sagan_IPC_Index *index, uint32_t hash )
+{
+    __atomic_store_n(&index->locks[hash & ( IPC_INDEX_LOCKS - 1 )].lock, 0, __ATOMIC_RELEASE);
+}
 
-        }
+void IPC_Index_Lock_All( _Sagan_IPC_Index *index )
+{
 
-    /* Threshbysrcport_IPC */
+    uint32_t i = 0;
 
-    else if ( type == THRESH_BY_SRCPORT && config->max_threshold_by_srcport < counters_ipc->thresh_count_by_srcport )
+    for ( i = 0; i < IPC_INDEX_LOCKS; i++ )
         {
+            IPC_Index_Lock(index, i);
+        }
 
-            time_t t;
-            struct tm *now;
+}
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+void IPC_Index_Unlock_All( _Sagan_IPC_Index *index )
+{
 
-            char timet[20];
+    uint32_t i = 0;
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+    for ( i = 0; i < IPC_INDEX_LOCKS; i++ )
+        {
+            IPC_Index_Unlock(index, i);
+        }
 
-            new_count = 0;
-            old_count = 0;
+}
 
-            File_Lock(config->shm_thresh_by_srcport);
-            pthread_mutex_lock(&Thresh_By_Src_Port_Mutex);
+/*****************************************************************************
+ * IPC_Index_Build - Rebuilds a table's index and wheel from its records.
+ * Done by IPC_Table_Map() when the file is new or its header doesn't
+ * match.  Caller holds File_Lock() and nobody can be using the index.  The
+ * stripes themselves are left alone.
+ *****************************************************************************/
 
-            struct thresh_by_srcport_ipc *temp_threshbysrcport_ipc;
-            temp_threshbysrcport_ipc = malloc(sizeof(struct thresh_by_srcport_ipc) * config->max_threshold_by_srcport);
+void IPC_Index_Build( int type )
+{
 
-            memset(temp_threshbysrcport_ipc, 0, sizeof(sizeof(struct thresh_by_srcport_ipc) * config->max_threshold_by_srcport));
+    _IPC_Table *table = IPC_Table_Lookup(type);
+    _Sagan_IPC_Index *index = NULL;
 
-            old_count = counters_ipc->thresh_count_by_srcport;
+    int count = 0;
+    int i = 0;
 
-            for (i = 0; i < counters_ipc->thresh_count_by_src; i++)
-                {
-                    if ( (utime - threshbysrc_ipc[i].utime) < threshbysrc_ipc[i].expire )
-                        {
+    if ( table == NULL )
+        {
+            return;
+        }
 
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Threshbysrcport_IPC : Keeping %u.", __FILE__, __LINE__, threshbysrcport_ipc[i].ipsrcport);
-                                }
+    index = *table->index;
+    count = *IPC_Table_Count(table);
 
-                            temp_threshbysrcport_ipc[new_count].ipsrcport = threshbysrcport_ipc[i].ipsrcport;
-                            temp_threshbysrcport_ipc[new_count].count = threshbysrcport_ipc[i].count;
-                            temp_threshbysrcport_ipc[new_count].utime = threshbysrcport_ipc[i].utime;
-                            temp_threshbysrcport_ipc[new_count].expire = threshbysrcport_ipc[i].expire;
-                            strlcpy(temp_threshbysrcport_ipc[new_count].sid, threshbysrcport_ipc[i].sid, sizeof(temp_threshbysrcport_ipc[new_count].sid));
-                            new_count++;
-                        }
-                }
+    index->mask = IPC_Index_Slots(IPC_Table_Max(table), table->hashed) - 1;
+    memset(index->slots, 0, ( index->mask + 1 ) * sizeof(_Sagan_IPC_Index_Slot));
 
-            if ( new_count > 0 )
-                {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            threshbysrcport_ipc[i].ipsrcport = temp_threshbysrcport_ipc[i].ipsrcport;
-                            threshbysrcport_ipc[i].count = temp_threshbysrcport_ipc[i].count;
-                            threshbysrcport_ipc[i].utime = temp_threshbysrcport_ipc[i].utime;
-                            threshbysrcport_ipc[i].expire = temp_threshbysrcport_ipc[i].expire;
-                            strlcpy(threshbysrcport_ipc[i].sid, temp_threshbysrcport_ipc[i].sid, sizeof(threshbysrcport_ipc[i].sid));
-                        }
+    /* Records left over from the last run and already expired are on the
+       first second the reaper looks at */
 
-                    counters_ipc->thresh_count_by_srcport = new_count;
+    index->wheel_tick = time(NULL);
+    memset(index->wheel, 0, sizeof(index->wheel));
 
+    for ( i = 0; i < count; i++ )
+        {
+            if ( table->hashed == true )
+                {
+                    IPC_Index_Add(index, IPC_Index_Record_Hash(type, i), i, IPC_Table_Expire(table, i));
                 }
             else
                 {
+                    IPC_Wheel_Link(index, i, IPC_Table_Expire(table, i));
+                }
+        }
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean thresh_by_srcport.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_threshbysrcport_ipc);
-                    pthread_mutex_unlock(&Thresh_By_Src_Port_Mutex);
-                    File_Unlock(config->shm_thresh_by_src);
-                    return(1);
+}
 
-                }
+/*****************************************************************************
+ * IPC_Reap - Removes the expired records of a table,  one second of the
+ * wheel at a time up to "now".  The last record is moved into the hole,
+ * so no record is copied more than once.  Stops after "limit" records and
+ * returns false if there is more to do.  Caller holds the table's mutex,
+ * File_Lock() and every stripe.
+ *****************************************************************************/
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for thresh_by_srcport", __FILE__, __LINE__, new_count, old_count);
-            free(temp_threshbysrcport_ipc);
+static void IPC_Reap_Record( _IPC_Table *table, _Sagan_IPC_Index *index, int position )
+{
 
-            pthread_mutex_unlock(&Thresh_By_Src_Port_Mutex);
-            File_Unlock(config->shm_thresh_by_srcport);
-            return(0);
+    int *count = IPC_Table_Count(table);
+    int last = *count - 1;
 
+    if ( table->hashed == true )
+        {
+            IPC_Index_Remove(index, IPC_Index_Record_Hash(table->type, position), position);
         }
 
-    /* Threshbydstport_IPC */
-
-    else if ( type == THRESH_BY_DSTPORT && config->max_threshold_by_dstport < counters_ipc->thresh_count_by_dstport )
+    if ( position != last )
         {
 
-            time_t t;
-            struct tm *now;
+            if ( table->hashed == true )
+                {
+                    IPC_Index_Move(index, IPC_Index_Record_Hash(table->type, last), last, position);
+                }
+
+            IPC_Wheel_Move(index, last, position);
+            memcpy(IPC_Table_Record(table, position), IPC_Table_Record(table, last), table->record_size);
+
+            if ( table->side != NULL )
+                {
+                    memcpy((char *)*table->side + (size_t)position * table->side_size, (char *)*table->side + (size_t)last * table->side_size, table->side_size);
+                }
+        }
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+    *count = last;
 
-            char timet[20];
+}
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+static bool IPC_Reap( _IPC_Table *table, uint64_t now, int limit, int *removed )
+{
 
-            new_count = 0;
-            old_count = 0;
+    _Sagan_IPC_Index *index = *table->index;
+    _Sagan_IPC_Wheel_Link *links = IPC_Wheel_Links(index);
 
-            File_Lock(config->shm_thresh_by_dstport);
-            pthread_mutex_lock(&Thresh_By_Dst_Port_Mutex);
+    uint32_t *drain = &index->wheel[IPC_WHEEL_SLOTS];
+    uint32_t slot = 0;
+    uint32_t p = 0;
 
-            struct thresh_by_dstport_ipc *temp_threshbydstport_ipc;
-            temp_threshbydstport_ipc = malloc(sizeof(struct thresh_by_dstport_ipc) * config->max_threshold_by_dstport);
+    uint64_t expire_at = 0;
+    int done = 0;
 
-            memset(temp_threshbydstport_ipc, 0, sizeof(sizeof(struct thresh_by_dstport_ipc) * config->max_threshold_by_dstport));
+    while (1)
+        {
 
-            old_count = counters_ipc->thresh_count_by_dstport;
+            /* The list being worked on.  It's a wheel slot of its own so
+               moving the last record into a hole keeps it right */
 
-            for (i = 0; i < counters_ipc->thresh_count_by_dst; i++)
+            while ( *drain != 0 )
                 {
-                    if ( (utime - threshbydst_ipc[i].utime) < threshbydst_ipc[i].expire )
+
+                    if ( done++ == limit )
                         {
+                            return(false);
+                        }
 
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Threshbydstport_IPC : Keeping %u.", __FILE__, __LINE__, threshbydstport_ipc[i].ipdstport);
-                                }
+                    p = *drain - 1;
+                    IPC_Wheel_Unlink(index, p);
+
+                    expire_at = IPC_Table_Expire(table, p);
 
-                            temp_threshbydstport_ipc[new_count].ipdstport = threshbydstport_ipc[i].ipdstport;
-                            temp_threshbydstport_ipc[new_count].count = threshbydstport_ipc[i].count;
-                            temp_threshbydstport_ipc[new_count].utime = threshbydstport_ipc[i].utime;
-                            temp_threshbydstport_ipc[new_count].expire = threshbydstport_ipc[i].expire;
-                            strlcpy(temp_threshbydstport_ipc[new_count].sid, threshbydstport_ipc[i].sid, sizeof(temp_threshbydstport_ipc[new_count].sid));
-                            new_count++;
+                    if ( expire_at <= now )
+                        {
+                            IPC_Reap_Record(table, index, p);
+                            (*removed)++;
+                        }
+                    else
+                        {
+                            IPC_Wheel_Link(index, p, expire_at);
                         }
                 }
 
-            if ( new_count > 0 )
+            if ( index->wheel_tick >= now )
                 {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            threshbydstport_ipc[i].ipdstport = temp_threshbydstport_ipc[i].ipdstport;
-                            threshbydstport_ipc[i].count = temp_threshbydstport_ipc[i].count;
-                            threshbydstport_ipc[i].utime = temp_threshbydstport_ipc[i].utime;
-                            threshbydstport_ipc[i].expire = temp_threshbydstport_ipc[i].expire;
-                            strlcpy(threshbydstport_ipc[i].sid, temp_threshbydstport_ipc[i].sid, sizeof(threshbydstport_ipc[i].sid));
-                        }
+                    return(true);
+                }
 
-                    counters_ipc->thresh_count_by_dstport = new_count;
+            /* Been away for more than a turn of the wheel.  One turn
+               looks at every record */
 
-                }
-            else
+            if ( now - index->wheel_tick > IPC_WHEEL_SLOTS )
                 {
+                    index->wheel_tick = now - IPC_WHEEL_SLOTS;
+                }
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean thresh_by_dstport.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_threshbydstport_ipc);
-                    pthread_mutex_unlock(&Thresh_By_Dst_Port_Mutex);
-                    File_Unlock(config->shm_thresh_by_dst);
-                    return(1);
+            index->wheel_tick++;
 
+            slot = index->wheel_tick % IPC_WHEEL_SLOTS;
+            *drain = index->wheel[slot];
+            index->wheel[slot] = 0;
+
+            for ( p = *drain; p != 0; p = links[p - 1].next )
+                {
+                    links[p - 1].slot = IPC_WHEEL_SLOTS;
                 }
+        }
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for thresh_by_dstport", __FILE__, __LINE__, new_count, old_count);
-            free(temp_threshbydstport_ipc);
+}
 
-            pthread_mutex_unlock(&Thresh_By_Dst_Port_Mutex);
-            File_Unlock(config->shm_thresh_by_dstport);
-            return(0);
+/*****************************************************************************
+ * IPC_Reaper - Thread that expires threshold/after records as they age
+ * out,  a batch at a time so lookups and inserts never wait long.
+ *****************************************************************************/
 
-        }
+static void IPC_Reaper_Table( _IPC_Table *table, uint64_t now, int limit )
+{
+
+    int shm = IPC_Table_Shm(table);
+    int removed = 0;
+    bool finished = false;
 
-    /* ThreshbyUsername_IPC */
+    /* Xbits kept in Redis */
 
-    else if ( type == THRESH_BY_USERNAME && config->max_threshold_by_username < counters_ipc->thresh_count_by_username )
+    if ( *table->index == NULL )
         {
+            return;
+        }
 
-            time_t t;
-            struct tm *now;
+    while ( finished == false )
+        {
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+            File_Lock(shm);
+            pthread_mutex_lock(table->mutex);
+            IPC_Index_Lock_All(*table->index);
 
-            char timet[20];
+            finished = IPC_Reap(table, now, limit, &removed);
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+            IPC_Index_Unlock_All(*table->index);
+            pthread_mutex_unlock(table->mutex);
+            File_Unlock(shm);
 
-            new_count = 0;
-            old_count = 0;
+        }
 
-            File_Lock(config->shm_thresh_by_username);
-            pthread_mutex_lock(&Thresh_By_Username_Mutex);
+    if ( removed > 0 && debug->debugipc )
+        {
+            Sagan_Log(DEBUG, "[%s, line %d] Expired %d records from %s.", __FILE__, __LINE__, removed, table->name);
+        }
 
-            struct thresh_by_username_ipc *temp_threshbyusername_ipc;
-            temp_threshbyusername_ipc = malloc(sizeof(struct thresh_by_username_ipc) * config->max_threshold_by_username);
+}
 
-            memset(temp_threshbyusername_ipc, 0, sizeof(sizeof(struct thresh_by_username_ipc) * config->max_threshold_by_username));
+void IPC_Reaper( void )
+{
 
-            old_count = counters_ipc->thresh_count_by_username;
+    uint32_t i = 0;
 
-            for (i = 0; i < counters_ipc->thresh_count_by_username; i++)
-                {
-                    if ( (utime - threshbyusername_ipc[i].utime) < threshbyusername_ipc[i].expire )
-                        {
+    (void)SetThreadName("SaganReaper");
 
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Afterbyusername_IPC : Keeping '%s'.", __FILE__, __LINE__, threshbyusername_ipc[i].username);
-                                }
+    while (1)
+        {
 
-                            temp_threshbyusername_ipc[new_count].count = threshbyusername_ipc[i].count;
-                            temp_threshbyusername_ipc[new_count].utime = threshbyusername_ipc[i].utime;
-                            temp_threshbyusername_ipc[new_count].expire = threshbyusername_ipc[i].expire;
-                            strlcpy(temp_threshbyusername_ipc[new_count].sid, threshbyusername_ipc[i].sid, sizeof(temp_threshbyusername_ipc[new_count].sid));
-                            strlcpy(temp_threshbyusername_ipc[new_count].username, threshbyusername_ipc[i].username, sizeof(temp_threshbyusername_ipc[new_count].username));
+            sleep(1);
 
-                            new_count++;
-                        }
-                }
-
-            if ( new_count > 0 )
+            for ( i = 0; i < IPC_TABLES; i++ )
                 {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            threshbyusername_ipc[i].count = temp_threshbyusername_ipc[i].count;
-                            threshbyusername_ipc[i].utime = temp_threshbyusername_ipc[i].utime;
-                            threshbyusername_ipc[i].expire = temp_threshbyusername_ipc[i].expire;
-                            strlcpy(threshbyusername_ipc[i].sid, temp_threshbyusername_ipc[i].sid, sizeof(threshbyusername_ipc[i].sid));
-                            strlcpy(threshbyusername_ipc[i].username, temp_threshbyusername_ipc[i].username, sizeof(threshbyusername_ipc[i].username));
-                        }
+                    IPC_Reaper_Table(&ipc_tables[i], time(NULL), IPC_REAP_BATCH);
+                }
 
-                    counters_ipc->thresh_count_by_username = new_count;
+        }
 
-                }
-            else
-                {
+}
 
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean thresh_by_username.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_threshbyusername_ipc);
-                    pthread_mutex_unlock(&Thresh_By_Username_Mutex);
-                    File_Unlock(config->shm_thresh_by_username);
-                    return(1);
+/*****************************************************************************
+ * IPC_Sample - Stores a "last message" sample for a threshold,  after or
+ * xbit record.  Returns the number the record keeps,  or 0 if samples are
+ * turned off.  See _Sagan_IPC_Sample.
+ *****************************************************************************/
 
-                }
+uint64_t IPC_Sample( const char *signature_msg, const char *syslog_message )
+{
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for thresh_by_username", __FILE__, __LINE__, new_count, old_count);
-            free(temp_threshbyusername_ipc);
+    _Sagan_IPC_Sample *sample = NULL;
+    uint64_t sequence = 0;
 
-            pthread_mutex_unlock(&Thresh_By_Username_Mutex);
-            File_Unlock(config->shm_thresh_by_username);
+    if ( samples_ipc == NULL )
+        {
             return(0);
         }
 
-    /* Xbit_IPC */
-
-    else if ( type == XBIT && config->max_xbits < counters_ipc->xbit_count && config->xbit_storage == XBIT_STORAGE_MMAP )
-        {
+    sequence = __atomic_add_fetch(&samples_ipc->sequence, 1, __ATOMIC_RELAXED);
+    sample = &samples_ipc->samples[sequence % samples_ipc->max];
 
-            time_t t;
-            struct tm *now;
+    __atomic_store_n(&sample->sequence, 0, __ATOMIC_RELAXED);
 
-            int i;
-            int utime = 0;
-            int new_count = 0;
-            int old_count = 0;
+    strlcpy(sample->signature_msg, signature_msg, sizeof(sample->signature_msg));
+    strlcpy(sample->syslog_message, syslog_message, sizeof(sample->syslog_message));
 
-            char timet[20];
+    __atomic_store_n(&sample->sequence, sequence, __ATOMIC_RELEASE);
 
-            t = time(NULL);
-            now=localtime(&t);
-            strftime(timet, sizeof(timet), "%s",  now);
-            utime = atol(timet);
+    return(sequence);
+}
 
-            new_count = 0;
-            old_count = 0;
+/*****************************************************************************
+ * Clean_IPC_Object - If the max IPC is hit,  we attempt to "clean" out
+ * any stale IPC entries.
+ *****************************************************************************/
 
-            File_Lock(config->shm_xbit);
-            pthread_mutex_lock(&Xbit_Mutex);
+bool Clean_IPC_Object( int type )
+{
 
-            struct _Sagan_IPC_Xbit *temp_xbit_ipc;
-            temp_xbit_ipc = malloc(sizeof(struct _Sagan_IPC_Xbit) * config->max_xbits);
+    _IPC_Table *table = IPC_Table_Lookup(type);
 
-            memset(temp_xbit_ipc, 0, sizeof(sizeof(struct _Sagan_IPC_Xbit) * config->max_xbits));
+    /* Threshold,  after and xbit records are expired as they age out by
+       IPC_Reaper().  If the table is full anyway,  the reaper might be
+       behind,  so catch it up here */
 
-            old_count = counters_ipc->xbit_count;
+    if ( table != NULL )
+        {
 
-            for (i = 0; i < counters_ipc->xbit_count; i++)
+            if ( *IPC_Table_Count(table) < IPC_Table_Max(table) )
                 {
-                    if ( (utime - xbit_ipc[i].xbit_expire) < xbit_ipc[i].expire )
-                        {
-
-                            if ( debug->debugipc )
-                                {
-                                    Sagan_Log(DEBUG, "[%s, %d line] Flowbot_IPC : Keeping [0x%.08X%.08X%.08X%.08X -> 0x%.08X%.08X%.08X%.08X].", __FILE__, __LINE__,
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_src)[0]),
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_src)[1]),
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_src)[2]),
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_src)[3]),
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_dst)[0]),
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_dst)[1]),
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_dst)[2]),
-                                              htonl(((unsigned int *)&xbit_ipc[i].ip_dst)[3]));
-                                }
-
-                            temp_xbit_ipc[new_count].xbit_state = xbit_ipc[i].xbit_state;
-                            memcpy(temp_xbit_ipc[new_count].ip_src, xbit_ipc[i].ip_src, sizeof(xbit_ipc[i].ip_src));
-                            memcpy(temp_xbit_ipc[new_count].ip_dst, xbit_ipc[i].ip_dst, sizeof(xbit_ipc[i].ip_dst));
-                            temp_xbit_ipc[new_count].xbit_expire = xbit_ipc[i].xbit_expire;
-                            temp_xbit_ipc[new_count].expire = xbit_ipc[i].expire;
-                            strlcpy(temp_xbit_ipc[new_count].xbit_name, xbit_ipc[i].xbit_name, sizeof(temp_xbit_ipc[new_count].xbit_name));
-
-                            new_count++;
-                        }
+                    return(0);
                 }
 
-            if ( new_count > 0 )
+            if ( debug->debugipc )
                 {
-                    for ( i = 0; i < new_count; i++ )
-                        {
-                            xbit_ipc[i].xbit_state = temp_xbit_ipc[i].xbit_state;
-                            memcpy(temp_xbit_ipc[i].ip_src, temp_xbit_ipc[i].ip_src, sizeof(temp_xbit_ipc[i].ip_src));
-                            memcpy(temp_xbit_ipc[i].ip_dst, temp_xbit_ipc[i].ip_dst, sizeof(temp_xbit_ipc[i].ip_dst));
-                            xbit_ipc[i].xbit_expire = temp_xbit_ipc[i].xbit_expire;
-                            xbit_ipc[i].expire = temp_xbit_ipc[i].expire;
-                            strlcpy(xbit_ipc[i].xbit_name, temp_xbit_ipc[i].xbit_name, sizeof(xbit_ipc[i].xbit_name));
-                        }
+                    Sagan_Log(DEBUG, "[%s, %d line] Cleaning IPC data. Type: %d", __FILE__, __LINE__, type);
+                }
 
-                    counters_ipc->xbit_count = new_count;
+            IPC_Reaper_Table(table, time(NULL), IPC_REAP_BATCH);
 
-                }
-            else
+            if ( *IPC_Table_Count(table) < IPC_Table_Max(table) )
                 {
-
-                    Sagan_Log(WARN, "[%s, line %d] Could not clean _Sagan_IPC_Xbit.  Nothing to remove!", __FILE__, __LINE__);
-                    free(temp_xbit_ipc);
-                    pthread_mutex_unlock(&Xbit_Mutex);
-                    File_Unlock(config->shm_xbit);
-                    return(1);
+                    return(0);
                 }
 
-            Sagan_Log(NORMAL, "[%s, line %d] Kept %d elements out of %d for _Sagan_IPC_Xbit.", __FILE__, __LINE__, new_count, old_count);
-            free(temp_xbit_ipc);
-
-            pthread_mutex_unlock(&Xbit_Mutex);
-            File_Unlock(config->shm_xbit);
-            return(0);
+            Sagan_Log(WARN, "[%s, line %d] Could not clean %s.  Nothing to remove!", __FILE__, __LINE__, table->name);
+            return(1);
 
         }
 
@@ -1102,6 +1015,127 @@ void IPC_Check_Object(char *tmp_object_check, bool new_counters, char *object_na
         }
 }
 
+/*****************************************************************************
+ * IPC_Table_Map - Create (if needed) or map to a threshold/after table.
+ * Other Sagans can be using the file,  so it's only touched under
+ * File_Lock() and only set up again if it's new or its header doesn't
+ * match.  A file made for a different "max" is used as it is.  Making it
+ * smaller would pull the pages out from under whoever has it mapped.
+ * Returns true if the file is new.
+ *****************************************************************************/
+
+/* The per record side table (see _Sagan_Thresh_State) starts on the
+   cache line after the index */
+
+static size_t IPC_Table_Side( _IPC_Table *table, int max )
+{
+    return( ( sizeof(_Sagan_IPC_Header) + table->record_size * (size_t)max + IPC_Index_Size(max, table->hashed) + 63 ) & ~(size_t)63 );
+}
+
+static size_t IPC_Table_Size( _IPC_Table *table, int max )
+{
+    return( IPC_Table_Side(table, max) + table->side_size * (size_t)max );
+}
+
+static bool IPC_Table_Map( int type, bool new_counters )
+{
+
+    _IPC_Table *table = IPC_Table_Lookup(type);
+    _Sagan_IPC_Header header;
+    _Sagan_IPC_Header *map = NULL;
+
+    struct stat object_stat;
+
+    char tmp_object_check[255];
+
+    int *shm = (int *)( (char *)config + table->shm );
+    int *count = IPC_Table_Count(table);
+    int max = IPC_Table_Config_Max(table);
+
+    bool new_object = false;
+    bool rebuild = false;
+
+    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, table->file);
+
+    IPC_Check_Object(tmp_object_check, new_counters, (char *)table->name);
+
+    if ((*shm = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+        {
+            new_object = true;
+        }
+
+    else if ((*shm = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for %s (%s:%s)", __FILE__, __LINE__, table->name, tmp_object_check, strerror(errno));
+        }
+
+    File_Lock(*shm);
+
+    if ( fstat(*shm, &object_stat) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Cannot fstat() %s. [%s]", __FILE__, __LINE__, tmp_object_check, strerror(errno));
+        }
+
+    if ( new_object == true || pread(*shm, &header, sizeof(header), 0) != sizeof(header) ||
+            header.magic != IPC_MAGIC || header.version != IPC_VERSION || header.record_size != table->record_size ||
+            header.max == 0 || header.max > INT_MAX || (uint64_t)object_stat.st_size < IPC_Table_Size(table, header.max) ||
+            *count < 0 || *count > (int)header.max )
+        {
+
+            if ( new_object == false )
+                {
+                    Sagan_Log(WARN, "[%s, line %d] %s was made by a different version of Sagan or is damaged.  Starting it over.", __FILE__, __LINE__, tmp_object_check);
+                }
+
+            /* Truncating to 0 first zeros it */
+
+            if ( ftruncate(*shm, 0) != 0 || ftruncate(*shm, IPC_Table_Size(table, max)) != 0 )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate %s. [%s]", __FILE__, __LINE__, table->name, strerror(errno));
+                }
+
+            *count = 0;
+            rebuild = true;
+
+        }
+    else if ( (int)header.max != max )
+        {
+            Sagan_Log(WARN, "[%s, line %d] %s holds %u records,  not the %d configured.  Using %u.  Remove the file while no Sagan is running to resize it.", __FILE__, __LINE__, tmp_object_check, header.max, max, header.max);
+            max = header.max;
+        }
+
+    if (( map = mmap(0, IPC_Table_Size(table, max), (PROT_READ | PROT_WRITE), MAP_SHARED, *shm, 0)) == MAP_FAILED )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for %s object! [%s]", __FILE__, __LINE__, table->name, strerror(errno));
+        }
+
+    table->records_max = max;
+    *table->records = (char *)map + sizeof(_Sagan_IPC_Header);
+    *table->index = (_Sagan_IPC_Index *)( (char *)*table->records + table->record_size * (size_t)max );
+
+    if ( table->side != NULL )
+        {
+            *table->side = (char *)map + IPC_Table_Side(table, max);
+        }
+
+    if ( rebuild == true )
+        {
+
+            memset((*table->index)->locks, 0, sizeof((*table->index)->locks));
+            IPC_Index_Build(type);
+
+            map->version = IPC_VERSION;
+            map->max = max;
+            map->record_size = table->record_size;
+            __atomic_store_n(&map->magic, IPC_MAGIC, __ATOMIC_RELEASE);
+
+        }
+
+    File_Unlock(*shm);
+
+    return(new_object);
+}
+
 /*****************************************************************************
  * IPC_Init - Create (if needed) or map to an IPC object.
  *****************************************************************************/
@@ -1122,8 +1156,14 @@ void IPC_Init(void)
     char ip_src[MAXIP];
     char ip_dst[MAXIP];
 
+    struct stat samples_stat;
+    _Sagan_IPC_Samples samples_header;
+    uint32_t samples_max = 0;
+
     /* For convert 32 bit IP to octet */
 
+    ipc_pid = getpid();
+
     Sagan_Log(NORMAL, "Initializing shared memory objects.");
     Sagan_Log(NORMAL, "---------------------------------------------------------------------------");
 
@@ -1148,6 +1188,8 @@ void IPC_Init(void)
         }
 
 
+    File_Lock(config->shm_counters);
+
     if ( ftruncate(config->shm_counters, sizeof(_Sagan_IPC_Counters)) != 0 )
         {
             Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate counters. [%s]", __FILE__, __LINE__, strerror(errno));
@@ -1158,39 +1200,40 @@ void IPC_Init(void)
             Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for counters object! [%s]", __FILE__, __LINE__, strerror(errno));
         }
 
-    /* Xbit memory object - File based mmap() */
+    /* Counters from another version of Sagan (or from before the counters
+       had a version) don't go with the other objects.  Start them all
+       over.  The others are unlinked,  so a Sagan still running from them
+       keeps its own copy */
 
-    if ( config->xbit_storage == XBIT_STORAGE_MMAP )
+    if ( new_counters == 0 && ( counters_ipc->magic != IPC_MAGIC || counters_ipc->version != IPC_VERSION ) )
         {
+            Sagan_Log(WARN, "[%s, line %d] %s was made by a different version of Sagan.  Starting the shared memory objects over.", __FILE__, __LINE__, tmp_object_check);
+            memset(counters_ipc, 0, sizeof(_Sagan_IPC_Counters));
+            new_counters = 1;
+        }
 
-            snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, XBIT_IPC_FILE);
-
-            IPC_Check_Object(tmp_object_check, new_counters, "xbit");
+    if ( new_counters == 1 )
+        {
+            counters_ipc->version = IPC_VERSION;
+            __atomic_store_n(&counters_ipc->magic, IPC_MAGIC, __ATOMIC_RELEASE);
+        }
 
-            if ((config->shm_xbit = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
-                {
-                    Sagan_Log(NORMAL, "+ Xbit shared object (new).");
-                    new_object=1;
-                }
+    File_Unlock(config->shm_counters);
 
-            else if ((config->shm_xbit = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-                {
-                    Sagan_Log(ERROR, "[%s, line %d] Cannot open() for xbit (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
-                }
+    /* Xbit memory object - File based mmap() */
 
-            if ( ftruncate(config->shm_xbit, sizeof(_Sagan_IPC_Xbit) * config->max_xbits ) != 0 )
-                {
-                    Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate xbit. [%s]", __FILE__, __LINE__, strerror(errno));
-                }
+    if ( config->xbit_storage == XBIT_STORAGE_MMAP )
+        {
 
-            if (( xbit_ipc = mmap(0, sizeof(_Sagan_IPC_Xbit) * config->max_xbits, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_xbit, 0)) == MAP_FAILED )
+            if ( IPC_Table_Map(XBIT, new_counters) == true )
                 {
-                    Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for xbit object! [%s]", __FILE__, __LINE__, strerror(errno));
+                    Sagan_Log(NORMAL, "+ Xbit shared object (new).");
+                    new_object=1;
                 }
 
             if ( new_object == 0)
                 {
-                    Sagan_Log(NORMAL, "- Xbit shared object reloaded (%d xbits loaded / max: %d).", counters_ipc->xbit_count, config->max_xbits);
+                    Sagan_Log(NORMAL, "- Xbit shared object reloaded (%d xbits loaded / max: %d).", counters_ipc->xbit_count, IPC_Table_Max(IPC_Table_Lookup(XBIT)));
                 }
 
             new_object = 0;
@@ -1240,34 +1283,15 @@ void IPC_Init(void)
 
     /* Threshold by source */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, THRESH_BY_SRC_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "thresh_by_src");
-
-    if ((config->shm_thresh_by_src = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(THRESH_BY_SRC, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ Thresh_by_src shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_thresh_by_src = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for thresh_by_src (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_thresh_by_src, sizeof(thresh_by_src_ipc) * config->max_threshold_by_src ) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate thresh_by_src. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( threshbysrc_ipc = mmap(0, sizeof(thresh_by_src_ipc) * config->max_threshold_by_src, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_thresh_by_src, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for thresh_by_src object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0)
         {
-            Sagan_Log(NORMAL, "- Thresh_by_src shared object reloaded (%d sources loaded / max: %d).", counters_ipc->thresh_count_by_src, config->max_threshold_by_src);
+            Sagan_Log(NORMAL, "- Thresh_by_src shared object reloaded (%d sources loaded / max: %d).", counters_ipc->thresh_count_by_src, IPC_Table_Max(IPC_Table_Lookup(THRESH_BY_SRC)));
         }
 
     new_object = 0;
@@ -1297,34 +1321,15 @@ void IPC_Init(void)
 
     /* Threshold by destination */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, THRESH_BY_DST_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "thresh_by_dst");
-
-    if ((config->shm_thresh_by_dst = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(THRESH_BY_DST, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ Thresh_by_dst shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_thresh_by_dst = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for thresh_by_dst (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_thresh_by_dst, sizeof(thresh_by_dst_ipc) * config->max_threshold_by_dst) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate thresh_by_dst. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( threshbydst_ipc = mmap(0, sizeof(thresh_by_dst_ipc) * config->max_threshold_by_dst, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_thresh_by_dst, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for thresh_by_dst object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0)
         {
-            Sagan_Log(NORMAL, "- Thresh_by_dst shared object reloaded (%d destinations loaded / max: %d).", counters_ipc->thresh_count_by_dst, config->max_threshold_by_dst);
+            Sagan_Log(NORMAL, "- Thresh_by_dst shared object reloaded (%d destinations loaded / max: %d).", counters_ipc->thresh_count_by_dst, IPC_Table_Max(IPC_Table_Lookup(THRESH_BY_DST)));
         }
 
     new_object = 0;
@@ -1355,34 +1360,15 @@ void IPC_Init(void)
 
     /* Threshold by source port */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, THRESH_BY_SRCPORT_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "thresh_by_srcport");
-
-    if ((config->shm_thresh_by_srcport = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(THRESH_BY_SRCPORT, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ Thresh_by_srcport shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_thresh_by_srcport = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for thresh_by_srcport (%s)", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_thresh_by_srcport, sizeof(thresh_by_srcport_ipc) * config->max_threshold_by_srcport) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate thresh_by_srcport. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( threshbysrcport_ipc = mmap(0, sizeof(thresh_by_srcport_ipc) * config->max_threshold_by_srcport, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_thresh_by_srcport, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for thresh_by_srcport object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0)
         {
-            Sagan_Log(NORMAL, "- Thresh_by_srcport shared object reloaded (%d source ports loaded / max: %d).", counters_ipc->thresh_count_by_srcport, config->max_threshold_by_srcport);
+            Sagan_Log(NORMAL, "- Thresh_by_srcport shared object reloaded (%d source ports loaded / max: %d).", counters_ipc->thresh_count_by_srcport, IPC_Table_Max(IPC_Table_Lookup(THRESH_BY_SRCPORT)));
         }
 
     new_object = 0;
@@ -1412,34 +1398,15 @@ void IPC_Init(void)
 
     /* Threshold by destination port */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, THRESH_BY_DSTPORT_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "thresh_by_dstport");
-
-    if ((config->shm_thresh_by_dstport = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(THRESH_BY_DSTPORT, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ Thresh_by_dstport shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_thresh_by_dstport = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for thresh_by_dstport (%s)", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_thresh_by_dstport, sizeof(thresh_by_dstport_ipc) * config->max_threshold_by_dstport) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate thresh_by_dstport. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( threshbydstport_ipc = mmap(0, sizeof(thresh_by_dstport_ipc) * config->max_threshold_by_dstport, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_thresh_by_dstport, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for thresh_by_dstport object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0)
         {
-            Sagan_Log(NORMAL, "- Thresh_by_dstport shared object reloaded (%d destination ports loaded / max: %d).", counters_ipc->thresh_count_by_dstport, config->max_threshold_by_dstport);
+            Sagan_Log(NORMAL, "- Thresh_by_dstport shared object reloaded (%d destination ports loaded / max: %d).", counters_ipc->thresh_count_by_dstport, IPC_Table_Max(IPC_Table_Lookup(THRESH_BY_DSTPORT)));
         }
 
     new_object = 0;
@@ -1470,34 +1437,15 @@ void IPC_Init(void)
 
     /* Threshold by username */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, THRESH_BY_USERNAME_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "thresh_by_username");
-
-    if ((config->shm_thresh_by_username = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(THRESH_BY_USERNAME, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ Thresh_by_username shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_thresh_by_username = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for thresh_by_username (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_thresh_by_username, sizeof(thresh_by_username_ipc) * config->max_threshold_by_username ) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate thresh_by_username. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( threshbyusername_ipc = mmap(0, sizeof(thresh_by_username_ipc) * config->max_threshold_by_username, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_thresh_by_username, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for thresh_by_username object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0 )
         {
-            Sagan_Log(NORMAL, "- Thresh_by_username shared object reloaded (%d usernames loaded / max: %d).", counters_ipc->thresh_count_by_username, config->max_threshold_by_username);
+            Sagan_Log(NORMAL, "- Thresh_by_username shared object reloaded (%d usernames loaded / max: %d).", counters_ipc->thresh_count_by_username, IPC_Table_Max(IPC_Table_Lookup(THRESH_BY_USERNAME)));
         }
 
     new_object = 0;
@@ -1522,34 +1470,15 @@ void IPC_Init(void)
 
     /* After by source */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, AFTER_BY_SRC_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "after_by_src");
-
-    if ((config->shm_after_by_src = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(AFTER_BY_SRC, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ After_by_src shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_after_by_src = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for after_by_src (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_after_by_src, sizeof(after_by_src_ipc) * config->max_after_by_src ) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate after_by_src. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( afterbysrc_ipc = mmap(0, sizeof(after_by_src_ipc) * config->max_after_by_src, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_after_by_src, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for after_by_src object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0 )
         {
-            Sagan_Log(NORMAL, "- After_by_src shared object reloaded (%d sources loaded / max: %d).", counters_ipc->after_count_by_src, config->max_after_by_src);
+            Sagan_Log(NORMAL, "- After_by_src shared object reloaded (%d sources loaded / max: %d).", counters_ipc->after_count_by_src, IPC_Table_Max(IPC_Table_Lookup(AFTER_BY_SRC)));
         }
 
     new_object = 0;
@@ -1577,34 +1506,15 @@ void IPC_Init(void)
 
     /* After by destination */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, AFTER_BY_DST_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "after_by_dst");
-
-    if ((config->shm_after_by_dst = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(AFTER_BY_DST, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ After_by_dst shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_after_by_dst = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for after_by_dst (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_after_by_dst, sizeof(after_by_dst_ipc) * config->max_after_by_dst) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate after_by_dst. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( afterbydst_ipc = mmap(0, sizeof(after_by_dst_ipc) * config->max_after_by_dst, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_after_by_dst, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for after_by_src object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0 )
         {
-            Sagan_Log(NORMAL, "- After_by_dst shared object reloaded (%d destinations loaded / max: %d).", counters_ipc->after_count_by_dst, config->max_after_by_dst);
+            Sagan_Log(NORMAL, "- After_by_dst shared object reloaded (%d destinations loaded / max: %d).", counters_ipc->after_count_by_dst, IPC_Table_Max(IPC_Table_Lookup(AFTER_BY_DST)));
         }
 
     new_object = 0;
@@ -1633,34 +1543,15 @@ void IPC_Init(void)
 
     /* After by source port */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, AFTER_BY_SRCPORT_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "after_by_srcport");
-
-    if ((config->shm_after_by_srcport = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(AFTER_BY_SRCPORT, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ After_by_srcport shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_after_by_srcport = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for after_by_srcport (%s)", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_after_by_srcport, sizeof(after_by_srcport_ipc) * config->max_after_by_srcport) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate after_by_srcport. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( afterbysrcport_ipc = mmap(0, sizeof(after_by_srcport_ipc) * config->max_after_by_srcport, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_after_by_srcport, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for after_by_src object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0 )
         {
-            Sagan_Log(NORMAL, "- After_by_srcport shared object reloaded (%d source ports loaded / max: %d).", counters_ipc->after_count_by_srcport, config->max_after_by_srcport);
+            Sagan_Log(NORMAL, "- After_by_srcport shared object reloaded (%d source ports loaded / max: %d).", counters_ipc->after_count_by_srcport, IPC_Table_Max(IPC_Table_Lookup(AFTER_BY_SRCPORT)));
         }
 
     new_object = 0;
@@ -1689,34 +1580,15 @@ void IPC_Init(void)
 
     /* After by destination port */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, AFTER_BY_DSTPORT_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "after_by_dstport");
-
-    if ((config->shm_after_by_dstport = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(AFTER_BY_DSTPORT, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ After_by_dstport shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_after_by_dstport = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for after_by_dstport (%s)", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_after_by_dstport, sizeof(after_by_dstport_ipc) * config->max_after_by_dstport) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate after_by_dstport. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( afterbydstport_ipc = mmap(0, sizeof(after_by_dstport_ipc) * config->max_after_by_dstport, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_after_by_dstport, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for after_by_src object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0 )
         {
-            Sagan_Log(NORMAL, "- After_by_dstport shared object reloaded (%d destinations ports loaded / max: %d).", counters_ipc->after_count_by_dstport, config->max_after_by_dstport);
+            Sagan_Log(NORMAL, "- After_by_dstport shared object reloaded (%d destinations ports loaded / max: %d).", counters_ipc->after_count_by_dstport, IPC_Table_Max(IPC_Table_Lookup(AFTER_BY_DSTPORT)));
         }
 
     new_object = 0;
@@ -1744,34 +1616,15 @@ void IPC_Init(void)
 
     /* After by username */
 
-    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, AFTER_BY_USERNAME_IPC_FILE);
-
-    IPC_Check_Object(tmp_object_check, new_counters, "after_by_username");
-
-    if ((config->shm_after_by_username = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+    if ( IPC_Table_Map(AFTER_BY_USERNAME, new_counters) == true )
         {
             Sagan_Log(NORMAL, "+ After_by_username shared object (new).");
             new_object=1;
         }
 
-    else if ((config->shm_after_by_username = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Cannot open() for after_by_username (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
-        }
-
-    if ( ftruncate(config->shm_after_by_username, sizeof(after_by_username_ipc) * config->max_after_by_username ) != 0 )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate after_by_username. [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
-    if (( afterbyusername_ipc = mmap(0, sizeof(after_by_username_ipc) * config->max_after_by_username, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_after_by_username, 0)) == MAP_FAILED )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for after_by_src object! [%s]", __FILE__, __LINE__, strerror(errno));
-        }
-
     if ( new_object == 0 )
         {
-            Sagan_Log(NORMAL, "- After_by_username shared object reloaded (%d usernames loaded / max: %d).", counters_ipc->after_count_by_username, config->max_after_by_username);
+            Sagan_Log(NORMAL, "- After_by_username shared object reloaded (%d usernames loaded / max: %d).", counters_ipc->after_count_by_username, IPC_Table_Max(IPC_Table_Lookup(AFTER_BY_USERNAME)));
         }
 
     new_object = 0;
@@ -1859,4 +1712,77 @@ void IPC_Init(void)
 
         }
 
+    /* "Last message" samples */
+
+    if ( config->max_samples > 0 )
+        {
+
+            snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", config->ipc_directory, SAMPLES_IPC_FILE);
+
+            IPC_Check_Object(tmp_object_check, new_counters, "samples");
+
+            if ((config->shm_samples = open(tmp_object_check, (O_CREAT | O_EXCL | O_RDWR), (S_IREAD | S_IWRITE))) > 0 )
+                {
+                    Sagan_Log(NORMAL, "+ Samples shared object (new).");
+                    new_object=1;
+                }
+
+            else if ((config->shm_samples = open(tmp_object_check, (O_CREAT | O_RDWR), (S_IREAD | S_IWRITE))) < 0 )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Cannot open() for samples (%s:%s)", __FILE__, __LINE__, tmp_object_check, strerror(errno));
+                }
+
+            /* The ring is used at the size it was made.  A Sagan that
+               made it bigger or smaller would pull samples out from under
+               the others.  IPC_Sample() goes by the ring's "max",  not the
+               configured one */
+
+            File_Lock(config->shm_samples);
+
+            samples_max = config->max_samples;
+
+            if ( new_object == 0 &&
+                    fstat(config->shm_samples, &samples_stat) == 0 &&
+                    pread(config->shm_samples, &samples_header, sizeof(samples_header), 0) == sizeof(samples_header) &&
+                    samples_header.max > 0 &&
+                    (uint64_t)samples_stat.st_size >= sizeof(_Sagan_IPC_Samples) + sizeof(_Sagan_IPC_Sample) * (uint64_t)samples_header.max )
+                {
+
+                    if ( samples_header.max != (uint32_t)config->max_samples )
+                        {
+                            Sagan_Log(WARN, "[%s, line %d] %s holds %u samples,  not the %d configured.  Using %u.  Remove the file while no Sagan is running to resize it.", __FILE__, __LINE__, tmp_object_check, samples_header.max, config->max_samples, samples_header.max);
+                        }
+
+                    samples_max = samples_header.max;
+
+                }
+            else if ( ftruncate(config->shm_samples, 0) != 0 || ftruncate(config->shm_samples, sizeof(_Sagan_IPC_Samples) + sizeof(_Sagan_IPC_Sample) * (size_t)samples_max ) != 0 )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to ftruncate samples. [%s]", __FILE__, __LINE__, strerror(errno));
+                }
+
+            if (( samples_ipc = mmap(0, sizeof(_Sagan_IPC_Samples) + sizeof(_Sagan_IPC_Sample) * (size_t)samples_max, (PROT_READ | PROT_WRITE), MAP_SHARED, config->shm_samples, 0)) == MAP_FAILED )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Error allocating memory for samples object! [%s]", __FILE__, __LINE__, strerror(errno));
+                }
+
+            samples_ipc->max = samples_max;
+
+            File_Unlock(config->shm_samples);
+
+            if ( new_object == 0 )
+                {
+                    Sagan_Log(NORMAL, "- Samples shared object reloaded (max: %u).", samples_max);
+                }
+
+            new_object = 0;
+
+        }
+    else
+        {
+
+            Sagan_Log(NORMAL, "- Samples shared object (disabled)");
+
+        }
+
 }
@@ -34,5 +34,19 @@
 void IPC_Init(void);
 bool Clean_IPC_Object( int );
 void IPC_Check_Object(char *, bool, char *);
+int IPC_Max( int type );
+
+size_t IPC_Index_Size( int max, bool hashed );
+uint32_t IPC_Index_Hash( const void *key, size_t key_len, const char *sid, const char *selector );
+void IPC_Index_Add( _Sagan_IPC_Index *index, uint32_t hash, int position, uint64_t expire_at );
+int IPC_Index_Next( _Sagan_IPC_Index *index, uint32_t hash, uint32_t *slot );
+void IPC_Index_Build( int type );
+void IPC_Wheel_Link( _Sagan_IPC_Index *index, int position, uint64_t expire_at );
+void IPC_Index_Lock( _Sagan_IPC_Index *index, uint32_t hash );
+void IPC_Index_Unlock( _Sagan_IPC_Index *index, uint32_t hash );
+void IPC_Index_Lock_All( _Sagan_IPC_Index *index );
+void IPC_Index_Unlock_All( _Sagan_IPC_Index *index );
+void IPC_Reaper( void );
+uint64_t IPC_Sample( const char *signature_msg, const char *syslog_message );
 
 
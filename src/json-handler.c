@@ -65,7 +65,7 @@ void Format_JSON_Alert_EVE( _Sagan_Event *Event, char *str, size_t size )
     char timebuf[64];
     char classbuf[64];
 
-    char tmp_data[MAX_SYSLOGMSG*2] = { 0 };
+    char tmp_data[MAX_SYSLOGMSG*2];
 
     if ( Event->ip_proto == 17 )
         {
@@ -197,7 +197,7 @@ void Format_JSON_Log_EVE( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, struct time
     char tmp[32];
     char *proto = NULL;
 
-    char tmp_data[MAX_SYSLOGMSG+1024] = { 0 };
+    char tmp_data[MAX_SYSLOGMSG+1024];
 
     CreateIsoTimeString(&tp, timebuf, sizeof(timebuf));
 
@@ -108,7 +108,7 @@ void Liblognorm_Load(char *infile)
 json_object *Normalize_Liblognorm(char *syslog_msg, struct _SaganNormalizeLiblognorm *SaganNormalizeLiblognorm)
 {
 
-    char buf[10*1024] = { 0 };
+    char buf[10*1024];
     char tmp_host[254] = { 0 };
 
     int rc_normalize = 0;
@@ -138,6 +138,8 @@ json_object *Normalize_Liblognorm(char *syslog_msg, struct _SaganNormalizeLiblog
     SaganNormalizeLiblognorm->http_uri[0] = '\0';
     SaganNormalizeLiblognorm->http_hostname[0] = '\0';
 
+    SaganNormalizeLiblognorm->filename[0] = '\0';
+
     SaganNormalizeLiblognorm->src_port = 0;
     SaganNormalizeLiblognorm->dst_port = 0;
 
@@ -43,69 +43,28 @@
 #include "meta-content.h"
 #include "rules.h"
 #include "parsers/parsers.h"
+#include "util-ac.h"
 
 struct _Rule_Struct *rulestruct;
 
-int Meta_Content_Search(char *syslog_msg, int rule_position , int meta_content_count)
+int Meta_Content_Search(const char *syslog_msg, size_t syslog_msg_len, int rule_position, int meta_content_count)
 {
 
     int z = meta_content_count;
-    int i;
+    bool found = false;
 
-    /* Normal "meta_content" search */
-
-    if ( rulestruct[rule_position].meta_content_not[z] == 0 )
-        {
-            for ( i=0; i<rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ )
-                {
-                    if ( rulestruct[rule_position].meta_content_case[z] == 1 )
-                        {
-
-                            if (Sagan_stristr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true))
-                                {
-                                    return(true);
-                                }
-                        }
-                    else
-                        {
+    /* All of the items are searched for at once (see Load_Rules()).  With
+     * "meta_nocase",  the automaton folds case itself */
 
+    found = Sagan_AC_Match(rulestruct[rule_position].meta_content_containers[z].meta_ac, syslog_msg, syslog_msg_len);
 
-                            if (Sagan_strstr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i]))
-                                {
-                                    return(true);
-                                }
-                        }
-                }
+    /* meta_content: ! "something" is a match if none of the items are found */
 
-            return(false);
-
-        }
-    else
+    if ( rulestruct[rule_position].meta_content_not[z] == 0 )
         {
+            return(found);
+        }
 
-            for ( i=0; i<rulestruct[rule_position].meta_content_containers[z].meta_counter; i++ )
-                {
-                    if ( rulestruct[rule_position].meta_content_case[z] == 1 )
-                        {
-
-                            if (Sagan_stristr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i], true))
-                                {
-                                    return(false);
-                                }
-                        }
-                    else
-                        {
-
-                            if (Sagan_strstr(syslog_msg, rulestruct[rule_position].meta_content_containers[z].meta_content_converted[i]))
-                                {
-                                    return(false);
-                                }
-                        }
-
-                }
-
-            return(true);
-
-        } /* End of "else" meta_content_not[z] == 0 */
+    return(!found);
 
 } /* End of Meta_Content_Search() */
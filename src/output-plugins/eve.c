@@ -46,7 +46,7 @@ struct _SaganConfig *config;
 void Alert_JSON( _Sagan_Event *Event )
 {
 
-    char alert_data[MAX_SYSLOGMSG+1024] = { 0 };
+    char alert_data[MAX_SYSLOGMSG+1024];
 
     if ( config->eve_alerts == true )
         {
@@ -64,7 +64,7 @@ void Alert_JSON( _Sagan_Event *Event )
 void Log_JSON ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, struct timeval tp, json_object *json_normalize )
 {
 
-    char log_data[MAX_SYSLOGMSG+1024] = { 0 };
+    char log_data[MAX_SYSLOGMSG+1024];
 
     Format_JSON_Log_EVE( SaganProcSyslog_LOCAL, tp, log_data, sizeof(log_data), json_normalize );
     fprintf(config->eve_stream, "%s\n", log_data);
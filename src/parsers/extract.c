@@ -0,0 +1,236 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+/* extract.c
+ *
+ * Walks the syslog message one time and pulls out everything the rules
+ * might ask for:  IP addresses (with ports when they can be found),  the
+ * protocol ("tcp",  "udp",  "icmp") and MD5/SHA1/SHA256 hashes.  The results
+ * go into a _Sagan_Parse_Cache that the engine reads from for every rule
+ * that fires on the event.
+ *
+ * A character class table splits the message into tokens and counts the
+ * dots,  colons and hashes as it goes.  Only tokens that could be an
+ * address are copied out and handed to Parse_IP_Token() (ip.c).  Hashes
+ * are checked in place by Parse_Hash_Token() (hash.c).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+
+#include "version.h"
+#include "parsers/parsers.h"
+
+struct _SaganConfig *config;
+struct _SaganDebug *debug;
+
+#define S	PARSE_CLASS_SPACE
+#define H	PARSE_CLASS_HEX
+
+const unsigned char parse_class[256] =
+{
+    /* Token seperators.  Quotes, brackets, etc. so "[192.168.1.1]" works */
+
+    [' '] = S,  ['"'] = S,  ['('] = S,  [')'] = S,  ['['] = S,  [']'] = S,
+    ['<'] = S,  ['>'] = S,  ['{'] = S,  ['}'] = S,  [','] = S,  ['/'] = S,
+    ['@'] = S,  ['='] = S,  ['-'] = S,  ['!'] = S,  ['|'] = S,  ['_'] = S,
+    ['+'] = S,  ['&'] = S,  ['%'] = S,  ['$'] = S,  ['~'] = S,  ['^'] = S,
+    ['\''] = S,
+
+    ['.'] = PARSE_CLASS_DOT,
+    [':'] = PARSE_CLASS_COLON,
+    ['#'] = PARSE_CLASS_HASH,
+
+    ['0'] = H,  ['1'] = H,  ['2'] = H,  ['3'] = H,  ['4'] = H,  ['5'] = H,
+    ['6'] = H,  ['7'] = H,  ['8'] = H,  ['9'] = H,
+    ['a'] = H,  ['b'] = H,  ['c'] = H,  ['d'] = H,  ['e'] = H,  ['f'] = H,
+    ['A'] = H,  ['B'] = H,  ['C'] = H,  ['D'] = H,  ['E'] = H,  ['F'] = H
+};
+
+#undef S
+#undef H
+
+/****************************************************************************
+ * Parse_Extract - Fills "parse_cache" from the message.  Returns the
+ * number of IP addresses found.
+ ****************************************************************************/
+
+int Parse_Extract( char *syslog_message, struct _Sagan_Parse_Cache *parse_cache )
+{
+
+    const unsigned char *p = (const unsigned char *)syslog_message;
+    const unsigned char *start = NULL;
+    const unsigned char *hash_start = NULL;
+
+    char token[MAX_SYSLOGMSG];
+
+    int current_position = 0;
+
+    int num_colons = 0;
+    int num_dots = 0;
+    int num_hashes = 0;
+
+    bool ip_full = false;
+
+    size_t len = 0;
+    int i = 0;
+
+    if ( debug->debugparse_ip )
+        {
+            Sagan_Log(DEBUG, "[%s:%lu] Start Function.", __FUNCTION__, pthread_self() );
+        }
+
+    memset(parse_cache->ip, 0, sizeof(parse_cache->ip));
+
+    parse_cache->proto = 0;
+    parse_cache->md5[0] = '\0';
+    parse_cache->sha1[0] = '\0';
+    parse_cache->sha256[0] = '\0';
+
+    while ( *p != '\0' )
+        {
+
+            while ( *p != '\0' && ( parse_class[*p] & PARSE_CLASS_SPACE ) )
+                {
+                    p++;
+                }
+
+            if ( *p == '\0' )
+                {
+                    break;
+                }
+
+            /* Walk the token,  counting as we go.  Hashes are also split on
+               '.',  so each piece is checked as we pass it */
+
+            start = p;
+            hash_start = p;
+
+            num_colons = 0;
+            num_dots = 0;
+            num_hashes = 0;
+
+            for ( ; *p != '\0' && !( parse_class[*p] & PARSE_CLASS_SPACE ); p++ )
+                {
+
+                    switch ( parse_class[*p] )
+                        {
+
+                        case PARSE_CLASS_DOT:
+                            Parse_Hash_Token((const char *)hash_start, p - hash_start, parse_cache);
+                            hash_start = p + 1;
+                            num_dots++;
+                            break;
+
+                        case PARSE_CLASS_COLON:
+                            num_colons++;
+                            break;
+
+                        case PARSE_CLASS_HASH:
+                            num_hashes++;
+                            break;
+
+                        }
+                }
+
+            Parse_Hash_Token((const char *)hash_start, p - hash_start, parse_cache);
+
+            len = p - start;
+
+            /* Protocol clues */
+
+            if ( len == 3 && !strncasecmp((const char *)start, "tcp", 3) )
+                {
+                    parse_cache->proto = 6;
+                }
+
+            else if ( len == 3 && !strncasecmp((const char *)start, "udp", 3) )
+                {
+                    parse_cache->proto = 17;
+                }
+
+            else if ( len == 4 && !strncasecmp((const char *)start, "icmp", 4) )
+                {
+                    parse_cache->proto = 1;
+                }
+
+            /* Needs to have proper IPv6 or IPv4 encoding. num_dots > 4 is for IP with trailing
+            period. */
+
+            if ( ip_full == true || ( num_colons < 2 && num_dots < 3 ) || ( num_dots > 4 ) )
+                {
+                    continue;
+                }
+
+            memcpy(token, start, len);
+            token[len] = '\0';
+
+            if ( debug->debugparse_ip )
+                {
+                    Sagan_Log(DEBUG, "[%s:%lu] Token: '%s' Colons: %d, Dots: %d, Hashes: %d", __FUNCTION__, pthread_self(), token, num_colons, num_dots, num_hashes );
+                }
+
+            /* Anything after the token (past the character that ended it) can
+               hold the port */
+
+            if ( Parse_IP_Token(token, num_dots, num_colons, num_hashes, *p != '\0' ? p + 1 : p, parse_cache->ip, &current_position) == false )
+                {
+                    ip_full = true;
+                }
+
+        }
+
+    parse_cache->ip_count = current_position;
+
+    if ( debug->debugparse_ip )
+        {
+
+
+            if ( current_position > 0 )
+                {
+
+                    Sagan_Log(DEBUG, "[%lld:%d] --[Lookup Cache Array]----", pthread_self(), current_position );
+
+
+                    for (i = 0; i < current_position; i++)
+                        {
+
+                            Sagan_Log(DEBUG, "-- ARRAY: Position: %d, Status: %d, IP: %s, Port: %d", i, parse_cache->ip[i].status, parse_cache->ip[i].ip, parse_cache->ip[i].port);
+                        }
+
+                }
+
+
+        }
+
+
+    return(current_position);
+}
@@ -20,6 +20,10 @@
 
 /*
  * hash.c
+ *
+ * Picks MD5, SHA1 and SHA256 hashes out of the tokens Parse_Extract()
+ * (extract.c) hands it.  A hash is a run of hex characters of the right
+ * length,  split on the same characters as the address tokens plus '.'.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -39,137 +43,55 @@
 
 struct _SaganConfig *config;
 
-void Parse_Hash(char *syslog_message, int type, char *str, size_t size)
-{
-    char mod_string[MAX_SYSLOGMSG];
+/****************************************************************************
+ * Parse_Hash_Token - Checks "len" bytes at "token" (not NUL terminated)
+ * for a hash.  The first hash of each type in the message is kept.
+ ****************************************************************************/
 
-    char *ptmp=NULL;
-    char *tok=NULL;
-    char tmp[SHA256_HASH_SIZE+1];
+void Parse_Hash_Token( const char *token, size_t len, struct _Sagan_Parse_Cache *parse_cache )
+{
 
-    int i;
+    char *str = NULL;
+    size_t i = 0;
 
-    /* Remove anything we dont want */
+    /* "hash:abc..." style */
 
-    for (i=0; i<strlen(syslog_message); i++)
+    if ( len > 0 && token[0] == ':' )
         {
-
-            /* Remove everything.  Just want any hashes */
-
-            if ( syslog_message[i] != '"' && syslog_message[i] != '(' && syslog_message[i] != ')' &&
-                    syslog_message[i] != '[' && syslog_message[i] != ']' && syslog_message[i] != '<' &&
-                    syslog_message[i] != '>' && syslog_message[i] != '{' && syslog_message[i] != '}' &&
-                    syslog_message[i] != ',' && syslog_message[i] != '/' && syslog_message[i] != '@' &&
-                    syslog_message[i] != '=' && syslog_message[i] != '-' && syslog_message[i] != '!' &&
-                    syslog_message[i] != '|' && syslog_message[i] != '_' && syslog_message[i] != '+' &&
-                    syslog_message[i] != '&' && syslog_message[i] != '%' && syslog_message[i] != '$' &&
-                    syslog_message[i] != '~' && syslog_message[i] != '^' && syslog_message[i] != '\'' &&
-                    syslog_message[i] != '.' )
-                {
-
-                    mod_string[i] = syslog_message[i];
-                    mod_string[i+1] = '\0';
-
-                }
-            else
-                {
-
-                    mod_string[i] = ' ';
-                    mod_string[i+1] = '\0';
-
-                }
-
+            token++;
+            len--;
         }
 
-    ptmp = strtok_r(mod_string, " ", &tok);
-
-    while (ptmp != NULL )
+    if ( len == MD5_HASH_SIZE )
         {
-
-            Parse_Hash_Cleanup(ptmp, tmp, sizeof(tmp));
-
-            if ( type == PARSE_HASH_MD5 || type == PARSE_HASH_ALL )
-                {
-                    if ( strlen(tmp) == MD5_HASH_SIZE )
-                        {
-                            if ( Validate_HEX(tmp) == true )
-                                {
-                                    snprintf(str, size, "%s", tmp);
-                                    return;
-                                }
-                        }
-
-                }
-
-            else if ( type == PARSE_HASH_SHA1 || type == PARSE_HASH_ALL )
-                {
-                    if ( strlen(tmp) == SHA1_HASH_SIZE )
-                        {
-                            if ( Validate_HEX(tmp) == true )
-                                {
-                                    snprintf(str, size, "%s", tmp);
-                                    return;
-                                }
-                        }
-                }
-
-            else if ( type == PARSE_HASH_SHA256 || type == PARSE_HASH_ALL )
-                {
-
-
-                    if ( strlen(tmp) == SHA256_HASH_SIZE )
-                        {
-                            if ( Validate_HEX(tmp) == true )
-                                {
-                                    snprintf(str, size, "%s", tmp);
-                                    return;
-                                }
-                        }
-                }
-
-
-            ptmp = strtok_r(NULL, " ", &tok);
-
+            str = parse_cache->md5;
         }
 
-    tmp[0] = '\0';
-    snprintf(str, size, "%s", tmp);
-}
-
-
-void Parse_Hash_Cleanup(char *string, char *str, size_t size)
-{
-
-    char tmp[512];
-    int i;
-    char in[512] = { 0 };
-    char tmp2[2];
+    else if ( len == SHA1_HASH_SIZE )
+        {
+            str = parse_cache->sha1;
+        }
 
-    strlcpy(in, string, sizeof(in));
+    else if ( len == SHA256_HASH_SIZE )
+        {
+            str = parse_cache->sha256;
+        }
 
-    int len = strlen(in);
+    /* Not a hash size or we already have one */
 
-    if ( ( in[strlen(in) - 1] ) == ',' || ( in[strlen(in) - 1] ) == '\'' )
+    if ( str == NULL || str[0] != '\0' )
         {
-            strlcpy(tmp, in, len-1 );
-            strlcpy(in, tmp, sizeof(in));
+            return;
         }
 
-    if ( in[0] == ',' || in[0] == '\'' || in[0] == ':' )
+    for ( i = 0; i < len; i++ )
         {
-
-            tmp[0] = '\0';
-
-            for(i=1; i < strlen(in); i++)
+            if ( !( parse_class[(unsigned char)token[i]] & PARSE_CLASS_HEX ) )
                 {
-                    snprintf(tmp2, sizeof(tmp2), "%c", in[i]);
-                    strcat(tmp, tmp2);
+                    return;
                 }
-
-            strlcpy(in, tmp, sizeof(in));
         }
 
-    snprintf(str, size, "%s", in);
-
+    memcpy(str, token, len);
+    str[len] = '\0';
 }
-
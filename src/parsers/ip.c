@@ -17,7 +17,6 @@
 ** along with this program; if not, write to the Free Software
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
-
 /* ip.c
  *
  * Simple method of "finding" the "real" IP address from a syslog message.  This
@@ -29,6 +28,10 @@
  * parse logs.  Support IPv6 and will attempt to pull the port and protocol
  *  if avaliable.
  *
+ * The message is tokenized once by Parse_Extract() (extract.c).  Tokens
+ * that could be an address are handed to Parse_IP_Token().  The address
+ * bits come straight from inet_pton().
+ *
  * What this detects:
  *
  * IPv4
@@ -85,908 +88,329 @@
 struct _SaganConfig *config;
 struct _SaganDebug *debug;
 
-int Parse_IP( char *syslog_message, struct _Sagan_Lookup_Cache_Entry *lookup_cache )
-{
-
-    if ( debug->debugparse_ip )
-        {
-            Sagan_Log(DEBUG, "[%s:%lu] Start Function.", __FUNCTION__, pthread_self() );
-        }
-
-    struct sockaddr_in sa;
-
-    int current_position = 0;
-
-    char mod_string[MAX_SYSLOGMSG] = { 0 };
-
-    char tmp_token[64] = { 0 };
+#define PARSE_IP_LOOKAHEAD	64	/* How far past an address we look for "port 1234" and such */
 
-    char *ptr1 = NULL;
-    char *ptr2 = NULL;
+/****************************************************************************
+ * Parse_IP_Next_Token - Copies the next token at or after "p" (but before
+ * "end") into "str".  Returns where the token stopped,  or NULL if there
+ * isn't one.
+ ****************************************************************************/
 
-    char *ptr3 = NULL;
-    char *ptr4 = NULL;
-
-
-    char *ip_1 = NULL;
-    char *ip_2 = NULL;
-
-    char port_test[6] = { 0 };
-    int  port_test_int = 0;
-
-    bool valid = false ;
+static const unsigned char *Parse_IP_Next_Token( const unsigned char *p, const unsigned char *end, char *str, size_t size )
+{
 
-    int i=0;
-    int b=0;
+    size_t i = 0;
 
-    int num_colons = 0;
-    int num_dots = 0;
-    int num_hashes = 0;
+    while ( p < end && *p != '\0' && ( parse_class[*p] & PARSE_CLASS_SPACE ) )
+        {
+            p++;
+        }
 
-    int port = config->sagan_port;
+    if ( p >= end || *p == '\0' )
+        {
+            return(NULL);
+        }
 
-    for (i=0; i<strlen(syslog_message); i++)
+    while ( p < end && *p != '\0' && !( parse_class[*p] & PARSE_CLASS_SPACE ) )
         {
 
-            /* Remove any ", (, ), etc. In case the IP is enclosed like this:
-               "192.168.1.1" or (192.168.1.1) */
-
-            if ( syslog_message[i] != '"' && syslog_message[i] != '(' && syslog_message[i] != ')' &&
-                    syslog_message[i] != '[' && syslog_message[i] != ']' && syslog_message[i] != '<' &&
-                    syslog_message[i] != '>' && syslog_message[i] != '{' && syslog_message[i] != '}' &&
-                    syslog_message[i] != ',' && syslog_message[i] != '/' && syslog_message[i] != '@' &&
-                    syslog_message[i] != '=' && syslog_message[i] != '-' && syslog_message[i] != '!' &&
-                    syslog_message[i] != '|' && syslog_message[i] != '_' && syslog_message[i] != '+' &&
-                    syslog_message[i] != '&' && syslog_message[i] != '%' && syslog_message[i] != '$' &&
-                    syslog_message[i] != '~' && syslog_message[i] != '^' && syslog_message[i] != '\'' )
+            if ( i < size - 1 )
                 {
+                    str[i++] = *p;
+                }
 
-                    mod_string[i] = syslog_message[i];
-                    mod_string[i+1] = '\0';
+            p++;
+        }
 
-                }
-            else
-                {
+    str[i] = '\0';
 
-                    mod_string[i] = ' ';
-                    mod_string[i+1] = '\0';
+    return(p);
+}
 
-                }
+/****************************************************************************
+ * Parse_IP_Port - Looks at the tokens after an address for "port 1234",
+ * "source port: 1234",  "client port 1234" and (IPv6) "[...]:1234".
+ * Returns 0 if there isn't a port.
+ ****************************************************************************/
 
-        }
+static int Parse_IP_Port( const unsigned char *next, bool ipv6 )
+{
 
+    const unsigned char *end = next + PARSE_IP_LOOKAHEAD;
+    const unsigned char *p = next;
 
-    if ( debug->debugparse_ip )
+    char token[PARSE_IP_LOOKAHEAD + 1] = { 0 };
+    int port = 0;
+
+    if ( ( p = Parse_IP_Next_Token(p, end, token, sizeof(token)) ) == NULL )
         {
-            Sagan_Log(DEBUG, "[%s:%lu] Modified string: %s", __FUNCTION__, pthread_self(), mod_string);
+            return(0);
         }
 
-    ptr1 = strtok_r(mod_string, " ", &ptr2);
+    /* "192.168.1.1 port 1234" */
 
-    while ( ptr1 != NULL )
+    if ( strcasestr(token, "port") )
         {
 
-            num_colons = 0;
-            num_dots = 0;
-            num_hashes = 0;
-
             if ( debug->debugparse_ip )
                 {
-                    Sagan_Log(DEBUG, "[%s:%lu] Token: '%s'", __FUNCTION__, pthread_self(), ptr1 );
+                    Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'port'", __FUNCTION__, pthread_self() );
                 }
 
-            /* Get counts of colons, hashes, dots.  */
-
-            for (i=0; i<strlen(ptr1); i++)
+            if ( Parse_IP_Next_Token(p, end, token, sizeof(token)) == NULL )
                 {
+                    return(0);
+                }
 
-                    switch(ptr1[i])
-                        {
-
-                        case(':'):
-                            num_colons++;
-                            break;
+            port = atoi(token);
 
-                        case('#'):
-                            num_hashes++;
-                            break;
+            return( port == 0 ? config->sagan_port : port );
+        }
 
-                        case('.'):
-                            num_dots++;
-                            break;
+    /* "192.168.1.1 source port: 1234",  "192.168.1.1 client port 1234" */
 
-                        }
-
-                }
-
-            valid = false;		/* Reset to not valid */
+    if ( strcasestr(token, "source") || strcasestr(token, "destination") || strcasestr(token, "client") )
+        {
 
             if ( debug->debugparse_ip )
                 {
-                    Sagan_Log(DEBUG, "[%s:%lu] Colons: %d, Dots: %d, Hashes: %d", __FUNCTION__, pthread_self(), num_colons, num_dots, num_hashes );
+                    Sagan_Log(DEBUG, "[%s:%lu] Identified 'source', 'destination' or 'client'", __FUNCTION__, pthread_self() );
                 }
 
-            if ( !strcasecmp(ptr1, "tcp" ) )
+            if ( ( p = Parse_IP_Next_Token(p, end, token, sizeof(token)) ) == NULL || !strcasestr(token, "port") )
                 {
-
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] Protocal TCP detected.", __FUNCTION__, pthread_self() );
-                        }
-
-                    lookup_cache[0].proto = 6;
+                    return(0);
                 }
 
-            else if ( !strcasecmp(ptr1, "udp" ) )
+            if ( Parse_IP_Next_Token(p, end, token, sizeof(token)) == NULL )
                 {
-
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] Protocal UDP detected.", __FUNCTION__, pthread_self() );
-                        }
-
-                    lookup_cache[0].proto = 17;
-
+                    return(0);
                 }
 
-            else if ( !strcasecmp(ptr1, "icmp" ) )
-                {
-
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] Protocal ICMP detected.", __FUNCTION__, pthread_self() );
-                        }
-
-                    lookup_cache[0].proto = 1;
+            port = atoi(token);
 
-                }
+            return( port == 0 ? config->sagan_port : port );
+        }
 
+    /* IPv6 [fe80::b614:89ff:fe11:5e24]:443.  The brackets split the tokens,  so
+       the port is a token of it's own */
 
-            /* Needs to have proper IPv6 or IPv4 encoding. num_dots > 4 is for IP with trailing
-            period. */
+    if ( ipv6 == true && token[0] == ':' )
+        {
 
-            if ( ( num_colons < 2 && num_dots < 3 ) || ( num_dots > 4 ) )
+            if ( debug->debugparse_ip )
                 {
-
-                    if ( debug->debugparse_ip )
-                        {
-                            Sagan_Log(DEBUG, "[%s:%lu] '%s' can't be an IPv4 or IPv6.", __FUNCTION__, pthread_self(), ptr1 );
-                        }
-
-                    ptr1 = strtok_r(NULL, " ", &ptr2);		/* move to next token */
-                    continue;
+                    Sagan_Log(DEBUG, "[%s:%lu] Identified possible [IPv6]:PORT", __FUNCTION__, pthread_self() );
                 }
 
+            port = atoi(token + 1);
 
-            /* Stand alone IPv4 address */
-
-            if ( num_dots == 3 && num_colons == 0 )
-                {
-
-                    valid = inet_pton(AF_INET, ptr1,  &(sa.sin_addr));
-
-                    if ( valid == 1 )
-                        {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv4 address '%s' position %d **", __FUNCTION__, pthread_self(), ptr1, current_position );
-                                }
-
-                            /* Grab the IP */
-
-                            memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                            /* Preserve the array */
-
-                            memcpy(tmp_token, ptr2, sizeof(tmp_token));
-
-                            ptr4 = tmp_token;
-                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                            /* Look for "192.168.1.1 port 1234" */
-
-                            if ( ptr3 != NULL && strcasestr(ptr3, "port") )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%d] Identified the word 'port'", __FUNCTION__, pthread_self() );
-                                        }
-
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                    if ( ptr3 != NULL )
-                                        {
-                                            port = atoi(ptr3);
-
-                                            if ( port == 0 )
-                                                {
-                                                    lookup_cache[current_position].port = config->sagan_port;
-
-                                                }
-                                            else
-                                                {
-
-                                                    lookup_cache[current_position].port = port;
-
-                                                }
-                                        }
-
-                                }
-
-                            /* Look for "192.168.1.1 source port: 1234" or
-                            "192.168.1.1 source port 1234" */
-
-                            else if ( ptr3 != NULL && ( strcasestr(ptr3, "source") ||
-                                                        strcasestr(ptr3, "destination" ) ) )
-
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] Identified 'source' or 'destination'", __FUNCTION__, pthread_self() );
-                                        }
-
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                    if ( ptr3 != NULL && strcasestr(ptr3, "port" ) )
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified 'port'.", __FUNCTION__, pthread_self() );
-                                                }
-
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                            if ( ptr3 != NULL )
-                                                {
-
-                                                    port = atoi(ptr3);
-
-                                                    if ( port == 0 )
-                                                        {
-
-                                                            lookup_cache[current_position].port = config->sagan_port;
-
-                                                        }
-                                                    else
-                                                        {
-
-                                                            lookup_cache[current_position].port = port;
-                                                        }
-
-
-                                                }
-
-                                        }
-
-                                }
-
-                            /* Look's for 192.168.1.1 client port 1234 */
-
-                            else if ( ptr3 != NULL && strcasestr(ptr3, "client") )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] Identified 'client'", __FUNCTION__, pthread_self() );
-                                        }
-
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                    if ( ptr3 != NULL && strcasestr(ptr3, "port" ) )
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified 'port'.", __FUNCTION__, pthread_self() );
-                                                }
-
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
+            return( port == 0 ? config->sagan_port : port );
+        }
 
-                                            if ( ptr3 != NULL )
-                                                {
+    return(0);
+}
 
-                                                    port = atoi(ptr3);
+/****************************************************************************
+ * Parse_IP_Add - Adds an address to the cache.  "bits" are from
+ * inet_pton().  Returns false when the cache is full.
+ ****************************************************************************/
 
-                                                    if ( port == 0 )
-                                                        {
+static bool Parse_IP_Add( struct _Sagan_Lookup_Cache_Entry *lookup_cache, int *current_position, const char *ip, const unsigned char *bits, size_t bits_len, int port )
+{
 
-                                                            lookup_cache[current_position].port = config->sagan_port;
+    if ( debug->debugparse_ip )
+        {
+            Sagan_Log(DEBUG, "[%s:%lu] ** Identified '%s' port %d at position %d **", __FUNCTION__, pthread_self(), ip, port, *current_position );
+        }
 
-                                                        }
-                                                    else
-                                                        {
+    strlcpy(lookup_cache[*current_position].ip, ip, MAXIP);
+    memset(lookup_cache[*current_position].ip_bits, 0, MAXIPBIT);
+    memcpy(lookup_cache[*current_position].ip_bits, bits, bits_len);
+    lookup_cache[*current_position].port = port;
+    lookup_cache[*current_position].status = 1;
 
-                                                            lookup_cache[current_position].port = port;
-                                                        }
+    (*current_position)++;
 
+    return( *current_position < MAX_PARSE_IP );
+}
 
-                                                }
+/****************************************************************************
+ * Parse_IP_IPv6_Add - Parse_IP_Add() for IPv6.  Unless told otherwise,
+ * ::ffff:192.168.1.1 is stored as 192.168.1.1 (the bits stay IPv6).
+ ****************************************************************************/
 
-                                        }
+static bool Parse_IP_IPv6_Add( struct _Sagan_Lookup_Cache_Entry *lookup_cache, int *current_position, const char *ip, const unsigned char *bits, int port )
+{
 
-                                }
+    if ( config->parse_ip_ipv4_mapped_ipv6 == false &&
+            ip[0] == ':' && ip[1] == ':' && ( ip[2] == 'f' || ip[2] == 'F' ) &&
+            ( ip[3] == 'f' || ip[3] == 'F' ) && ( ip[4] == 'f' || ip[4] == 'F' ) &&
+            ( ip[5] == 'f' || ip[5] == 'F' ) && ip[6] == ':' && ip[7] != '\0' )
+        {
+            ip = ip + 7;
+        }
 
+    return( Parse_IP_Add(lookup_cache, current_position, ip, bits, 16, port) );
+}
 
-                            lookup_cache[current_position].status = 1;
-                            current_position++;
+/****************************************************************************
+ * Parse_IP_Token - Tries the different address formats on one token.
+ * "next" is where the message picks up after the token.  Returns false
+ * when the cache is full.
+ ****************************************************************************/
 
-                            /* If we've run to the end, we're done */
+bool Parse_IP_Token( char *ptr1, int num_dots, int num_colons, int num_hashes, const unsigned char *next, struct _Sagan_Lookup_Cache_Entry *lookup_cache, int *current_position )
+{
 
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
+    unsigned char bits[16] = { 0 };
 
-                        }
+    char *ip_1 = NULL;
+    char *ip_2 = NULL;
 
-                }
+    int port = 0;
+    size_t len = 0;
 
-            /* Stand alone IPv4 with trailing period */
+    /* Stand alone IPv4 address */
 
-            if ( num_dots == 4 && ptr1[ strlen(ptr1)-1 ] == '.' )
+    if ( num_dots == 3 && num_colons == 0 && inet_pton(AF_INET, ptr1, bits) == 1 )
+        {
+            if ( Parse_IP_Add(lookup_cache, current_position, ptr1, bits, 4, Parse_IP_Port(next, false)) == false )
                 {
-
-                    /* Erase the period */
-
-                    ptr1[ strlen(ptr1)-1 ] = '\0';
-
-                    valid = inet_pton(AF_INET, ptr1,  &(sa.sin_addr));
-
-                    if ( valid == 1 )
-                        {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv4 address '%s' with trailing period. **", __FUNCTION__, pthread_self(), ptr1 );
-                                }
-
-                            memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-                            lookup_cache[current_position].port = config->sagan_port;
-                            lookup_cache[current_position].status = 1;
-
-                            current_position++;
-
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
-
-
-                        }
-
+                    return(false);
                 }
+        }
 
-            /* IPv4 with 192.168.2.1:12345 or inet:192.168.2.1 */
+    /* Stand alone IPv4 with trailing period */
 
-            if ( num_colons == 1 && num_dots == 3)
-                {
+    len = strlen(ptr1);
 
-                    /* test both sides */
+    if ( num_dots == 4 && ptr1[len-1] == '.' )
+        {
 
-                    ip_1 = strtok_r(ptr1, ":", &ip_2);
+            ptr1[len-1] = '\0';
 
-                    if ( ip_1 != NULL )
+            if ( inet_pton(AF_INET, ptr1, bits) == 1 )
+                {
+                    if ( Parse_IP_Add(lookup_cache, current_position, ptr1, bits, 4, config->sagan_port) == false )
                         {
-                            valid = inet_pton(AF_INET, ip_1,  &(sa.sin_addr));
+                            return(false);
                         }
+                }
+        }
 
-                    if ( valid == 1 )
-                        {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified IPv4:PORT address. **", __FUNCTION__, pthread_self() );
-                                }
-
-                            memcpy(lookup_cache[current_position].ip, ip_1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_1, lookup_cache[current_position].ip_bits);
-
-                            /* In many cases, the port is after the : */
-
-                            port = atoi(ip_2);
+    /* IPv4 with 192.168.2.1:12345 or inet:192.168.2.1,  then 192.168.2.1#12345 or
+       inet#192.168.2.1.  Both sides are tested */
 
-                            if ( port == 0 )
-                                {
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                }
-                            else
-                                {
-                                    lookup_cache[current_position].port = port;
-                                }
+    if ( num_colons == 1 && num_dots == 3 )
+        {
 
-                            lookup_cache[current_position].status = 1;
-                            current_position++;
+            ip_1 = strtok_r(ptr1, ":", &ip_2);
 
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
+            if ( ip_1 != NULL && inet_pton(AF_INET, ip_1, bits) == 1 )
+                {
 
-                        }
+                    port = atoi(ip_2);
 
-                    if ( ip_2 != NULL )
+                    if ( Parse_IP_Add(lookup_cache, current_position, ip_1, bits, 4, port == 0 ? config->sagan_port : port) == false )
                         {
-                            valid = inet_pton(AF_INET, ip_2,  &(sa.sin_addr));
+                            return(false);
                         }
-
-                    if ( valid == 1 )
-
-                        {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified INTERFACE:IPv4 **", __FUNCTION__, pthread_self() );
-                                }
-
-                            memcpy(lookup_cache[current_position].ip, ip_2, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_2, lookup_cache[current_position].ip_bits);
-                            lookup_cache[current_position].port = config->sagan_port;
-                            lookup_cache[current_position].status = 1;
-
-                            current_position++;
-
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
-
-                        }
-
                 }
 
-            /* Handle 192.168.2.1#12345 or inet#192.168.2.1 */
-
-            if ( num_hashes == 1 && num_dots == 3)
+            if ( ip_2 != NULL && inet_pton(AF_INET, ip_2, bits) == 1 )
                 {
-
-                    /* test both sides */
-
-                    ip_1 = strtok_r(ptr1, "#", &ip_2);
-
-                    if ( ip_1 != NULL )
+                    if ( Parse_IP_Add(lookup_cache, current_position, ip_2, bits, 4, config->sagan_port) == false )
                         {
-                            valid = inet_pton(AF_INET, ip_1,  &(sa.sin_addr));
+                            return(false);
                         }
+                }
+        }
 
-                    if ( valid == 1 )
-                        {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified IPv4#PORT **", __FUNCTION__, pthread_self() );
-                                }
-
-
-                            memcpy(lookup_cache[current_position].ip, ip_1, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_1, lookup_cache[current_position].ip_bits);
-
-                            /* In many cases, the port is after the : */
-
-                            port = atoi(ip_2);
-
-                            if ( port == 0 )
-                                {
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                }
-                            else
-                                {
-                                    lookup_cache[current_position].port = port;
-                                }
-
-                            lookup_cache[current_position].status = 1;
-                            current_position++;
-
-                            /* If we've run to the end, we're done */
-
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
+    if ( num_hashes == 1 && num_dots == 3 )
+        {
 
-                        }
+            ip_1 = strtok_r(ptr1, "#", &ip_2);
 
-                    if ( ip_2 != NULL )
-                        {
-                            valid = inet_pton(AF_INET, ip_2,  &(sa.sin_addr));
-                        }
+            if ( ip_1 != NULL && inet_pton(AF_INET, ip_1, bits) == 1 )
+                {
 
-                    if ( valid == 1 )
+                    port = atoi(ip_2);
 
+                    if ( Parse_IP_Add(lookup_cache, current_position, ip_1, bits, 4, port == 0 ? config->sagan_port : port) == false )
                         {
-
-                            if ( debug->debugparse_ip )
-                                {
-                                    Sagan_Log(DEBUG, "[%s:%lu] ** Identified INTERFACE#PORT **", __FUNCTION__, pthread_self() );
-                                }
-
-                            memcpy(lookup_cache[current_position].ip, ip_2, MAXIP);
-                            memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                            IP2Bit(ip_2, lookup_cache[current_position].ip_bits);
-                            lookup_cache[current_position].port = config->sagan_port;
-                            lookup_cache[current_position].status = 1;
-
-                            current_position++;
-
-                            /* If we've run to the end, we're done */
-
-                            if ( current_position > MAX_PARSE_IP )
-                                {
-                                    break;
-                                }
-
+                            return(false);
                         }
-
                 }
 
-
-            /* Do we even want to part IPv6? */
-
-            if ( config->parse_ip_ipv6 == true )
+            if ( ip_2 != NULL && inet_pton(AF_INET, ip_2, bits) == 1 )
                 {
-
-                    /* Stand alone IPv6 */
-
-                    if ( num_colons > 2 )
+                    if ( Parse_IP_Add(lookup_cache, current_position, ip_2, bits, 4, config->sagan_port) == false )
                         {
-
-                            valid = inet_pton(AF_INET6, ptr1,  &(sa.sin_addr));
-
-                            if ( valid == 1 )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv6 address '%s' **", __FUNCTION__, pthread_self(), ptr1 );
-                                        }
-
-                                    memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                    /* This converts ::ffff:192.168.1.1 to regular IPv4 (192.168.1.1) */
-
-                                    if ( config->parse_ip_ipv4_mapped_ipv6 == false )
-                                        {
-
-                                            if ( ptr1[0] == ':' && ptr1[1] == ':' && ( ptr1[2] == 'f' || ptr1[2] == 'F' ) &&
-                                                    ( ptr1[3] == 'f' || ptr1[3] == 'F' ) && ( ptr1[4] == 'f' || ptr1[4] == 'F' ) &&
-                                                    ( ptr1[5] == 'f' || ptr1[5] == 'F' ) && ptr1[6] == ':' )
-                                                {
-
-                                                    b = strlen(ptr1);
-
-                                                    for (i = 7; b > i; i++)
-                                                        {
-                                                            lookup_cache[current_position].ip[i-7] = ptr1[i];
-                                                            lookup_cache[current_position].ip[i-6] = '\0';
-                                                        }
-
-                                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                                }
-
-                                        }
-
-                                    /* Look for "fe80::b614:89ff:fe11:5e24 port 1234" */
-
-                                    memcpy(tmp_token, ptr2, sizeof(tmp_token));
-
-                                    ptr4 = tmp_token;
-                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                    if ( ptr3 != NULL && strcasestr(ptr3, "port") )
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'port'", __FUNCTION__, pthread_self() );
-                                                }
-
-
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                            if ( ptr3 != NULL )
-                                                {
-                                                    port = atoi(ptr3);
-
-                                                    if ( port == 0 )
-                                                        {
-                                                            lookup_cache[current_position].port = port;
-                                                        }
-                                                    else
-                                                        {
-                                                            lookup_cache[current_position].port = config->sagan_port;
-                                                        }
-
-                                                }
-
-                                        }
-
-                                    /* Look for "fe80::b614:89ff:fe11:5e24 source port: 1234" or
-                                    "fe80::b614:89ff:fe11:5e24 source port 1234" */
-
-                                    else if ( ptr3 != NULL && ( strcasestr(ptr3, "source") ||
-                                                                strcasestr(ptr3, "destination" ) ) )
-
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'source' or 'destination'", __FUNCTION__, pthread_self() );
-                                                }
-
-
-                                            ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                            if ( ptr3 != NULL && strcasestr(ptr3, "port" ) )
-                                                {
-
-                                                    if ( debug->debugparse_ip )
-                                                        {
-                                                            Sagan_Log(DEBUG, "[%s:%lu] Identified the word 'port'", __FUNCTION__, pthread_self() );
-                                                        }
-
-
-                                                    ptr3 = strtok_r(NULL, " ", &ptr4);
-
-                                                    if ( ptr3 != NULL )
-                                                        {
-
-                                                            port = atoi(ptr3);
-
-                                                            if ( port == 0 )
-                                                                {
-                                                                    lookup_cache[current_position].port = config->sagan_port;
-                                                                }
-                                                            else
-                                                                {
-                                                                    lookup_cache[current_position].port = port;
-                                                                }
-
-                                                        }
-
-                                                }
-
-                                        }
-
-                                    /* IPv6 [fe80::b614:89ff:fe11:5e24]:443 */
-
-                                    else if ( ptr3 != NULL && ptr3[0] == ':' )
-                                        {
-
-                                            if ( debug->debugparse_ip )
-                                                {
-                                                    Sagan_Log(DEBUG, "[%s:%lu] Identified possible [IPv6]:PORT", __FUNCTION__, pthread_self() );
-                                                }
-
-                                            for ( i = 1; i < strlen(ptr3); i++ )
-                                                {
-                                                    port_test[i-1] = ptr3[i];
-                                                }
-
-                                            port_test_int = atoi(port_test);
-
-                                            if ( port_test_int == 0 )
-                                                {
-                                                    lookup_cache[current_position].port = config->sagan_port;
-                                                }
-                                            else
-                                                {
-                                                    lookup_cache[current_position].port = port_test_int;
-                                                }
-
-                                        }
-
-                                    lookup_cache[current_position].status = 1;
-
-                                    current_position++;
-
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
-
-                                }
-
+                            return(false);
                         }
+                }
+        }
 
+    /* Do we even want to part IPv6? */
 
-                    /* Stand alone IPv6 with trailing period */
-
-                    if ( num_colons > 2 && ptr1[ strlen(ptr1)-1 ] == '.' )
-                        {
-
-                            /* Erase the period */
-
-                            ptr1[ strlen(ptr1)-1 ] = '\0';
-
-                            valid = inet_pton(AF_INET6, ptr1,  &(sa.sin_addr));
-
-                            if ( valid == 1 )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified stand alone IPv6 '%s' with trailing period. **", __FUNCTION__, pthread_self(), ptr1 );
-                                        }
-
-                                    memcpy(lookup_cache[current_position].ip, ptr1, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                    /* This converts ::ffff:192.168.1.1 to regular IPv4 (192.168.1.1) */
-
-                                    if ( config->parse_ip_ipv4_mapped_ipv6 == false )
-                                        {
-
-                                            if ( ptr1[0] == ':' && ptr1[1] == ':' && ( ptr1[2] == 'f' || ptr1[2] == 'F' ) &&
-                                                    ( ptr1[3] == 'f' || ptr1[3] == 'F' ) && ( ptr1[4] == 'f' || ptr1[4] == 'F' ) &&
-                                                    ( ptr1[5] == 'f' || ptr1[5] == 'F' ) && ptr1[6] == ':' )
-                                                {
-
-                                                    b = strlen(ptr1);
-
-                                                    for (i = 7; b > i; i++)
-                                                        {
-                                                            lookup_cache[current_position].ip[i-7] = ptr1[i];
-                                                            lookup_cache[current_position].ip[i-6] = '\0';
-                                                        }
-
-                                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                                    IP2Bit(ptr1, lookup_cache[current_position].ip_bits);
-
-                                                }
-
-                                        }
-
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                    lookup_cache[current_position].status = 1;
+    if ( config->parse_ip_ipv6 == false || num_colons <= 2 )
+        {
+            return(true);
+        }
 
-                                    current_position++;
+    /* Stand alone IPv6,  then with a trailing period */
 
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
+    if ( inet_pton(AF_INET6, ptr1, bits) == 1 )
+        {
+            if ( Parse_IP_IPv6_Add(lookup_cache, current_position, ptr1, bits, Parse_IP_Port(next, true)) == false )
+                {
+                    return(false);
+                }
+        }
 
-                                }
+    len = strlen(ptr1);
 
-                        }
+    if ( ptr1[len-1] == '.' )
+        {
 
-                    /* Handle IPv6 fe80::b614:89ff:fe11:5e24#12345 or inet#fe80::b614:89ff:fe11:5e24 */
+            ptr1[len-1] = '\0';
 
-                    if ( num_hashes == 1 && num_colons > 2 )
+            if ( inet_pton(AF_INET6, ptr1, bits) == 1 )
+                {
+                    if ( Parse_IP_IPv6_Add(lookup_cache, current_position, ptr1, bits, config->sagan_port) == false )
                         {
-
-                            /* test both sides */
-
-                            ip_1 = strtok_r(ptr1, "#", &ip_2);
-
-                            if ( ip_1 != NULL )
-                                {
-                                    valid = inet_pton(AF_INET6, ip_1,  &(sa.sin_addr));
-                                }
-
-                            if ( valid == 1 )
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified IPv6#PORT **", __FUNCTION__, pthread_self() );
-                                        }
-
-
-                                    memcpy(lookup_cache[current_position].ip, ip_1, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ip_1, lookup_cache[current_position].ip_bits);
-
-                                    /* In many cases, the port is after the : */
-
-                                    port = atoi(ip_2);
-
-                                    if ( port == 0 )
-                                        {
-                                            lookup_cache[current_position].port = config->sagan_port;
-
-                                        }
-                                    else
-                                        {
-
-                                            lookup_cache[current_position].port = port;
-                                        }
-
-                                    lookup_cache[current_position].status = 1;
-                                    current_position++;
-
-                                    /* If we've run to the end, we're done */
-
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
-
-                                }
-
-                            if ( ip_2 != NULL )
-                                {
-                                    valid = inet_pton(AF_INET6, ip_2,  &(sa.sin_addr));
-                                }
-
-                            if ( valid == 1 )
-
-                                {
-
-                                    if ( debug->debugparse_ip )
-                                        {
-                                            Sagan_Log(DEBUG, "[%s:%lu] ** Identified INTERFACE#IPv6 **", __FUNCTION__, pthread_self() );
-                                        }
-
-
-                                    memcpy(lookup_cache[current_position].ip, ip_2, MAXIP);
-                                    memset(lookup_cache[current_position].ip_bits, 0, MAXIPBIT);
-                                    IP2Bit(ip_2, lookup_cache[current_position].ip_bits);
-                                    lookup_cache[current_position].port = config->sagan_port;
-                                    lookup_cache[current_position].status = 1;
-
-                                    current_position++;
-
-                                    /* If we've run to the end, we're done */
-
-                                    if ( current_position > MAX_PARSE_IP )
-                                        {
-                                            break;
-                                        }
-
-
-                                }
-
+                            return(false);
                         }
-
-                } /* If config->parse_ip_ipv6 */
-
-            ptr1 = strtok_r(NULL, " ", &ptr2);
-
+                }
         }
 
-    for ( i = 0; i < current_position; i++)
-        {
-            lookup_cache[current_position].status = 0;
-        }
+    /* Handle IPv6 fe80::b614:89ff:fe11:5e24#12345 or inet#fe80::b614:89ff:fe11:5e24 */
 
-    if ( debug->debugparse_ip )
+    if ( num_hashes == 1 )
         {
 
+            ip_1 = strtok_r(ptr1, "#", &ip_2);
 
-            if ( current_position > 0 )
+            if ( ip_1 != NULL && inet_pton(AF_INET6, ip_1, bits) == 1 )
                 {
 
-                    Sagan_Log(DEBUG, "[%lld:%d] --[Lookup Cache Array]----", pthread_self(), current_position );
+                    port = atoi(ip_2);
 
-
-                    for (i = 0; i < current_position; i++)
+                    if ( Parse_IP_Add(lookup_cache, current_position, ip_1, bits, 16, port == 0 ? config->sagan_port : port) == false )
                         {
-
-                            Sagan_Log(DEBUG, "-- ARRAY: Position: %d, Status: %d, IP: %s, Port: %d", i, lookup_cache[i].status, lookup_cache[i].ip, lookup_cache[i].port);
+                            return(false);
                         }
-
                 }
 
-
+            if ( ip_2 != NULL && inet_pton(AF_INET6, ip_2, bits) == 1 )
+                {
+                    if ( Parse_IP_Add(lookup_cache, current_position, ip_2, bits, 16, config->sagan_port) == false )
+                        {
+                            return(false);
+                        }
+                }
         }
 
-
-    return(current_position);
+    return(true);
 }
-
@@ -24,14 +24,25 @@
 
 #include "parsers/strstr-asm/strstr-hook.h"
 
-int Parse_IP( char *syslog_message, struct _Sagan_Lookup_Cache_Entry *lookup_cache );
+/* Character classes for Parse_Extract() and friends */
+
+#define PARSE_CLASS_SPACE	0x01		/* Splits tokens */
+#define PARSE_CLASS_DOT		0x02
+#define PARSE_CLASS_COLON	0x04
+#define PARSE_CLASS_HASH	0x08
+#define PARSE_CLASS_HEX		0x10
+
+extern const unsigned char parse_class[256];
+
+int   Parse_Extract( char *syslog_message, struct _Sagan_Parse_Cache *parse_cache );
+bool  Parse_IP_Token( char *, int, int, int, const unsigned char *, struct _Sagan_Lookup_Cache_Entry *, int * );
+void  Parse_Hash_Token( const char *, size_t, struct _Sagan_Parse_Cache * );
 
 int   Parse_Src_Port( char * );
 int   Parse_Dst_Port( char * );
 int   Parse_Proto( char * );
 int   Parse_Proto_Program( char * );
-void  Parse_Hash( char *, int, char *str, size_t size );
-void  Parse_Hash_Cleanup(char *, char *str, size_t size );
+bool  Parse_Syslog( char *, size_t, struct _Sagan_Proc_Syslog * );
 
 /* IP Lookup cache */
 
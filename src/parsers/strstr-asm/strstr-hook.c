@@ -125,3 +125,50 @@ char *Sagan_stristr(const char *_x, const char *_y, bool needle_lower )
     return (strcasestr(_x, _y));
 }
 #endif
+
+/****************************************************************************
+ * Sagan_memmem - Length bounded strstr().  Used by the engine to search a
+ * "window" (offset/depth/distance/within) of the message without copying
+ * it out first.  glibc's memmem() is two way/SIMD,  so use it if we can.
+ ****************************************************************************/
+
+char *Sagan_memmem(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len)
+{
+
+#ifdef HAVE_MEMMEM
+
+    return( (char *)memmem(haystack, haystack_len, needle, needle_len) );
+
+#else
+
+    const char *p = haystack;
+    const char *end = haystack + haystack_len;
+
+    if ( needle_len == 0 )
+        {
+            return( (char *)haystack );
+        }
+
+    while ( (size_t)( end - p ) >= needle_len )
+        {
+
+            p = memchr(p, needle[0], ( end - p ) - needle_len + 1);
+
+            if ( p == NULL )
+                {
+                    return(NULL);
+                }
+
+            if ( !memcmp(p, needle, needle_len) )
+                {
+                    return( (char *)p );
+                }
+
+            p++;
+        }
+
+    return(NULL);
+
+#endif
+
+}
@@ -44,4 +44,5 @@ int __strstr_sse42();
 
 char *Sagan_strstr(const char *, const char *);
 char *Sagan_stristr(const char *, const char *, bool);
+char *Sagan_memmem(const char *, size_t, const char *, size_t);
 
@@ -0,0 +1,312 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* syslog.c
+ *
+ * Parses RFC3164 ("BSD") and RFC5424 syslog messages as received by the
+ * built in listener (input-listener.c).  The message is split in place
+ * and the fields are pointed at,  the same as lines that come in over
+ * the FIFO.
+ *
+ * Field values mirror what the rsyslog/syslog-ng templates we ship hand
+ * Sagan.  "facility", "priority" and "level" are the text names (the
+ * priority and level are both the severity).  The "tag" is the PRI in
+ * two digit hex,  like syslog-ng's $TAG.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "parsers/parsers.h"
+
+static char *syslog_facility_names[] =
+{
+    "kern", "user", "mail", "daemon", "auth", "syslog", "lpr", "news",
+    "uucp", "cron", "authpriv", "ftp", "ntp", "security", "console", "solaris-cron",
+    "local0", "local1", "local2", "local3", "local4", "local5", "local6", "local7"
+};
+
+static char *syslog_severity_names[] =
+{
+    "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+};
+
+static const char syslog_hex[] = "0123456789abcdef";
+
+/****************************************************************************
+ * Parse_Syslog_Token - Terminates the space delimited token at *p and moves
+ * *p past it.  Returns NULL if we ran out of message.
+ ****************************************************************************/
+
+static char *Parse_Syslog_Token( char **p, char *end )
+{
+
+    char *start = *p;
+    char *space = NULL;
+
+    if ( start >= end )
+        {
+            return(NULL);
+        }
+
+    space = memchr(start, ' ', end - start);
+
+    if ( space == NULL )
+        {
+            *p = end;
+            return(start);
+        }
+
+    *space = '\0';
+    *p = space + 1;
+
+    return(start);
+}
+
+/****************************************************************************
+ * Parse_Syslog - Splits "msg" (of "len" bytes,  NULL terminated) in place.
+ * Sets the facility,  priority,  level,  tag,  program and message of
+ * SaganProcSyslog.  The host,  date and time are left to the caller.
+ * Returns false if there was no <PRI> (RFC3164 says to assume <13> and
+ * we do).
+ ****************************************************************************/
+
+bool Parse_Syslog( char *msg, size_t len, struct _Sagan_Proc_Syslog *SaganProcSyslog )
+{
+
+    char *p = msg;
+    char *end = msg + len;
+    char *program = NULL;
+    char *token = NULL;
+
+    int pri = 13;
+    int i = 0;
+
+    bool valid = true;
+
+    /* Trailing new lines/NULLs some senders tack on */
+
+    while ( end > msg && ( end[-1] == '\n' || end[-1] == '\r' || end[-1] == '\0' ) )
+        {
+            end--;
+        }
+
+    *end = '\0';
+
+    /* <PRI> */
+
+    if ( p < end && *p == '<' )
+        {
+
+            pri = 0;
+
+            for ( i = 1; i < 5 && p + i < end && isdigit((unsigned char)p[i]); i++ )
+                {
+                    pri = ( pri * 10 ) + ( p[i] - '0' );
+                }
+
+            if ( i > 1 && p + i < end && p[i] == '>' && pri < 192 )
+                {
+
+                    /* "<PRI>" is at least three bytes. Reuse it for the hex tag */
+
+                    p[0] = syslog_hex[ ( pri >> 4 ) & 0x0f ];
+                    p[1] = syslog_hex[ pri & 0x0f ];
+                    p[2] = '\0';
+
+                    SaganProcSyslog->syslog_tag = p;
+
+                    p = p + i + 1;
+
+                }
+            else
+                {
+                    pri = 13;
+                    valid = false;
+                }
+
+        }
+    else
+        {
+            valid = false;
+        }
+
+    if ( valid == false )
+        {
+            SaganProcSyslog->syslog_tag = "0d";
+        }
+
+    SaganProcSyslog->syslog_facility = syslog_facility_names[pri >> 3];
+    SaganProcSyslog->syslog_priority = syslog_severity_names[pri & 0x07];
+    SaganProcSyslog->syslog_level = syslog_severity_names[pri & 0x07];
+
+    /* RFC5424: <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID SD [MSG] */
+
+    if ( end - p >= 2 && p[0] == '1' && p[1] == ' ' )
+        {
+
+            p = p + 2;
+
+            (void)Parse_Syslog_Token(&p, end);		/* TIMESTAMP */
+            (void)Parse_Syslog_Token(&p, end);		/* HOSTNAME */
+            program = Parse_Syslog_Token(&p, end);	/* APP-NAME */
+            (void)Parse_Syslog_Token(&p, end);		/* PROCID */
+            (void)Parse_Syslog_Token(&p, end);		/* MSGID */
+
+            /* STRUCTURED-DATA is "-" or one or more [..] elements.  ']' can be
+               escaped within a value. */
+
+            if ( p < end && *p == '[' )
+                {
+
+                    while ( p < end && *p == '[' )
+                        {
+
+                            for ( p++; p < end && *p != ']'; p++ )
+                                {
+                                    if ( *p == '\\' && p + 1 < end )
+                                        {
+                                            p++;
+                                        }
+                                }
+
+                            if ( p < end )
+                                {
+                                    p++;
+                                }
+                        }
+
+                }
+            else if ( p < end && *p == '-' )
+                {
+                    p++;
+                }
+
+            if ( p < end && *p == ' ' )
+                {
+                    p++;
+                }
+
+            /* UTF-8 BOM */
+
+            if ( end - p >= 3 && (unsigned char)p[0] == 0xEF && (unsigned char)p[1] == 0xBB && (unsigned char)p[2] == 0xBF )
+                {
+                    p = p + 3;
+                }
+
+            if ( program == NULL || !strcmp(program, "-") )
+                {
+                    program = "";
+                }
+
+        }
+
+    /* RFC3164: <PRI>Mmm dd hh:mm:ss HOSTNAME TAG[pid]: MSG */
+
+    else
+        {
+
+            if ( end - p >= 16 && p[3] == ' ' && p[6] == ' ' && p[9] == ':' &&
+                    p[12] == ':' && p[15] == ' ' )
+                {
+
+                    p = p + 16;
+
+                    /* A hostname follows the timestamp unless the next token is
+                       already the tag */
+
+                    token = p;
+
+                    while ( token < end && *token != ' ' && *token != ':' && *token != '[' )
+                        {
+                            token++;
+                        }
+
+                    if ( token < end && *token == ' ' )
+                        {
+                            p = token + 1;
+                        }
+
+                }
+
+            /* TAG is up to 32 characters and ends at '[', ':' or a space */
+
+            program = p;
+
+            for ( i = 0; i < MAXPROGRAM && p < end && *p != '[' && *p != ':' && *p != ' '; i++ )
+                {
+                    p++;
+                }
+
+            if ( p < end && ( *p == '[' || *p == ':' ) )
+                {
+
+                    if ( *p == '[' )
+                        {
+
+                            *p = '\0';
+
+                            for ( p++; p < end && *p != ']'; p++ );
+
+                            if ( p < end )
+                                {
+                                    p++;
+                                }
+                        }
+
+                    if ( p < end && *p == ':' )
+                        {
+                            *p = '\0';
+                            p++;
+                        }
+
+                }
+            else
+                {
+
+                    /* No tag.  The whole thing is the message */
+
+                    p = program;
+                    program = "";
+                }
+
+            if ( p < end && *p == ' ' )
+                {
+                    p++;
+                }
+
+        }
+
+    SaganProcSyslog->syslog_program = program;
+    SaganProcSyslog->syslog_message = p;
+    SaganProcSyslog->syslog_message_len = end - p;
+
+    return(valid);
+}
+
@@ -41,6 +41,8 @@
 #include "sagan-defs.h"
 #include "ignore-list.h"
 #include "sagan-config.h"
+#include "util-ring.h"
+#include "input-slab.h"
 #include "parsers/parsers.h"
 
 #include "processors/engine.h"
@@ -50,19 +52,15 @@
 
 struct _Sagan_Ignorelist *SaganIgnorelist;
 struct _SaganCounters *counters;
-struct _Sagan_Proc_Syslog *SaganProcSyslog;
+_Sagan_Ring *SaganProcRing;		/* Comes from sagan.c */
 struct _SaganConfig *config;
 struct _Rule_Struct *rulestruct;
 
-int proc_msgslot; 		/* Comes from sagan.c */
 int proc_running;   	        /* Comes from sagan.c */
 unsigned char dynamic_rule_flag; /* Comes from sagan.c */
 
 bool death=false;
 
-pthread_cond_t SaganProcDoWork;
-pthread_mutex_t SaganProcWorkMutex;
-
 pthread_cond_t SaganReloadCond;
 pthread_mutex_t SaganReloadMutex;
 
@@ -77,15 +75,10 @@ void Processor ( void )
 
     (void)SetThreadName("SaganWorker");
 
-    struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = NULL;
-    SaganProcSyslog_LOCAL = malloc(sizeof(struct _Sagan_Proc_Syslog));
-
-    if ( SaganProcSyslog_LOCAL == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog_LOCAL. Abort!", __FILE__, __LINE__);
-        }
-
-    memset(SaganProcSyslog_LOCAL, 0, sizeof(struct _Sagan_Proc_Syslog));
+    struct _Sagan_Proc_Syslog SaganProcSyslog_COPY;
+    struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = &SaganProcSyslog_COPY;
+    struct _Sagan_Proc_Syslog *proc_syslog = NULL;
+    _Sagan_Ring_Slot *proc_slot = NULL;
 
     bool ignore_flag = false;
 
@@ -95,30 +88,56 @@ void Processor ( void )
     while(death == false)
         {
 
-            pthread_mutex_lock(&SaganProcWorkMutex);
-
-            while ( proc_msgslot == 0 ) pthread_cond_wait(&SaganProcDoWork, &SaganProcWorkMutex);
+            Sagan_Ring_Wait(SaganProcRing);
 
             if ( config->sagan_reload )
                 {
                     pthread_cond_wait(&SaganReloadCond, &SaganReloadMutex);
                 }
 
-            proc_running++;
-            proc_msgslot--;	/* This was ++ before coming over, so we now -- it to get to
-					 * original value */
+            /* Count ourselves as running before taking the line so the EOF
+               and shutdown checks never see an empty queue with nothing
+               running while a line is in flight */
+
+            __atomic_add_fetch(&proc_running, 1, __ATOMIC_SEQ_CST);
+
+            proc_slot = Sagan_Ring_Dequeue_Claim(SaganProcRing);
+
+            if ( proc_slot == NULL )
+                {
+
+                    /* Another worker beat us to it */
+
+                    __atomic_sub_fetch(&proc_running, 1, __ATOMIC_SEQ_CST);
+                    continue;
+                }
+
+            /* Copy the (small) descriptor out and hand the slot back right
+               away,  so a slow event doesn't keep the input from queueing
+               behind it.  The fields still point into the input slab,  which
+               we hold a reference on.  Fields pointing at the descriptor's
+               own buffers are re-pointed at the copy */
 
-            strlcpy(SaganProcSyslog_LOCAL->syslog_host, SaganProcSyslog[proc_msgslot].syslog_host, sizeof(SaganProcSyslog_LOCAL->syslog_host));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog[proc_msgslot].syslog_facility, sizeof(SaganProcSyslog_LOCAL->syslog_facility));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog[proc_msgslot].syslog_priority, sizeof(SaganProcSyslog_LOCAL->syslog_priority));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog[proc_msgslot].syslog_level, sizeof(SaganProcSyslog_LOCAL->syslog_level));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_tag, SaganProcSyslog[proc_msgslot].syslog_tag, sizeof(SaganProcSyslog_LOCAL->syslog_tag));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_date, SaganProcSyslog[proc_msgslot].syslog_date, sizeof(SaganProcSyslog_LOCAL->syslog_date));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_time, SaganProcSyslog[proc_msgslot].syslog_time, sizeof(SaganProcSyslog_LOCAL->syslog_time));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog[proc_msgslot].syslog_program, sizeof(SaganProcSyslog_LOCAL->syslog_program));
-            strlcpy(SaganProcSyslog_LOCAL->syslog_message, SaganProcSyslog[proc_msgslot].syslog_message, sizeof(SaganProcSyslog_LOCAL->syslog_message));
+            proc_syslog = (struct _Sagan_Proc_Syslog *)proc_slot->data;
 
-            pthread_mutex_unlock(&SaganProcWorkMutex);
+            memcpy(SaganProcSyslog_LOCAL, proc_syslog, sizeof(struct _Sagan_Proc_Syslog));
+
+            if ( proc_syslog->syslog_host == proc_syslog->syslog_host_lookup )
+                {
+                    SaganProcSyslog_LOCAL->syslog_host = SaganProcSyslog_LOCAL->syslog_host_lookup;
+                }
+
+            if ( proc_syslog->syslog_date == proc_syslog->syslog_date_buf )
+                {
+                    SaganProcSyslog_LOCAL->syslog_date = SaganProcSyslog_LOCAL->syslog_date_buf;
+                }
+
+            if ( proc_syslog->syslog_time == proc_syslog->syslog_time_buf )
+                {
+                    SaganProcSyslog_LOCAL->syslog_time = SaganProcSyslog_LOCAL->syslog_time_buf;
+                }
+
+            Sagan_Ring_Dequeue_Commit(SaganProcRing, proc_slot);
 
             /* Check for general "drop" items.  We do this first so we can save CPU later */
 
@@ -170,10 +189,12 @@ outside_loop:
 
                 } // End if if (ignore_Flag)
 
+            if ( SaganProcSyslog_LOCAL->slab != NULL )
+                {
+                    Sagan_Slab_Release(SaganProcSyslog_LOCAL->slab);
+                }
 
-            pthread_mutex_lock(&SaganProcWorkMutex);
-            proc_running--;
-            pthread_mutex_unlock(&SaganProcWorkMutex);
+            __atomic_sub_fetch(&proc_running, 1, __ATOMIC_SEQ_CST);
         } //  for (;;)
 
 //    printf("DEATH: %d\n", proc_running);
@@ -181,6 +202,5 @@ outside_loop:
     pthread_exit(NULL);
 
 //    Sagan_Log(WARN, "[%s, line %d] Holy cow! You should never see this message!", __FILE__, __LINE__);
-//    free(SaganProcSyslog_LOCAL);		/* Should never make it here */
 }
 
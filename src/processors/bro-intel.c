@@ -645,7 +645,7 @@ bool Sagan_BroIntel_DOMAIN ( char *syslog_message )
     for ( i = 0; i < counters->brointel_domain_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_Domain[i].domain, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_Domain[i].domain) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -673,7 +673,7 @@ bool Sagan_BroIntel_FILE_HASH ( char *syslog_message )
     for ( i = 0; i < counters->brointel_file_hash_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_File_Hash[i].hash, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_File_Hash[i].hash) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -701,7 +701,7 @@ bool Sagan_BroIntel_URL ( char *syslog_message )
     for ( i = 0; i < counters->brointel_url_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_URL[i].url, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_URL[i].url) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -728,7 +728,7 @@ bool Sagan_BroIntel_SOFTWARE ( char *syslog_message )
     for ( i = 0; i < counters->brointel_software_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_Software[i].software, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_Software[i].software) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -755,7 +755,7 @@ bool Sagan_BroIntel_EMAIL ( char *syslog_message )
     for ( i = 0; i < counters->brointel_email_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_Email[i].email, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_Email[i].email) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -782,7 +782,7 @@ bool Sagan_BroIntel_USER_NAME ( char *syslog_message )
     for ( i = 0; i < counters->brointel_user_name_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_User_Name[i].username, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_User_Name[i].username) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -809,7 +809,7 @@ bool Sagan_BroIntel_FILE_NAME ( char *syslog_message )
     for ( i = 0; i < counters->brointel_file_name_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_File_Name[i].file_name, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_File_Name[i].file_name) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -836,7 +836,7 @@ bool Sagan_BroIntel_CERT_HASH ( char *syslog_message )
     for ( i = 0; i < counters->brointel_cert_hash_count; i++)
         {
 
-            if ( Sagan_stristr(syslog_message, Sagan_BroIntel_Intel_Cert_Hash[i].cert_hash, false) )
+            if ( Sagan_strstr(syslog_message, Sagan_BroIntel_Intel_Cert_Hash[i].cert_hash) )
                 {
                     if ( debug->debugbrointel )
                         {
@@ -40,6 +40,7 @@
 #include "sagan.h"
 #include "sagan-defs.h"
 #include "rules.h"
+#include "rules-index.h"
 #include "sagan-config.h"
 #include "send-alert.h"
 
@@ -135,6 +136,7 @@ int Sagan_Dynamic_Rules ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, int rule_po
             reload_rules = 1;
 
             Load_Rules(rulestruct[rule_position].dynamic_ruleset);
+            Rules_Index_Build(false);
 
             reload_rules = 0;
             pthread_mutex_unlock(&SaganRulesLoadedMutex);
@@ -51,6 +51,9 @@
 #include "flow.h"
 #include "after.h"
 #include "threshold.h"
+#include "rules-index.h"
+#include "rules-plan.h"
+#include "util-memo.h"
 
 #include "parsers/parsers.h"
 
@@ -58,6 +61,7 @@
 #include "processors/bro-intel.h"
 #include "processors/blacklist.h"
 #include "processors/dynamic-rules.h"
+#include "processors/rule-profile.h"
 
 #ifdef WITH_BLUEDOT
 #include "processors/bluedot.h"
@@ -83,34 +87,242 @@ pthread_mutex_t CountersFlowFlowTotal=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t CountersGeoIPHit=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t CounterSaganFoundMutex=PTHREAD_MUTEX_INITIALIZER;
 
+static __thread struct _Sagan_Parse_Cache parse_cache;
+
 void Sagan_Engine_Init ( void )
 {
     /* Nothing to do yet */
 }
 
+/****************************************************************************
+ * Engine_Parse/Engine_Parse_Proto_Program - Run the parsers the first time
+ * a rule for this event needs them.  After that,  the results in
+ * parse_cache are used.
+ ****************************************************************************/
 
-int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_flag )
+static struct _Sagan_Parse_Cache *Engine_Parse( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    if ( parse_cache.parsed == false )
+        {
+            Parse_Extract(SaganProcSyslog_LOCAL->syslog_message, &parse_cache);
+            parse_cache.parsed = true;
+        }
+
+    return(&parse_cache);
+}
+
+static int Engine_Parse_Proto_Program( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    if ( parse_cache.proto_program_parsed == false )
+        {
+            parse_cache.proto_program = Parse_Proto_Program(SaganProcSyslog_LOCAL->syslog_program);
+            parse_cache.proto_program_parsed = true;
+        }
+
+    return(parse_cache.proto_program);
+}
+
+/****************************************************************************
+ * Engine_Blacklist/BroIntel/Bluedot - The enrichment lookups.  The first
+ * rule to ask about something in this event does the lookup.  Every other
+ * rule gets the answer from util-memo.c.
+ ****************************************************************************/
+
+static bool Engine_Blacklist_IPADDR( unsigned char *ip_bits )
+{
+
+    int result = 0;
+
+    if ( Sagan_Memo_Get(MEMO_BLACKLIST, 0, ip_bits, MAXIPBIT, &result) == false )
+        {
+            result = Sagan_Blacklist_IPADDR(ip_bits);
+            Sagan_Memo_Set(MEMO_BLACKLIST, 0, ip_bits, MAXIPBIT, result);
+        }
+
+    return(result);
+}
+
+static bool Engine_Blacklist_IPADDR_All( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, _Sagan_Lookup_Cache_Entry *lookup_cache, int lookup_cache_size )
+{
+
+    int result = 0;
+
+    if ( Sagan_Memo_Get(MEMO_BLACKLIST_ALL, 0, "", 0, &result) == false )
+        {
+            result = Sagan_Blacklist_IPADDR_All(SaganProcSyslog_LOCAL->syslog_message, lookup_cache, lookup_cache_size);
+            Sagan_Memo_Set(MEMO_BLACKLIST_ALL, 0, "", 0, result);
+        }
+
+    return(result);
+}
+
+static bool Engine_BroIntel_IPADDR( unsigned char *ip_bits, char *ip )
+{
+
+    int result = 0;
+
+    if ( Sagan_Memo_Get(MEMO_BROINTEL, 0, ip_bits, MAXIPBIT, &result) == false )
+        {
+            result = Sagan_BroIntel_IPADDR(ip_bits, ip);
+            Sagan_Memo_Set(MEMO_BROINTEL, 0, ip_bits, MAXIPBIT, result);
+        }
+
+    return(result);
+}
+
+static bool Engine_BroIntel_IPADDR_All( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, _Sagan_Lookup_Cache_Entry *lookup_cache )
 {
 
-    struct _Sagan_Processor_Info *processor_info_engine = NULL;
-    processor_info_engine = malloc(sizeof(struct _Sagan_Processor_Info));
+    int result = 0;
 
-    if ( processor_info_engine == NULL )
+    if ( Sagan_Memo_Get(MEMO_BROINTEL_ALL, 0, "", 0, &result) == false )
         {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for processor_info_engine. Abort!", __FILE__, __LINE__);
+            result = Sagan_BroIntel_IPADDR_All(SaganProcSyslog_LOCAL->syslog_message, lookup_cache, MAX_PARSE_IP);
+            Sagan_Memo_Set(MEMO_BROINTEL_ALL, 0, "", 0, result);
         }
 
-    memset(processor_info_engine, 0, sizeof(_Sagan_Processor_Info));
+    return(result);
+}
+
+/* Domain,  file hash,  URL,  etc.  These search the whole message,  so the
+   lookup function itself tells them apart */
+
+static bool Engine_BroIntel_Message( bool (*lookup)( char * ), _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
 
-    struct _Sagan_Lookup_Cache_Entry *lookup_cache = NULL;
-    lookup_cache = malloc(sizeof(struct _Sagan_Lookup_Cache_Entry) * MAX_PARSE_IP);
+    int result = 0;
 
-    if ( lookup_cache == NULL )
+    if ( Sagan_Memo_Get(MEMO_BROINTEL_MESSAGE, (uintptr_t)lookup, "", 0, &result) == false )
         {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for lookup_cache. Abort!", __FILE__, __LINE__);
+            result = lookup(Sagan_Message_Lower(SaganProcSyslog_LOCAL));
+            Sagan_Memo_Set(MEMO_BROINTEL_MESSAGE, (uintptr_t)lookup, "", 0, result);
         }
 
-    memset(lookup_cache, 0, sizeof(_Sagan_Lookup_Cache_Entry) * MAX_PARSE_IP);
+    return(result);
+}
+
+#ifdef WITH_BLUEDOT
+
+/* What Bluedot says depends on the rule's "mdate"/"cdate" effective
+   periods,  so they are part of the key */
+
+static unsigned char Engine_Bluedot_Lookup( char *data, unsigned char type, int rule_position, unsigned char *ip_bits )
+{
+
+    unsigned char key[MEMO_MAX_KEY];
+    size_t key_len = sizeof(uint64_t);
+    size_t data_len = 0;
+
+    int result = 0;
+
+    memcpy(key, &rulestruct[rule_position].bluedot_cdate_effective_period, sizeof(uint64_t));
+
+    if ( type == BLUEDOT_LOOKUP_IP )
+        {
+            memcpy(key + key_len, ip_bits, MAXIPBIT);
+            key_len = key_len + MAXIPBIT;
+        }
+    else
+        {
+
+            data_len = strlen(data);
+
+            /* Too long to remember */
+
+            if ( key_len + data_len > MEMO_MAX_KEY )
+                {
+                    return( Sagan_Bluedot_Lookup(data, type, rule_position, ip_bits) );
+                }
+
+            memcpy(key + key_len, data, data_len);
+            key_len = key_len + data_len;
+        }
+
+    if ( Sagan_Memo_Get(MEMO_BLUEDOT + type, rulestruct[rule_position].bluedot_mdate_effective_period, key, key_len, &result) == false )
+        {
+            result = Sagan_Bluedot_Lookup(data, type, rule_position, ip_bits);
+            Sagan_Memo_Set(MEMO_BLUEDOT + type, rulestruct[rule_position].bluedot_mdate_effective_period, key, key_len, result);
+        }
+
+    return(result);
+}
+
+#endif
+
+/****************************************************************************
+ * Engine_Content_Window - Works out the part of the message a content or
+ * meta_content looks at (offset, depth, distance and within) as a pointer
+ * and length into the message.  Nothing is copied.
+ ****************************************************************************/
+
+static inline void Engine_Content_Window( const char *message, size_t message_len, int offset, int depth, int distance, int within, int previous_depth, const char **window, size_t *window_len )
+{
+
+    size_t start = 0;
+    size_t len = message_len;
+
+    /* OFFSET.  If the offset is larger than the message,  there is nothing to search */
+
+    if ( offset != 0 )
+        {
+            start = message_len > (size_t)offset ? (size_t)offset : message_len;
+            len = message_len - start;
+        }
+
+    /* DEPTH.  We do +1 to account for the whitespace at the begin of the syslog message */
+
+    if ( depth != 0 && len > (size_t)depth + 1 )
+        {
+            len = depth + 1;
+        }
+
+    /* DISTANCE is from the end of the previous content's depth.  It replaces offset/depth */
+
+    if ( distance != 0 )
+        {
+
+            start = (size_t)previous_depth + distance + 1;
+
+            if ( start > message_len )
+                {
+                    start = message_len;
+                }
+
+            len = message_len - start;
+
+            /* WITHIN */
+
+            if ( within != 0 && len > (size_t)within )
+                {
+                    len = within;
+                }
+        }
+
+    *window = message + start;
+    *window_len = len;
+
+}
+
+
+int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_flag )
+{
+
+    /* Every field is set before an alert is sent,  so this isn't cleared
+       for each event */
+
+    struct _Sagan_Processor_Info processor_info_engine_LOCAL;
+    struct _Sagan_Processor_Info *processor_info_engine = &processor_info_engine_LOCAL;
+
+    struct _Sagan_Lookup_Cache_Entry *lookup_cache = parse_cache.ip;
+
+    /* New event,  nothing has been parsed yet */
+
+    parse_cache.parsed = false;
+    parse_cache.proto_program_parsed = false;
+
+    Sagan_Memo_Reset();
 
     int processor_info_engine_src_port = 0;
     int processor_info_engine_dst_port = 0;
@@ -126,22 +338,32 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
     int z = 0;
 
     bool match = false;
-    int sagan_match = 0;	/* Used to determine if all has "matched" (content, pcre, meta_content, etc) */
+
+    _Rules_Index *rules_index = NULL;
+    _Rules_Index_Step *step = NULL;
+    uint64_t *rules_candidates = NULL;
+    uint32_t *rules_order = NULL;
+    uint32_t rules_order_count = 0;
+    uint32_t c = 0;
+    bool rules_sample = false;
+    bool rules_profile = config->rule_profile_flag;
+    bool message_match = false;
+    uint64_t rule_start = 0;
+    uint64_t rule_time = 0;
 
     int rc = 0;
     int ovector[PCRE_OVECCOUNT];
 
-    int alter_num = 0;
-    int meta_alter_num = 0;
+    const char *window = NULL;
+    size_t window_len = 0;
+    size_t message_len = SaganProcSyslog_LOCAL->syslog_message_len;
+    bool found = false;
 
     bool xbit_return = 0;
     bool xbit_count_return = 0;
 
-    bool alert_time_trigger = false;
     bool check_flow_return = true;  /* 1 = match, 0 = no match */
 
-    char *ptmp;
-    char *tok2;
 
     char *pnormalize_selector = NULL;
 
@@ -161,10 +383,7 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
     uint32_t ip_dstport_u32 = 0;
     unsigned char ip_dst_bits[MAXIPBIT] = { 0 };
 
-    char tmpbuf[128];
     char s_msg[1024];
-    char alter_content[MAX_SYSLOGMSG];
-    char meta_alter_content[MAX_SYSLOGMSG];
 
     struct timeval tp;
     unsigned char proto = 0;
@@ -207,8 +426,10 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
 #ifdef HAVE_LIBLOGNORM
 
+    /* Normalize_Liblognorm() resets what it fills in.  No need to clear
+       it for every event */
+
     static __thread struct _SaganNormalizeLiblognorm SaganNormalizeLiblognorm = { { 0 } };
-    memset((char *)&SaganNormalizeLiblognorm, 0, sizeof(struct _SaganNormalizeLiblognorm));
 
 #endif
 
@@ -223,12 +444,32 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
     /* Search for matches */
 
-    /* First we search for 'program' and such.   This way,  we don't waste CPU
-     * time with pcre/content.  */
+    /* First we narrow down to the rules whose 'program',  'facility' and such
+     * can match (see rules-index.c).  This way,  we don't waste CPU time with
+     * pcre/content on rules that can never fire.  With "rule-reorder",  the
+     * candidates that fire most often are checked first. */
+
+    rules_index = Rules_Index_Candidates(SaganProcSyslog_LOCAL, &rules_candidates);
+    rules_order_count = Rules_Index_Order(rules_index, rules_candidates, &rules_order);
+    rules_sample = Rules_Index_Sample(rules_index);
 
-    for(b=0; b < counters->rulecount; b++)
+    for ( c = 0; c < rules_order_count; c++ )
         {
 
+            b = rules_order[c];
+
+            /* While this rule is checked,  start loading the next one's steps */
+
+            if ( c + 1 < rules_order_count )
+                {
+                    __builtin_prefetch(&rules_index->hot_steps[rules_index->hot_plan_start[rules_order[c + 1]]]);
+                }
+
+            if ( rules_sample == true || rules_profile == true )
+                {
+                    rule_start = Monotonic_NS();
+                }
+
             ip_src_flag = false;
             ip_dst_flag = false;
 
@@ -253,596 +494,367 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
             /* Process "normal" rules.  Skip dynamic rules if it's not time to process them */
 
-            if ( rulestruct[b].type == NORMAL_RULE || ( rulestruct[b].type == DYNAMIC_RULE && dynamic_rule_flag == true ) )
+            if ( rules_index->hot_type[b] == NORMAL_RULE || ( rules_index->hot_type[b] == DYNAMIC_RULE && dynamic_rule_flag == true ) )
                 {
 
-                    match = false;
-
-                    if ( strcmp(rulestruct[b].s_program, "" ))
-                        {
-                            strlcpy(tmpbuf, rulestruct[b].s_program, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            match = true;
-                            while ( ptmp != NULL )
-                                {
-                                    if ( Wildcard(ptmp, SaganProcSyslog_LOCAL->syslog_program) == 1 )
-                                        {
-                                            match = false;
-                                        }
-
-                                    ptmp = strtok_r(NULL, "|", &tok2);
-                                }
-                        }
+                    /* The rule index already matched the program/facility/level/tag.  The
+                     * rest of the rule is its plan (see rules-plan.c).  Tests that only need
+                     * the message come first,  cheapest first,  and the first one that fails
+                     * ends it.  This way,  we don't pcre a message a content: already
+                     * ruled out.  These steps come from the index's "hot" copy,  not
+                     * rulestruct (see rules-index.h). */
 
-                    if ( strcmp(rulestruct[b].s_facility, "" ))
-                        {
-                            strlcpy(tmpbuf, rulestruct[b].s_facility, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            match = true;
-                            while ( ptmp != NULL )
-                                {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_facility))
-                                        {
-                                            match = false;
-                                        }
-
-                                    ptmp = strtok_r(NULL, "|", &tok2);
-                                }
-                        }
-
-                    if ( strcmp(rulestruct[b].s_syspri, "" ))
-                        {
-                            strlcpy(tmpbuf, rulestruct[b].s_syspri, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            match = true;
-                            while ( ptmp != NULL )
-                                {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_priority))
-                                        {
-                                            match = false;
-                                        }
-
-                                    ptmp = strtok_r(NULL, "|", &tok2);
-                                }
-                        }
+                    match = true;
+                    step = &rules_index->hot_steps[rules_index->hot_plan_start[b]];
 
-                    if ( strcmp(rulestruct[b].s_level, "" ))
+                    for ( z = 0; z < rules_index->hot_plan_message_count[b] && match == true; z++, step++ )
                         {
-                            strlcpy(tmpbuf, rulestruct[b].s_level, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            match = true;
-                            while ( ptmp != NULL )
-                                {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_level))
-                                        {
-                                            match = false;
-                                        }
 
-                                    ptmp = strtok_r(NULL, "|", &tok2);
-                                }
-                        }
-
-                    if ( strcmp(rulestruct[b].s_tag, "" ))
-                        {
-                            strlcpy(tmpbuf, rulestruct[b].s_tag, sizeof(tmpbuf));
-                            ptmp = strtok_r(tmpbuf, "|", &tok2);
-                            match = true;
-                            while ( ptmp != NULL )
+                            switch ( step->type )
                                 {
-                                    if (!strcmp(ptmp, SaganProcSyslog_LOCAL->syslog_tag))
-                                        {
-                                            match = false;
-                                        }
 
-                                    ptmp = strtok_r(NULL, "|", &tok2);
-                                }
-                        }
+                                case(PLAN_TIME):
+                                    match = Check_Time(b);
+                                    break;
 
-                    /* If there has been a match above,  or NULL on all,  then we continue with
-                     * PCRE/content search */
+                                /* Search via strstr (content:) */
 
-                    /* Search via strstr (content:) */
+                                case(PLAN_CONTENT):
 
-                    if ( match == false )
-                        {
+                                    Engine_Content_Window(SaganProcSyslog_LOCAL->syslog_message, message_len,
+                                                          step->offset, step->depth, step->distance, step->within,
+                                                          step->prev_depth, &window, &window_len);
 
-                            if ( rulestruct[b].content_count != 0 )
-                                {
+                                    /* If case insensitive.  "nocase" content is lower case
+                                       already,  so search the same window of the lower case message */
 
-                                    for(z=0; z<rulestruct[b].content_count; z++)
+                                    if ( step->nocase == true )
                                         {
-
-
-                                            /* Content: OFFSET */
-
-                                            alter_num = 0;
-
-                                            if ( rulestruct[b].s_offset[z] != 0 )
-                                                {
-
-                                                    if ( strlen(SaganProcSyslog_LOCAL->syslog_message) > rulestruct[b].s_offset[z] )
-                                                        {
-
-                                                            alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - rulestruct[b].s_offset[z];
-                                                            strlcpy(alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - alter_num), alter_num + 1);
-
-                                                        }
-                                                    else
-                                                        {
-
-                                                            alter_content[0] = '\0'; 	/* The offset is larger than the message.  Set content too NULL */
-
-                                                        }
-
-                                                }
-                                            else
-                                                {
-
-                                                    strlcpy(alter_content, SaganProcSyslog_LOCAL->syslog_message, sizeof(alter_content));
-
-                                                }
-
-                                            /* Content: DEPTH */
-
-                                            if ( rulestruct[b].s_depth[z] != 0 )
-                                                {
-
-                                                    /* We do +2 to account for alter_count[0] and whitespace at the begin of syslog message */
-
-                                                    strlcpy(alter_content, alter_content, rulestruct[b].s_depth[z] + 2);
-
-                                                }
-
-                                            /* Content: DISTANCE */
-
-                                            if ( rulestruct[b].s_distance[z] != 0 )
-                                                {
-
-                                                    alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - ( rulestruct[b].s_depth[z-1] + rulestruct[b].s_distance[z] + 1);
-                                                    strlcpy(alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - alter_num), alter_num + 1);
-
-                                                    /* Content: WITHIN */
-
-                                                    if ( rulestruct[b].s_within[z] != 0 )
-                                                        {
-                                                            strlcpy(alter_content, alter_content, rulestruct[b].s_within[z] + 1);
-
-                                                        }
-
-                                                }
-
-                                            /* If case insensitive */
-
-                                            if ( rulestruct[b].s_nocase[z] == 1 )
-                                                {
-
-                                                    if (rulestruct[b].content_not[z] != 1 && Sagan_stristr(alter_content, rulestruct[b].s_content[z], false))
-
-                                                        {
-                                                            sagan_match++;
-                                                        }
-                                                    else
-                                                        {
-
-                                                            /* for content: ! */
-
-                                                            if ( rulestruct[b].content_not[z] == 1 && !Sagan_stristr(alter_content, rulestruct[b].s_content[z], false)) sagan_match++;
-
-                                                        }
-                                                }
-                                            else
-                                                {
-
-                                                    /* If case sensitive */
-
-                                                    if ( rulestruct[b].content_not[z] != 1 && Sagan_strstr(alter_content, rulestruct[b].s_content[z] ))
-                                                        {
-                                                            sagan_match++;
-                                                        }
-                                                    else
-                                                        {
-
-                                                            /* for content: ! */
-                                                            if ( rulestruct[b].content_not[z] == 1 && !Sagan_strstr(alter_content, rulestruct[b].s_content[z])) sagan_match++;
-
-                                                        }
-                                                }
+                                            window = Sagan_Message_Lower(SaganProcSyslog_LOCAL) + ( window - SaganProcSyslog_LOCAL->syslog_message );
                                         }
-                                }
 
-                            /* Search via PCRE */
+                                    found = Sagan_memmem(window, window_len, step->content, step->len) != NULL;
 
-                            /* Note:  We verify each "step" has succeeded before function execution.  For example,
-                             * if there is a "content",  but that has failed,  there is no point in doing the
-                             * pcre or meta_content. */
+                                    /* for content: ! */
 
-                            if ( rulestruct[b].pcre_count != 0 && sagan_match == rulestruct[b].content_count )
-                                {
+                                    match = ( found != step->negated );
+                                    break;
 
-                                    for(z=0; z<rulestruct[b].pcre_count; z++)
-                                        {
+                                /* Search via meta_content */
 
-                                            rc = pcre_exec( rulestruct[b].re_pcre[z], rulestruct[b].pcre_extra[z], SaganProcSyslog_LOCAL->syslog_message, (int)strlen(SaganProcSyslog_LOCAL->syslog_message), 0, 0, ovector, PCRE_OVECCOUNT);
+                                case(PLAN_META_CONTENT):
 
-                                            if ( rc > 0 )
-                                                {
-                                                    sagan_match++;
-                                                }
+                                    Engine_Content_Window(SaganProcSyslog_LOCAL->syslog_message, message_len,
+                                                          step->offset, step->depth, step->distance, step->within,
+                                                          step->prev_depth, &window, &window_len);
 
-                                        }  /* End of pcre if */
-                                }
-
-                            /* Search via meta_content */
+                                    match = ( Meta_Content_Search(window, window_len, b, step->index) == 1 );
+                                    break;
 
-                            if ( rulestruct[b].meta_content_count != 0 && sagan_match == rulestruct[b].content_count + rulestruct[b].pcre_count )
-                                {
+                                /* Search via PCRE */
 
-                                    for (z=0; z<rulestruct[b].meta_content_count; z++)
-                                        {
+                                case(PLAN_PCRE):
 
-                                            meta_alter_num = 0;
-
-                                            /* Meta_content: OFFSET */
-
-                                            if ( rulestruct[b].meta_offset[z] != 0 )
-                                                {
-
-                                                    if ( strlen(SaganProcSyslog_LOCAL->syslog_message) > rulestruct[b].meta_offset[z] )
-                                                        {
-
-                                                            meta_alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - rulestruct[b].meta_offset[z];
-                                                            strlcpy(meta_alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - meta_alter_num), meta_alter_num + 1);
-
-                                                        }
-                                                    else
-                                                        {
-
-                                                            meta_alter_content[0] = '\0';    /* The offset is larger than the message.  Set meta_content too NULL */
-
-                                                        }
-
-                                                }
-                                            else
-                                                {
+                                    rc = pcre_exec( step->re, step->extra, SaganProcSyslog_LOCAL->syslog_message, (int)message_len, 0, 0, ovector, PCRE_OVECCOUNT);
 
-                                                    strlcpy(meta_alter_content, SaganProcSyslog_LOCAL->syslog_message, sizeof(meta_alter_content));
+                                    match = ( rc > 0 );
+                                    break;
 
-                                                }
-
-
-                                            /* Meta_content: DEPTH */
-
-                                            if ( rulestruct[b].meta_depth[z] != 0 )
-                                                {
-
-                                                    /* We do +2 to account for alter_count[0] and whitespace at the begin of syslog message */
-
-                                                    strlcpy(meta_alter_content, meta_alter_content, rulestruct[b].meta_depth[z] + 2);
-
-                                                }
-
-                                            /* Meta_content: DISTANCE */
-
-                                            if ( rulestruct[b].meta_distance[z] != 0 )
-                                                {
-
-                                                    meta_alter_num = strlen(SaganProcSyslog_LOCAL->syslog_message) - ( rulestruct[b].meta_depth[z-1] + rulestruct[b].meta_distance[z] + 1 );
-                                                    strlcpy(meta_alter_content, SaganProcSyslog_LOCAL->syslog_message + (strlen(SaganProcSyslog_LOCAL->syslog_message) - meta_alter_num), meta_alter_num + 1);
-
-                                                    /* Meta_ontent: WITHIN */
-
-                                                    if ( rulestruct[b].meta_within[z] != 0 )
-                                                        {
-                                                            strlcpy(meta_alter_content, meta_alter_content, rulestruct[b].meta_within[z] + 1);
-
-                                                        }
-
-                                                }
-
-                                            rc = Meta_Content_Search(meta_alter_content, b, z);
-
-                                            if ( rc == 1 )
-                                                {
-                                                    sagan_match++;
-                                                }
-
-                                        }
                                 }
+                        }
 
-
-                        } /* End of content: & pcre */
+                    message_match = match;
 
                     /* if you got match */
 
-                    if ( sagan_match == rulestruct[b].pcre_count + rulestruct[b].content_count + rulestruct[b].meta_content_count )
+                    if ( match == true )
                         {
 
-                            if ( match == false )
+#ifdef HAVE_LIBLOGNORM
+                            if ( liblognorm_status == 0 && rulestruct[b].normalize == 1 )
                                 {
+                                    /* Set that normalization has been tried work isn't repeated */
+
+                                    liblognorm_status = -1;
+
+                                    json_normalize = Normalize_Liblognorm(SaganProcSyslog_LOCAL->syslog_message, &SaganNormalizeLiblognorm);
+
+                                    if ( SaganNormalizeLiblognorm.ip_src[0] != '0'  ||
+                                            SaganNormalizeLiblognorm.ip_dst[0] != '0'  ||
+                                            SaganNormalizeLiblognorm.src_port != 0  ||
+                                            SaganNormalizeLiblognorm.dst_port != 0  ||
+                                            SaganNormalizeLiblognorm.hash_sha1[0] != '\0'  ||
+                                            SaganNormalizeLiblognorm.hash_sha256[0] != '\0'  ||
+                                            SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
 
-#ifdef HAVE_LIBLOGNORM
-                                    if ( liblognorm_status == 0 && rulestruct[b].normalize == 1 )
                                         {
-                                            /* Set that normalization has been tried work isn't repeated */
+                                            liblognorm_status = 1;
+                                        }
 
-                                            liblognorm_status = -1;
+                                    /* These are _only_ set here */
 
-                                            json_normalize = Normalize_Liblognorm(SaganProcSyslog_LOCAL->syslog_message, &SaganNormalizeLiblognorm);
+                                    if ( SaganNormalizeLiblognorm.username[0] != '\0' )
+                                        {
 
-                                            if ( SaganNormalizeLiblognorm.ip_src[0] != '0'  ||
-                                                    SaganNormalizeLiblognorm.ip_dst[0] != '0'  ||
-                                                    SaganNormalizeLiblognorm.src_port != 0  ||
-                                                    SaganNormalizeLiblognorm.dst_port != 0  ||
-                                                    SaganNormalizeLiblognorm.hash_sha1[0] != '\0'  ||
-                                                    SaganNormalizeLiblognorm.hash_sha256[0] != '\0'  ||
-                                                    SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
+                                            liblognorm_status = 1;
+                                            normalize_username = SaganNormalizeLiblognorm.username;
+                                        }
 
-                                                {
-                                                    liblognorm_status = 1;
-                                                }
+                                    if ( config->selector_flag && SaganNormalizeLiblognorm.selector[0] != '\0' )
+                                        {
+                                            liblognorm_status = 1;
+                                            pnormalize_selector = SaganNormalizeLiblognorm.username;
+                                        }
 
-                                            /* These are _only_ set here */
+                                    if ( SaganNormalizeLiblognorm.http_uri[0] != '\0' )
+                                        {
+                                            liblognorm_status = 1;
+                                            normalize_http_uri = SaganNormalizeLiblognorm.http_uri;
+                                        }
 
-                                            if ( SaganNormalizeLiblognorm.username[0] != '\0' )
-                                                {
+                                    if ( SaganNormalizeLiblognorm.filename[0] != '\0' )
+                                        {
+                                            liblognorm_status = 1;
+                                            normalize_filename = SaganNormalizeLiblognorm.filename;
+                                        }
+                                }
 
-                                                    liblognorm_status = 1;
-                                                    normalize_username = SaganNormalizeLiblognorm.username;
-                                                }
+                            if ( liblognorm_status == 1  && rulestruct[b].normalize == 1 )
+                                {
+                                    if ( SaganNormalizeLiblognorm.ip_src[0] != '0')
+                                        {
+                                            ip_src_flag = true;
+                                            ip_src = SaganNormalizeLiblognorm.ip_src;
 
-                                            if ( config->selector_flag && SaganNormalizeLiblognorm.selector[0] != '\0' )
+                                            if ( !strcmp(ip_src, "127.0.0.1") ||
+                                                    !strcmp(ip_src, "::1" ) ||
+                                                    !strcmp(ip_src, "::ffff:127.0.0.1" ) )
                                                 {
-                                                    liblognorm_status = 1;
-                                                    pnormalize_selector = SaganNormalizeLiblognorm.username;
+                                                    ip_src = SaganProcSyslog_LOCAL->syslog_host;
+                                                    ip_src_flag = false;
                                                 }
-
-                                            if ( SaganNormalizeLiblognorm.http_uri[0] != '\0' )
+                                            else
                                                 {
-                                                    liblognorm_status = 1;
-                                                    normalize_http_uri = SaganNormalizeLiblognorm.http_uri;
+                                                    IP2Bit(ip_src, ip_src_bits);
                                                 }
 
-                                            if ( SaganNormalizeLiblognorm.filename[0] != '\0' )
-                                                {
-                                                    liblognorm_status = 1;
-                                                    normalize_filename = SaganNormalizeLiblognorm.filename;
-                                                }
                                         }
 
-                                    if ( liblognorm_status == 1  && rulestruct[b].normalize == 1 )
-                                        {
-                                            if ( SaganNormalizeLiblognorm.ip_src[0] != '0')
-                                                {
-                                                    ip_src_flag = true;
-                                                    ip_src = SaganNormalizeLiblognorm.ip_src;
-
-                                                    if ( !strcmp(ip_src, "127.0.0.1") ||
-                                                            !strcmp(ip_src, "::1" ) ||
-                                                            !strcmp(ip_src, "::ffff:127.0.0.1" ) )
-                                                        {
-                                                            ip_src = SaganProcSyslog_LOCAL->syslog_host;
-                                                            ip_src_flag = false;
-                                                        }
-                                                    else
-                                                        {
-                                                            IP2Bit(ip_src, ip_src_bits);
-                                                        }
-
-                                                }
 
+                                    if ( SaganNormalizeLiblognorm.ip_dst[0] != '0' )
+                                        {
+                                            ip_dst_flag = true;
+                                            ip_dst = SaganNormalizeLiblognorm.ip_dst;
 
-                                            if ( SaganNormalizeLiblognorm.ip_dst[0] != '0' )
+                                            if ( !strcmp(ip_dst, "127.0.0.1") ||
+                                                    !strcmp(ip_dst, "::1" ) ||
+                                                    !strcmp(ip_dst, "::ffff:127.0.0.1" ) )
                                                 {
-                                                    ip_dst_flag = true;
-                                                    ip_dst = SaganNormalizeLiblognorm.ip_dst;
-
-                                                    if ( !strcmp(ip_dst, "127.0.0.1") ||
-                                                            !strcmp(ip_dst, "::1" ) ||
-                                                            !strcmp(ip_dst, "::ffff:127.0.0.1" ) )
-                                                        {
-                                                            ip_dst = SaganProcSyslog_LOCAL->syslog_host;
-                                                            ip_dst_flag = false;
-                                                        }
-                                                    else
-                                                        {
-                                                            IP2Bit(ip_dst, ip_dst_bits);
-                                                        }
+                                                    ip_dst = SaganProcSyslog_LOCAL->syslog_host;
+                                                    ip_dst_flag = false;
                                                 }
-
-                                            if ( SaganNormalizeLiblognorm.src_port != 0 )
+                                            else
                                                 {
-                                                    ip_srcport_u32 = SaganNormalizeLiblognorm.src_port;
+                                                    IP2Bit(ip_dst, ip_dst_bits);
                                                 }
+                                        }
 
+                                    if ( SaganNormalizeLiblognorm.src_port != 0 )
+                                        {
+                                            ip_srcport_u32 = SaganNormalizeLiblognorm.src_port;
+                                        }
 
-                                            if ( SaganNormalizeLiblognorm.dst_port != 0 )
-                                                {
-                                                    ip_dstport_u32 = SaganNormalizeLiblognorm.dst_port;
-                                                }
 
-                                            if ( SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
-                                                {
-                                                    md5_hash = SaganNormalizeLiblognorm.hash_md5;
-                                                }
+                                    if ( SaganNormalizeLiblognorm.dst_port != 0 )
+                                        {
+                                            ip_dstport_u32 = SaganNormalizeLiblognorm.dst_port;
+                                        }
 
-                                            if ( SaganNormalizeLiblognorm.hash_sha1[0] != '\0' )
-                                                {
-                                                    sha1_hash = SaganNormalizeLiblognorm.hash_sha1;
-                                                }
+                                    if ( SaganNormalizeLiblognorm.hash_md5[0] != '\0' )
+                                        {
+                                            md5_hash = SaganNormalizeLiblognorm.hash_md5;
+                                        }
 
-                                            if ( SaganNormalizeLiblognorm.hash_sha256[0] != '\0' )
-                                                {
-                                                    sha256_hash = SaganNormalizeLiblognorm.hash_sha256;
-                                                }
+                                    if ( SaganNormalizeLiblognorm.hash_sha1[0] != '\0' )
+                                        {
+                                            sha1_hash = SaganNormalizeLiblognorm.hash_sha1;
+                                        }
 
+                                    if ( SaganNormalizeLiblognorm.hash_sha256[0] != '\0' )
+                                        {
+                                            sha256_hash = SaganNormalizeLiblognorm.hash_sha256;
                                         }
+
+                                }
 #endif
 
 
-                                    /* Normalization should always over ride parse_src_ip/parse_dst_ip/parse_port,
-                                     * _unless_ liblognorm fails and both are in a rule or liblognorm failed to get src or dst */
+                            /* Normalization should always over ride parse_src_ip/parse_dst_ip/parse_port,
+                             * _unless_ liblognorm fails and both are in a rule or liblognorm failed to get src or dst */
 
-                                    /* parse_src_ip: {position} - Parse_IP build a cache table for IPs, ports, etc.  This way,
-                                    we only parse the syslog string one time regardless of the rule options! */
+                            /* parse_src_ip: {position} - Parse_Extract builds a cache table for IPs, ports, etc.  This way,
+                            we only parse the syslog string one time regardless of the rule options or how many
+                            rules need it! */
 
-                                    if ( rulestruct[b].s_find_src_ip == 1 ||
-                                            rulestruct[b].s_find_src_ip == 1 ||
-                                            rulestruct[b].blacklist_ipaddr_all == 1 ||
-                                            rulestruct[b].s_find_proto == 1 ||
+                            if ( rulestruct[b].s_find_src_ip == 1 ||
+                                    rulestruct[b].s_find_dst_ip == 1 ||
+                                    rulestruct[b].blacklist_ipaddr_all == 1 ||
+                                    rulestruct[b].s_find_proto == 1 ||
 #ifdef WITH_BLUEDOT
-                                            rulestruct[b].bluedot_ipaddr_type == 4 ||
+                                    rulestruct[b].bluedot_ipaddr_type == 4 ||
 #endif
-                                            rulestruct[b].brointel_ipaddr_all == 1 )
-                                        {
+                                    rulestruct[b].brointel_ipaddr_all == 1 )
+                                {
 
-                                            lookup_cache_size = Parse_IP(SaganProcSyslog_LOCAL->syslog_message, lookup_cache );
+                                    lookup_cache_size = Engine_Parse(SaganProcSyslog_LOCAL)->ip_count;
 
-                                        }
+                                }
+
+                            if ( ip_src_flag == false && rulestruct[b].s_find_src_ip == true )
+                                {
 
-                                    if ( ip_src_flag == false && rulestruct[b].s_find_src_ip == true )
+                                    if ( lookup_cache[rulestruct[b].s_find_src_pos-1].status == 1 )
                                         {
 
-                                            if ( lookup_cache[rulestruct[b].s_find_src_pos-1].status == 1 )
-                                                {
 
+                                            memcpy(parse_ip_src, lookup_cache[rulestruct[b].s_find_src_pos-1].ip, MAXIP );
+                                            memcpy(ip_src_bits, lookup_cache[rulestruct[b].s_find_src_pos-1].ip_bits, MAXIPBIT);
 
-                                                    memcpy(parse_ip_src, lookup_cache[rulestruct[b].s_find_src_pos-1].ip, MAXIP );
-                                                    memcpy(ip_src_bits, lookup_cache[rulestruct[b].s_find_src_pos-1].ip_bits, MAXIPBIT);
+                                            ip_src = parse_ip_src;
 
-                                                    ip_src = parse_ip_src;
+                                            if ( !strcmp(ip_src, "127.0.0.1") ||
+                                                    !strcmp(ip_src, "::1" ) ||
+                                                    !strcmp(ip_src, "::ffff:127.0.0.1" ) )
+                                                {
 
-                                                    if ( !strcmp(ip_src, "127.0.0.1") ||
-                                                            !strcmp(ip_src, "::1" ) ||
-                                                            !strcmp(ip_src, "::ffff:127.0.0.1" ) )
-                                                        {
+                                                    ip_src = SaganProcSyslog_LOCAL->syslog_host;
+                                                    ip_src_flag = false;
 
-                                                            ip_src = SaganProcSyslog_LOCAL->syslog_host;
-                                                            ip_src_flag = false;
+                                                }
 
-                                                        }
+                                            ip_srcport_u32 = lookup_cache[rulestruct[b].s_find_src_pos-1].port;
+                                            proto = parse_cache.proto;
+                                            ip_src_flag = true;
 
-                                                    ip_srcport_u32 = lookup_cache[rulestruct[b].s_find_src_pos-1].port;
-                                                    proto = lookup_cache[0].proto;
-                                                    ip_src_flag = true;
+                                        }
 
-                                                }
+                                }
 
-                                        }
+                            /* parse_dst_ip: {postion} */
 
-                                    /* parse_dst_ip: {postion} */
+                            if ( ip_dst_flag == false && rulestruct[b].s_find_dst_ip == true )
+                                {
 
-                                    if ( ip_dst_flag == false && rulestruct[b].s_find_dst_ip == true )
+                                    if ( lookup_cache[rulestruct[b].s_find_dst_pos-1].status == 1 )
                                         {
 
-                                            if ( lookup_cache[rulestruct[b].s_find_dst_pos-1].status == 1 )
-                                                {
 
+                                            memcpy(parse_ip_dst, lookup_cache[rulestruct[b].s_find_dst_pos-1].ip, MAXIP );
+                                            memcpy(ip_dst_bits, lookup_cache[rulestruct[b].s_find_dst_pos-1].ip_bits, MAXIPBIT);
 
-                                                    memcpy(parse_ip_dst, lookup_cache[rulestruct[b].s_find_dst_pos-1].ip, MAXIP );
-                                                    memcpy(ip_dst_bits, lookup_cache[rulestruct[b].s_find_src_pos-1].ip_bits, MAXIPBIT);
+                                            ip_dst = parse_ip_dst;
 
-                                                    ip_dst = parse_ip_dst;
+                                            if ( !strcmp(ip_dst, "127.0.0.1") ||
+                                                    !strcmp(ip_dst, "::1" ) ||
+                                                    !strcmp(ip_dst, "::ffff:127.0.0.1" ) )
+                                                {
 
-                                                    if ( !strcmp(ip_dst, "127.0.0.1") ||
-                                                            !strcmp(ip_dst, "::1" ) ||
-                                                            !strcmp(ip_dst, "::ffff:127.0.0.1" ) )
-                                                        {
+                                                    ip_dst = SaganProcSyslog_LOCAL->syslog_host;
+                                                    ip_dst_flag = false;
 
-                                                            ip_dst = SaganProcSyslog_LOCAL->syslog_host;
-                                                            ip_dst_flag = false;
+                                                }
 
-                                                        }
+                                            ip_dstport_u32 = lookup_cache[rulestruct[b].s_find_dst_pos-1].port;
+                                            proto = parse_cache.proto;
+                                            ip_dst_flag = true;
 
-                                                    ip_dstport_u32 = lookup_cache[rulestruct[b].s_find_dst_pos-1].port;
-                                                    proto = lookup_cache[0].proto;
-                                                    ip_dst_flag = true;
+                                        }
 
-                                                }
+                                }
 
-                                        }
+                            /* parse_hash: md5 */
 
-                                    /* parse_hash: md5 */
+                            if ( rulestruct[b].s_find_hash_type == PARSE_HASH_MD5 )
+                                {
+                                    md5_hash = Engine_Parse(SaganProcSyslog_LOCAL)->md5;
+                                }
 
-                                    if ( parse_md5_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_MD5 )
-                                        {
-                                            Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_MD5, parse_md5_hash, sizeof(parse_md5_hash));
-                                            md5_hash = parse_md5_hash;
-                                        }
+                            else if ( rulestruct[b].s_find_hash_type == PARSE_HASH_SHA1 )
+                                {
+                                    sha1_hash = Engine_Parse(SaganProcSyslog_LOCAL)->sha1;
+                                }
 
-                                    else if ( parse_sha1_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_SHA1 )
-                                        {
-                                            Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA1, parse_sha256_hash, sizeof(parse_sha1_hash));
-                                            sha1_hash = parse_sha1_hash;
-                                        }
+                            else if ( rulestruct[b].s_find_hash_type == PARSE_HASH_SHA256 )
+                                {
+                                    sha256_hash = Engine_Parse(SaganProcSyslog_LOCAL)->sha256;
+                                }
 
-                                    else if ( parse_sha256_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_SHA256 )
-                                        {
-                                            Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA256, parse_sha256_hash, sizeof(parse_sha256_hash));
-                                            sha256_hash = parse_sha256_hash;
-                                        }
+                            /*  DEBUG
+                            else if ( sha256_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_ALL )
+                                {
+                            Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA256, sha256_hash, sizeof(sha256_hash));
+                                    sha256_hash = parse_sha256_hash;
+                                              }
+                                              */
 
-                                    /*  DEBUG
-                                    else if ( sha256_hash[0] == '\0' && rulestruct[b].s_find_hash_type == PARSE_HASH_ALL )
-                                        {
-                                    Parse_Hash(SaganProcSyslog_LOCAL->syslog_message, PARSE_HASH_SHA256, sha256_hash, sizeof(sha256_hash));
-                                            sha256_hash = parse_sha256_hash;
-                                                      }
-                                                      */
 
+                            /* If the rule calls for proto searching,  we do it now */
 
-                                    /* If the rule calls for proto searching,  we do it now */
+                            if ( rulestruct[b].s_find_proto_program == true )
+                                {
+                                    proto = Engine_Parse_Proto_Program(SaganProcSyslog_LOCAL);
+                                }
 
-                                    if ( rulestruct[b].s_find_proto_program == true )
-                                        {
-                                            proto = Parse_Proto_Program(SaganProcSyslog_LOCAL->syslog_program);
-                                        }
 
+                            /* If proto is not searched or has failed,  default to whatever the rule told us to
+                               use */
 
-                                    /* If proto is not searched or has failed,  default to whatever the rule told us to
-                                       use */
+                            if ( ip_src_flag == false )
+                                {
+                                    ip_src = SaganProcSyslog_LOCAL->syslog_host;
+                                    IP2Bit(ip_src, ip_src_bits);
+                                }
 
-                                    if ( ip_src_flag == false )
-                                        {
-                                            ip_src = SaganProcSyslog_LOCAL->syslog_host;
-                                            IP2Bit(ip_src, ip_src_bits);
-                                        }
+                            if ( ip_dst_flag == false )
+                                {
+                                    ip_dst = SaganProcSyslog_LOCAL->syslog_host;
+                                    IP2Bit(ip_dst, ip_dst_bits);
+                                }
 
-                                    if ( ip_dst_flag == false )
-                                        {
-                                            ip_dst = SaganProcSyslog_LOCAL->syslog_host;
-                                            IP2Bit(ip_dst, ip_dst_bits);
-                                        }
+                            /* No source port was normalized, Use the rules default */
 
-                                    /* No source port was normalized, Use the rules default */
+                            if ( ip_srcport_u32 == 0 )
+                                {
+                                    ip_srcport_u32=rulestruct[b].default_src_port;
+                                }
 
-                                    if ( ip_srcport_u32 == 0 )
-                                        {
-                                            ip_srcport_u32=rulestruct[b].default_src_port;
-                                        }
+                            /* No destination port was normalzied. Use the rules default */
 
-                                    /* No destination port was normalzied. Use the rules default */
+                            if ( ip_dstport_u32 == 0 )
+                                {
+                                    ip_dstport_u32=rulestruct[b].default_dst_port;
+                                }
 
-                                    if ( ip_dstport_u32 == 0 )
-                                        {
-                                            ip_dstport_u32=rulestruct[b].default_dst_port;
-                                        }
 
+                            /* No protocol was normalized.  Use the rules default */
 
-                                    /* No protocol was normalized.  Use the rules default */
+                            if ( proto == 0 )
+                                {
+                                    proto = rulestruct[b].default_proto;
+                                }
 
-                                    if ( proto == 0 )
-                                        {
-                                            proto = rulestruct[b].default_proto;
-                                        }
+                            strlcpy(s_msg, rulestruct[b].s_msg, sizeof(s_msg));
 
-                                    strlcpy(s_msg, rulestruct[b].s_msg, sizeof(s_msg));
+                            /* The rest of the plan needs the addresses,  ports,  etc. we parsed above */
 
-                                    /* Check for flow of rule - has_flow is set as rule loading.  It 1, then
-                                    the rule has some sort of flow.  It 0,  rule is set any:any/any:any */
+                            for ( z = rules_index->hot_plan_message_count[b]; z < rules_index->hot_plan_count[b] && match == true; z++ )
+                                {
 
-                                    if ( rulestruct[b].has_flow == 1 )
+                                    switch ( rulestruct[b].plan[z].type )
                                         {
 
+                                        case(PLAN_FLOW):
+
                                             check_flow_return = Check_Flow( b, proto, ip_src_bits, ip_srcport_u32, ip_dst_bits, ip_dstport_u32);
 
                                             if(check_flow_return == false)
@@ -858,14 +870,11 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
                                             counters->follow_flow_total++;
                                             pthread_mutex_unlock(&CountersFlowFlowTotal);
 
-                                        }
+                                            match = check_flow_return;
 
-                                    /****************************************************************************
-                                     * Xbit - ISSET || ISNOTSET
-                                     ****************************************************************************/
+                                            break;
 
-                                    if ( rulestruct[b].xbit_flag )
-                                        {
+                                        case(PLAN_XBIT):
 
                                             if ( rulestruct[b].xbit_condition_count )
                                                 {
@@ -877,24 +886,28 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
                                                     xbit_count_return = Xbit_Count(b, ip_src, ip_dst, pnormalize_selector);
                                                 }
 
-                                        }
+                                            match = ( rulestruct[b].xbit_set_count && rulestruct[b].xbit_condition_count == 0 ) ||
+                                                    ( rulestruct[b].xbit_condition_count && xbit_return );
 
+                                            if ( rulestruct[b].xbit_count_flag && xbit_count_return == false )
+                                                {
+                                                    match = false;
+                                                }
 
-                                    /****************************************************************************
-                                     * Country code
-                                     ****************************************************************************/
+                                            break;
 
 #ifdef HAVE_LIBMAXMINDDB
+                                        case(PLAN_GEOIP2):
 
-                                    if ( rulestruct[b].geoip2_flag )
-                                        {
+                                            geoip2_return = false;
+                                            geoip2_isset = false;
 
                                             if ( ip_src_flag == true && rulestruct[b].geoip2_src_or_dst == 1 )
                                                 {
                                                     geoip2_return = GeoIP2_Lookup_Country(ip_src, ip_src_bits, b );
                                                 }
 
-                                            else if ( ip_dst_flag == true && rulestruct[b].geoip2_src_or_dst == 1 )
+                                            else if ( ip_dst_flag == true && rulestruct[b].geoip2_src_or_dst == 2 )
                                                 {
                                                     geoip2_return = GeoIP2_Lookup_Country(ip_dst, ip_dst_bits, b );
                                                 }
@@ -943,190 +956,183 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
                                                                 }
                                                         }
                                                 }
-                                        }
-
-#endif
-
-                                    /****************************************************************************
-                                     * Time based alerting
-                                     ****************************************************************************/
-
-                                    if ( rulestruct[b].alert_time_flag )
-                                        {
-
-                                            alert_time_trigger = false;
 
-                                            if ( Check_Time(b) )
-                                                {
-                                                    alert_time_trigger = true;
-                                                }
-                                        }
+                                            match = geoip2_isset;
 
-                                    /****************************************************************************
-                                     * Blacklist
-                                     ****************************************************************************/
+                                            break;
+#endif
 
-                                    if ( rulestruct[b].blacklist_flag )
-                                        {
+                                        case(PLAN_BLACKLIST):
 
                                             blacklist_results = false;
 
                                             if ( rulestruct[b].blacklist_ipaddr_src && ip_src_flag )
                                                 {
-                                                    blacklist_results = Sagan_Blacklist_IPADDR( ip_src_bits );
+                                                    blacklist_results = Engine_Blacklist_IPADDR( ip_src_bits );
                                                 }
 
                                             if ( blacklist_results == false && rulestruct[b].blacklist_ipaddr_dst && ip_dst_flag )
                                                 {
-                                                    blacklist_results = Sagan_Blacklist_IPADDR( ip_dst_bits );
+                                                    blacklist_results = Engine_Blacklist_IPADDR( ip_dst_bits );
                                                 }
 
                                             if ( blacklist_results == false && rulestruct[b].blacklist_ipaddr_all )
                                                 {
-                                                    blacklist_results = Sagan_Blacklist_IPADDR_All(SaganProcSyslog_LOCAL->syslog_message, lookup_cache, lookup_cache_size);
+                                                    blacklist_results = Engine_Blacklist_IPADDR_All(SaganProcSyslog_LOCAL, lookup_cache, lookup_cache_size);
                                                 }
 
                                             if ( blacklist_results == false && rulestruct[b].blacklist_ipaddr_both && ip_src_flag && ip_dst_flag )
                                                 {
-                                                    if ( Sagan_Blacklist_IPADDR( ip_src_bits ) || Sagan_Blacklist_IPADDR( ip_dst_bits ) )
+                                                    if ( Engine_Blacklist_IPADDR( ip_src_bits ) || Engine_Blacklist_IPADDR( ip_dst_bits ) )
                                                         {
                                                             blacklist_results = true;
                                                         }
                                                 }
-                                        }
 
-#ifdef WITH_BLUEDOT
+                                            match = blacklist_results;
 
-                                    if ( config->bluedot_flag )
-                                        {
-                                            if ( rulestruct[b].bluedot_ipaddr_type )
-                                                {
+                                            break;
 
-                                                    bluedot_results = 0;
+#ifdef WITH_BLUEDOT
+                                        case(PLAN_BLUEDOT):
 
-                                                    /* 1 == src,  2 == dst,  3 == both,  4 == all */
+                                            bluedot_ip_flag = false;
+                                            bluedot_hash_flag = false;
+                                            bluedot_url_flag = false;
+                                            bluedot_filename_flag = false;
 
-                                                    if ( rulestruct[b].bluedot_ipaddr_type == 1 && ip_src_flag )
+                                            if ( config->bluedot_flag )
+                                                {
+                                                    if ( rulestruct[b].bluedot_ipaddr_type )
                                                         {
-                                                            bluedot_results = Sagan_Bluedot_Lookup(ip_src, BLUEDOT_LOOKUP_IP, b, ip_src_bits);
-                                                            bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
-                                                        }
 
-                                                    if ( rulestruct[b].bluedot_ipaddr_type == 2 && ip_dst_flag )
-                                                        {
-                                                            bluedot_results = Sagan_Bluedot_Lookup(ip_dst, BLUEDOT_LOOKUP_IP, b, ip_dst_bits);
-                                                            bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
-                                                        }
+                                                            bluedot_results = 0;
 
-                                                    if ( rulestruct[b].bluedot_ipaddr_type == 3 && ip_src_flag && ip_dst_flag )
-                                                        {
+                                                            /* 1 == src,  2 == dst,  3 == both,  4 == all */
 
-                                                            bluedot_results = Sagan_Bluedot_Lookup(ip_src, BLUEDOT_LOOKUP_IP, b, ip_src_bits );
-                                                            bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+                                                            if ( rulestruct[b].bluedot_ipaddr_type == 1 && ip_src_flag )
+                                                                {
+                                                                    bluedot_results = Engine_Bluedot_Lookup(ip_src, BLUEDOT_LOOKUP_IP, b, ip_src_bits);
+                                                                    bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+                                                                }
 
-                                                            /* If the source isn't found,  then check the dst */
+                                                            if ( rulestruct[b].bluedot_ipaddr_type == 2 && ip_dst_flag )
+                                                                {
+                                                                    bluedot_results = Engine_Bluedot_Lookup(ip_dst, BLUEDOT_LOOKUP_IP, b, ip_dst_bits);
+                                                                    bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+                                                                }
 
-                                                            if ( bluedot_ip_flag != 0 )
+                                                            if ( rulestruct[b].bluedot_ipaddr_type == 3 && ip_src_flag && ip_dst_flag )
                                                                 {
-                                                                    bluedot_results = Sagan_Bluedot_Lookup(ip_dst, BLUEDOT_LOOKUP_IP, b, ip_dst_bits);
+
+                                                                    bluedot_results = Engine_Bluedot_Lookup(ip_src, BLUEDOT_LOOKUP_IP, b, ip_src_bits );
                                                                     bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+
+                                                                    /* If the source isn't found,  then check the dst */
+
+                                                                    if ( bluedot_ip_flag != 0 )
+                                                                        {
+                                                                            bluedot_results = Engine_Bluedot_Lookup(ip_dst, BLUEDOT_LOOKUP_IP, b, ip_dst_bits);
+                                                                            bluedot_ip_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_IP);
+                                                                        }
+
                                                                 }
 
-                                                        }
+                                                            if ( lookup_cache_size > 0 && rulestruct[b].bluedot_ipaddr_type == 4 )
+                                                                {
 
-                                                    if ( lookup_cache_size > 0 && rulestruct[b].bluedot_ipaddr_type == 4 )
-                                                        {
+                                                                    bluedot_ip_flag = Sagan_Bluedot_IP_Lookup_All(SaganProcSyslog_LOCAL->syslog_message, b, lookup_cache, lookup_cache_size );
 
-                                                            bluedot_ip_flag = Sagan_Bluedot_IP_Lookup_All(SaganProcSyslog_LOCAL->syslog_message, b, lookup_cache, lookup_cache_size );
+                                                                }
 
                                                         }
 
-                                                }
 
+                                                    if ( rulestruct[b].bluedot_file_hash && ( md5_hash[0] != '\0' ||
+                                                            sha256_hash[0] != '\0' || sha256_hash[0] != '\0') )
+                                                        {
+
+                                                            if ( md5_hash[0] != '\0')
+                                                                {
 
-                                            if ( rulestruct[b].bluedot_file_hash && ( md5_hash[0] != '\0' ||
-                                                    sha256_hash[0] != '\0' || sha256_hash[0] != '\0') )
-                                                {
+                                                                    bluedot_results = Engine_Bluedot_Lookup( md5_hash, BLUEDOT_LOOKUP_HASH, b, NULL);
+                                                                    bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
 
-                                                    if ( md5_hash[0] != '\0')
-                                                        {
+                                                                }
 
-                                                            bluedot_results = Sagan_Bluedot_Lookup( md5_hash, BLUEDOT_LOOKUP_HASH, b, NULL);
-                                                            bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
+                                                            if ( sha256_hash[0] != '\0' )
+                                                                {
 
-                                                        }
+                                                                    bluedot_results = Engine_Bluedot_Lookup( sha256_hash, BLUEDOT_LOOKUP_HASH, b, NULL);
+                                                                    bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
 
-                                                    if ( sha256_hash[0] != '\0' )
-                                                        {
+                                                                }
+
+                                                            if ( sha256_hash[0] != '\0')
+                                                                {
+
+                                                                    bluedot_results = Engine_Bluedot_Lookup( sha256_hash, BLUEDOT_LOOKUP_HASH, b, NULL);
+                                                                    bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
 
-                                                            bluedot_results = Sagan_Bluedot_Lookup( sha256_hash, BLUEDOT_LOOKUP_HASH, b, NULL);
-                                                            bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
+                                                                }
 
                                                         }
 
-                                                    if ( sha256_hash[0] != '\0')
+                                                    if ( rulestruct[b].bluedot_url && normalize_http_uri != NULL )
                                                         {
 
-                                                            bluedot_results = Sagan_Bluedot_Lookup( sha256_hash, BLUEDOT_LOOKUP_HASH, b, NULL);
-                                                            bluedot_hash_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_HASH);
+                                                            bluedot_results = Engine_Bluedot_Lookup( normalize_http_uri, BLUEDOT_LOOKUP_URL, b, NULL);
+                                                            bluedot_url_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_URL);
 
                                                         }
 
-                                                }
+                                                    if ( rulestruct[b].bluedot_filename && normalize_filename != NULL )
+                                                        {
 
-                                            if ( rulestruct[b].bluedot_url && normalize_http_uri != NULL )
-                                                {
+                                                            bluedot_results = Engine_Bluedot_Lookup( normalize_filename, BLUEDOT_LOOKUP_FILENAME, b, NULL);
+                                                            bluedot_filename_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_FILENAME);
 
-                                                    bluedot_results = Sagan_Bluedot_Lookup( normalize_http_uri, BLUEDOT_LOOKUP_URL, b, NULL);
-                                                    bluedot_url_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_URL);
+                                                        }
 
-                                                }
+                                                    /* Do cleanup at the end in case any "hits" above refresh the cache.  This why we don't
+                                                     * "delete" an entry only to re-add it! */
 
-                                            if ( rulestruct[b].bluedot_filename && normalize_filename != NULL )
-                                                {
+                                                    Sagan_Bluedot_Check_Cache_Time();
 
-                                                    bluedot_results = Sagan_Bluedot_Lookup( normalize_filename, BLUEDOT_LOOKUP_FILENAME, b, NULL);
-                                                    bluedot_filename_flag = Sagan_Bluedot_Cat_Compare( bluedot_results, b, BLUEDOT_LOOKUP_FILENAME);
 
                                                 }
 
-                                            /* Do cleanup at the end in case any "hits" above refresh the cache.  This why we don't
-                                             * "delete" an entry only to re-add it! */
-
-                                            Sagan_Bluedot_Check_Cache_Time();
+                                            match = config->bluedot_flag == false ||
+                                                    ( ( rulestruct[b].bluedot_file_hash == false || bluedot_hash_flag == true ) &&
+                                                      ( rulestruct[b].bluedot_filename == false || bluedot_filename_flag == true ) &&
+                                                      ( rulestruct[b].bluedot_url == false || bluedot_url_flag == true ) &&
+                                                      ( rulestruct[b].bluedot_ipaddr_type == 0 || bluedot_ip_flag == true ) );
 
-
-                                        }
+                                            break;
 #endif
 
-
-                                    /****************************************************************************
-                                    * Bro Intel
-                                    ****************************************************************************/
-
-                                    if ( rulestruct[b].brointel_flag )
-                                        {
+                                        case(PLAN_BROINTEL):
 
                                             brointel_results = false;
 
                                             if ( rulestruct[b].brointel_ipaddr_src && ip_src_flag )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_IPADDR( ip_src_bits, ip_src );
+                                                    brointel_results = Engine_BroIntel_IPADDR( ip_src_bits, ip_src );
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_ipaddr_dst && ip_dst_flag )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_IPADDR( ip_dst_bits, ip_dst );
+                                                    brointel_results = Engine_BroIntel_IPADDR( ip_dst_bits, ip_dst );
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_ipaddr_all )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_IPADDR_All ( SaganProcSyslog_LOCAL->syslog_message, lookup_cache, MAX_PARSE_IP);
+                                                    brointel_results = Engine_BroIntel_IPADDR_All( SaganProcSyslog_LOCAL, lookup_cache );
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_ipaddr_both && ip_src_flag && ip_dst_flag )
                                                 {
-                                                    if ( Sagan_BroIntel_IPADDR( ip_src_bits, ip_src ) || Sagan_BroIntel_IPADDR( ip_dst_bits, ip_dst ) )
+                                                    if ( Engine_BroIntel_IPADDR( ip_src_bits, ip_src ) || Engine_BroIntel_IPADDR( ip_dst_bits, ip_dst ) )
                                                         {
                                                             brointel_results = true;
                                                         }
@@ -1134,275 +1140,228 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
 
                                             if ( brointel_results == false && rulestruct[b].brointel_domain )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_DOMAIN(SaganProcSyslog_LOCAL->syslog_message);
+                                                    brointel_results = Engine_BroIntel_Message(Sagan_BroIntel_DOMAIN, SaganProcSyslog_LOCAL);
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_file_hash )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_FILE_HASH(SaganProcSyslog_LOCAL->syslog_message);
+                                                    brointel_results = Engine_BroIntel_Message(Sagan_BroIntel_FILE_HASH, SaganProcSyslog_LOCAL);
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_url )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_URL(SaganProcSyslog_LOCAL->syslog_message);
+                                                    brointel_results = Engine_BroIntel_Message(Sagan_BroIntel_URL, SaganProcSyslog_LOCAL);
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_software )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_SOFTWARE(SaganProcSyslog_LOCAL->syslog_message);
+                                                    brointel_results = Engine_BroIntel_Message(Sagan_BroIntel_SOFTWARE, SaganProcSyslog_LOCAL);
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_user_name )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_USER_NAME(SaganProcSyslog_LOCAL->syslog_message);
+                                                    brointel_results = Engine_BroIntel_Message(Sagan_BroIntel_USER_NAME, SaganProcSyslog_LOCAL);
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_file_name )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_FILE_NAME(SaganProcSyslog_LOCAL->syslog_message);
+                                                    brointel_results = Engine_BroIntel_Message(Sagan_BroIntel_FILE_NAME, SaganProcSyslog_LOCAL);
                                                 }
 
                                             if ( brointel_results == false && rulestruct[b].brointel_cert_hash )
                                                 {
-                                                    brointel_results = Sagan_BroIntel_CERT_HASH(SaganProcSyslog_LOCAL->syslog_message);
+                                                    brointel_results = Engine_BroIntel_Message(Sagan_BroIntel_CERT_HASH, SaganProcSyslog_LOCAL);
                                                 }
 
-                                        }
-
-                                    /****************************************************************************/
-                                    /* Populate the SaganEvent array with the information needed.  This info    */
-                                    /* will be passed to the threads.  No need to populate it _if_ we're in a   */
-                                    /* threshold state.                                                         */
-                                    /****************************************************************************/
-
-                                    if ( check_flow_return == true )
-                                        {
-
-                                            /* DEBUG: Had rulestruct[b].xbit_flag */
-
-                                            if ( rulestruct[b].xbit_flag == false ||
-                                                    ( rulestruct[b].xbit_set_count && rulestruct[b].xbit_condition_count == 0 ) ||
-                                                    ( rulestruct[b].xbit_set_count && rulestruct[b].xbit_condition_count && xbit_return ) ||
-                                                    ( rulestruct[b].xbit_set_count == false && rulestruct[b].xbit_condition_count && xbit_return ))
-                                                {
-
-                                                    if ( rulestruct[b].xbit_count_flag == false ||
-                                                            xbit_count_return == true )
-                                                        {
-
-                                                            if ( rulestruct[b].alert_time_flag == false || alert_time_trigger == true )
-                                                                {
-
-#ifdef HAVE_LIBMAXMINDDB
-                                                                    if ( rulestruct[b].geoip2_flag == false || geoip2_isset == true )
-                                                                        {
-#endif
-                                                                            if ( rulestruct[b].blacklist_flag == false || blacklist_results == true )
-                                                                                {
-
-                                                                                    if ( rulestruct[b].brointel_flag == false || brointel_results == true )
-                                                                                        {
-#ifdef WITH_BLUEDOT
-
-
-                                                                                            if ( config->bluedot_flag == false || rulestruct[b].bluedot_file_hash == false || ( rulestruct[b].bluedot_file_hash == true && bluedot_hash_flag == true ))
-                                                                                                {
-
-                                                                                                    if ( config->bluedot_flag == false || rulestruct[b].bluedot_filename == false || ( rulestruct[b].bluedot_filename == true && bluedot_filename_flag == true ))
-                                                                                                        {
-
-                                                                                                            if ( config->bluedot_flag == false || rulestruct[b].bluedot_url == false || ( rulestruct[b].bluedot_url == true && bluedot_url_flag == true ))
-                                                                                                                {
-
-                                                                                                                    if ( config->bluedot_flag == false || rulestruct[b].bluedot_ipaddr_type == false || ( rulestruct[b].bluedot_ipaddr_type != 0 && bluedot_ip_flag == true ))
-                                                                                                                        {
-
 
+                                            match = brointel_results;
 
-#endif
-
-                                                                                                                            /* After */
+                                            break;
+                                        }
+                                }
 
-                                                                                                                            after_log_flag = false;
+                            /****************************************************************************/
+                            /* Populate the SaganEvent array with the information needed.  This info    */
+                            /* will be passed to the threads.  No need to populate it _if_ we're in a   */
+                            /* threshold state.                                                         */
+                            /****************************************************************************/
 
-                                                                                                                            if ( rulestruct[b].after_method != 0 )
-                                                                                                                                {
+                            if ( match == true )
+                                {
 
-                                                                                                                                    switch(rulestruct[b].after_method)
-                                                                                                                                        {
+                                    /* After */
 
-                                                                                                                                        case(AFTER_BY_SRC):
-                                                                                                                                            after_log_flag = After_By_Src(b, ip_src, ip_src_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
-                                                                                                                                            break;
+                                    after_log_flag = false;
 
-                                                                                                                                        case(AFTER_BY_DST):
-                                                                                                                                            after_log_flag = After_By_Dst(b, ip_dst, ip_dst_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
-                                                                                                                                            break;
+                                    if ( rulestruct[b].after_method != 0 )
+                                        {
 
-                                                                                                                                        case(AFTER_BY_SRCPORT):
-                                                                                                                                            after_log_flag = After_By_SrcPort(b, ip_srcport_u32, pnormalize_selector);
-                                                                                                                                            break;
+                                            switch(rulestruct[b].after_method)
+                                                {
 
-                                                                                                                                        case(AFTER_BY_DSTPORT):
-                                                                                                                                            after_log_flag = After_By_DstPort(b, ip_dstport_u32, pnormalize_selector);
-                                                                                                                                            break;
+                                                case(AFTER_BY_SRC):
+                                                    after_log_flag = After_By_Src(b, ip_src, ip_src_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
+                                                    break;
 
-                                                                                                                                        case(AFTER_BY_USERNAME):
+                                                case(AFTER_BY_DST):
+                                                    after_log_flag = After_By_Dst(b, ip_dst, ip_dst_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
+                                                    break;
 
-                                                                                                                                            if ( normalize_username != NULL )
-                                                                                                                                                {
+                                                case(AFTER_BY_SRCPORT):
+                                                    after_log_flag = After_By_SrcPort(b, ip_srcport_u32, pnormalize_selector);
+                                                    break;
 
-                                                                                                                                                    after_log_flag = After_By_Username(b, normalize_username, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
-                                                                                                                                                }
+                                                case(AFTER_BY_DSTPORT):
+                                                    after_log_flag = After_By_DstPort(b, ip_dstport_u32, pnormalize_selector);
+                                                    break;
 
+                                                case(AFTER_BY_USERNAME):
 
-                                                                                                                                        } /*switch */
+                                                    if ( normalize_username != NULL )
+                                                        {
 
-                                                                                                                                } /* rulestruct[b].after_method != 0 */
+                                                            after_log_flag = After_By_Username(b, normalize_username, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
+                                                        }
 
-                                                                                                                            thresh_log_flag = false;
 
-                                                                                                                            if ( rulestruct[b].threshold_type != 0 &&
-                                                                                                                                    after_log_flag == false )
-                                                                                                                                {
+                                                } /*switch */
 
-                                                                                                                                    switch( rulestruct[b].threshold_method )
-                                                                                                                                        {
+                                        } /* rulestruct[b].after_method != 0 */
 
-                                                                                                                                        case(THRESH_BY_SRC):
-                                                                                                                                            thresh_log_flag = Thresh_By_Src(b, ip_src, ip_src_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
-                                                                                                                                            break;
+                                    thresh_log_flag = false;
 
-                                                                                                                                        case(THRESH_BY_DST):
-                                                                                                                                            thresh_log_flag = Thresh_By_Dst(b, ip_dst, ip_dst_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
-                                                                                                                                            break;
+                                    if ( rulestruct[b].threshold_type != 0 &&
+                                            after_log_flag == false )
+                                        {
 
-                                                                                                                                        case(THRESH_BY_USERNAME):
-                                                                                                                                            if ( normalize_username != NULL )
-                                                                                                                                                {
-                                                                                                                                                    thresh_log_flag = Thresh_By_Username(b, normalize_username, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
-                                                                                                                                                }
-                                                                                                                                            break;
+                                            switch( rulestruct[b].threshold_method )
+                                                {
 
-                                                                                                                                        case(THRESH_BY_SRCPORT):
-                                                                                                                                            thresh_log_flag = Thresh_By_SrcPort(b, ip_srcport_u32, pnormalize_selector);
+                                                case(THRESH_BY_SRC):
+                                                    thresh_log_flag = Thresh_By_Src(b, ip_src, ip_src_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
+                                                    break;
 
-                                                                                                                                        case(THRESH_BY_DSTPORT):
-                                                                                                                                            thresh_log_flag = Thresh_By_DstPort(b, ip_dstport_u32, pnormalize_selector);
-                                                                                                                                            break;
+                                                case(THRESH_BY_DST):
+                                                    thresh_log_flag = Thresh_By_Dst(b, ip_dst, ip_dst_bits, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
+                                                    break;
 
-                                                                                                                                        } /* switch */
+                                                case(THRESH_BY_USERNAME):
+                                                    if ( normalize_username != NULL )
+                                                        {
+                                                            thresh_log_flag = Thresh_By_Username(b, normalize_username, pnormalize_selector, SaganProcSyslog_LOCAL->syslog_message );
+                                                        }
+                                                    break;
 
-                                                                                                                                } /* if */
+                                                case(THRESH_BY_SRCPORT):
+                                                    thresh_log_flag = Thresh_By_SrcPort(b, ip_srcport_u32, pnormalize_selector);
 
-                                                                                                                            pthread_mutex_lock(&CounterSaganFoundMutex);
-                                                                                                                            counters->saganfound++;
-                                                                                                                            pthread_mutex_unlock(&CounterSaganFoundMutex);
+                                                case(THRESH_BY_DSTPORT):
+                                                    thresh_log_flag = Thresh_By_DstPort(b, ip_dstport_u32, pnormalize_selector);
+                                                    break;
 
-                                                                                                                            /* Check for thesholding & "after" */
+                                                } /* switch */
 
-                                                                                                                            if ( thresh_log_flag == false && after_log_flag == false )
-                                                                                                                                {
+                                        } /* if */
 
-                                                                                                                                    if ( debug->debugengine )
-                                                                                                                                        {
+                                    pthread_mutex_lock(&CounterSaganFoundMutex);
+                                    counters->saganfound++;
+                                    pthread_mutex_unlock(&CounterSaganFoundMutex);
 
-                                                                                                                                            Sagan_Log(DEBUG, "[%s, line %d] **[Trigger]*********************************", __FILE__, __LINE__);
-                                                                                                                                            Sagan_Log(DEBUG, "[%s, line %d] Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog_LOCAL->syslog_tag);
-                                                                                                                                            Sagan_Log(DEBUG, "[%s, line %d] Threshold flag: %d | After flag: %d | Xbit Flag: %d | Xbit status: %d", __FILE__, __LINE__, thresh_log_flag, after_log_flag, rulestruct[b].xbit_flag, xbit_return);
-                                                                                                                                            Sagan_Log(DEBUG, "[%s, line %d] Triggering Message: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_message);
+                                    /* Check for thesholding & "after" */
 
-                                                                                                                                        }
+                                    if ( thresh_log_flag == false && after_log_flag == false )
+                                        {
 
-                                                                                                                                    if ( rulestruct[b].xbit_flag && rulestruct[b].xbit_set_count )
-                                                                                                                                        {
-                                                                                                                                            Xbit_Set(b, ip_src, ip_dst, ip_srcport_u32, ip_dstport_u32, pnormalize_selector, SaganProcSyslog_LOCAL);
-                                                                                                                                        }
+                                            if ( debug->debugengine )
+                                                {
 
-                                                                                                                                    threadid++;
+                                                    Sagan_Log(DEBUG, "[%s, line %d] **[Trigger]*********************************", __FILE__, __LINE__);
+                                                    Sagan_Log(DEBUG, "[%s, line %d] Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_program, SaganProcSyslog_LOCAL->syslog_facility, SaganProcSyslog_LOCAL->syslog_priority, SaganProcSyslog_LOCAL->syslog_level, SaganProcSyslog_LOCAL->syslog_tag);
+                                                    Sagan_Log(DEBUG, "[%s, line %d] Threshold flag: %d | After flag: %d | Xbit Flag: %d | Xbit status: %d", __FILE__, __LINE__, thresh_log_flag, after_log_flag, rulestruct[b].xbit_flag, xbit_return);
+                                                    Sagan_Log(DEBUG, "[%s, line %d] Triggering Message: %s", __FILE__, __LINE__, SaganProcSyslog_LOCAL->syslog_message);
 
-                                                                                                                                    if ( threadid >= MAX_THREADS )
-                                                                                                                                        {
-                                                                                                                                            threadid=0;
-                                                                                                                                        }
+                                                }
 
+                                            if ( rulestruct[b].xbit_flag && rulestruct[b].xbit_set_count )
+                                                {
+                                                    Xbit_Set(b, ip_src, ip_dst, ip_srcport_u32, ip_dstport_u32, pnormalize_selector, SaganProcSyslog_LOCAL);
+                                                }
 
-                                                                                                                                    processor_info_engine->processor_name          =       s_msg;
-                                                                                                                                    processor_info_engine->processor_generator_id  =       SAGAN_PROCESSOR_GENERATOR_ID;
-                                                                                                                                    processor_info_engine->processor_facility      =       SaganProcSyslog_LOCAL->syslog_facility;
-                                                                                                                                    processor_info_engine->processor_priority      =       SaganProcSyslog_LOCAL->syslog_level;
-                                                                                                                                    processor_info_engine->processor_pri           =       rulestruct[b].s_pri;
-                                                                                                                                    processor_info_engine->processor_class         =       rulestruct[b].s_classtype;
-                                                                                                                                    processor_info_engine->processor_tag           =       SaganProcSyslog_LOCAL->syslog_tag;
-                                                                                                                                    processor_info_engine->processor_rev           =       rulestruct[b].s_rev;
-                                                                                                                                    processor_info_engine_dst_port                 =       ip_dstport_u32;
-                                                                                                                                    processor_info_engine_src_port                 =       ip_srcport_u32;
-                                                                                                                                    processor_info_engine_proto                    =       proto;
-                                                                                                                                    processor_info_engine_alertid                  =       atoi(rulestruct[b].s_sid);
+                                            threadid++;
 
-                                                                                                                                    if ( rulestruct[b].xbit_flag == false || rulestruct[b].xbit_noalert == 0 )
-                                                                                                                                        {
+                                            if ( threadid >= MAX_THREADS )
+                                                {
+                                                    threadid=0;
+                                                }
 
-                                                                                                                                            if ( rulestruct[b].type == NORMAL_RULE )
-                                                                                                                                                {
 
-                                                                                                                                                    Send_Alert(SaganProcSyslog_LOCAL,
-                                                                                                                                                               liblognorm_status == 1 && rulestruct[b].normalize == 1 ? json_normalize : NULL,
-                                                                                                                                                               processor_info_engine,
-                                                                                                                                                               ip_src,
-                                                                                                                                                               ip_dst,
-                                                                                                                                                               normalize_http_uri,
-                                                                                                                                                               normalize_http_hostname,
-                                                                                                                                                               processor_info_engine_proto,
-                                                                                                                                                               processor_info_engine_alertid,
-                                                                                                                                                               processor_info_engine_src_port,
-                                                                                                                                                               processor_info_engine_dst_port,
-                                                                                                                                                               b, tp );
+                                            processor_info_engine->processor_name          =       s_msg;
+                                            processor_info_engine->processor_generator_id  =       SAGAN_PROCESSOR_GENERATOR_ID;
+                                            processor_info_engine->processor_facility      =       SaganProcSyslog_LOCAL->syslog_facility;
+                                            processor_info_engine->processor_priority      =       SaganProcSyslog_LOCAL->syslog_level;
+                                            processor_info_engine->processor_pri           =       rulestruct[b].s_pri;
+                                            processor_info_engine->processor_class         =       rulestruct[b].s_classtype;
+                                            processor_info_engine->processor_tag           =       SaganProcSyslog_LOCAL->syslog_tag;
+                                            processor_info_engine->processor_rev           =       rulestruct[b].s_rev;
+                                            processor_info_engine_dst_port                 =       ip_dstport_u32;
+                                            processor_info_engine_src_port                 =       ip_srcport_u32;
+                                            processor_info_engine_proto                    =       proto;
+                                            processor_info_engine_alertid                  =       atoi(rulestruct[b].s_sid);
+
+                                            if ( rulestruct[b].xbit_flag == false || rulestruct[b].xbit_noalert == 0 )
+                                                {
 
-                                                                                                                                                }
-                                                                                                                                            else
-                                                                                                                                                {
+                                                    if ( rulestruct[b].type == NORMAL_RULE )
+                                                        {
 
-                                                                                                                                                    Sagan_Dynamic_Rules(SaganProcSyslog_LOCAL, b, processor_info_engine,
-                                                                                                                                                                        ip_src, ip_dst);
+                                                            Send_Alert(SaganProcSyslog_LOCAL,
+                                                                       liblognorm_status == 1 && rulestruct[b].normalize == 1 ? json_normalize : NULL,
+                                                                       processor_info_engine,
+                                                                       ip_src,
+                                                                       ip_dst,
+                                                                       normalize_http_uri,
+                                                                       normalize_http_hostname,
+                                                                       processor_info_engine_proto,
+                                                                       processor_info_engine_alertid,
+                                                                       processor_info_engine_src_port,
+                                                                       processor_info_engine_dst_port,
+                                                                       b, tp );
 
-                                                                                                                                                }
+                                                        }
+                                                    else
+                                                        {
 
-                                                                                                                                        }
+                                                            Sagan_Dynamic_Rules(SaganProcSyslog_LOCAL, b, processor_info_engine,
+                                                                                ip_src, ip_dst);
 
+                                                        }
 
-                                                                                                                                } /* Threshold / After */
-#ifdef WITH_BLUEDOT
-                                                                                                                        } /* Bluedot */
-                                                                                                                }
-                                                                                                        }
-                                                                                                }
-#endif
+                                                }
 
-                                                                                        } /* Bro Intel */
 
-                                                                                } /* Blacklist */
-#ifdef HAVE_LIBMAXMINDDB
-                                                                        } /* GeoIP2 */
-#endif
-                                                                } /* Time based alerts */
+                                        } /* Threshold / After */
 
-                                                        } /* Xbit count */
+                                } /* Plan */
 
-                                                } /* Xbit */
+                        } /* End of match */
 
-                                        } /* Check Rule Flow */
+                    if ( rules_sample == true || rules_profile == true )
+                        {
 
-                                } /* End of match */
+                            rule_time = Monotonic_NS() - rule_start;
 
-                        } /* End of pcre match */
+                            if ( rules_sample == true )
+                                {
+                                    Rules_Index_Record(rules_index, b, match, rule_time);
+                                }
 
-#ifdef HAVE_LIBMAXMINDDB
-                    geoip2_isset = false;
-#endif
+                            if ( rules_profile == true )
+                                {
+                                    Sagan_Rule_Profile_Record(b, message_match, match, rule_time);
+                                }
+                        }
 
                     match = false;  		      /* Reset match! */
-                    sagan_match=0;	      /* Reset pcre/meta_content/content match! */
                     rc=0;		      /* Return code */
                     xbit_return=0;	      /* Xbit reset */
                     check_flow_return = true;      /* Rule flow direction reset */
@@ -1417,9 +1376,6 @@ int Sagan_Engine ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, bool dynamic_rule_
             Log_JSON(SaganProcSyslog_LOCAL, tp, json_normalize);
         }
 
-    free(processor_info_engine);
-    free(lookup_cache);
-
 #ifdef HAVE_LIBLOGNORM
     if ( json_normalize != NULL )
         {
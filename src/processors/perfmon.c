@@ -46,6 +46,7 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "lockfile.h"
+#include "util-memo.h"
 
 #include "processors/perfmon.h"
 
@@ -116,6 +117,11 @@ void Sagan_Perfmonitor_Handler( void )
 
     uint64_t last_dns_miss_count = 0;
 
+    uint64_t memo_hit = 0;
+    uint64_t memo_miss = 0;
+    uint64_t last_memo_hit = 0;
+    uint64_t last_memo_miss = 0;
+
     while (1)
         {
 
@@ -300,6 +306,14 @@ void Sagan_Perfmonitor_Handler( void )
                     fprintf(config->perfmonitor_file_stream, "0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
 #endif
 
+                    /* Newer columns go on the end so existing readers still line up */
+
+                    Sagan_Memo_Stats(&memo_hit, &memo_miss);
+
+                    fprintf(config->perfmonitor_file_stream, ",%" PRIu64 ",%" PRIu64 "", memo_hit - last_memo_hit, memo_miss - last_memo_miss);
+                    last_memo_hit = memo_hit;
+                    last_memo_miss = memo_miss;
+
                     fprintf(config->perfmonitor_file_stream, "\n");
                     fflush(config->perfmonitor_file_stream);
                 }
@@ -351,7 +365,7 @@ void Sagan_Perfmonitor_Open(void)
         }
 
     fprintf(config->perfmonitor_file_stream, "################################ Perfmon start: pid=%d at=%s ###################################\n", getpid(), curtime);
-    fprintf(config->perfmonitor_file_stream, "# engine.utime,engine.total,engine.sig_match.total,engine.alerts.total,engine.after.total,engine.threshold.total, engine.drop.total,engine.ignored.total,engine.eps,geoip2.lookup.total,geoip2.hits,geoip2.misses,processor.drop.total,processor.blacklist.hits,processor.tracker.total,processor.tracker.down,output.drop.total,processor.esmtp.success,processor.esmtp.failed,dns.total,dns.miss,processor.bluedot_ip_cache_count,processor.bluedot_ip_cache_hit,processor.bluedot_ip_positive_hit,processor.bluedot_ip_qps,processor.bluedot_hash_cache_count,processor.bluedot_hash_cache_hit,processor.bluedot_hash_positive_hit,processor.bluedot_hash_qps,processor.bluedot_url_cache_count,processor.bluedot_url_cache_hit,processor.bluedot_url_positive_hit,processor.bluedot_url_qps,processor.bluedot_filename_cache_count,processor.bluedot_filename_cache_hit,processor.bluedot_filename_positive_hit,processor.bluedot_filename_qps,processor.bluedot_error_count,processor.bluedot_total_qps\n");
+    fprintf(config->perfmonitor_file_stream, "# engine.utime,engine.total,engine.sig_match.total,engine.alerts.total,engine.after.total,engine.threshold.total, engine.drop.total,engine.ignored.total,engine.eps,geoip2.lookup.total,geoip2.hits,geoip2.misses,processor.drop.total,processor.blacklist.hits,processor.tracker.total,processor.tracker.down,output.drop.total,processor.esmtp.success,processor.esmtp.failed,dns.total,dns.miss,processor.bluedot_ip_cache_count,processor.bluedot_ip_cache_hit,processor.bluedot_ip_positive_hit,processor.bluedot_ip_qps,processor.bluedot_hash_cache_count,processor.bluedot_hash_cache_hit,processor.bluedot_hash_positive_hit,processor.bluedot_hash_qps,processor.bluedot_url_cache_count,processor.bluedot_url_cache_hit,processor.bluedot_url_positive_hit,processor.bluedot_url_qps,processor.bluedot_filename_cache_count,processor.bluedot_filename_cache_hit,processor.bluedot_filename_positive_hit,processor.bluedot_filename_qps,processor.bluedot_error_count,processor.bluedot_total_qps,engine.memo.hits,engine.memo.misses\n");
     fflush(config->perfmonitor_file_stream);
 
 }
@@ -0,0 +1,358 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rule-profile.c
+ *
+ * Per rule profiling.  Workers add up how often each rule is checked,
+ * passes its content/pcre/meta_content,  matches and how long it took in
+ * their own counters.  On SIGUSR2 (and every "time" seconds),  the counters
+ * from all the workers are added up and written to a file,  the most
+ * expensive rule first.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#ifdef HAVE_SYS_PRCTL_H
+#include <sys/prctl.h>
+#endif
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "rules.h"
+
+#include "processors/rule-profile.h"
+
+struct _SaganConfig *config;
+struct _SaganCounters *counters;
+struct _Rule_Struct *rulestruct;
+
+pthread_mutex_t RuleProfileDumpMutex=PTHREAD_MUTEX_INITIALIZER;
+
+static _Rule_Profile_Thread *rule_profile_threads = NULL;
+static uint64_t rule_profile_generation = 0;
+
+static __thread _Rule_Profile_Thread *rule_profile_thread = NULL;
+
+/*****************************************************************************
+ * Rule_Profile_Add - Only the owning thread writes its counters,  so there
+ * is no need for a locked add.  The atomic load/store keeps a dump from
+ * reading a half written value.
+ *****************************************************************************/
+
+static inline void Rule_Profile_Add( uint64_t *counter, uint64_t value )
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************************
+ * Rule_Profile_Get - Returns this thread's counters for "rule".  The first
+ * call from a thread adds it to the list the dump walks.
+ *****************************************************************************/
+
+static _Rule_Profile *Rule_Profile_Get( uint32_t rule )
+{
+
+    _Rule_Profile_Thread *thread = rule_profile_thread;
+    _Rule_Profile *chunk = NULL;
+
+    uint64_t generation = __atomic_load_n(&rule_profile_generation, __ATOMIC_RELAXED);
+    uint32_t i = 0;
+
+    if ( rule >= RULE_PROFILE_CHUNK * RULE_PROFILE_MAX_CHUNKS )
+        {
+            return(NULL);
+        }
+
+    if ( thread == NULL )
+        {
+
+            thread = calloc(1, sizeof(_Rule_Profile_Thread));
+
+            if ( thread == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rule_Profile_Thread. Abort!", __FILE__, __LINE__);
+                }
+
+            thread->generation = generation;
+
+            /* Threads are never taken off the list,  so a dump can walk it
+               without a lock */
+
+            thread->next = __atomic_load_n(&rule_profile_threads, __ATOMIC_RELAXED);
+
+            while ( __atomic_compare_exchange_n(&rule_profile_threads, &thread->next, thread, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED) == false );
+
+            rule_profile_thread = thread;
+        }
+
+    /* Rules were reloaded.  The old counts belong to other rules now */
+
+    if ( thread->generation != generation )
+        {
+
+            for ( i = 0; i < RULE_PROFILE_MAX_CHUNKS; i++ )
+                {
+                    if ( thread->chunks[i] != NULL )
+                        {
+                            memset(thread->chunks[i], 0, RULE_PROFILE_CHUNK * sizeof(_Rule_Profile));
+                        }
+                }
+
+            __atomic_store_n(&thread->generation, generation, __ATOMIC_RELAXED);
+        }
+
+    chunk = thread->chunks[rule / RULE_PROFILE_CHUNK];
+
+    if ( chunk == NULL )
+        {
+
+            chunk = calloc(RULE_PROFILE_CHUNK, sizeof(_Rule_Profile));
+
+            if ( chunk == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rule_Profile. Abort!", __FILE__, __LINE__);
+                }
+
+            __atomic_store_n(&thread->chunks[rule / RULE_PROFILE_CHUNK], chunk, __ATOMIC_RELEASE);
+        }
+
+    return( &chunk[rule % RULE_PROFILE_CHUNK] );
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Profile_Record - Called by the engine for each rule it checks
+ *****************************************************************************/
+
+void Sagan_Rule_Profile_Record( uint32_t rule, bool passed, bool matched, uint64_t ns )
+{
+
+    _Rule_Profile *profile = Rule_Profile_Get(rule);
+
+    if ( profile == NULL )
+        {
+            return;
+        }
+
+    Rule_Profile_Add(&profile->checks, 1);
+    Rule_Profile_Add(&profile->ns, ns);
+
+    if ( passed == true )
+        {
+            Rule_Profile_Add(&profile->passes, 1);
+        }
+
+    if ( matched == true )
+        {
+            Rule_Profile_Add(&profile->matches, 1);
+        }
+
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Profile_Reset - Called after the rules are reloaded (SIGHUP).
+ * Each worker clears its own counters the next time it records.
+ *****************************************************************************/
+
+void Sagan_Rule_Profile_Reset( void )
+{
+    __atomic_add_fetch(&rule_profile_generation, 1, __ATOMIC_RELAXED);
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Profile_Dump - Adds up every thread's counters and writes the
+ * rules that were checked,  most time spent first.  This is run from the
+ * signal thread,  so the rules can't be reloaded out from under it.
+ *****************************************************************************/
+
+static int Rule_Profile_Compare( const void *a, const void *b )
+{
+
+    const _Rule_Profile_Total *total_a = (const _Rule_Profile_Total *)a;
+    const _Rule_Profile_Total *total_b = (const _Rule_Profile_Total *)b;
+
+    if ( total_a->profile.ns != total_b->profile.ns )
+        {
+            return( total_a->profile.ns > total_b->profile.ns ? -1 : 1 );
+        }
+
+    return( total_a->rule < total_b->rule ? -1 : total_a->rule > total_b->rule );
+}
+
+void Sagan_Rule_Profile_Dump( void )
+{
+
+    _Rule_Profile_Thread *thread = NULL;
+    _Rule_Profile_Total *totals = NULL;
+    _Rule_Profile *chunk = NULL;
+
+    FILE *profile_file = NULL;
+
+    char curtime[64] = { 0 };
+    time_t t;
+    struct tm *now;
+
+    uint32_t rule_count = counters->rulecount;
+    uint32_t count = 0;
+    uint32_t rule = 0;
+    uint32_t i = 0;
+
+    if ( rule_count > RULE_PROFILE_CHUNK * RULE_PROFILE_MAX_CHUNKS )
+        {
+            rule_count = RULE_PROFILE_CHUNK * RULE_PROFILE_MAX_CHUNKS;
+        }
+
+    pthread_mutex_lock(&RuleProfileDumpMutex);
+
+    totals = calloc(rule_count + 1, sizeof(_Rule_Profile_Total));
+
+    if ( totals == NULL )
+        {
+            pthread_mutex_unlock(&RuleProfileDumpMutex);
+            Sagan_Log(WARN, "[%s, line %d] Failed to allocate memory for the rule profile. Not writing it.", __FILE__, __LINE__);
+            return;
+        }
+
+    for ( rule = 0; rule < rule_count; rule++ )
+        {
+            totals[rule].rule = rule;
+        }
+
+    for ( thread = __atomic_load_n(&rule_profile_threads, __ATOMIC_ACQUIRE); thread != NULL; thread = thread->next )
+        {
+
+            /* A thread that hasn't seen the last reload yet has old counts */
+
+            if ( __atomic_load_n(&thread->generation, __ATOMIC_RELAXED) != __atomic_load_n(&rule_profile_generation, __ATOMIC_RELAXED) )
+                {
+                    continue;
+                }
+
+            for ( rule = 0; rule < rule_count; rule++ )
+                {
+
+                    chunk = __atomic_load_n(&thread->chunks[rule / RULE_PROFILE_CHUNK], __ATOMIC_ACQUIRE);
+
+                    if ( chunk == NULL )
+                        {
+                            rule += RULE_PROFILE_CHUNK - ( rule % RULE_PROFILE_CHUNK ) - 1;
+                            continue;
+                        }
+
+                    i = rule % RULE_PROFILE_CHUNK;
+
+                    totals[rule].profile.checks += __atomic_load_n(&chunk[i].checks, __ATOMIC_RELAXED);
+                    totals[rule].profile.passes += __atomic_load_n(&chunk[i].passes, __ATOMIC_RELAXED);
+                    totals[rule].profile.matches += __atomic_load_n(&chunk[i].matches, __ATOMIC_RELAXED);
+                    totals[rule].profile.ns += __atomic_load_n(&chunk[i].ns, __ATOMIC_RELAXED);
+                }
+        }
+
+    /* Only rules that were checked are worth listing */
+
+    for ( rule = 0; rule < rule_count; rule++ )
+        {
+            if ( totals[rule].profile.checks != 0 )
+                {
+                    totals[count++] = totals[rule];
+                }
+        }
+
+    qsort(totals, count, sizeof(_Rule_Profile_Total), Rule_Profile_Compare);
+
+    if (( profile_file = fopen(config->rule_profile_file_name, "w" )) == NULL )
+        {
+            free(totals);
+            pthread_mutex_unlock(&RuleProfileDumpMutex);
+            Sagan_Log(WARN, "[%s, line %d] Can't open %s - %s!", __FILE__, __LINE__, config->rule_profile_file_name, strerror(errno));
+            return;
+        }
+
+    t = time(NULL);
+    now=localtime(&t);
+    strftime(curtime, sizeof(curtime), "%m/%d/%Y %H:%M:%S",  now);
+
+    fprintf(profile_file, "# Sagan rule profile: pid=%d at=%s.  %u of %u rules checked,  most time first.\n", getpid(), curtime, count, rule_count);
+    fprintf(profile_file, "#\n");
+    fprintf(profile_file, "# %6s %12s %5s %14s %14s %14s %14s %10s  %s\n", "Num", "SID", "Rev", "Checks", "Passes", "Matches", "Total(us)", "Avg(ns)", "Message");
+
+    for ( i = 0; i < count; i++ )
+        {
+
+            rule = totals[i].rule;
+
+            fprintf(profile_file, "  %6u %12s %5s %14" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64 " %10" PRIu64 "  %s\n",
+                    i + 1,
+                    rulestruct[rule].s_sid,
+                    rulestruct[rule].s_rev,
+                    totals[i].profile.checks,
+                    totals[i].profile.passes,
+                    totals[i].profile.matches,
+                    totals[i].profile.ns / 1000,
+                    totals[i].profile.ns / totals[i].profile.checks,
+                    rulestruct[rule].s_msg);
+        }
+
+    fclose(profile_file);
+    free(totals);
+
+    pthread_mutex_unlock(&RuleProfileDumpMutex);
+
+    Sagan_Log(NORMAL, "Rule profile for %u rules written to %s.", count, config->rule_profile_file_name);
+
+}
+
+/*****************************************************************************
+ * Sagan_Rule_Profile_Handler - Thread for "time".  The dump itself is left
+ * to the signal thread (see Sagan_Rule_Profile_Dump()).
+ *****************************************************************************/
+
+void Sagan_Rule_Profile_Handler( void )
+{
+
+    (void)SetThreadName("SaganRuleProf");
+
+    while (1)
+        {
+
+            sleep(config->rule_profile_time);
+
+            if ( config->rule_profile_flag )
+                {
+                    kill(getpid(), SIGUSR2);
+                }
+
+        }
+
+}
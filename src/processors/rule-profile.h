@@ -0,0 +1,63 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Per rule profiling.  Each worker thread keeps its own counters,  so the
+ * engine never locks or shares a cache line to record a check.  The
+ * counters are kept in fixed size chunks that never move,  so a dump can
+ * walk them while the workers keep counting. */
+
+#define RULE_PROFILE_CHUNK		1024		/* Rules per chunk */
+#define RULE_PROFILE_MAX_CHUNKS		1024		/* Rules past CHUNK * MAX_CHUNKS aren't profiled */
+
+typedef struct _Rule_Profile _Rule_Profile;
+struct _Rule_Profile
+{
+    uint64_t checks;			/* Rule was a candidate */
+    uint64_t passes;			/* content/pcre/meta_content passed */
+    uint64_t matches;			/* Whole rule matched */
+    uint64_t ns;			/* Time spent checking the rule */
+};
+
+typedef struct _Rule_Profile_Thread _Rule_Profile_Thread;
+struct _Rule_Profile_Thread
+{
+    _Rule_Profile *chunks[RULE_PROFILE_MAX_CHUNKS];
+    uint64_t generation;
+    _Rule_Profile_Thread *next;
+};
+
+typedef struct _Rule_Profile_Total _Rule_Profile_Total;
+struct _Rule_Profile_Total
+{
+    uint32_t rule;
+    _Rule_Profile profile;
+};
+
+void Sagan_Rule_Profile_Record( uint32_t rule, bool passed, bool matched, uint64_t ns );
+void Sagan_Rule_Profile_Dump( void );
+void Sagan_Rule_Profile_Reset( void );
+void Sagan_Rule_Profile_Handler( void );
@@ -57,7 +57,6 @@ pthread_mutex_t IPCTrackClientCounter=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t IPCTrackClientsStatus=PTHREAD_MUTEX_INITIALIZER;
 
 struct _Sagan_Processor_Info *processor_info_track_client = NULL;
-struct _Sagan_Proc_Syslog *SaganProcSyslog;
 struct _Sagan_Track_Clients_IPC *SaganTrackClients_ipc;
 struct _Sagan_IPC_Counters *counters_ipc;
 
@@ -184,6 +183,16 @@ void Track_Clients_Thread ( void )
 
             struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL = NULL;
 
+            char syslog_host[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_facility[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_priority[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_level[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_tag[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_date[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_time[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_program[MAX_SYSLOG_FIELD] = { 0 };
+            char syslog_message[MAX_SYSLOGMSG] = { 0 };
+
             int alertid;
             int i;
 
@@ -213,6 +222,18 @@ void Track_Clients_Thread ( void )
                     Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog_LOCAL. Abort!", __FILE__, __LINE__);
                 }
 
+            memset(SaganProcSyslog_LOCAL, 0, sizeof(struct _Sagan_Proc_Syslog));
+
+            SaganProcSyslog_LOCAL->syslog_host = syslog_host;
+            SaganProcSyslog_LOCAL->syslog_facility = syslog_facility;
+            SaganProcSyslog_LOCAL->syslog_priority = syslog_priority;
+            SaganProcSyslog_LOCAL->syslog_level = syslog_level;
+            SaganProcSyslog_LOCAL->syslog_tag = syslog_tag;
+            SaganProcSyslog_LOCAL->syslog_date = syslog_date;
+            SaganProcSyslog_LOCAL->syslog_time = syslog_time;
+            SaganProcSyslog_LOCAL->syslog_program = syslog_program;
+            SaganProcSyslog_LOCAL->syslog_message = syslog_message;
+
             /*********************************/
             /* Look through "known" system   */
             /*********************************/
@@ -256,17 +277,18 @@ void Track_Clients_Thread ( void )
 
                                     /* Populate SaganProcSyslog_LOCAL for output plugins */
 
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_host, tmp_ip, sizeof(SaganProcSyslog_LOCAL->syslog_host));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_facility, PROCESSOR_FACILITY, sizeof(SaganProcSyslog_LOCAL->syslog_facility));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_priority, PROCESSOR_PRIORITY, sizeof(SaganProcSyslog_LOCAL->syslog_priority));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_level, "info", sizeof(SaganProcSyslog_LOCAL->syslog_level));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_tag, "00", sizeof(SaganProcSyslog_LOCAL->syslog_tag));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_program, PROCESSOR_NAME, sizeof(SaganProcSyslog_LOCAL->syslog_program));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_host, tmp_ip, sizeof(syslog_host));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_facility, PROCESSOR_FACILITY, sizeof(syslog_facility));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_priority, PROCESSOR_PRIORITY, sizeof(syslog_priority));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_level, "info", sizeof(syslog_level));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_tag, "00", sizeof(syslog_tag));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_program, PROCESSOR_NAME, sizeof(syslog_program));
 
-                                    Return_Date(utime_u32, SaganProcSyslog_LOCAL->syslog_date, sizeof(SaganProcSyslog_LOCAL->syslog_date));
-                                    Return_Time(utime_u32, SaganProcSyslog_LOCAL->syslog_time, sizeof(SaganProcSyslog_LOCAL->syslog_time));
+                                    Return_Date(utime_u32, SaganProcSyslog_LOCAL->syslog_date, sizeof(syslog_date));
+                                    Return_Time(utime_u32, SaganProcSyslog_LOCAL->syslog_time, sizeof(syslog_time));
 
-                                    snprintf(SaganProcSyslog_LOCAL->syslog_message, sizeof(SaganProcSyslog_LOCAL->syslog_message)-1, "The IP address %s was previously not sending logs. The system appears to be sending logs again at %s", tmp_ip, ctime(&SaganTrackClients_ipc[i].utime) );
+                                    snprintf(SaganProcSyslog_LOCAL->syslog_message, sizeof(syslog_message)-1, "The IP address %s was previously not sending logs. The system appears to be sending logs again at %s", tmp_ip, ctime(&SaganTrackClients_ipc[i].utime) );
+                                    SaganProcSyslog_LOCAL->syslog_message_len = strlen(syslog_message);
 
                                     alertid=101;		/* See gen-msg.map */
 
@@ -322,17 +344,18 @@ void Track_Clients_Thread ( void )
 
                                     /* Populate SaganProcSyslog_LOCAL for output plugins */
 
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_host, tmp_ip, sizeof(SaganProcSyslog_LOCAL->syslog_host));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_facility, PROCESSOR_FACILITY, sizeof(SaganProcSyslog_LOCAL->syslog_facility));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_priority, PROCESSOR_PRIORITY, sizeof(SaganProcSyslog_LOCAL->syslog_priority));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_level, "info", sizeof(SaganProcSyslog_LOCAL->syslog_level));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_tag, "00", sizeof(SaganProcSyslog_LOCAL->syslog_tag));
-                                    strlcpy(SaganProcSyslog_LOCAL->syslog_program, PROCESSOR_NAME, sizeof(SaganProcSyslog_LOCAL->syslog_program));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_host, tmp_ip, sizeof(syslog_host));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_facility, PROCESSOR_FACILITY, sizeof(syslog_facility));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_priority, PROCESSOR_PRIORITY, sizeof(syslog_priority));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_level, "info", sizeof(syslog_level));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_tag, "00", sizeof(syslog_tag));
+                                    strlcpy(SaganProcSyslog_LOCAL->syslog_program, PROCESSOR_NAME, sizeof(syslog_program));
 
-                                    Return_Date(utime_u32, SaganProcSyslog_LOCAL->syslog_date, sizeof(SaganProcSyslog_LOCAL->syslog_date));
-                                    Return_Time(utime_u32, SaganProcSyslog_LOCAL->syslog_time, sizeof(SaganProcSyslog_LOCAL->syslog_time));
+                                    Return_Date(utime_u32, SaganProcSyslog_LOCAL->syslog_date, sizeof(syslog_date));
+                                    Return_Time(utime_u32, SaganProcSyslog_LOCAL->syslog_time, sizeof(syslog_time));
 
-                                    snprintf(SaganProcSyslog_LOCAL->syslog_message, sizeof(SaganProcSyslog_LOCAL->syslog_message)-1, "Sagan has not recieved any logs from the IP address %s in over %d minute(s). Last log was seen at %s. This could be an indication that the system is down.", tmp_ip, config->pp_sagan_track_clients, ctime(&SaganTrackClients_ipc[i].utime) );
+                                    snprintf(SaganProcSyslog_LOCAL->syslog_message, sizeof(syslog_message)-1, "Sagan has not recieved any logs from the IP address %s in over %d minute(s). Last log was seen at %s. This could be an indication that the system is down.", tmp_ip, config->pp_sagan_track_clients, ctime(&SaganTrackClients_ipc[i].utime) );
+                                    SaganProcSyslog_LOCAL->syslog_message_len = strlen(syslog_message);
 
                                     alertid=100;	/* See gen-msg.map  */
 
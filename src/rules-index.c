@@ -0,0 +1,1157 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* rules-index.c
+ *
+ * Builds the rule "header" index (see rules-index.h) and uses it to pick
+ * the candidate rules for an event.  The index is built after rules are
+ * loaded and is read only after that,  so the workers don't lock it.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "rules.h"
+#include "rules-index.h"
+#include "rules-plan.h"
+#include "util-ac.h"
+
+struct _SaganCounters *counters;
+struct _SaganConfig *config;
+struct _Rule_Struct *rulestruct;
+
+static _Rules_Index *rules_index = NULL;
+
+static __thread uint64_t *rules_index_candidates = NULL;
+static __thread uint64_t *rules_index_content = NULL;
+static __thread uint32_t rules_index_candidates_words = 0;
+
+static __thread uint32_t *rules_index_order = NULL;
+static __thread uint32_t rules_index_order_size = 0;
+static __thread uint32_t *rules_index_order_rank = NULL;
+static __thread uint64_t rules_index_events = 0;
+
+static __thread _Rules_Index_Stats *rules_index_rank_stats = NULL;
+
+static _Rules_Index_Reader *rules_index_readers = NULL;
+static uint64_t rules_index_generation = 1;
+
+static __thread _Rules_Index_Reader *rules_index_reader = NULL;
+
+/****************************************************************************
+ * Rules_Index_Hash - FNV-1a
+ ****************************************************************************/
+
+static uint32_t Rules_Index_Hash( const char *value )
+{
+
+    uint32_t hash = 2166136261U;
+
+    while ( *value != '\0' )
+        {
+            hash ^= (unsigned char)*value++;
+            hash *= 16777619U;
+        }
+
+    return(hash);
+}
+
+/****************************************************************************
+ * Rules_Index_Field_Init - Allocates the hash and "any" bitmap for a field
+ ****************************************************************************/
+
+static void Rules_Index_Field_Init( _Rules_Index_Field *field, uint32_t hash_size, uint32_t words )
+{
+
+    uint32_t size = 16;
+
+    while ( size < hash_size )
+        {
+            size <<= 1;
+        }
+
+    field->hash = calloc(size, sizeof(_Rules_Index_Entry *));
+    field->any = calloc(words, sizeof(uint64_t));
+
+    if ( field->hash == NULL || field->any == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    field->hash_mask = size - 1;
+    field->used = false;
+
+}
+
+/****************************************************************************
+ * Rules_Index_Lookup - Returns the entry for "value" or NULL
+ ****************************************************************************/
+
+static _Rules_Index_Entry *Rules_Index_Lookup( _Rules_Index_Field *field, const char *value )
+{
+
+    _Rules_Index_Entry *entry = NULL;
+
+    for ( entry = field->hash[Rules_Index_Hash(value) & field->hash_mask]; entry != NULL; entry = entry->next )
+        {
+            if (!strcmp(entry->value, value))
+                {
+                    return(entry);
+                }
+        }
+
+    return(NULL);
+}
+
+/****************************************************************************
+ * Rules_Index_Insert - Returns the entry for "value",  adding it if needed.
+ * "words" is non-zero for bitmap fields.
+ ****************************************************************************/
+
+static _Rules_Index_Entry *Rules_Index_Insert( _Rules_Index_Field *field, const char *value, uint32_t words )
+{
+
+    _Rules_Index_Entry *entry = NULL;
+    uint32_t bucket = 0;
+
+    entry = Rules_Index_Lookup(field, value);
+
+    if ( entry != NULL )
+        {
+            return(entry);
+        }
+
+    entry = calloc(1, sizeof(_Rules_Index_Entry));
+
+    if ( entry == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    entry->value = strdup(value);
+
+    if ( words != 0 )
+        {
+            entry->bits = calloc(words, sizeof(uint64_t));
+        }
+
+    if ( entry->value == NULL || ( words != 0 && entry->bits == NULL ) )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    bucket = Rules_Index_Hash(value) & field->hash_mask;
+
+    entry->next = field->hash[bucket];
+    field->hash[bucket] = entry;
+
+    field->used = true;
+
+    return(entry);
+}
+
+/****************************************************************************
+ * Rules_Index_Add_Program - Indexes one (already split) program
+ ****************************************************************************/
+
+static void Rules_Index_Add_Program( _Rules_Index *index, const char *program, uint32_t rule )
+{
+
+    _Rules_Index_Entry *entry = NULL;
+    _Rules_Index_Trie *node = NULL;
+    _Rules_Index_Trie *child = NULL;
+    _Rules_Index_Wildcard *wildcard = NULL;
+
+    const char *p = NULL;
+
+    /* No wildcards.  Exact match via the hash */
+
+    if ( strpbrk(program, "*?") == NULL )
+        {
+
+            entry = Rules_Index_Insert(&index->program, program, 0);
+
+            /* "program: sshd|sshd" */
+
+            if ( entry->rule_count != 0 && entry->rules[entry->rule_count - 1] == rule )
+                {
+                    return;
+                }
+
+            entry->rules = realloc(entry->rules, (entry->rule_count + 1) * sizeof(uint32_t));
+
+            if ( entry->rules == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for the rule index. Abort!", __FILE__, __LINE__);
+                }
+
+            entry->rules[entry->rule_count++] = rule;
+            return;
+        }
+
+    /* Wildcards.  Walk/build the trie for the text before the first wildcard */
+
+    node = index->program_wildcard;
+
+    for ( p = program; *p != '*' && *p != '?'; p++ )
+        {
+
+            for ( child = node->child; child != NULL && child->c != (unsigned char)*p; child = child->next );
+
+            if ( child == NULL )
+                {
+
+                    child = calloc(1, sizeof(_Rules_Index_Trie));
+
+                    if ( child == NULL )
+                        {
+                            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+                        }
+
+                    child->c = (unsigned char)*p;
+                    child->next = node->child;
+                    node->child = child;
+                }
+
+            node = child;
+        }
+
+    wildcard = calloc(1, sizeof(_Rules_Index_Wildcard));
+
+    if ( wildcard == NULL || ( wildcard->pattern = strdup(program) ) == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    wildcard->rule = rule;
+    wildcard->prefix_only = ( p[0] == '*' && p[1] == '\0' );
+    wildcard->next = node->patterns;
+    node->patterns = wildcard;
+
+}
+
+/****************************************************************************
+ * Rules_Index_Add_Field - Indexes a '|' separated bitmap field for a rule
+ ****************************************************************************/
+
+static void Rules_Index_Add_Field( _Rules_Index *index, _Rules_Index_Field *field, const char *value, uint32_t rule )
+{
+
+    _Rules_Index_Entry *entry = NULL;
+
+    char tmp[256] = { 0 };
+    char *ptmp = NULL;
+    char *tok = NULL;
+
+    bool found = false;
+
+    strlcpy(tmp, value, sizeof(tmp));
+
+    for ( ptmp = strtok_r(tmp, "|", &tok); ptmp != NULL; ptmp = strtok_r(NULL, "|", &tok) )
+        {
+            entry = Rules_Index_Insert(field, ptmp, index->words);
+            entry->bits[rule >> 6] |= 1ULL << ( rule & 63 );
+            found = true;
+        }
+
+    if ( found == false )
+        {
+            field->any[rule >> 6] |= 1ULL << ( rule & 63 );
+        }
+
+}
+
+/****************************************************************************
+ * Rules_Index_Field_Finish - Rules that don't use a field pass whatever
+ * its value is,  so they're folded into every entry's bitmap.
+ ****************************************************************************/
+
+static void Rules_Index_Field_Finish( _Rules_Index *index, _Rules_Index_Field *field )
+{
+
+    _Rules_Index_Entry *entry = NULL;
+
+    uint32_t i = 0;
+    uint32_t w = 0;
+
+    for ( i = 0; i <= field->hash_mask; i++ )
+        {
+            for ( entry = field->hash[i]; entry != NULL; entry = entry->next )
+                {
+                    for ( w = 0; w < index->words; w++ )
+                        {
+                            entry->bits[w] |= field->any[w];
+                        }
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Rules_Index_Free_Field/Trie/Index - Clean up
+ ****************************************************************************/
+
+static void Rules_Index_Free_Field( _Rules_Index_Field *field )
+{
+
+    _Rules_Index_Entry *entry = NULL;
+    _Rules_Index_Entry *next = NULL;
+
+    uint32_t i = 0;
+
+    if ( field->hash != NULL )
+        {
+
+            for ( i = 0; i <= field->hash_mask; i++ )
+                {
+                    for ( entry = field->hash[i]; entry != NULL; entry = next )
+                        {
+                            next = entry->next;
+                            free(entry->value);
+                            free(entry->rules);
+                            free(entry->bits);
+                            free(entry);
+                        }
+                }
+        }
+
+    free(field->hash);
+    free(field->any);
+
+}
+
+static void Rules_Index_Free_Trie( _Rules_Index_Trie *node )
+{
+
+    _Rules_Index_Trie *child = NULL;
+    _Rules_Index_Trie *next = NULL;
+    _Rules_Index_Wildcard *wildcard = NULL;
+    _Rules_Index_Wildcard *next_wildcard = NULL;
+
+    if ( node == NULL )
+        {
+            return;
+        }
+
+    for ( child = node->child; child != NULL; child = next )
+        {
+            next = child->next;
+            Rules_Index_Free_Trie(child);
+        }
+
+    for ( wildcard = node->patterns; wildcard != NULL; wildcard = next_wildcard )
+        {
+            next_wildcard = wildcard->next;
+            free(wildcard->pattern);
+            free(wildcard);
+        }
+
+    free(node);
+
+}
+
+static void Rules_Index_Free( _Rules_Index *index )
+{
+
+    _Rules_Index *retired = NULL;
+    _Rules_Index_Retired *rank = NULL;
+    _Rules_Index_Retired *next_rank = NULL;
+
+    while ( index != NULL )
+        {
+
+            retired = index->retired;
+
+            for ( rank = index->rank_retired; rank != NULL; rank = next_rank )
+                {
+                    next_rank = rank->next;
+                    free(rank->rank);
+                    free(rank);
+                }
+
+            Rules_Index_Free_Field(&index->program);
+            Rules_Index_Free_Field(&index->facility);
+            Rules_Index_Free_Field(&index->syspri);
+            Rules_Index_Free_Field(&index->level);
+            Rules_Index_Free_Field(&index->tag);
+            Rules_Index_Free_Trie(index->program_wildcard);
+            Sagan_AC_Free(index->content);
+            free(index->content_any);
+            free(index->stats);
+            free(index->rank);
+            free(index->hot_type);
+            free(index->hot_plan_count);
+            free(index->hot_plan_message_count);
+            free(index->hot_plan_start);
+            free(index->hot_steps);
+
+            free(index);
+
+            index = retired;
+        }
+
+}
+
+/****************************************************************************
+ * Rules_Index_Hot - Copies what the engine needs to check a rule's
+ * message (see rules-index.h) out of rulestruct
+ ****************************************************************************/
+
+static void Rules_Index_Hot( _Rules_Index *index )
+{
+
+    _Rules_Index_Step *step = NULL;
+
+    uint32_t rule = 0;
+    uint32_t total = 0;
+    int z = 0;
+    int i = 0;
+
+    for ( rule = 0; rule < index->rule_count; rule++ )
+        {
+            total = total + rulestruct[rule].plan_message_count;
+        }
+
+    index->hot_type = calloc(index->rule_count + 1, sizeof(unsigned char));
+    index->hot_plan_count = calloc(index->rule_count + 1, sizeof(unsigned char));
+    index->hot_plan_message_count = calloc(index->rule_count + 1, sizeof(unsigned char));
+    index->hot_plan_start = calloc(index->rule_count + 1, sizeof(uint32_t));
+    index->hot_steps = calloc(total + 1, sizeof(_Rules_Index_Step));
+
+    if ( index->hot_type == NULL || index->hot_plan_count == NULL || index->hot_plan_message_count == NULL ||
+            index->hot_plan_start == NULL || index->hot_steps == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    step = index->hot_steps;
+
+    for ( rule = 0; rule < index->rule_count; rule++ )
+        {
+
+            index->hot_type[rule] = rulestruct[rule].type;
+            index->hot_plan_count[rule] = rulestruct[rule].plan_count;
+            index->hot_plan_message_count[rule] = rulestruct[rule].plan_message_count;
+            index->hot_plan_start[rule] = step - index->hot_steps;
+
+            for ( z = 0; z < rulestruct[rule].plan_message_count; z++, step++ )
+                {
+
+                    i = rulestruct[rule].plan[z].index;
+
+                    step->type = rulestruct[rule].plan[z].type;
+                    step->index = i;
+
+                    switch ( step->type )
+                        {
+
+                        case(PLAN_CONTENT):
+                            step->content = rulestruct[rule].s_content[i];
+                            step->len = rulestruct[rule].s_content_len[i];
+                            step->nocase = rulestruct[rule].s_nocase[i];
+                            step->negated = rulestruct[rule].content_not[i];
+                            step->offset = rulestruct[rule].s_offset[i];
+                            step->depth = rulestruct[rule].s_depth[i];
+                            step->distance = rulestruct[rule].s_distance[i];
+                            step->within = rulestruct[rule].s_within[i];
+                            step->prev_depth = i > 0 ? rulestruct[rule].s_depth[i-1] : 0;
+                            break;
+
+                        case(PLAN_META_CONTENT):
+                            step->offset = rulestruct[rule].meta_offset[i];
+                            step->depth = rulestruct[rule].meta_depth[i];
+                            step->distance = rulestruct[rule].meta_distance[i];
+                            step->within = rulestruct[rule].meta_within[i];
+                            step->prev_depth = i > 0 ? rulestruct[rule].meta_depth[i-1] : 0;
+                            break;
+
+                        case(PLAN_PCRE):
+                            step->re = rulestruct[rule].re_pcre[i];
+                            step->extra = rulestruct[rule].pcre_extra[i];
+                            break;
+
+                        }
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Rules_Index_Build - (Re)builds the index from rulestruct.  On a full
+ * reload (SIGHUP) the workers are held,  so the old index is freed.
+ * Dynamic rule loads happen while other workers are running,  so there
+ * the old index is kept around until the next full reload.
+ ****************************************************************************/
+
+void Rules_Index_Build( bool full_reload )
+{
+
+    _Rules_Index *index = NULL;
+    _Rules_Index *old_index = NULL;
+
+    char tmp[256] = { 0 };
+    char *ptmp = NULL;
+    char *tok = NULL;
+
+    uint32_t rule = 0;
+    int content = 0;
+    int z = 0;
+    bool found = false;
+
+    index = calloc(1, sizeof(_Rules_Index));
+
+    if ( index == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    index->rule_count = counters->rulecount;
+    index->words = ( index->rule_count + 63 ) / 64;
+
+    if ( index->words == 0 )
+        {
+            index->words = 1;
+        }
+
+    Rules_Index_Field_Init(&index->program, index->rule_count * 2, index->words);
+    Rules_Index_Field_Init(&index->facility, 64, index->words);
+    Rules_Index_Field_Init(&index->syspri, 64, index->words);
+    Rules_Index_Field_Init(&index->level, 64, index->words);
+    Rules_Index_Field_Init(&index->tag, 256, index->words);
+
+    index->program_wildcard = calloc(1, sizeof(_Rules_Index_Trie));
+    index->content_any = calloc(index->words, sizeof(uint64_t));
+    index->content = Sagan_AC_Init(true);
+
+    if ( index->program_wildcard == NULL || index->content_any == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    /* Rules start out in load order.  See Rules_Index_Rank() */
+
+    index->stats = calloc(index->rule_count + 1, sizeof(_Rules_Index_Stats));
+    index->rank = calloc(index->rule_count + 1, sizeof(uint32_t));
+
+    if ( index->stats == NULL || index->rank == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for the rule index. Abort!", __FILE__, __LINE__);
+        }
+
+    for ( rule = 0; rule < index->rule_count; rule++ )
+        {
+            index->rank[rule] = rule;
+        }
+
+    Rules_Index_Hot(index);
+
+    for ( rule = 0; rule < index->rule_count; rule++ )
+        {
+
+            strlcpy(tmp, rulestruct[rule].s_program, sizeof(tmp));
+            found = false;
+
+            for ( ptmp = strtok_r(tmp, "|", &tok); ptmp != NULL; ptmp = strtok_r(NULL, "|", &tok) )
+                {
+                    Rules_Index_Add_Program(index, ptmp, rule);
+                    found = true;
+                }
+
+            if ( found == false )
+                {
+                    index->program.any[rule >> 6] |= 1ULL << ( rule & 63 );
+                }
+
+            Rules_Index_Add_Field(index, &index->facility, rulestruct[rule].s_facility, rule);
+            Rules_Index_Add_Field(index, &index->syspri, rulestruct[rule].s_syspri, rule);
+            Rules_Index_Add_Field(index, &index->level, rulestruct[rule].s_level, rule);
+            Rules_Index_Add_Field(index, &index->tag, rulestruct[rule].s_tag, rule);
+
+            /* One content per rule goes into the automaton.  "content: !"
+               can't be used to rule anything out */
+
+            content = -1;
+
+            if ( rulestruct[rule].fast_pattern != 0 && rulestruct[rule].content_not[rulestruct[rule].fast_pattern - 1] == false )
+                {
+                    content = rulestruct[rule].fast_pattern - 1;
+                }
+            else
+                {
+                    for ( z = 0; z < rulestruct[rule].content_count; z++ )
+                        {
+                            if ( rulestruct[rule].content_not[z] == false &&
+                                    ( content == -1 || strlen(rulestruct[rule].s_content[z]) > strlen(rulestruct[rule].s_content[content]) ) )
+                                {
+                                    content = z;
+                                }
+                        }
+                }
+
+            if ( content != -1 && rulestruct[rule].s_content[content][0] != '\0' )
+                {
+                    Sagan_AC_Add(index->content, rulestruct[rule].s_content[content], strlen(rulestruct[rule].s_content[content]), rule);
+                }
+            else
+                {
+                    index->content_any[rule >> 6] |= 1ULL << ( rule & 63 );
+                }
+
+        }
+
+    Rules_Index_Field_Finish(index, &index->facility);
+    Rules_Index_Field_Finish(index, &index->syspri);
+    Rules_Index_Field_Finish(index, &index->level);
+    Rules_Index_Field_Finish(index, &index->tag);
+
+    Sagan_AC_Compile(index->content);
+
+    old_index = __atomic_load_n(&rules_index, __ATOMIC_ACQUIRE);
+
+    if ( full_reload == false )
+        {
+            index->retired = old_index;
+        }
+
+    __atomic_store_n(&rules_index, index, __ATOMIC_RELEASE);
+
+    if ( full_reload == true )
+        {
+            Rules_Index_Free(old_index);
+        }
+
+}
+
+/****************************************************************************
+ * Rules_Index_Candidates - Sets "candidates" to a bitmap of the rules
+ * whose header can match the event.  The bitmap is per thread and good
+ * until the next call.  Returns the index used (for the rule count).
+ ****************************************************************************/
+
+_Rules_Index *Rules_Index_Candidates( struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, uint64_t **candidates )
+{
+
+    _Rules_Index *index = __atomic_load_n(&rules_index, __ATOMIC_ACQUIRE);
+    _Rules_Index_Field *fields[4];
+    _Rules_Index_Entry *entry = NULL;
+    _Rules_Index_Trie *node = NULL;
+    _Rules_Index_Wildcard *wildcard = NULL;
+
+    char *values[4];
+    char *program = SaganProcSyslog_LOCAL->syslog_program;
+    char *p = NULL;
+
+    uint64_t *mask = NULL;
+    uint64_t remaining = 0;
+    uint32_t i = 0;
+    uint32_t w = 0;
+
+    if ( rules_index_candidates_words < index->words )
+        {
+
+            rules_index_candidates = realloc(rules_index_candidates, index->words * sizeof(uint64_t));
+            rules_index_content = realloc(rules_index_content, index->words * sizeof(uint64_t));
+
+            if ( rules_index_candidates == NULL || rules_index_content == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for rules_index_candidates. Abort!", __FILE__, __LINE__);
+                }
+
+            rules_index_candidates_words = index->words;
+        }
+
+    *candidates = rules_index_candidates;
+
+    /* Rules without a program,  plus rules for this program */
+
+    memcpy(rules_index_candidates, index->program.any, index->words * sizeof(uint64_t));
+
+    entry = Rules_Index_Lookup(&index->program, program);
+
+    if ( entry != NULL )
+        {
+            for ( i = 0; i < entry->rule_count; i++ )
+                {
+                    rules_index_candidates[entry->rules[i] >> 6] |= 1ULL << ( entry->rules[i] & 63 );
+                }
+        }
+
+    /* Wildcard programs.  Only patterns whose leading text matches the
+       program are tried */
+
+    node = index->program_wildcard;
+    p = program;
+
+    while ( node != NULL )
+        {
+
+            for ( wildcard = node->patterns; wildcard != NULL; wildcard = wildcard->next )
+                {
+                    if ( wildcard->prefix_only == true || Wildcard(wildcard->pattern, program) == true )
+                        {
+                            rules_index_candidates[wildcard->rule >> 6] |= 1ULL << ( wildcard->rule & 63 );
+                        }
+                }
+
+            if ( *p == '\0' )
+                {
+                    break;
+                }
+
+            for ( node = node->child; node != NULL && node->c != (unsigned char)*p; node = node->next );
+
+            p++;
+        }
+
+    /* Everything else has to match as well */
+
+    fields[0] = &index->facility;
+    values[0] = SaganProcSyslog_LOCAL->syslog_facility;
+    fields[1] = &index->syspri;
+    values[1] = SaganProcSyslog_LOCAL->syslog_priority;
+    fields[2] = &index->level;
+    values[2] = SaganProcSyslog_LOCAL->syslog_level;
+    fields[3] = &index->tag;
+    values[3] = SaganProcSyslog_LOCAL->syslog_tag;
+
+    for ( i = 0; i < 4; i++ )
+        {
+
+            if ( fields[i]->used == false )
+                {
+                    continue;
+                }
+
+            entry = Rules_Index_Lookup(fields[i], values[i]);
+            mask = entry != NULL ? entry->bits : fields[i]->any;
+
+            for ( w = 0; w < index->words; w++ )
+                {
+                    rules_index_candidates[w] &= mask[w];
+                }
+        }
+
+    /* Content.  Only worth scanning the message if a candidate has a
+       pattern in the automaton */
+
+    for ( w = 0; w < index->words; w++ )
+        {
+            remaining |= rules_index_candidates[w] & ~index->content_any[w];
+        }
+
+    if ( remaining != 0 )
+        {
+
+            memcpy(rules_index_content, index->content_any, index->words * sizeof(uint64_t));
+
+            Sagan_AC_Search(index->content, SaganProcSyslog_LOCAL->syslog_message, SaganProcSyslog_LOCAL->syslog_message_len, rules_index_content);
+
+            for ( w = 0; w < index->words; w++ )
+                {
+                    rules_index_candidates[w] &= rules_index_content[w];
+                }
+        }
+
+    return(index);
+}
+
+/****************************************************************************
+ * Rules_Index_Next - Returns the next candidate rule at or after "rule".
+ * Returns a value >= the index's rule count when there are no more.
+ ****************************************************************************/
+
+uint32_t Rules_Index_Next( _Rules_Index *index, uint64_t *candidates, uint32_t rule )
+{
+
+    uint32_t w = rule >> 6;
+    uint64_t bits = 0;
+
+    if ( w >= index->words )
+        {
+            return(index->rule_count);
+        }
+
+    bits = candidates[w] & ( ~0ULL << ( rule & 63 ) );
+
+    while ( bits == 0 )
+        {
+
+            if ( ++w >= index->words )
+                {
+                    return(index->rule_count);
+                }
+
+            bits = candidates[w];
+        }
+
+    return( ( w << 6 ) + __builtin_ctzll(bits) );
+}
+
+
+/****************************************************************************
+ * Rules_Index_Reader - This thread's entry on the reader list.  The first
+ * call from a thread adds it.  Threads are never taken off the list,  so
+ * Rules_Index_Rank() can walk it without a lock.
+ ****************************************************************************/
+
+static _Rules_Index_Reader *Rules_Index_Reader( void )
+{
+
+    _Rules_Index_Reader *reader = rules_index_reader;
+
+    if ( reader != NULL )
+        {
+            return(reader);
+        }
+
+    if ( posix_memalign((void **)&reader, 64, sizeof(_Rules_Index_Reader)) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Rules_Index_Reader. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(reader, 0, sizeof(_Rules_Index_Reader));
+
+    reader->next = __atomic_load_n(&rules_index_readers, __ATOMIC_RELAXED);
+
+    while ( __atomic_compare_exchange_n(&rules_index_readers, &reader->next, reader, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED) == false );
+
+    rules_index_reader = reader;
+
+    return(reader);
+}
+
+/****************************************************************************
+ * Rules_Index_Order - Sets "order" to the candidate rules in the order they
+ * should be checked and returns how many there are.  That is load order
+ * unless "rule-reorder" is enabled.  The list is per thread and good until
+ * the next call.
+ ****************************************************************************/
+
+static int Rules_Index_Order_Compare( const void *a, const void *b )
+{
+
+    uint32_t rank_a = rules_index_order_rank[*(const uint32_t *)a];
+    uint32_t rank_b = rules_index_order_rank[*(const uint32_t *)b];
+
+    return( rank_a < rank_b ? -1 : rank_a > rank_b );
+}
+
+uint32_t Rules_Index_Order( _Rules_Index *index, uint64_t *candidates, uint32_t **order )
+{
+
+    _Rules_Index_Reader *reader = NULL;
+
+    uint32_t *rank = NULL;
+    uint32_t count = 0;
+    uint32_t rule = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    if ( rules_index_order_size < index->rule_count )
+        {
+
+            rules_index_order = realloc(rules_index_order, index->rule_count * sizeof(uint32_t));
+
+            if ( rules_index_order == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for rules_index_order. Abort!", __FILE__, __LINE__);
+                }
+
+            rules_index_order_size = index->rule_count;
+        }
+
+    *order = rules_index_order;
+
+    for ( rule = Rules_Index_Next(index, candidates, 0); rule < index->rule_count; rule = Rules_Index_Next(index, candidates, rule + 1) )
+        {
+            rules_index_order[count++] = rule;
+        }
+
+    if ( config->rule_reorder == false || count < 2 )
+        {
+            return(count);
+        }
+
+    /* Say which generation we're on before picking up the rank array,  so
+       a re-rank that swaps it out keeps it around until we're done */
+
+    reader = Rules_Index_Reader();
+
+    __atomic_store_n(&reader->active, __atomic_load_n(&rules_index_generation, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    rank = __atomic_load_n(&index->rank, __ATOMIC_SEQ_CST);
+
+    /* There are usually only a few candidates left,  so an insertion sort
+       does.  Big lists get qsort() */
+
+    if ( count > 16 )
+        {
+            rules_index_order_rank = rank;
+            qsort(rules_index_order, count, sizeof(uint32_t), Rules_Index_Order_Compare);
+        }
+
+    else
+        {
+
+            for ( i = 1; i < count; i++ )
+                {
+
+                    rule = rules_index_order[i];
+
+                    for ( j = i; j > 0 && rank[rules_index_order[j - 1]] > rank[rule]; j-- )
+                        {
+                            rules_index_order[j] = rules_index_order[j - 1];
+                        }
+
+                    rules_index_order[j] = rule;
+                }
+        }
+
+    __atomic_store_n(&reader->active, 0, __ATOMIC_RELEASE);
+
+    return(count);
+}
+
+/****************************************************************************
+ * Rules_Index_Rank - Re-ranks the rules from the stats workers recorded.
+ * The new order is built in a fresh rank array and swapped in.  The old
+ * one is retired and freed by a later re-rank once no worker can still be
+ * sorting with it (see rules-index.h).
+ ****************************************************************************/
+
+static int Rules_Index_Rank_Compare( const void *a, const void *b )
+{
+
+    uint32_t rule_a = *(const uint32_t *)a;
+    uint32_t rule_b = *(const uint32_t *)b;
+
+    _Rules_Index_Stats *stats_a = &rules_index_rank_stats[rule_a];
+    _Rules_Index_Stats *stats_b = &rules_index_rank_stats[rule_b];
+
+    double fired_a = stats_a->checked ? (double)stats_a->fired / stats_a->checked : 0;
+    double fired_b = stats_b->checked ? (double)stats_b->fired / stats_b->checked : 0;
+    double cost_a = stats_a->checked ? (double)stats_a->cost / stats_a->checked : 0;
+    double cost_b = stats_b->checked ? (double)stats_b->cost / stats_b->checked : 0;
+
+    /* Fire most often first */
+
+    if ( fired_a != fired_b )
+        {
+            return( fired_a > fired_b ? -1 : 1 );
+        }
+
+    /* Never (or equally) fire.  Cheapest to rule out first */
+
+    if ( cost_a != cost_b )
+        {
+            return( cost_a < cost_b ? -1 : 1 );
+        }
+
+    return( rule_a < rule_b ? -1 : rule_a > rule_b );
+}
+
+static void Rules_Index_Rank( _Rules_Index *index )
+{
+
+    _Rules_Index_Reader *reader = NULL;
+    _Rules_Index_Retired *retired = NULL;
+    _Rules_Index_Retired **prev = NULL;
+
+    uint32_t *sorted = NULL;
+    uint32_t *rank = NULL;
+    uint32_t rule = 0;
+    uint32_t pinned = 0;
+    uint32_t i = 0;
+
+    uint64_t generation = 0;
+    uint64_t oldest = 0;
+    uint64_t active = 0;
+
+    sorted = malloc(index->rule_count * sizeof(uint32_t));
+    rank = calloc(index->rule_count + 1, sizeof(uint32_t));
+    retired = malloc(sizeof(_Rules_Index_Retired));
+    rules_index_rank_stats = malloc(index->rule_count * sizeof(_Rules_Index_Stats));
+
+    if ( sorted == NULL || rank == NULL || retired == NULL || rules_index_rank_stats == NULL )
+        {
+            Sagan_Log(WARN, "[%s, line %d] Failed to allocate memory to re-rank rules. Keeping the current order.", __FILE__, __LINE__);
+            free(sorted);
+            free(rank);
+            free(retired);
+            free(rules_index_rank_stats);
+            rules_index_rank_stats = NULL;
+            return;
+        }
+
+    /* Work from a copy.  Workers keep adding to the stats while we sort.
+       Halve the stats as we go so the order follows changes in traffic */
+
+    for ( rule = 0; rule < index->rule_count; rule++ )
+        {
+
+            rules_index_rank_stats[rule].checked = __atomic_load_n(&index->stats[rule].checked, __ATOMIC_RELAXED);
+            rules_index_rank_stats[rule].fired = __atomic_load_n(&index->stats[rule].fired, __ATOMIC_RELAXED);
+            rules_index_rank_stats[rule].cost = __atomic_load_n(&index->stats[rule].cost, __ATOMIC_RELAXED);
+
+            __atomic_store_n(&index->stats[rule].checked, rules_index_rank_stats[rule].checked / 2, __ATOMIC_RELAXED);
+            __atomic_store_n(&index->stats[rule].fired, rules_index_rank_stats[rule].fired / 2, __ATOMIC_RELAXED);
+            __atomic_store_n(&index->stats[rule].cost, rules_index_rank_stats[rule].cost / 2, __ATOMIC_RELAXED);
+
+            sorted[rule] = rule;
+        }
+
+    qsort(sorted, index->rule_count, sizeof(uint32_t), Rules_Index_Rank_Compare);
+
+    /* xbit and dynamic_load rules can depend on the rules before them
+       (an xbit "set" then "isset" in the same event).  They go back in
+       the slots they were sorted to,  but in load order */
+
+    for ( i = 0; i < index->rule_count; i++ )
+        {
+
+            if ( rulestruct[sorted[i]].xbit_flag == false && rulestruct[sorted[i]].type != DYNAMIC_RULE )
+                {
+                    continue;
+                }
+
+            while ( rulestruct[pinned].xbit_flag == false && rulestruct[pinned].type != DYNAMIC_RULE )
+                {
+                    pinned++;
+                }
+
+            sorted[i] = pinned++;
+        }
+
+    for ( i = 0; i < index->rule_count; i++ )
+        {
+            rank[sorted[i]] = i;
+        }
+
+    /* Publish the new order,  then move on to the next generation.  Workers
+       that pick up the new generation are sure to see the new array */
+
+    retired->rank = __atomic_exchange_n(&index->rank, rank, __ATOMIC_SEQ_CST);
+    generation = __atomic_add_fetch(&rules_index_generation, 1, __ATOMIC_SEQ_CST);
+
+    retired->generation = generation;
+    retired->next = index->rank_retired;
+    index->rank_retired = retired;
+
+    /* Free the retired arrays no worker can still be using.  Only the
+       worker holding index->ranking gets here */
+
+    oldest = generation;
+
+    for ( reader = __atomic_load_n(&rules_index_readers, __ATOMIC_ACQUIRE); reader != NULL; reader = reader->next )
+        {
+
+            active = __atomic_load_n(&reader->active, __ATOMIC_SEQ_CST);
+
+            if ( active != 0 && active < oldest )
+                {
+                    oldest = active;
+                }
+        }
+
+    prev = &index->rank_retired;
+
+    while ( *prev != NULL )
+        {
+
+            retired = *prev;
+
+            if ( retired->generation <= oldest )
+                {
+                    *prev = retired->next;
+                    free(retired->rank);
+                    free(retired);
+                    continue;
+                }
+
+            prev = &retired->next;
+        }
+
+    free(sorted);
+    free(rules_index_rank_stats);
+    rules_index_rank_stats = NULL;
+
+}
+
+/****************************************************************************
+ * Rules_Index_Sample - Called once per event.  Returns true if this event's
+ * rule stats should be recorded (see Rules_Index_Record()).  When it's
+ * time,  the worker that gets here first re-ranks the rules.
+ ****************************************************************************/
+
+bool Rules_Index_Sample( _Rules_Index *index )
+{
+
+    uint64_t events = 0;
+
+    if ( config->rule_reorder == false )
+        {
+            return(false);
+        }
+
+    if ( ( ++rules_index_events & ( RULE_REORDER_SAMPLE - 1 ) ) != 0 )
+        {
+            return(false);
+        }
+
+    /* Each sample stands in for RULE_REORDER_SAMPLE events */
+
+    events = __atomic_add_fetch(&index->events, RULE_REORDER_SAMPLE, __ATOMIC_RELAXED);
+
+    if ( events / config->rule_reorder_interval != ( events - RULE_REORDER_SAMPLE ) / config->rule_reorder_interval &&
+            __atomic_exchange_n(&index->ranking, true, __ATOMIC_ACQUIRE) == false )
+        {
+            Rules_Index_Rank(index);
+            __atomic_store_n(&index->ranking, false, __ATOMIC_RELEASE);
+        }
+
+    return(true);
+}
+
+/****************************************************************************
+ * Rules_Index_Record - Adds a sampled rule check to the rule's stats
+ ****************************************************************************/
+
+void Rules_Index_Record( _Rules_Index *index, uint32_t rule, bool fired, uint64_t cost )
+{
+
+    __atomic_add_fetch(&index->stats[rule].checked, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&index->stats[rule].cost, cost, __ATOMIC_RELAXED);
+
+    if ( fired == true )
+        {
+            __atomic_add_fetch(&index->stats[rule].fired, 1, __ATOMIC_RELAXED);
+        }
+
+}
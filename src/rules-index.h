@@ -0,0 +1,174 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+
+/* The rule "header" (program, facility, syslog priority, level and tag) is
+ * compiled into an index when rules are loaded so the engine only looks at
+ * rules that could match an event.  Programs are hashed (exact) or put in
+ * a trie keyed on the text before the first wildcard.  The other fields
+ * have few possible values,  so each value gets a bitmap of the rules that
+ * can match it.  Last,  each rule's longest (or "fast_pattern") content
+ * goes into one Aho-Corasick automaton so a single pass over the message
+ * drops the rules whose content can't be there. */
+
+typedef struct _Rules_Index_Entry _Rules_Index_Entry;
+struct _Rules_Index_Entry
+{
+    char *value;
+    uint32_t *rules;			/* program: rules using this value */
+    uint32_t rule_count;
+    uint64_t *bits;			/* other fields: rules that pass with this value */
+    _Rules_Index_Entry *next;
+};
+
+typedef struct _Rules_Index_Field _Rules_Index_Field;
+struct _Rules_Index_Field
+{
+    _Rules_Index_Entry **hash;
+    uint32_t hash_mask;
+    uint64_t *any;			/* Rules that don't use this field */
+    bool used;
+};
+
+typedef struct _Rules_Index_Wildcard _Rules_Index_Wildcard;
+struct _Rules_Index_Wildcard
+{
+    char *pattern;
+    uint32_t rule;
+    bool prefix_only;			/* "sshd*".  Reaching the node is a match */
+    _Rules_Index_Wildcard *next;
+};
+
+typedef struct _Rules_Index_Trie _Rules_Index_Trie;
+struct _Rules_Index_Trie
+{
+    unsigned char c;
+    _Rules_Index_Trie *child;
+    _Rules_Index_Trie *next;
+    _Rules_Index_Wildcard *patterns;
+};
+
+/* With "rule-reorder" enabled,  1 in RULE_REORDER_SAMPLE events records how
+ * long each candidate rule took and if it fired.  Every
+ * "rule-reorder-interval" events the rules are re-ranked: rules that fire
+ * most often first,  rules that never fire last (cheapest first).  Rules
+ * with xbits or dynamic_load depend on the rules before them,  so they keep
+ * their load order among themselves. */
+
+typedef struct _Rules_Index_Stats _Rules_Index_Stats;
+struct _Rules_Index_Stats
+{
+    uint64_t checked;
+    uint64_t fired;
+    uint64_t cost;			/* Nanoseconds,  sampled events only */
+};
+
+/* A re-rank never writes to a rank array a worker might be sorting with.
+ * It publishes a new one and retires the old.  Each worker says which
+ * generation of rank array it picked up (0 when it isn't sorting),  and a
+ * retired array is freed once no worker is on an older generation. */
+
+typedef struct _Rules_Index_Retired _Rules_Index_Retired;
+struct _Rules_Index_Retired
+{
+    uint32_t *rank;
+    uint64_t generation;		/* The generation that replaced it */
+    _Rules_Index_Retired *next;
+};
+
+typedef struct _Rules_Index_Reader _Rules_Index_Reader;
+struct _Rules_Index_Reader
+{
+    uint64_t active;			/* Generation in use.  0 == none */
+    _Rules_Index_Reader *next;
+    char pad[48];			/* One per cache line */
+};
+
+/* The "hot" side of the rules.  Checking a rule against a message only
+ * needs its plan and the content/pcre it searches for.  In rulestruct
+ * those are spread over a dozen MAX_CONTENT sized arrays,  between the
+ * msg,  references and such that are only used on an alert.  The index
+ * keeps its own copy,  by rule (hot_type,  hot_plan_*) and one step after
+ * another (hot_steps),  so a rule's message checks come from a couple of
+ * cache lines.  The rest of the plan (flow,  xbits,  etc) runs after the
+ * message matched and still reads rulestruct. */
+
+typedef struct _Rules_Index_Step _Rules_Index_Step;
+struct _Rules_Index_Step
+{
+    unsigned char type;			/* PLAN_* */
+    unsigned char index;		/* Which content,  pcre or meta_content */
+    bool nocase;
+    bool negated;			/* content: ! */
+    int len;
+    int offset;
+    int depth;
+    int distance;
+    int within;
+    int prev_depth;			/* Depth of the content/meta_content before it */
+    const char *content;
+    pcre *re;
+    pcre_extra *extra;
+};
+
+typedef struct _Rules_Index _Rules_Index;
+struct _Rules_Index
+{
+    uint32_t rule_count;
+    uint32_t words;			/* uint64_t's per bitmap */
+
+    _Rules_Index_Field program;
+    _Rules_Index_Trie *program_wildcard;
+
+    _Rules_Index_Field facility;
+    _Rules_Index_Field syspri;
+    _Rules_Index_Field level;
+    _Rules_Index_Field tag;
+
+    struct _Sagan_AC *content;
+    uint64_t *content_any;		/* Rules without a usable content */
+
+    unsigned char *hot_type;		/* NORMAL_RULE/DYNAMIC_RULE */
+    unsigned char *hot_plan_count;
+    unsigned char *hot_plan_message_count;
+    uint32_t *hot_plan_start;		/* First of the rule's hot_steps */
+    _Rules_Index_Step *hot_steps;
+
+    _Rules_Index_Stats *stats;
+    uint32_t *rank;			/* Evaluation order,  by rule */
+    _Rules_Index_Retired *rank_retired;
+    uint64_t events;
+    bool ranking;			/* A worker is re-ranking */
+
+    _Rules_Index *retired;		/* Replaced by a dynamic rule load */
+};
+
+void Rules_Index_Build( bool full_reload );
+_Rules_Index *Rules_Index_Candidates( struct _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, uint64_t **candidates );
+uint32_t Rules_Index_Next( _Rules_Index *index, uint64_t *candidates, uint32_t rule );
+uint32_t Rules_Index_Order( _Rules_Index *index, uint64_t *candidates, uint32_t **order );
+bool Rules_Index_Sample( _Rules_Index *index );
+void Rules_Index_Record( _Rules_Index *index, uint32_t rule, bool fired, uint64_t cost );
+
@@ -0,0 +1,287 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+/* rules-plan.c
+ *
+ * Compiles a rule into the order the engine evaluates it in (see
+ * rules-plan.h).  Each step gets a rough cost and the steps are sorted
+ * cheapest first.  Steps that cost the same keep the order they were
+ * written in the rule.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "sagan-config.h"
+#include "rules.h"
+#include "rules-plan.h"
+
+struct _SaganConfig *config;
+struct _SaganDebug *debug;
+struct _Rule_Struct *rulestruct;
+
+/****************************************************************************
+ * Rules_Plan_Cost - How expensive a step is.  These are relative,  not
+ * measured.  A content that must be there rules out more than one that
+ * must not be (content: !),  so it goes first.  Redis xbits are a
+ * network round trip.
+ ****************************************************************************/
+
+static int Rules_Plan_Cost( int rule_position, _Rule_Plan_Step *step )
+{
+
+    switch ( step->type )
+        {
+
+        case PLAN_TIME:
+            return(1);
+
+        case PLAN_CONTENT:
+            return( rulestruct[rule_position].content_not[step->index] ? 3 : 2 );
+
+        case PLAN_META_CONTENT:
+            return(4);
+
+        case PLAN_PCRE:
+            return(6);
+
+        case PLAN_FLOW:
+            return(1);
+
+        case PLAN_BLACKLIST:
+            return(2);
+
+        case PLAN_GEOIP2:
+        case PLAN_BROINTEL:
+            return(3);
+
+        case PLAN_XBIT:
+            return( config->xbit_storage == XBIT_STORAGE_REDIS ? 8 : 4 );
+
+        case PLAN_BLUEDOT:
+            return(9);
+
+        }
+
+    return(10);
+}
+
+/****************************************************************************
+ * Rules_Plan_Add - Adds a step to the end of the plan.
+ ****************************************************************************/
+
+static void Rules_Plan_Add( int rule_position, unsigned char type, unsigned char index )
+{
+
+    _Rule_Plan_Step *step = &rulestruct[rule_position].plan[rulestruct[rule_position].plan_count];
+
+    step->type = type;
+    step->index = index;
+
+    rulestruct[rule_position].plan_count++;
+}
+
+/****************************************************************************
+ * Rules_Plan_Sort - Insertion sort of plan[start] to plan[end-1] by cost.
+ * It's stable and plans are short.
+ ****************************************************************************/
+
+static void Rules_Plan_Sort( int rule_position, int start, int end )
+{
+
+    _Rule_Plan_Step *plan = rulestruct[rule_position].plan;
+    _Rule_Plan_Step tmp;
+
+    int i = 0;
+    int j = 0;
+
+    for ( i = start + 1; i < end; i++ )
+        {
+
+            tmp = plan[i];
+
+            for ( j = i; j > start && Rules_Plan_Cost(rule_position, &plan[j-1]) > Rules_Plan_Cost(rule_position, &tmp); j-- )
+                {
+                    plan[j] = plan[j-1];
+                }
+
+            plan[j] = tmp;
+        }
+}
+
+/****************************************************************************
+ * Rules_Plan_Compile - Builds the plan for a rule.  Called once the rule
+ * is completely loaded.
+ ****************************************************************************/
+
+void Rules_Plan_Compile( int rule_position )
+{
+
+    int i = 0;
+
+    rulestruct[rule_position].plan_count = 0;
+
+    /* Only need the message */
+
+    if ( rulestruct[rule_position].alert_time_flag )
+        {
+            Rules_Plan_Add(rule_position, PLAN_TIME, 0);
+        }
+
+    for ( i = 0; i < rulestruct[rule_position].content_count; i++ )
+        {
+            Rules_Plan_Add(rule_position, PLAN_CONTENT, i);
+        }
+
+    for ( i = 0; i < rulestruct[rule_position].meta_content_count; i++ )
+        {
+            Rules_Plan_Add(rule_position, PLAN_META_CONTENT, i);
+        }
+
+    for ( i = 0; i < rulestruct[rule_position].pcre_count; i++ )
+        {
+            Rules_Plan_Add(rule_position, PLAN_PCRE, i);
+        }
+
+    rulestruct[rule_position].plan_message_count = rulestruct[rule_position].plan_count;
+
+    Rules_Plan_Sort(rule_position, 0, rulestruct[rule_position].plan_message_count);
+
+    /* Need the addresses,  ports,  etc */
+
+    if ( rulestruct[rule_position].has_flow )
+        {
+            Rules_Plan_Add(rule_position, PLAN_FLOW, 0);
+        }
+
+    if ( rulestruct[rule_position].xbit_flag )
+        {
+            Rules_Plan_Add(rule_position, PLAN_XBIT, 0);
+        }
+
+#ifdef HAVE_LIBMAXMINDDB
+
+    if ( rulestruct[rule_position].geoip2_flag )
+        {
+            Rules_Plan_Add(rule_position, PLAN_GEOIP2, 0);
+        }
+
+#endif
+
+    if ( rulestruct[rule_position].blacklist_flag )
+        {
+            Rules_Plan_Add(rule_position, PLAN_BLACKLIST, 0);
+        }
+
+#ifdef WITH_BLUEDOT
+
+    if ( rulestruct[rule_position].bluedot_ipaddr_type || rulestruct[rule_position].bluedot_file_hash ||
+            rulestruct[rule_position].bluedot_url || rulestruct[rule_position].bluedot_filename )
+        {
+            Rules_Plan_Add(rule_position, PLAN_BLUEDOT, 0);
+        }
+
+#endif
+
+    if ( rulestruct[rule_position].brointel_flag )
+        {
+            Rules_Plan_Add(rule_position, PLAN_BROINTEL, 0);
+        }
+
+    Rules_Plan_Sort(rule_position, rulestruct[rule_position].plan_message_count, rulestruct[rule_position].plan_count);
+
+    if ( debug->debugplan )
+        {
+            Rules_Plan_Dump(rule_position);
+        }
+}
+
+/****************************************************************************
+ * Rules_Plan_Dump - Logs a rule's plan (-d plan)
+ ****************************************************************************/
+
+void Rules_Plan_Dump( int rule_position )
+{
+
+    _Rule_Plan_Step *step = NULL;
+    int i = 0;
+
+    Sagan_Log(DEBUG, "[%s, line %d] Plan for sid %s (%d steps,  %d on the message only):", __FILE__, __LINE__, rulestruct[rule_position].s_sid, rulestruct[rule_position].plan_count, rulestruct[rule_position].plan_message_count);
+
+    for ( i = 0; i < rulestruct[rule_position].plan_count; i++ )
+        {
+
+            step = &rulestruct[rule_position].plan[i];
+
+            switch ( step->type )
+                {
+
+                case PLAN_TIME:
+                    Sagan_Log(DEBUG, "    [%d] alert_time (cost %d)", i, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_CONTENT:
+                    Sagan_Log(DEBUG, "    [%d] content %d: %s\"%s\" (cost %d)", i, step->index,
+                              rulestruct[rule_position].content_not[step->index] ? "!" : "",
+                              rulestruct[rule_position].s_content[step->index], Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_META_CONTENT:
+                    Sagan_Log(DEBUG, "    [%d] meta_content %d (cost %d)", i, step->index, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_PCRE:
+                    Sagan_Log(DEBUG, "    [%d] pcre %d (cost %d)", i, step->index, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_FLOW:
+                    Sagan_Log(DEBUG, "    [%d] flow (cost %d)", i, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_BLACKLIST:
+                    Sagan_Log(DEBUG, "    [%d] blacklist (cost %d)", i, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_GEOIP2:
+                    Sagan_Log(DEBUG, "    [%d] country_code (cost %d)", i, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_BROINTEL:
+                    Sagan_Log(DEBUG, "    [%d] bro-intel (cost %d)", i, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_XBIT:
+                    Sagan_Log(DEBUG, "    [%d] xbits (cost %d)", i, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                case PLAN_BLUEDOT:
+                    Sagan_Log(DEBUG, "    [%d] bluedot (cost %d)", i, Rules_Plan_Cost(rule_position, step));
+                    break;
+
+                }
+        }
+}
@@ -0,0 +1,48 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+/* Each rule is compiled into an evaluation plan when it is loaded.  The
+ * plan lists the rule's tests cheapest first so the engine can stop at
+ * the first one that fails.  Steps that only need the message (content,
+ * pcre,  etc) come before steps that need the addresses,  ports and such
+ * pulled from it (flow,  xbits,  GeoIP2,  etc). */
+
+/* Only need the message */
+
+#define PLAN_TIME		1
+#define PLAN_CONTENT		2
+#define PLAN_META_CONTENT	3
+#define PLAN_PCRE		4
+
+/* Need the addresses,  ports,  etc. */
+
+#define PLAN_FLOW		10
+#define PLAN_BLACKLIST		11
+#define PLAN_GEOIP2		12
+#define PLAN_BROINTEL		13
+#define PLAN_XBIT		14
+#define PLAN_BLUEDOT		15
+
+void Rules_Plan_Compile( int rule_position );
+void Rules_Plan_Dump( int rule_position );
@@ -55,6 +55,9 @@
 #include "rules.h"
 #include "sagan-config.h"
 #include "parsers/parsers.h"
+#include "util-ac.h"
+#include "util-arena.h"
+#include "rules-plan.h"
 
 #ifdef WITH_BLUEDOT
 #include "processors/bluedot.h"
@@ -88,8 +91,38 @@ int liblognorm_count;
 #endif
 
 struct _Rule_Struct *rulestruct = NULL;
+static int rulestruct_size = 0;			/* Rules rulestruct has room for */
 struct _Class_Struct *classstruct = NULL;
 
+/* Strings and lists whose size depends on the rule (content,  flows,
+ * meta_content items,  etc) are kept here rather than in fixed size
+ * arrays in _Rule_Struct.  It is freed on reload (see Free_Rules()) */
+
+static _Sagan_Arena *rules_arena = NULL;
+
+#ifdef PCRE_HAVE_JIT
+
+/****************************************************************************
+ * Rules_PCRE_JIT_Stack - PCRE calls this (from whichever worker is running
+ * pcre_exec()) to get the JIT stack.  Each thread gets its own,  made the
+ * first time it's needed.  Returning NULL falls back to PCRE's 32k default.
+ ****************************************************************************/
+
+static pcre_jit_stack *Rules_PCRE_JIT_Stack( void *data )
+{
+
+    static __thread pcre_jit_stack *jit_stack = NULL;
+
+    if ( jit_stack == NULL )
+        {
+            jit_stack = pcre_jit_stack_alloc(PCRE_JIT_STACK_START, config->pcre_jit_stack);
+        }
+
+    return(jit_stack);
+}
+
+#endif
+
 void Load_Rules( const char *ruleset )
 {
 
@@ -109,8 +142,6 @@ void Load_Rules( const char *ruleset )
 
     char nettmp[64];
 
-    char tolower_tmp[512];
-
     char *tokenrule;
     char *tokennet;
     char *rulesplit;
@@ -173,10 +204,30 @@ void Load_Rules( const char *ruleset )
     int port_1_count=0;
     int port_2_count=0;
 
+    /* Flows,  ports and meta_content items are collected here.  Once the
+       rule is parsed,  only what was used is copied to the rules arena */
+
+    struct arr_flow_1 flow_1[MAX_CHECK_FLOWS+1];
+    struct arr_flow_2 flow_2[MAX_CHECK_FLOWS+1];
+    struct arr_port_1 port_1[MAX_CHECK_FLOWS+1];
+    struct arr_port_2 port_2[MAX_CHECK_FLOWS+1];
+
+    int flow_1_type[MAX_CHECK_FLOWS+2];
+    int flow_2_type[MAX_CHECK_FLOWS+2];
+    int port_1_type[MAX_CHECK_FLOWS+2];
+    int port_2_type[MAX_CHECK_FLOWS+2];
+
+    char *meta_items[MAX_META_CONTENT_ITEMS];
+    char meta_content_help[CONFBUF];
+
     bool pcreflag=0;
     int pcreoptions=0;
+    int pcrestudy=0;
 
     int i=0;
+    int z=0;
+
+    _Sagan_AC *meta_ac = NULL;
     int d;
 
     int rc=0;
@@ -197,6 +248,11 @@ void Load_Rules( const char *ruleset )
 
     Sagan_Log(NORMAL, "Loading %s rule file.", ruleset_fullname);
 
+    if ( rules_arena == NULL )
+        {
+            rules_arena = Sagan_Arena_Init(0);
+        }
+
     while ( fgets(rulebuf, sizeof(rulebuf), rulesfile) != NULL )
         {
             /* Reset for next rule */
@@ -217,6 +273,15 @@ void Load_Rules( const char *ruleset )
             memset(netstr, 0, sizeof(netstr));
             memset(rulestr, 0, sizeof(rulestr));
 
+            memset(flow_1, 0, sizeof(flow_1));
+            memset(flow_2, 0, sizeof(flow_2));
+            memset(port_1, 0, sizeof(port_1));
+            memset(port_2, 0, sizeof(port_2));
+            memset(flow_1_type, 0, sizeof(flow_1_type));
+            memset(flow_2_type, 0, sizeof(flow_2_type));
+            memset(port_1_type, 0, sizeof(port_1_type));
+            memset(port_2_type, 0, sizeof(port_2_type));
+
             int f1=0; /* Need for flow_direction, must reset every rule, not every group */
             int f2=0; /* Need for flow_direction, must reset every rule, not every group */
             int g1=0; /* Need for port_direction, must reset every rule, not every group */
@@ -233,12 +298,20 @@ void Load_Rules( const char *ruleset )
             else
                 {
 
-                    /* Allocate memory for rules, but not comments */
+                    /* Allocate memory for rules, but not comments.  Room is
+                       doubled as needed rather than grown a rule at a time */
 
-                    rulestruct = (_Rule_Struct *) realloc(rulestruct, (counters->rulecount+1) * sizeof(_Rule_Struct));
-                    if ( rulestruct == NULL )
+                    if ( counters->rulecount >= rulestruct_size )
                         {
-                            Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for rulestruct. Abort!", __FILE__, __LINE__);
+
+                            rulestruct_size = rulestruct_size == 0 ? 256 : rulestruct_size * 2;
+
+                            rulestruct = (_Rule_Struct *) realloc(rulestruct, rulestruct_size * sizeof(_Rule_Struct));
+
+                            if ( rulestruct == NULL )
+                                {
+                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for rulestruct. Abort!", __FILE__, __LINE__);
+                                }
                         }
 
                     memset(&rulestruct[counters->rulecount], 0, sizeof(struct _Rule_Struct));
@@ -495,7 +568,7 @@ void Load_Rules( const char *ruleset )
 
                                             f1++;
 
-                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&rulestruct[counters->rulecount].flow_1[flow_1_count].range);
+                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&flow_1[flow_1_count].range);
 
                                             if(strchr(tmptoken, '/'))
                                                 {
@@ -503,23 +576,23 @@ void Load_Rules( const char *ruleset )
                                                     if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                         {
 
-                                                            rulestruct[counters->rulecount].flow_1_type[f1] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
+                                                            flow_1_type[f1] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].flow_1_type[f1] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
+                                                            flow_1_type[f1] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
                                                         }
                                                 }
                                             else if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                 {
 
-                                                    rulestruct[counters->rulecount].flow_1_type[f1] = 2; /* 2 = not match ip */
+                                                    flow_1_type[f1] = 2; /* 2 = not match ip */
                                                 }
                                             else
                                                 {
 
-                                                    rulestruct[counters->rulecount].flow_1_type[f1] = 3; /* 3 = match ip */
+                                                    flow_1_type[f1] = 3; /* 3 = match ip */
                                                 }
 
                                             flow_1_count++;
@@ -528,7 +601,7 @@ void Load_Rules( const char *ruleset )
                                                 {
                                                     bad_rule = true;
                                                     Sagan_Log(WARN,"[%s, line %d] You have exceeded the amount of IP's for flow_1 '50', skipping rule.", __FILE__, __LINE__);
-                                                    continue;
+                                                    break;
                                                 }
                                             printf("%d\n", flow_1_count);
                                         }
@@ -555,7 +628,7 @@ void Load_Rules( const char *ruleset )
                                             g1++;
                                             if (Is_Numeric(nettmp))
                                                 {
-                                                    rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
+                                                    port_1[port_1_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
                                                 }
 
                                             if (!strncmp(tmptoken,"!", 1) || !strncmp("not", tmptoken, 3))
@@ -563,16 +636,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2,':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 0; /* 0 = not in group */
+                                                            port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            port_1_type[g1] = 0; /* 0 = not in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 2; /* This was a single port, not a range */
+                                                            port_1[port_1_count].lo = atoi(tok_help2);
+                                                            port_1_type[g1] = 2; /* This was a single port, not a range */
 
                                                         }
                                                 }
@@ -581,16 +654,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2, ':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 1; /* 1 = in group */
+                                                            port_1[port_1_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            port_1[port_1_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            port_1_type[g1] = 1; /* 1 = in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_1[port_1_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_1_type[g1] = 3; /* This was a single port, not a range */
+                                                            port_1[port_1_count].lo = atoi(tok_help2);
+                                                            port_1_type[g1] = 3; /* This was a single port, not a range */
 
                                                         }
 
@@ -601,7 +674,7 @@ void Load_Rules( const char *ruleset )
                                                 {
                                                     Sagan_Log(WARN,"[%s, line %d] You have exceeded the amount of Ports for port_1 '%d', skipping rule.", __FILE__, __LINE__, MAX_CHECK_FLOWS);
                                                     bad_rule = true;
-                                                    continue;
+                                                    break;
                                                 }
 
                                         }
@@ -687,32 +760,32 @@ void Load_Rules( const char *ruleset )
 
                                             f2++;
 
-                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&rulestruct[counters->rulecount].flow_2[flow_2_count].range);
+                                            is_masked = Netaddr_To_Range(tmptoken, (unsigned char *)&flow_2[flow_2_count].range);
 
                                             if(strchr(tmptoken, '/'))
                                                 {
                                                     if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                         {
-                                                            rulestruct[counters->rulecount].flow_2_type[f2] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
+                                                            flow_2_type[f2] = is_masked ? 0 : 2; /* 0 = not in group, 2 == IP not range */
                                                         }
                                                     else
                                                         {
-                                                            rulestruct[counters->rulecount].flow_2_type[f2] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
+                                                            flow_2_type[f2] = is_masked ? 1 : 3; /* 1 = in group, 3 == IP not range */
                                                         }
                                                 }
                                             else if( !strncmp(tmptoken, "!", 1) || !strncmp("not", tmptoken, 3))
                                                 {
-                                                    rulestruct[counters->rulecount].flow_2_type[f2] = 2; /* 2 = not match ip */
+                                                    flow_2_type[f2] = 2; /* 2 = not match ip */
                                                 }
                                             else
                                                 {
-                                                    rulestruct[counters->rulecount].flow_2_type[f2] = 3; /* 3 = match ip */
+                                                    flow_2_type[f2] = 3; /* 3 = match ip */
                                                 }
                                             if( flow_2_count > MAX_CHECK_FLOWS )
                                                 {
                                                     bad_rule = true;
                                                     Sagan_Log(WARN,"[%s, line %d] You have exceeded the amount of entries for follow_flow_2 '50', skipping.", __FILE__, __LINE__);
-                                                    continue;
+                                                    break;
                                                 }
                                         }
                                     rulestruct[counters->rulecount].flow_2_var = 1;   /* 1 = var */
@@ -738,7 +811,7 @@ void Load_Rules( const char *ruleset )
                                             g2++;
                                             if (Is_Numeric(nettmp))
                                                 {
-                                                    rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
+                                                    port_2[port_2_count].lo = atoi(nettmp);          /* If it's a number (see Var_To_Value),  then set to that */
                                                 }
 
                                             if (!strncmp(tmptoken,"!", 1) || !strncmp("not", tmptoken, 3))
@@ -746,16 +819,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2,':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 0; /* 0 = not in group */
+                                                            port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            port_2_type[g2] = 0; /* 0 = not in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 2; /* This was a single port, not a range */
+                                                            port_2[port_2_count].lo = atoi(tok_help2);
+                                                            port_2_type[g2] = 2; /* This was a single port, not a range */
 
                                                         }
                                                 }
@@ -764,16 +837,16 @@ void Load_Rules( const char *ruleset )
                                                     if(strchr(tok_help2, ':'))
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 1; /* 1 = in group */
+                                                            port_2[port_2_count].lo = atoi(strtok_r(tok_help2, ":", &saveptrportrange));
+                                                            port_2[port_2_count].hi = atoi(strtok_r(NULL, ":", &saveptrportrange));
+                                                            port_2_type[g2] = 1; /* 1 = in group */
 
                                                         }
                                                     else
                                                         {
 
-                                                            rulestruct[counters->rulecount].port_2[port_2_count].lo = atoi(tok_help2);
-                                                            rulestruct[counters->rulecount].port_2_type[g2] = 3; /* This was a single port, not a range */
+                                                            port_2[port_2_count].lo = atoi(tok_help2);
+                                                            port_2_type[g2] = 3; /* This was a single port, not a range */
 
                                                         }
 
@@ -784,7 +857,7 @@ void Load_Rules( const char *ruleset )
                                                 {
                                                     bad_rule = true;
                                                     Sagan_Log(WARN,"[%s, line %d] You have exceeded the amount of Ports for port_2 '%d', skipping.", __FILE__, __LINE__, MAX_CHECK_FLOWS);
-                                                    continue;
+                                                    break;
                                                 }
 
                                         }
@@ -1584,7 +1657,7 @@ void Load_Rules( const char *ruleset )
 
                             Content_Pipe(tmp2, linecount, ruleset_fullname, rule_tmp, sizeof(rule_tmp));
 
-                            strlcpy(rulestruct[counters->rulecount].meta_content_help[meta_content_count], rule_tmp, sizeof(rulestruct[counters->rulecount].meta_content_help[meta_content_count]));
+                            strlcpy(meta_content_help, rule_tmp, sizeof(meta_content_help));
 
                             tmptoken = strtok_r(NULL, ";", &saveptrrule2);           /* Grab Search data */
 
@@ -1607,21 +1680,22 @@ void Load_Rules( const char *ruleset )
                             while (ptmp != NULL)
                                 {
 
-                                    Replace_Sagan(rulestruct[counters->rulecount].meta_content_help[meta_content_count], ptmp, tmp_help, sizeof(tmp_help));
-                                    strlcpy(rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count], tmp_help, sizeof(rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted[meta_content_converted_count]));
-
-                                    meta_content_converted_count++;
-
-                                    if ( meta_content_converted_count > MAX_META_ITEM_SIZE )
+                                    if ( meta_content_converted_count >= MAX_META_CONTENT_ITEMS )
                                         {
 
-                                            Sagan_Log(ERROR, "[%s, line %d] To many meta_content string values at %d in %s.  Max is %d", __FILE__, __LINE__, linecount, ruleset_fullname, MAX_META_ITEM_SIZE);
+                                            Sagan_Log(ERROR, "[%s, line %d] To many meta_content string values at %d in %s.  Max is %d", __FILE__, __LINE__, linecount, ruleset_fullname, MAX_META_CONTENT_ITEMS);
 
                                         }
 
+                                    Replace_Sagan(meta_content_help, ptmp, tmp_help, sizeof(tmp_help));
+                                    meta_items[meta_content_converted_count] = Sagan_Arena_Strdup(rules_arena, tmp_help);
+
+                                    meta_content_converted_count++;
+
                                     ptmp = strtok_r(NULL, ",", &tok);
                                 }
 
+                            rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_content_converted = Sagan_Arena_Memdup(rules_arena, meta_items, meta_content_converted_count * sizeof(char *));
                             rulestruct[counters->rulecount].meta_content_containers[meta_content_count].meta_counter = meta_content_converted_count;
 
                             rulestruct[counters->rulecount].meta_content_flag = true;
@@ -1639,9 +1713,6 @@ void Load_Rules( const char *ruleset )
                         {
                             strtok_r(NULL, ":", &saveptrrule2);
                             rulestruct[counters->rulecount].meta_content_case[meta_content_count-1] = 1;
-                            To_LowerC(rulestruct[counters->rulecount].meta_content[meta_content_count-1]);
-                            strlcpy(tolower_tmp, rulestruct[counters->rulecount].meta_content[meta_content_count-1], sizeof(tolower_tmp));
-                            strlcpy(rulestruct[counters->rulecount].meta_content[meta_content_count-1], tolower_tmp, sizeof(rulestruct[counters->rulecount].meta_content[meta_content_count-1]));
                         }
 
 
@@ -1725,7 +1796,7 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             Remove_Spaces(arg);
-                            strlcpy(rulestruct[counters->rulecount].s_reference[ref_count], arg, sizeof(rulestruct[counters->rulecount].s_reference[ref_count]));
+                            rulestruct[counters->rulecount].s_reference[ref_count] = Sagan_Arena_Strdup(rules_arena, arg);
                             rulestruct[counters->rulecount].ref_count=ref_count;
                             ref_count++;
                         }
@@ -1909,7 +1980,8 @@ void Load_Rules( const char *ruleset )
                             Content_Pipe(tmp2, linecount, ruleset_fullname, rule_tmp, sizeof(rule_tmp));
                             strlcpy(final_content, rule_tmp, sizeof(final_content));
 
-                            strlcpy(rulestruct[counters->rulecount].s_content[content_count], final_content, sizeof(rulestruct[counters->rulecount].s_content[content_count]));
+                            rulestruct[counters->rulecount].s_content[content_count] = Sagan_Arena_Strdup(rules_arena, final_content);
+                            rulestruct[counters->rulecount].s_content_len[content_count] = strlen(rulestruct[counters->rulecount].s_content[content_count]);
                             final_content[0] = '\0';
                             content_count++;
                             rulestruct[counters->rulecount].content_count=content_count;
@@ -1922,11 +1994,25 @@ void Load_Rules( const char *ruleset )
                             strtok_r(NULL, ":", &saveptrrule2);
                             rulestruct[counters->rulecount].s_nocase[content_count - 1] = 1;
                             To_LowerC(rulestruct[counters->rulecount].s_content[content_count - 1]);
-                            strlcpy(tolower_tmp, rulestruct[counters->rulecount].s_content[content_count - 1], sizeof(tolower_tmp));
-                            strlcpy(rulestruct[counters->rulecount].s_content[content_count-1], tolower_tmp, sizeof(rulestruct[counters->rulecount].s_content[content_count-1]));
 
                         }
 
+                    /* Single option.  Use this content for the prefilter */
+
+                    if (!strcmp(rulesplit, "fast_pattern"))
+                        {
+                            strtok_r(NULL, ":", &saveptrrule2);
+
+                            if ( content_count == 0 )
+                                {
+                                    bad_rule = true;
+                                    Sagan_Log(WARN, "[%s, line %d] \"fast_pattern\" has no \"content\" before it at line %d in %s, skipping rule", __FILE__, __LINE__, linecount, ruleset_fullname);
+                                    continue;
+                                }
+
+                            rulestruct[counters->rulecount].fast_pattern = content_count;
+                        }
+
                     if (!strcmp(rulesplit, "offset"))
                         {
                             arg = strtok_r(NULL, ":", &saveptrrule2);
@@ -2064,6 +2150,8 @@ void Load_Rules( const char *ruleset )
                                 }
 
                             pcreflag=0;
+                            pcreoptions=0;
+                            pcrestudy=0;
                             memset(pcrerule, 0, sizeof(pcrerule));
 
                             for ( i = 1; i < strlen(tmp2); i++)
@@ -2147,15 +2235,25 @@ void Load_Rules( const char *ruleset )
 
                             rulestruct[counters->rulecount].re_pcre[pcre_count] =  pcre_compile( pcrerule, pcreoptions, &error, &erroffset, NULL );
 
+                            if (  rulestruct[counters->rulecount].re_pcre[pcre_count]  == NULL )
+                                {
+                                    bad_rule = true;
+                                    Remove_Lock_File();
+                                    Sagan_Log(WARN, "[%s, line %d] PCRE failure at %d: %s, skipping rule", __FILE__, __LINE__, erroffset, error);
+                                    continue;
+                                }
+
+                            /* pcre_study() takes PCRE_STUDY_* options,  not the compile options above */
+
 #ifdef PCRE_HAVE_JIT
 
                             if ( config->pcre_jit == 1 )
                                 {
-                                    pcreoptions |= PCRE_STUDY_JIT_COMPILE;
+                                    pcrestudy |= PCRE_STUDY_JIT_COMPILE;
                                 }
 #endif
 
-                            rulestruct[counters->rulecount].pcre_extra[pcre_count] = pcre_study( rulestruct[counters->rulecount].re_pcre[pcre_count], pcreoptions, &error);
+                            rulestruct[counters->rulecount].pcre_extra[pcre_count] = pcre_study( rulestruct[counters->rulecount].re_pcre[pcre_count], pcrestudy, &error);
 
 #ifdef PCRE_HAVE_JIT
 
@@ -2170,18 +2268,17 @@ void Load_Rules( const char *ruleset )
                                         {
                                             Sagan_Log(WARN, "[%s, line %d] PCRE JIT does not support regexp in %s at line %d (pcre: \"%s\"). Continuing without PCRE JIT enabled for this rule.", __FILE__, __LINE__, ruleset_fullname, linecount, pcrerule);
                                         }
+                                    else
+                                        {
+                                            /* The default JIT stack is 32k on the machine stack.  Give
+                                               each worker its own,  larger,  stack instead */
+
+                                            pcre_assign_jit_stack(rulestruct[counters->rulecount].pcre_extra[pcre_count], Rules_PCRE_JIT_Stack, NULL);
+                                        }
                                 }
 
 #endif
 
-                            if (  rulestruct[counters->rulecount].re_pcre[pcre_count]  == NULL )
-                                {
-                                    bad_rule = true;
-                                    Remove_Lock_File();
-                                    Sagan_Log(WARN, "[%s, line %d] PCRE failure at %d: %s, skipping rule", __FILE__, __LINE__, erroffset, error);
-                                    continue;
-                                }
-
                             pcre_count++;
                             rulestruct[counters->rulecount].pcre_count=pcre_count;
                         }
@@ -2365,12 +2462,22 @@ void Load_Rules( const char *ruleset )
 
                                             if (Sagan_strstr(tmptoken, "limit"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold_type = 1;
+                                                    rulestruct[counters->rulecount].threshold_type = THRESH_TYPE_LIMIT;
                                                 }
 
                                             if (Sagan_strstr(tmptoken, "threshold"))
                                                 {
-                                                    rulestruct[counters->rulecount].threshold_type = 2;
+                                                    rulestruct[counters->rulecount].threshold_type = THRESH_TYPE_THRESHOLD;
+                                                }
+
+                                            if (Sagan_strstr(tmptoken, "sliding"))
+                                                {
+                                                    rulestruct[counters->rulecount].threshold_type = THRESH_TYPE_SLIDING;
+                                                }
+
+                                            if (Sagan_strstr(tmptoken, "rate"))
+                                                {
+                                                    rulestruct[counters->rulecount].threshold_type = THRESH_TYPE_RATE;
                                                 }
                                         }
 
@@ -2419,6 +2526,12 @@ void Load_Rules( const char *ruleset )
 
                                     tmptoken = strtok_r(NULL, ",", &saveptrrule2);
                                 }
+
+                            if ( ( rulestruct[counters->rulecount].threshold_type == THRESH_TYPE_SLIDING || rulestruct[counters->rulecount].threshold_type == THRESH_TYPE_RATE ) &&
+                                    ( rulestruct[counters->rulecount].threshold_count <= 0 || rulestruct[counters->rulecount].threshold_seconds <= 0 ) )
+                                {
+                                    Sagan_Log(ERROR, "[%s, line %d] 'threshold' type sliding/rate needs a 'count' and 'seconds' greater than zero at %d in %s", __FILE__, __LINE__, linecount, ruleset_fullname);
+                                }
                         }
 
 
@@ -2979,9 +3092,67 @@ void Load_Rules( const char *ruleset )
                         }
                 }
 
+            /* Each meta_content's items go into one automaton,  so the engine
+               looks for all of them in a single pass.  meta_nocase can come
+               after meta_content,  so this waits until the rule is done */
+
+            for ( i = 0; i < meta_content_count; i++ )
+                {
+
+                    meta_ac = Sagan_AC_Init(rulestruct[counters->rulecount].meta_content_case[i]);
+
+                    for ( z = 0; z < rulestruct[counters->rulecount].meta_content_containers[i].meta_counter; z++ )
+                        {
+                            Sagan_AC_Add(meta_ac, rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted[z],
+                                         strlen(rulestruct[counters->rulecount].meta_content_containers[i].meta_content_converted[z]), z);
+                        }
+
+                    Sagan_AC_Compile(meta_ac);
+                    rulestruct[counters->rulecount].meta_content_containers[i].meta_ac = meta_ac;
+                }
+
+            /* Flows and ports the rule uses go to the arena */
+
+            rulestruct[counters->rulecount].flow_1 = Sagan_Arena_Memdup(rules_arena, flow_1, flow_1_count * sizeof(struct arr_flow_1));
+            rulestruct[counters->rulecount].flow_2 = Sagan_Arena_Memdup(rules_arena, flow_2, flow_2_count * sizeof(struct arr_flow_2));
+            rulestruct[counters->rulecount].port_1 = Sagan_Arena_Memdup(rules_arena, port_1, port_1_count * sizeof(struct arr_port_1));
+            rulestruct[counters->rulecount].port_2 = Sagan_Arena_Memdup(rules_arena, port_2, port_2_count * sizeof(struct arr_port_2));
+
+            rulestruct[counters->rulecount].flow_1_type = Sagan_Arena_Memdup(rules_arena, flow_1_type, ( f1 + 1 ) * sizeof(int));
+            rulestruct[counters->rulecount].flow_2_type = Sagan_Arena_Memdup(rules_arena, flow_2_type, ( f2 + 1 ) * sizeof(int));
+            rulestruct[counters->rulecount].port_1_type = Sagan_Arena_Memdup(rules_arena, port_1_type, ( g1 + 1 ) * sizeof(int));
+            rulestruct[counters->rulecount].port_2_type = Sagan_Arena_Memdup(rules_arena, port_2_type, ( g2 + 1 ) * sizeof(int));
+
+            Rules_Plan_Compile(counters->rulecount);
+
             counters->rulecount++;
 
         } /* end of while loop */
 
     fclose(rulesfile);
 }
+
+/****************************************************************************
+ * Free_Rules - Releases what was allocated for the loaded rules.  This is
+ * called on SIGHUP before the rules are loaded again.
+ ****************************************************************************/
+
+void Free_Rules( void )
+{
+
+    int rule = 0;
+    int i = 0;
+
+    for ( rule = 0; rule < counters->rulecount; rule++ )
+        {
+            for ( i = 0; i < rulestruct[rule].meta_content_count; i++ )
+                {
+                    Sagan_AC_Free(rulestruct[rule].meta_content_containers[i].meta_ac);
+                    rulestruct[rule].meta_content_containers[i].meta_ac = NULL;
+                }
+        }
+
+    Sagan_Arena_Free(rules_arena);
+    rules_arena = NULL;
+
+}
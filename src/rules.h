@@ -69,8 +69,18 @@ struct arr_port_2
 typedef struct meta_content_conversion meta_content_conversion;
 struct meta_content_conversion
 {
-    char meta_content_converted[MAX_META_CONTENT_ITEMS][256];
+    char **meta_content_converted;		/* meta_counter strings (rules arena) */
     int  meta_counter;
+    struct _Sagan_AC *meta_ac;		/* All of the above in one automaton */
+};
+
+/* One step of a rule's evaluation plan (see rules-plan.c) */
+
+typedef struct _Rule_Plan_Step _Rule_Plan_Step;
+struct _Rule_Plan_Step
+{
+    unsigned char type;			/* PLAN_* */
+    unsigned char index;		/* Which content,  pcre or meta_content */
 };
 
 typedef struct _Rule_Struct _Rule_Struct;
@@ -82,8 +92,8 @@ struct _Rule_Struct
     pcre *re_pcre[MAX_PCRE];
     pcre_extra *pcre_extra[MAX_PCRE];
 
-    char s_content[MAX_CONTENT][256];
-    char s_reference[MAX_REFERENCE][256];
+    char *s_content[MAX_CONTENT];		/* Strings live in the rules arena */
+    char *s_reference[MAX_REFERENCE];
     char s_classtype[32];
     char s_sid[32];
     char s_rev[5];
@@ -97,15 +107,19 @@ struct _Rule_Struct
     char email[255];
     bool email_flag;
 
+    _Rule_Plan_Step plan[MAX_PLAN_STEPS];
+    unsigned char plan_count;
+    unsigned char plan_message_count;		/* plan[] steps that only need the message */
+
     bool type;				/* 0 == normal,  1 == dynamic */
     char  dynamic_ruleset[MAXPATH];
 
-    /* Check Flow */
-    struct arr_flow_1 flow_1[MAX_CHECK_FLOWS];
-    struct arr_flow_2 flow_2[MAX_CHECK_FLOWS];
+    /* Check Flow.  Sized to what the rule uses (rules arena) */
+    struct arr_flow_1 *flow_1;
+    struct arr_flow_2 *flow_2;
 
-    struct arr_port_1 port_1[MAX_CHECK_FLOWS];
-    struct arr_port_2 port_2[MAX_CHECK_FLOWS];
+    struct arr_port_1 *port_1;
+    struct arr_port_2 *port_2;
 
     struct meta_content_conversion meta_content_containers[MAX_META_CONTENT];
 
@@ -118,13 +132,13 @@ struct _Rule_Struct
 
     bool has_flow;
 
-    int flow_1_type[MAX_CHECK_FLOWS];
-    int flow_2_type[MAX_CHECK_FLOWS];
+    int *flow_1_type;				/* 1 based */
+    int *flow_2_type;
     int flow_1_counter;
     int flow_2_counter;
 
-    int port_1_type[MAX_CHECK_FLOWS];
-    int port_2_type[MAX_CHECK_FLOWS];
+    int *port_1_type;				/* 1 based */
+    int *port_2_type;
     int port_1_counter;
     int port_2_counter;
 
@@ -133,6 +147,7 @@ struct _Rule_Struct
     int s_depth[MAX_CONTENT];
     int s_distance[MAX_CONTENT];
     int s_within[MAX_CONTENT];
+    int s_content_len[MAX_CONTENT];
 
     bool meta_nocase[MAX_META_CONTENT];
     int meta_offset[MAX_META_CONTENT];
@@ -187,10 +202,11 @@ struct _Rule_Struct
 
     bool normalize;
     bool content_not[MAX_CONTENT];             /* content: ! "something" */
+    int fast_pattern;				/* content number + 1 for the prefilter.  0 == longest */
 
     int drop;                                   /* inline DROP for ext. */
 
-    unsigned char threshold_type;               /* 1 = limit,  2 = thresh */
+    unsigned char threshold_type;               /* THRESH_TYPE_* */
     unsigned char threshold_method;             /* 1 ==  src,  2 == dst,  3 == username, 4 == srcport, 5 == dstport */
     int threshold_count;
     int threshold_seconds;
@@ -206,9 +222,6 @@ struct _Rule_Struct
     bool meta_content_case[MAX_META_CONTENT];
     bool meta_content_not[MAX_META_CONTENT];
 
-    char meta_content[MAX_META_CONTENT][CONFBUF];
-    char meta_content_help[MAX_META_CONTENT][CONFBUF];
-
     bool alert_time_flag;
     unsigned char alert_days;
     bool aetas_next_day;
@@ -287,3 +300,4 @@ struct _Rule_Struct
 };
 
 void Load_Rules ( const char * );
+void Free_Rules ( void );
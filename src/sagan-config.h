@@ -72,6 +72,8 @@ struct _SaganConfig
     char         sagan_lockfile[MAXPATH];
     char         sagan_fifo[MAXPATH];
     bool        sagan_is_file;                       /* FIFO or FILE */
+    struct      _Sagan_Input *inputs;		/* All FIFO/FILE inputs (sagan_fifo + 'inputs') */
+    int          input_count;
     char         sagan_log_path[MAXPATH];
     char         sagan_rule_path[MAXPATH];
     char         sagan_host[MAXHOST];
@@ -86,6 +88,7 @@ struct _SaganConfig
     bool        output_thread_flag;
 
     int          max_processor_threads;
+    uint64_t     queue_depth;				/* Worker queue slots */
 
     bool        sagan_external_output_flag;            /* For calling external commands */
     char         sagan_external_command[MAXPATH];
@@ -97,6 +100,10 @@ struct _SaganConfig
     char 	 *sagan_proto_string;
 
     bool	 pcre_jit; 				/* For PCRE JIT support testing */
+    int		 pcre_jit_stack;			/* Max size of the per thread JIT stack */
+
+    bool	 rule_reorder;				/* Adaptive candidate rule order */
+    uint64_t	 rule_reorder_interval;			/* Events between re-ranking */
 
     bool        endian;
 
@@ -120,6 +127,10 @@ struct _SaganConfig
     FILE	*perfmonitor_file_stream;
     int	    perfmonitor_file_fd;
 
+    bool	rule_profile_flag;
+    int		rule_profile_time;			/* Seconds between dumps.  0 == SIGUSR2 only */
+    char	rule_profile_file_name[MAXPATH];
+
     bool        sagan_fwsam_flag;
     char         sagan_fwsam_info[1024];
 
@@ -151,6 +162,7 @@ struct _SaganConfig
     int		shm_after_by_username;
 
     int		shm_track_clients;
+    int		shm_samples;
 
     /* IPC sizes for threshold, after, etc */
 
@@ -171,6 +183,18 @@ struct _SaganConfig
     int		max_after_by_username;
 
     int		max_track_clients;
+    int		max_samples;				/* 0 == no message samples */
+
+    /* Native syslog listener */
+
+    bool	listener_flag;
+    char	listener_address[MAXIP];
+    int		listener_udp_port;			/* 0 == disabled */
+    int		listener_tcp_port;			/* 0 == disabled */
+    int		listener_udp_threads;
+    int		listener_batch;
+    bool	listener_reuseport;
+    int		listener_max_connections;
 
 #ifdef HAVE_LIBPCAP
     char        plog_interface[50];
@@ -66,6 +66,11 @@ typedef void json_object;
 
 #define MAX_THREADS     	4096            /* Max system threads */
 #define MAX_SYSLOGMSG   	10240		/* Max length of a syslog message */
+#define MAX_SYSLOG_FIELD	50		/* Max length of host/facility/.../program fields */
+#define MAX_SYSLOG_FIELDS	9		/* host|facility|priority|level|tag|date|time|program|msg */
+
+#define INPUT_SLAB_SIZE		262144		/* Bytes read() from an input at a time */
+#define INPUT_MAX_SLABS		256		/* Max slabs in flight between readers and workers */
 
 #define MAX_VAR_NAME_SIZE  	64		/* Max "var" name size */
 #define MAX_VAR_VALUE_SIZE 	4096		/* Max "var" value size */
@@ -80,6 +85,8 @@ typedef void json_object;
 
 #define MAX_XBITS		20		/* Max 'xbits' within a rule */
 
+#define MAX_PLAN_STEPS		( MAX_CONTENT + MAX_PCRE + MAX_META_CONTENT + 8 )	/* See rules-plan.c */
+
 #define MAX_CHECK_FLOWS		100		/* Max amount of IP addresses to be checked in a flow */
 
 #define MAX_REFERENCE		10		/* Max references within a rule */
@@ -109,6 +116,18 @@ typedef void json_object;
 #define PLOG_FILTER		"port 514"
 #define PLOG_LOGDEV		"/dev/log"
 
+#define LISTENER_ADDRESS	"0.0.0.0"
+#define LISTENER_PORT		514
+#define LISTENER_THREADS	1		/* UDP receive threads */
+#define MAX_LISTENER_THREADS	64
+#define LISTENER_BATCH		64		/* Datagrams per recvmmsg() */
+#define MAX_LISTENER_BATCH	1024
+#define LISTENER_BACKLOG	128		/* TCP listen() backlog */
+#define LISTENER_MAX_CONNECTIONS	64		/* Concurrent TCP connections */
+#define MAX_LISTENER_CONNECTIONS	( INPUT_MAX_SLABS / 2 )
+#define LISTENER_IDLE_MS	1000		/* Quiet TCP connections give their slab back */
+#define LISTENER_ERROR_INTERVAL	60		/* Seconds between repeated socket error reports */
+
 #define TRACK_TIME		1440
 
 #define NORMAL			0
@@ -127,6 +146,16 @@ typedef void json_object;
 /* defaults if the user doesn't define */
 
 #define MAX_PROCESSOR_THREADS   100
+#define DEFAULT_QUEUE_DEPTH	1024		/* Slots in the worker queue (rounded up to a power of 2) */
+#define MAX_QUEUE_DEPTH		1048576		/* Upper bound on 'queue-depth' */
+
+#define PCRE_JIT_STACK_START	32768		/* Per thread PCRE JIT stack,  initial size */
+#define PCRE_JIT_STACK_MAX	1048576		/* Default 'pcre-jit-stack' (max size) */
+
+#define DEFAULT_RULE_REORDER_INTERVAL	100000	/* Events between re-ranking rules */
+#define RULE_REORDER_SAMPLE		64	/* Time 1 in this many events (power of 2) */
+
+#define CACHE_LINE_SIZE		64		/* Used to pad shared indexes */
 
 #define SUNDAY			1
 #define MONDAY			2
@@ -171,6 +200,7 @@ typedef void json_object;
 #define AFTER_BY_DSTPORT_IPC_FILE 	"sagan-after-by-destination-port.shared"
 #define AFTER_BY_USERNAME_IPC_FILE 	"sagan-after-by-username.shared"
 #define CLIENT_TRACK_IPC_FILE 		"sagan-track-clients.shared"
+#define SAMPLES_IPC_FILE 		"sagan-samples.shared"
 
 /* Default IPC/mmap sizes */
 
@@ -186,6 +216,14 @@ typedef void json_object;
 #define DEFAULT_IPC_THRESH_BY_DST_PORT  1000000
 #define DEFAULT_IPC_THRESH_BY_USERNAME	10000
 #define DEFAULT_IPC_XBITS		10000
+#define DEFAULT_IPC_SAMPLES		1000
+
+#define IPC_MAGIC			0x4e474153	/* "SAGN" */
+#define IPC_VERSION			2		/* Bump when an IPC file's layout changes */
+#define IPC_INDEX_LOCKS			64		/* Lock stripes per threshold/after table */
+#define IPC_INDEX_LOCK_CHECK		1024		/* Spins between checks the holder is alive */
+#define IPC_WHEEL_SLOTS			4096		/* Seconds in a turn of the expiry wheel */
+#define IPC_REAP_BATCH			4096		/* Records the reaper handles per lock */
 
 
 #define AFTER_BY_SRC			1
@@ -200,6 +238,13 @@ typedef void json_object;
 #define THRESH_BY_USERNAME		9
 #define THRESH_BY_SRCPORT               10
 
+#define THRESH_TYPE_LIMIT		1
+#define THRESH_TYPE_THRESHOLD		2
+#define THRESH_TYPE_SLIDING		3
+#define THRESH_TYPE_RATE		4
+
+#define THRESH_SLIDING_SLOTS		32		/* Slots in a "sliding" threshold window */
+
 #define XBIT				11
 
 #define PARSE_HASH_MD5			1
@@ -68,6 +68,11 @@
 #include "usage.h"
 #include "stats.h"
 #include "ipc.h"
+#include "util-ring.h"
+#include "input-slab.h"
+#include "input.h"
+#include "input-listener.h"
+#include "input-fifo.h"
 #include "parsers/parsers.h"
 
 #ifdef HAVE_SYS_PRCTL_H
@@ -82,6 +87,7 @@
 #include "processors/blacklist.h"
 #include "processors/track-clients.h"
 #include "processors/perfmon.h"
+#include "processors/rule-profile.h"
 #include "processors/bro-intel.h"
 
 #ifdef HAVE_LIBLOGNORM
@@ -110,17 +116,13 @@ struct _Rule_Struct *rulestruct;
 #include "redis.h"
 #endif
 
-struct _Sagan_Proc_Syslog *SaganProcSyslog = NULL;
+_Sagan_Ring *SaganProcRing = NULL;
 
-int proc_msgslot = 0;
 int proc_running = 0;
 
 unsigned char dynamic_rule_flag = 0;
 bool reload_rules = false;
 
-pthread_cond_t SaganProcDoWork=PTHREAD_COND_INITIALIZER;
-
-pthread_mutex_t SaganProcWorkMutex=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t SaganMalformedCounter=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t SaganRulesLoadedMutex=PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t SaganDynamicFlag=PTHREAD_MUTEX_INITIALIZER;
@@ -183,6 +185,24 @@ int main(int argc, char **argv)
     pthread_attr_init(&thread_perfmonitor_attr);
     pthread_attr_setdetachstate(&thread_perfmonitor_attr,  PTHREAD_CREATE_DETACHED);
 
+    /****************************************************************************/
+    /* Rule profile local variables                                             */
+    /****************************************************************************/
+
+    pthread_t rule_profile_thread;
+    pthread_attr_t thread_rule_profile_attr;
+    pthread_attr_init(&thread_rule_profile_attr);
+    pthread_attr_setdetachstate(&thread_rule_profile_attr,  PTHREAD_CREATE_DETACHED);
+
+    /****************************************************************************/
+    /* IPC reaper local variables                                               */
+    /****************************************************************************/
+
+    pthread_t ipc_reaper_thread;
+    pthread_attr_t thread_ipc_reaper_attr;
+    pthread_attr_init(&thread_ipc_reaper_attr);
+    pthread_attr_setdetachstate(&thread_ipc_reaper_attr,  PTHREAD_CREATE_DETACHED);
+
     /****************************************************************************/
     /* Various local variables						        */
     /****************************************************************************/
@@ -208,31 +228,11 @@ int main(int argc, char **argv)
     pthread_attr_init(&ct_report_thread_attr);
     pthread_attr_setdetachstate(&ct_report_thread_attr,  PTHREAD_CREATE_DETACHED);
 
-    char src_dns_lookup[20] = { 0 };
-
-    bool dns_flag = false;
-    bool fifoerr = false;
-
-    char *syslog_host=NULL;
-    char *syslog_facility=NULL;
-    char *syslog_priority=NULL;
-    char *syslog_level=NULL;
-    char *syslog_tag=NULL;
-    char *syslog_date=NULL;
-    char *syslog_time=NULL;
-    char *syslog_program=NULL;
-    char *syslog_msg=NULL;
-
-    char *psyslogstring = NULL;
-    char syslogstring[MAX_SYSLOGMSG];
-
     signed char c;
     int rc=0;
 
     int i;
 
-    int dynamic_line_count = 0;
-
     time_t t;
     struct tm *run;
 
@@ -260,16 +260,6 @@ int main(int argc, char **argv)
 
     memset(config, 0, sizeof(_SaganConfig));
 
-    struct _SaganDNSCache *dnscache;
-    dnscache = malloc(sizeof(_SaganDNSCache));
-
-    if ( dnscache == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for dnscache. Abort!", __FILE__, __LINE__);
-        }
-
-    memset(dnscache, 0, sizeof(_SaganDNSCache));
-
     counters = malloc(sizeof(_SaganCounters));
 
     if ( counters == NULL )
@@ -348,6 +338,12 @@ int main(int argc, char **argv)
                             debugflag = true;
                         }
 
+                    if (Sagan_strstr(optarg, "plan"))
+                        {
+                            debug->debugplan = true;
+                            debugflag = true;
+                        }
+
                     if (Sagan_strstr(optarg, "limits"))
                         {
                             debug->debuglimits = true;
@@ -612,15 +608,12 @@ int main(int argc, char **argv)
 #ifdef PCRE_HAVE_JIT
 
     /* We test if pages will support RWX before loading rules.  If it doesn't due to the OS,
-       we want to disable PCRE JIT now.  This prevents confusing warnings of PCRE JIT during
-       rule load */
-
-    config->pcre_jit = true;
+       Load_YAML_Config() leaves PCRE JIT off.  This prevents confusing warnings of PCRE JIT
+       during rule load */
 
     if (PageSupportsRWX() == false)
         {
             Sagan_Log(WARN, "The operating system doens't allow RWX pages.  Disabling PCRE JIT.");
-            config->pcre_jit = false;
         }
 
 #endif
@@ -629,16 +622,18 @@ int main(int argc, char **argv)
     (void)Load_YAML_Config(config->sagan_config);
     pthread_mutex_unlock(&SaganRulesLoadedMutex);
 
-    (void)Sagan_Engine_Init();
+    /* The primary FIFO (or '-F' file) is read along with any other 'inputs' */
 
-    SaganProcSyslog = malloc(config->max_processor_threads * sizeof(struct _Sagan_Proc_Syslog));
+    Sagan_Input_Add(config->sagan_fifo, config->sagan_is_file);
 
-    if ( SaganProcSyslog == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for SaganProcSyslog. Abort!", __FILE__, __LINE__);
-        }
+    (void)Sagan_Engine_Init();
 
-    memset(SaganProcSyslog, 0, sizeof(struct _Sagan_Proc_Syslog));
+    /* Work queue between the FIFO reader and the worker threads.  This is
+       sized independently from the number of workers so bursts can be
+       absorbed without dropping. */
+
+    SaganProcRing = Sagan_Ring_Init(config->queue_depth, sizeof(struct _Sagan_Proc_Syslog));
+    Sagan_Slab_Init();
 
     pthread_t processor_id[config->max_processor_threads];
     pthread_attr_t thread_processor_attr;
@@ -699,11 +694,29 @@ int main(int argc, char **argv)
 #endif
 
 
+    /* The syslog listener sockets are bound now so privileged ports
+       (514) can be used.  The threads are started once the workers are up */
+
+    if ( config->listener_flag )
+        {
+            Sagan_Listener_Init();
+        }
+
     Droppriv();              /* Become the Sagan user */
     Sagan_Log(NORMAL, "---------------------------------------------------------------------------");
 
     IPC_Init();
 
+    /* Expires threshold/after records as they age out */
+
+    rc = pthread_create( &ipc_reaper_thread, &thread_ipc_reaper_attr, (void *)IPC_Reaper, NULL );
+
+    if ( rc != 0 )
+        {
+            Remove_Lock_File();
+            Sagan_Log(ERROR, "[%s, line %d] Error creating IPC reaper thread [error: %d].", __FILE__, __LINE__, rc);
+        }
+
     if ( config->perfmonitor_flag )
         {
 
@@ -718,6 +731,30 @@ int main(int argc, char **argv)
                 }
         }
 
+    if ( config->rule_profile_flag )
+        {
+
+            if ( config->rule_profile_file_name[0] == '\0' )
+                {
+                    Remove_Lock_File();
+                    Sagan_Log(ERROR, "[%s, line %d] 'processor' : 'rule-profile' - 'filename' is missing. Abort!", __FILE__, __LINE__);
+                }
+
+            Sagan_Log(NORMAL, "Rule profiling enabled.  Send SIGUSR2 to write it to %s.", config->rule_profile_file_name);
+
+            if ( config->rule_profile_time > 0 )
+                {
+
+                    rc = pthread_create( &rule_profile_thread, &thread_rule_profile_attr, (void *)Sagan_Rule_Profile_Handler, NULL );
+
+                    if ( rc != 0 )
+                        {
+                            Remove_Lock_File();
+                            Sagan_Log(ERROR, "[%s, line %d] Error creating Rule Profile thread [error: %d].", __FILE__, __LINE__, rc);
+                        }
+                }
+        }
+
 
     /* Open sagan alert file */
 
@@ -975,7 +1012,7 @@ int main(int argc, char **argv)
 
 #endif
 
-    Sagan_Log(NORMAL, "Spawning %d Processor Threads.", config->max_processor_threads);
+    Sagan_Log(NORMAL, "Spawning %d Processor Threads (queue depth: %" PRIu64 ").", config->max_processor_threads, SaganProcRing->depth);
 
     for (i = 0; i < config->max_processor_threads; i++)
         {
@@ -1015,445 +1052,44 @@ int main(int argc, char **argv)
 
 #endif
 
-    Sagan_Log(NORMAL, "");
-
-    if ( !config->sagan_is_file )
+    if ( config->listener_flag )
         {
-
-            Sagan_Log(NORMAL, "Attempting to open syslog FIFO (%s).", config->sagan_fifo);
-
+            Sagan_Listener_Start();
         }
-    else
-        {
-
-            Sagan_Log(NORMAL, "Attempting to open syslog FILE (%s).", config->sagan_fifo);
 
-        }
+    Sagan_Log(NORMAL, "");
 
+    Sagan_Input_FIFO_Start();
 
+    /* Each input has its own reader thread.  If we are only reading files
+       (and not listening),  we exit once they have all been read */
 
     while(true)
         {
 
-            FILE *fd;
-
-            if (( fd = fopen(config->sagan_fifo, "r" )) == NULL )
+            if ( Sagan_Input_Files_Done() == true && config->listener_flag == false )
                 {
 
-                    if ( config->sagan_is_file == false )
-                        {
-
-                            /* try to create it */
-
-                            Sagan_Log(NORMAL, "Fifo not found, creating it (%s).", config->sagan_fifo);
-
-                            if (mkfifo(config->sagan_fifo, 0700) == -1)
-                                {
-                                    Sagan_Log(ERROR, "Could not create FIFO '%s'. Abort!", config->sagan_fifo);
-                                }
-
-                            fd = fopen(config->sagan_fifo, "r");
-
-                            if ( fd == NULL )
-                                {
-                                    Sagan_Log(ERROR, "Error opening %s. Abort!", config->sagan_fifo);
-                                }
+                    Sagan_Log(NORMAL, "EOF reached. Waiting for threads to catch up....");
+                    Sagan_Log(NORMAL, "");
 
-                        }
-                    else
+                    while(Sagan_Ring_Count(SaganProcRing) != 0 || __atomic_load_n(&proc_running, __ATOMIC_SEQ_CST) != 0)
                         {
-
-                            Sagan_Log(ERROR, "Could not open file '%s'. Abort!", config->sagan_fifo);
+                            Sagan_Log(NORMAL, "Waiting on %" PRIu64 "/%d threads....", Sagan_Ring_Count(SaganProcRing), proc_running);
+                            sleep(1);
                         }
 
-                }
-
-            if ( config->sagan_is_file == false )
-                {
-                    Sagan_Log(NORMAL, "Successfully opened FIFO (%s).", config->sagan_fifo);
-
-#if defined(HAVE_GETPIPE_SZ) && defined(HAVE_SETPIPE_SZ)
-
-                    Set_Pipe_Size(fd);
+                    Statistics();
+                    Remove_Lock_File();
 
-#endif
+                    Sagan_Log(NORMAL, "Exiting.");
+                    exit(0);
 
                 }
-            else
-                {
-                    Sagan_Log(NORMAL, "Successfully opened FILE (%s) and processing events.....", config->sagan_fifo);
-                }
-
-            while(fd != NULL)
-                {
-
-
-                    while(fgets(syslogstring, sizeof(syslogstring), fd) != NULL)
-                        {
-                            psyslogstring = syslogstring;
-
-                            /* If the FIFO was in a error state,  let user know the FIFO writer has resumed */
-
-                            if ( fifoerr == true )
-                                {
-
-                                    Sagan_Log(NORMAL, "FIFO writer has restarted. Processing events.");
-
-#if defined(HAVE_GETPIPE_SZ) && defined(HAVE_SETPIPE_SZ)
-
-                                    Set_Pipe_Size(fd);
-
-#endif
-                                    fifoerr = false;
-                                }
-
-                            counters->sagantotal++;
-
-                            /* If Dynamic rules are loaded,  keep track of line count */
-
-                            if ( config->dynamic_load_flag == true )
-                                {
-
-                                    dynamic_line_count++;
-                                }
-
-                            syslog_host = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-
-                            /* If we're using DNS (and we shouldn't be!),  we start DNS checks and lookups
-                             * here.  We cache both good and bad lookups to not over load our DNS server(s).
-                             * The only way DNS cache can be cleared is to restart Sagan */
-
-                            if (config->syslog_src_lookup )
-                                {
-
-                                    if ( !Is_IP(syslog_host, IPv4) || !Is_IP(syslog_host, IPv6) )   	/* Is inbound a valid IP? */
-                                        {
-                                            dns_flag = false;
-
-                                            for(i=0; i <= counters->dns_cache_count ; i++)  			/* Check cache first */
-                                                {
-                                                    if (!strcmp( dnscache[i].hostname, syslog_host))
-                                                        {
-                                                            syslog_host = dnscache[i].src_ip;
-                                                            dns_flag = true;
-                                                        }
-                                                }
-
-                                            /* If entry was not found in cache,  look it up */
-
-                                            if ( dns_flag == false )
-                                                {
-
-                                                    /* Do a DNS lookup */
-
-                                                    rc = DNS_Lookup(syslog_host, src_dns_lookup, sizeof(src_dns_lookup));
-
-                                                    /* Invalid lookups get the config->sagan_host value */
-
-                                                    if ( rc == -1 )
-                                                        {
-
-                                                            strlcpy(src_dns_lookup, config->sagan_host, sizeof(src_dns_lookup));
-                                                            counters->dns_miss_count++;
 
-                                                        }
+            sleep(1);
 
-
-                                                    /* Add entry to DNS Cache */
-
-                                                    dnscache = (_SaganDNSCache *) realloc(dnscache, (counters->dns_cache_count+1) * sizeof(_SaganDNSCache));
-
-                                                    if ( dnscache == NULL )
-                                                        {
-
-                                                            Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for dnscache. Abort!", __FILE__, __LINE__);
-
-                                                        }
-
-                                                    memset(&dnscache[counters->dns_cache_count], 0, sizeof(_SaganDNSCache));
-
-                                                    strlcpy(dnscache[counters->dns_cache_count].hostname, syslog_host, sizeof(dnscache[counters->dns_cache_count].hostname));
-                                                    strlcpy(dnscache[counters->dns_cache_count].src_ip, src_dns_lookup, sizeof(dnscache[counters->dns_cache_count].src_ip));
-                                                    counters->dns_cache_count++;
-                                                    syslog_host = src_dns_lookup;
-
-                                                }
-                                        }
-
-                                }
-                            else
-                                {
-
-                                    /* We check to see if values from our FIFO are valid.  If we aren't doing DNS related
-                                    * stuff (above),  we start basic check with the syslog_host */
-
-                                    if (syslog_host == NULL || !Is_IP(syslog_host, IPv4) || !Is_IP(syslog_host, IPv6) )
-                                        {
-                                            syslog_host = config->sagan_host;
-
-                                            pthread_mutex_lock(&SaganMalformedCounter);
-                                            counters->malformed_host++;
-                                            pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                            if ( debug->debugmalformed )
-                                                {
-                                                    Sagan_Log(DEBUG, "Sagan received a malformed 'host': '%s' (replaced with %s)", syslog_host, config->sagan_host);
-                                                }
-                                        }
-                                }
-
-                            /* We now check the rest of the values */
-
-                            syslog_facility = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-                            if ( syslog_facility == NULL )
-                                {
-
-                                    syslog_facility = "SAGAN: FACILITY ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_facility++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'facility'");
-                                        }
-                                }
-
-                            syslog_priority = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-                            if ( syslog_priority == NULL )
-                                {
-
-                                    syslog_priority = "SAGAN: PRIORITY ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_priority++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'priority'");
-                                        }
-                                }
-
-                            syslog_level = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-                            if ( syslog_level == NULL )
-                                {
-
-                                    syslog_level = "SAGAN: LEVEL ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_level++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'level'");
-                                        }
-                                }
-
-                            syslog_tag = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-                            if ( syslog_tag == NULL )
-                                {
-
-                                    syslog_tag = "SAGAN: TAG ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_tag++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'tag'");
-                                        }
-                                }
-
-                            syslog_date = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-                            if ( syslog_date == NULL )
-                                {
-
-                                    syslog_date = "SAGAN: DATE ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_date++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'date'");
-                                        }
-                                }
-
-                            syslog_time = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-                            if ( syslog_time == NULL )
-                                {
-
-                                    syslog_time = "SAGAN: TIME ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_time++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'time'");
-                                        }
-                                }
-
-
-                            syslog_program = psyslogstring != NULL ? strsep(&psyslogstring, "|") : NULL;
-                            if ( syslog_program == NULL )
-                                {
-
-                                    syslog_program = "SAGAN: PROGRAM ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_program++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'program'");
-                                        }
-                                }
-                            syslog_msg = psyslogstring != NULL ? strsep(&psyslogstring, "") : NULL; /* In case the message has | in it,  we delimit on "" */
-
-                            if ( syslog_msg == NULL )
-                                {
-
-                                    syslog_msg = "SAGAN: MESSAGE ERROR";
-
-                                    pthread_mutex_lock(&SaganMalformedCounter);
-                                    counters->malformed_message++;
-                                    pthread_mutex_unlock(&SaganMalformedCounter);
-
-                                    if ( debug->debugmalformed )
-                                        {
-                                            Sagan_Log(DEBUG, "Sagan received a malformed 'message' [Syslog Host: %s]", syslog_host);
-                                        }
-
-                                    /* If the message is lost,  all is lost.  Typically,  you don't lose part of the message,
-                                     * it's more likely to lose all  - Champ Clark III 11/17/2011 */
-
-                                    counters->sagan_log_drop++;
-
-                                }
-
-                            /* Strip any \n or \r from the syslog_msg */
-
-                            if ( strcspn ( syslog_msg, "\n" ) < strlen(syslog_msg) )
-                                {
-                                    syslog_msg[strcspn ( syslog_msg, "\n" )] = '\0';
-                                }
-
-
-                            if ( proc_msgslot < config->max_processor_threads )
-                                {
-
-                                    pthread_mutex_lock(&SaganProcWorkMutex);
-
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_host, syslog_host, sizeof(SaganProcSyslog[proc_msgslot].syslog_host));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_facility, syslog_facility, sizeof(SaganProcSyslog[proc_msgslot].syslog_facility));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_priority, syslog_priority, sizeof(SaganProcSyslog[proc_msgslot].syslog_priority));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_level, syslog_level, sizeof(SaganProcSyslog[proc_msgslot].syslog_level));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_tag, syslog_tag, sizeof(SaganProcSyslog[proc_msgslot].syslog_tag));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_date, syslog_date, sizeof(SaganProcSyslog[proc_msgslot].syslog_date));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_time, syslog_time, sizeof(SaganProcSyslog[proc_msgslot].syslog_time));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_program, syslog_program, sizeof(SaganProcSyslog[proc_msgslot].syslog_program));
-                                    strlcpy(SaganProcSyslog[proc_msgslot].syslog_message, syslog_msg, sizeof(SaganProcSyslog[proc_msgslot].syslog_message));
-
-                                    if ( config->dynamic_load_flag == true && ( dynamic_line_count >= config->dynamic_load_sample_rate ) )
-                                        {
-
-                                            pthread_mutex_lock(&SaganDynamicFlag);
-                                            dynamic_rule_flag = DYNAMIC_RULE;
-                                            pthread_mutex_unlock(&SaganDynamicFlag);
-
-                                            dynamic_line_count = 0;
-                                        }
-
-
-                                    /* Thread holds here if rule load is in progress */
-
-                                    if ( config->dynamic_load_flag == true )
-                                        {
-
-                                            pthread_mutex_lock(&SaganRulesLoadedMutex);
-                                            reload_rules = true;
-                                            pthread_mutex_unlock(&SaganRulesLoadedMutex);
-
-                                        }
-
-                                    proc_msgslot++;
-
-                                    pthread_cond_signal(&SaganProcDoWork);
-                                    pthread_mutex_unlock(&SaganProcWorkMutex);
-
-                                }
-                            else
-                                {
-
-                                    counters->worker_thread_exhaustion++;
-                                    counters->sagan_log_drop++;
-                                }
-
-                            if (debug->debugthreads)
-                                {
-                                    Sagan_Log(DEBUG, "[%s, line %d] Current \"proc_msgslot\": %d", __FILE__, __LINE__, proc_msgslot);
-                                }
-
-                            if (debug->debugsyslog)
-                                {
-
-                                    Sagan_Log(DEBUG, "[%s, line %d] **[RAW Syslog]*********************************", __FILE__, __LINE__);
-                                    Sagan_Log(DEBUG, "[%s, line %d] Host: %s | Program: %s | Facility: %s | Priority: %s | Level: %s | Tag: %s", __FILE__, __LINE__, syslog_host, syslog_program, syslog_facility, syslog_priority, syslog_level, syslog_tag);
-                                    Sagan_Log(DEBUG, "[%s, line %d] Raw message: %s", __FILE__, __LINE__, syslog_msg);
-
-                                }
-
-
-                        } /* while(fgets) */
-
-                    /* fgets() has returned a error,  likely due to the FIFO writer leaving */
-
-                    /* RMEOVE LOCK */
-
-                    if ( fifoerr == false )
-                        {
-
-                            if ( config->sagan_is_file != 0 )
-                                {
-                                    Sagan_Log(NORMAL, "EOF reached. Waiting for threads to catch up....");
-                                    Sagan_Log(NORMAL, "");
-
-                                    while(proc_msgslot != 0 || proc_running != 0)
-                                        {
-                                            Sagan_Log(NORMAL, "Waiting on %d/%d threads....", proc_msgslot, proc_running);
-                                            sleep(1);
-                                        }
-
-                                    fclose(fd);
-                                    Statistics();
-                                    Remove_Lock_File();
-
-                                    Sagan_Log(NORMAL, "Exiting.");
-                                    exit(0);
-
-                                }
-                            else
-                                {
-
-                                    Sagan_Log(WARN, "FIFO writer closed.  Waiting for FIFO writer to restart....");
-                                    fifoerr = true; 			/* Set flag so our wile(fgets) knows */
-                                }
-                        }
-                    sleep(1);		/* So we don't eat 100% CPU */
-
-                } /* while(fd != NULL)  */
-
-            fclose(fd); 			/* ???? */
-
-        } /* End of while(1) */
+        }
 
 } /* End of main */
 
@@ -131,6 +131,7 @@ bool     Check_Content_Not( char * );
 uint32_t  Djb2_Hash( char * );
 bool     Starts_With(const char *str, const char *prefix);
 char      *strrpbrk(const char *str, const char *accept);
+uint64_t  Monotonic_NS( void );
 
 
 
@@ -166,6 +167,9 @@ typedef struct _Sagan_IPC_Counters _Sagan_IPC_Counters;
 struct _Sagan_IPC_Counters
 {
 
+    uint32_t magic;			/* IPC_MAGIC.  See IPC_Init() */
+    uint32_t version;			/* IPC_VERSION */
+
     int  xbit_count;
     int	 thresh_count_by_src;
     int	 thresh_count_by_dst;
@@ -326,6 +330,7 @@ struct _SaganDebug
     bool debugipc;
     bool debugjson;
     bool debugparse_ip;
+    bool debugplan;
 
 #ifdef HAVE_LIBMAXMINDDB
     bool debuggeoip2;
@@ -366,15 +371,30 @@ struct _Sagan_Redis
 typedef struct _Sagan_Proc_Syslog _Sagan_Proc_Syslog;
 struct _Sagan_Proc_Syslog
 {
-    char syslog_host[50];
-    char syslog_facility[50];
-    char syslog_priority[50];
-    char syslog_level[50];
-    char syslog_tag[50];
-    char syslog_date[50];
-    char syslog_time[50];
-    char syslog_program[50];
-    char syslog_message[MAX_SYSLOGMSG];
+
+    /* These point into the input slab the line was read into (or to
+       static "error" strings for malformed fields).  They are only valid
+       until the slab is released. */
+
+    char *syslog_host;
+    char *syslog_facility;
+    char *syslog_priority;
+    char *syslog_level;
+    char *syslog_tag;
+    char *syslog_date;
+    char *syslog_time;
+    char *syslog_program;
+    char *syslog_message;
+
+    size_t syslog_message_len;
+
+    char *syslog_message_lower;			/* Built on first use.  See Sagan_Message_Lower() */
+
+    char syslog_host_lookup[MAXIP];		/* Storage for DNS resolved hosts */
+    char syslog_date_buf[MAXDATE];		/* Storage for generated dates/times */
+    char syslog_time_buf[MAXTIME];
+
+    struct _Sagan_Slab *slab;
 
 };
 
@@ -429,6 +449,20 @@ struct _Sagan_Event
 };
 
 
+/* "sliding" and "rate" threshold state.  See Thresh_Check().  Most rules
+ * don't use it,  so it isn't in the records.  The threshold files keep it
+ * in a table of its own after the index,  one per record position (see
+ * IPC_Table_Map()).  Only "sliding" and "rate" records write to it. */
+
+typedef struct _Sagan_Thresh_State _Sagan_Thresh_State;
+struct _Sagan_Thresh_State
+{
+    uint64_t mtime;			/* Monotonic milliseconds of the last event */
+    uint64_t tokens;			/* rate */
+    uint32_t total;			/* sliding: alerts in the window */
+    uint16_t slots[THRESH_SLIDING_SLOTS];
+};
+
 /* Thresholding structure by source */
 
 typedef struct thresh_by_src_ipc thresh_by_src_ipc;
@@ -440,8 +474,7 @@ struct thresh_by_src_ipc
     char sid[20];
     int expire;
     char selector[MAXSELECTOR];
-    char syslog_message[MAX_SYSLOGMSG];
-    char signature_msg[MAX_SAGAN_MSG];
+    uint64_t sample;			/* See IPC_Sample() */
 };
 
 
@@ -456,8 +489,7 @@ struct thresh_by_dst_ipc
     char sid[20];
     int expire;
     char selector[MAXSELECTOR];
-    char syslog_message[MAX_SYSLOGMSG];
-    char signature_msg[MAX_SAGAN_MSG];
+    uint64_t sample;			/* See IPC_Sample() */
 };
 
 
@@ -499,8 +531,7 @@ struct thresh_by_username_ipc
     char sid[20];
     int expire;
     char selector[MAXSELECTOR];
-    char syslog_message[MAX_SYSLOGMSG];
-    char signature_msg[MAX_SAGAN_MSG];
+    uint64_t sample;			/* See IPC_Sample() */
 };
 
 /* After structure by source */
@@ -515,8 +546,7 @@ struct after_by_src_ipc
     char sid[20];
     int expire;
     char selector[MAXSELECTOR];
-    char syslog_message[MAX_SYSLOGMSG];
-    char signature_msg[MAX_SAGAN_MSG];
+    uint64_t sample;			/* See IPC_Sample() */
 };
 
 /* After structure by destination */
@@ -531,8 +561,7 @@ struct after_by_dst_ipc
     char sid[20];
     int expire;
     char selector[MAXSELECTOR];
-    char syslog_message[MAX_SYSLOGMSG];
-    char signature_msg[MAX_SAGAN_MSG];
+    uint64_t sample;			/* See IPC_Sample() */
 
 };
 
@@ -576,8 +605,90 @@ struct after_by_username_ipc
     char sid[20];
     int expire;
     char selector[MAXSELECTOR];
-    char syslog_message[MAX_SYSLOGMSG];
+    uint64_t sample;			/* See IPC_Sample() */
+};
+
+/* The threshold/after mmap() files start with a header,  then hold the
+ * records above,  then an open addressing hash index of them keyed on
+ * (ip/port/username,  sid,  selector).  See ipc.c.  The xbit file is laid
+ * out the same way,  with an empty index.  The header says what the file
+ * was made for.  The index is found with the header's "max",  not
+ * the configured one,  and is only rebuilt when the header doesn't match. */
+
+typedef struct _Sagan_IPC_Header _Sagan_IPC_Header;
+struct _Sagan_IPC_Header
+{
+    uint32_t magic;			/* IPC_MAGIC.  Written last */
+    uint32_t version;			/* IPC_VERSION */
+    uint32_t max;			/* Records the file holds */
+    uint32_t record_size;
+    char pad[48];			/* Records start on a cache line */
+};
+
+typedef struct _Sagan_IPC_Index_Slot _Sagan_IPC_Index_Slot;
+struct _Sagan_IPC_Index_Slot
+{
+    uint32_t hash;
+    uint32_t position;			/* Record + 1.  0 == empty */
+};
+
+/* Updating a record only takes the lock "stripe" its hash falls in.  The
+ * stripes are spin locks in the file,  so they work across every Sagan
+ * sharing the IPC directory.  Adding or removing records still takes the
+ * table's mutex and File_Lock() */
+
+typedef struct _Sagan_IPC_Index_Lock _Sagan_IPC_Index_Lock;
+struct _Sagan_IPC_Index_Lock
+{
+    uint32_t lock;			/* pid of the holder.  0 == free */
+    char pad[60];			/* One per cache line */
+};
+
+/* Records expire off a timing wheel (see IPC_Reaper()).  Each record is
+ * on the list of the second it expires,  so the reaper only looks at what
+ * is due.  The links are kept by record,  after the index slots */
+
+typedef struct _Sagan_IPC_Wheel_Link _Sagan_IPC_Wheel_Link;
+struct _Sagan_IPC_Wheel_Link
+{
+    uint32_t next;			/* Record + 1.  0 == end of the list */
+    uint32_t prev;
+    uint32_t slot;
+};
+
+/* "Last message" samples for the threshold,  after and xbit records.  The
+ * records used to carry the syslog message and signature inline,  ~11k a
+ * record for ~100 bytes of state.  Now they keep the sequence number of a
+ * sample in a ring of its own size ("samples" in sagan.yaml,  0 turns
+ * them off).  The sample is still the record's if the sequence numbers
+ * match,  otherwise the ring went around and wrote over it. */
+
+typedef struct _Sagan_IPC_Sample _Sagan_IPC_Sample;
+struct _Sagan_IPC_Sample
+{
+    uint64_t sequence;			/* 0 == being written */
     char signature_msg[MAX_SAGAN_MSG];
+    char syslog_message[MAX_SYSLOGMSG];
+};
+
+typedef struct _Sagan_IPC_Samples _Sagan_IPC_Samples;
+struct _Sagan_IPC_Samples
+{
+    uint64_t sequence;			/* Last one handed out */
+    uint32_t max;
+    uint32_t pad;
+    _Sagan_IPC_Sample samples[];
+};
+
+typedef struct _Sagan_IPC_Index _Sagan_IPC_Index;
+struct _Sagan_IPC_Index
+{
+    uint32_t mask;			/* Slots - 1 */
+    uint32_t pad;
+    _Sagan_IPC_Index_Lock locks[IPC_INDEX_LOCKS];
+    uint64_t wheel_tick;		/* Last second the reaper went by */
+    uint32_t wheel[IPC_WHEEL_SLOTS + 1];	/* The last is the list being reaped */
+    _Sagan_IPC_Index_Slot slots[];
 };
 
 typedef struct _SaganVar _SaganVar;
@@ -609,7 +720,6 @@ struct _Sagan_Lookup_Cache_Entry
     char ip[MAXIP];
     unsigned char ip_bits[MAXIPBIT];
     int  port;
-    unsigned char proto;
     bool status;
 };
 
@@ -619,9 +729,32 @@ struct _Sagan_Lookup_Cache_Other
     int proto;
 };
 
+/* What Parse_Extract() pulled out of the message.  It is filled in the
+   first time a rule needs any of it and reused by every other rule for
+   that event. */
+
+typedef struct _Sagan_Parse_Cache _Sagan_Parse_Cache;
+struct _Sagan_Parse_Cache
+{
+    bool parsed;
+
+    int  ip_count;
+    struct _Sagan_Lookup_Cache_Entry ip[MAX_PARSE_IP];
+
+    unsigned char proto;
+
+    char md5[MD5_HASH_SIZE+1];
+    char sha1[SHA1_HASH_SIZE+1];
+    char sha256[SHA256_HASH_SIZE+1];
+
+    bool proto_program_parsed;
+    int  proto_program;
+};
+
 /* Function that require the above arrays */
 
 //int64_t   FlowGetId( _Sagan_Event *);
 int64_t	  FlowGetId(struct timeval tp);
 void 	  Escape_Chars( char *str_in, char *str, size_t size);
+char     *Sagan_Message_Lower( _Sagan_Proc_Syslog * );
 
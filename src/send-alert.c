@@ -44,15 +44,11 @@ void Send_Alert ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, json_object *json_n
 
     char tmp[64] = { 0 };
 
-    struct _Sagan_Event *SaganProcessorEvent = NULL;
-    SaganProcessorEvent = malloc(sizeof(struct _Sagan_Event));
+    /* Output() is done with the event when it returns,  so it can live on
+       the stack */
 
-    if ( SaganProcessorEvent == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for SaganProcessorEvent. Abort!", __FILE__, __LINE__);
-        }
-
-    memset(SaganProcessorEvent, 0, sizeof(_Sagan_Event));
+    struct _Sagan_Event SaganProcessorEvent_LOCAL = { 0 };
+    struct _Sagan_Event *SaganProcessorEvent = &SaganProcessorEvent_LOCAL;
 
     if ( processor_info->processor_generator_id != SAGAN_PROCESSOR_GENERATOR_ID )
         {
@@ -103,7 +99,6 @@ void Send_Alert ( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL, json_object *json_n
     SaganProcessorEvent->json_normalize     =    json_normalize;
 
     Output ( SaganProcessorEvent );
-    free(SaganProcessorEvent);
 
 }
 
@@ -57,6 +57,7 @@
 #include "classifications.h"
 
 #include "processors/perfmon.h"
+#include "processors/rule-profile.h"
 #include "rules.h"
 #include "ignore-list.h"
 #include "flow.h"
@@ -302,6 +303,8 @@ void Sig_Handler( void )
                     /* Reset counters */
                     /******************/
 
+                    Free_Rules();
+
                     counters->refcount=0;
                     counters->classcount=0;
                     counters->rulecount=0;
@@ -421,6 +424,8 @@ void Sig_Handler( void )
                     Load_YAML_Config(config->sagan_config);	/* <- RELOAD */
                     pthread_mutex_unlock(&SaganRulesLoadedMutex);
 
+                    Sagan_Rule_Profile_Reset();
+
                     /************************************************************/
                     /* Re-load primary configuration (rules/classifictions/etc) */
                     /************************************************************/
@@ -506,6 +511,15 @@ void Sig_Handler( void )
                     Statistics();
                     break;
 
+                case SIGUSR2:
+
+                    if ( config->rule_profile_flag )
+                        {
+                            Sagan_Rule_Profile_Dump();
+                        }
+
+                    break;
+
                 default:
                     Sagan_Log(NORMAL, "[Received signal %d. Sagan doesn't know how to deal with]", sig);
                 }
@@ -39,6 +39,8 @@
 #include "sagan-defs.h"
 #include "stats.h"
 #include "sagan-config.h"
+#include "input.h"
+#include "input-listener.h"
 
 struct _SaganCounters *counters;
 struct _Sagan_IPC_Counters *counters_ipc;
@@ -62,6 +64,8 @@ void Statistics( void )
     int uptime_minutes;
     int uptime_seconds;
 
+    int i;
+
 #ifdef WITH_BLUEDOT
     unsigned long bluedot_ip_total=0;
     unsigned long bluedot_hash_total=0;
@@ -154,6 +158,23 @@ void Statistics( void )
                 }
 
 
+            Sagan_Log(NORMAL, "");
+            Sagan_Log(NORMAL, "          -[ Sagan Input Statistics ]-");
+            Sagan_Log(NORMAL, "");
+
+            for ( i = 0; i < config->input_count; i++ )
+                {
+                    Sagan_Log(NORMAL, "           %s (%s)", config->inputs[i].path, config->inputs[i].is_file ? "file" : "FIFO");
+                    Sagan_Log(NORMAL, "             Received               : %" PRIu64 " (%" PRIu64 " bytes)", config->inputs[i].received, config->inputs[i].bytes);
+                    Sagan_Log(NORMAL, "             Malformed              : %" PRIu64 " (%.3f%%)", config->inputs[i].malformed, CalcPct(config->inputs[i].malformed, config->inputs[i].received) );
+                    Sagan_Log(NORMAL, "             Dropped                : %" PRIu64 " (%.3f%%)", config->inputs[i].dropped, CalcPct(config->inputs[i].dropped, config->inputs[i].received) );
+                }
+
+            if ( config->listener_flag == true )
+                {
+                    Sagan_Listener_Statistics();
+                }
+
             Sagan_Log(NORMAL, "");
             Sagan_Log(NORMAL, "          -[ Sagan Processor Statistics ]-");
             Sagan_Log(NORMAL, "");
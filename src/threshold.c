@@ -29,6 +29,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <time.h>
 #include <stdbool.h>
@@ -53,6 +54,18 @@ struct thresh_by_srcport_ipc *threshbysrcport_ipc;
 struct thresh_by_dstport_ipc *threshbydstport_ipc;
 struct thresh_by_username_ipc *threshbyusername_ipc;
 
+struct _Sagan_IPC_Index *threshbysrc_index;
+struct _Sagan_IPC_Index *threshbydst_index;
+struct _Sagan_IPC_Index *threshbysrcport_index;
+struct _Sagan_IPC_Index *threshbydstport_index;
+struct _Sagan_IPC_Index *threshbyusername_index;
+
+struct _Sagan_Thresh_State *threshbysrc_state;
+struct _Sagan_Thresh_State *threshbydst_state;
+struct _Sagan_Thresh_State *threshbysrcport_state;
+struct _Sagan_Thresh_State *threshbydstport_state;
+struct _Sagan_Thresh_State *threshbyusername_state;
+
 struct _Sagan_IPC_Counters *counters_ipc;
 
 struct _SaganCounters *counters;
@@ -60,30 +73,171 @@ struct _Rule_Struct *rulestruct;
 struct _SaganDebug *debug;
 struct _SaganConfig *config;
 
-/***********************/
-/* Threshold by source */
-/***********************/
+/*****************************************************************************
+ * Thresh_Check - Counts an event against a record.  Returns true if the
+ * event is over the rule's threshold (and shouldn't alert).
+ *
+ * "limit" and "threshold" count events in a window that starts with the
+ * first event and is reset once it's "seconds" old.
+ *
+ * "sliding" allows "count" alerts in any "seconds".  The window is split
+ * into THRESH_SLIDING_SLOTS slots,  so it's within 1/THRESH_SLIDING_SLOTS
+ * of the window,  no matter where the events fall.
+ *
+ * "rate" is a token bucket.  It holds "count" tokens and is refilled at
+ * "count" tokens every "seconds".  A token is one "seconds" * 1000 units
+ * and a millisecond adds "count" units,  so it's all integer math.
+ *
+ * Both of them use milliseconds from Monotonic_NS() and only the record's
+ * own state,  so each event is a constant amount of work.
+ *****************************************************************************/
+
+static bool Thresh_Sliding( int rule_position, _Sagan_Thresh_State *state, uint64_t mtime )
+{
 
-bool Thresh_By_Src ( int rule_position, char *ip_src, unsigned char *ip_src_bits, char *selector, char *syslog_message )
+    uint64_t width = ( (uint64_t)rulestruct[rule_position].threshold_seconds * 1000 + THRESH_SLIDING_SLOTS - 1 ) / THRESH_SLIDING_SLOTS;
+    uint64_t current = 0;
+    uint64_t last = 0;
+    uint64_t b = 0;
+
+    width = width > 0 ? width : 1;
+
+    current = mtime / width;
+    last = state->mtime / width;
+
+    /* New,  idle for a whole window or from before a reboot */
+
+    if ( state->mtime == 0 || mtime < state->mtime || current - last >= THRESH_SLIDING_SLOTS )
+        {
+            memset(state->slots, 0, sizeof(state->slots));
+            state->total = 0;
+        }
+    else
+        {
+            for ( b = last + 1; b <= current; b++ )
+                {
+                    state->total -= state->slots[b % THRESH_SLIDING_SLOTS];
+                    state->slots[b % THRESH_SLIDING_SLOTS] = 0;
+                }
+        }
+
+    state->mtime = mtime;
+
+    if ( state->total >= (uint32_t)rulestruct[rule_position].threshold_count )
+        {
+            return(true);
+        }
+
+    if ( state->slots[current % THRESH_SLIDING_SLOTS] < UINT16_MAX )
+        {
+            state->slots[current % THRESH_SLIDING_SLOTS]++;
+            state->total++;
+        }
+
+    return(false);
+}
+
+static bool Thresh_Rate( int rule_position, _Sagan_Thresh_State *state, uint64_t mtime )
 {
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+    uint64_t token = (uint64_t)rulestruct[rule_position].threshold_seconds * 1000;
+    uint64_t capacity = token * rulestruct[rule_position].threshold_count;
+    uint64_t elapsed = 0;
 
-    bool thresh_log_flag = false;
+    if ( state->mtime == 0 || mtime < state->mtime || mtime - state->mtime >= token )
+        {
+            state->tokens = capacity;
+        }
+    else
+        {
+            elapsed = mtime - state->mtime;
+            state->tokens = state->tokens + elapsed * rulestruct[rule_position].threshold_count;
+            state->tokens = state->tokens < capacity ? state->tokens : capacity;
+        }
 
-    uint64_t thresh_oldtime;
+    state->mtime = mtime;
 
-    int i;
+    if ( state->tokens < token || token == 0 )
+        {
+            return(true);
+        }
+
+    state->tokens -= token;
+
+    return(false);
+}
+
+static bool Thresh_Check( int rule_position, int *count, uint64_t *utime, _Sagan_Thresh_State *state, uint64_t now )
+{
+
+    uint64_t oldtime = now - *utime;
+    bool over = false;
+
+    *utime = now;
+
+    switch ( rulestruct[rule_position].threshold_type )
+        {
+
+        case(THRESH_TYPE_SLIDING):
+            over = Thresh_Sliding(rule_position, state, Monotonic_NS() / 1000000);
+            *count = state->total;
+            return(over);
+
+        case(THRESH_TYPE_RATE):
+            *count = *count + 1;
+            return( Thresh_Rate(rule_position, state, Monotonic_NS() / 1000000) );
+
+        }
+
+    *count = *count + 1;
+
+    if ( oldtime > (uint64_t)rulestruct[rule_position].threshold_seconds )
+        {
+            *count = 1;
+        }
+
+    return( rulestruct[rule_position].threshold_count < *count );
+}
+
+/* A new record.  Its first event is counted like any other.  "limit" and
+   "threshold" don't touch the state,  so its pages are only used by rules
+   that need it */
+
+static void Thresh_Init( int rule_position, _Sagan_Thresh_State *state )
+{
+
+    switch ( rulestruct[rule_position].threshold_type )
+        {
+
+        case(THRESH_TYPE_SLIDING):
+            memset(state, 0, sizeof(_Sagan_Thresh_State));
+            Thresh_Sliding(rule_position, state, Monotonic_NS() / 1000000);
+            break;
+
+        case(THRESH_TYPE_RATE):
+            memset(state, 0, sizeof(_Sagan_Thresh_State));
+            Thresh_Rate(rule_position, state, Monotonic_NS() / 1000000);
+            break;
+
+        }
+
+}
+
+/***********************/
+/* Threshold by source */
+/***********************/
+
+/* The threshold by source record for the event,  or -1.  Caller holds the
+   stripe "hash" falls in */
+
+static int Thresh_By_Src_Find( int rule_position, unsigned char *ip_src_bits, char *selector, uint32_t hash )
+{
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    int i;
 
-    /* Check array for matching src / sid */
+    uint32_t slot = 0;
 
-    for (i = 0; i < counters_ipc->thresh_count_by_src; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(threshbysrc_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -98,98 +252,121 @@ bool Thresh_By_Src ( int rule_position, char *ip_src, unsigned char *ip_src_bits
 
             if ( !memcmp(threshbysrc_ipc[i].ipsrc, ip_src_bits, sizeof(threshbysrc_ipc[i].ipsrc)) && !strcmp(threshbysrc_ipc[i].sid, rulestruct[rule_position].s_sid ))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_thresh_by_src);
-                    pthread_mutex_lock(&Thresh_By_Src_Mutex);
+    return(-1);
+}
 
-                    threshbysrc_ipc[i].count++;
-                    thresh_oldtime = atol(timet) - threshbysrc_ipc[i].utime;
+bool Thresh_By_Src ( int rule_position, char *ip_src, unsigned char *ip_src_bits, char *selector, char *syslog_message )
+{
 
-                    threshbysrc_ipc[i].utime = atol(timet);
+    uint64_t utime = time(NULL);
 
-                    strlcpy(threshbysrc_ipc[i].syslog_message, syslog_message, sizeof(threshbysrc_ipc[i].syslog_message));
-                    strlcpy(threshbysrc_ipc[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(threshbysrc_ipc[i].signature_msg));
+    bool thresh_log_flag = false;
 
-                    if ( thresh_oldtime > rulestruct[rule_position].threshold_seconds )
-                        {
-                            threshbysrc_ipc[i].count=1;
-                            threshbysrc_ipc[i].utime = atol(timet);
-                            thresh_log_flag = false;
-                        }
+    int i;
 
-                    if ( rulestruct[rule_position].threshold_count < threshbysrc_ipc[i].count )
-                        {
-                            thresh_log_flag = true;
+    uint32_t hash = 0;
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "Threshold SID %s by source IP address. [%s]", threshbysrc_ipc[i].sid, ip_src);
-                                }
+    bool locked = false;
 
-                            counters->threshold_total++;
-                        }
+    /* Find the matching src / sid via the hash index (see ipc.c) */
 
-                    pthread_mutex_unlock(&Thresh_By_Src_Mutex);
-                    File_Unlock(config->shm_thresh_by_src);
+    hash = IPC_Index_Hash(ip_src_bits, MAXIPBIT, rulestruct[rule_position].s_sid, selector);
 
-                    return(thresh_log_flag);
+    IPC_Index_Lock(threshbysrc_index, hash);
 
-                }
-        }
+    i = Thresh_By_Src_Find(rule_position, ip_src_bits, selector, hash);
 
-    /* If not found,  add it to the array */
+    /* If not found,  add it to the array.  Adding takes File_Lock() and
+       the mutex,  which come before the stripe (as in IPC_Reaper()),  so
+       let go of it and look again once they are held.  Another thread or
+       Sagan might have added the record,  or filled the table,  in
+       between */
 
-    if ( Clean_IPC_Object(THRESH_BY_SRC) == 0 )
+    if ( i == -1 )
         {
 
+            IPC_Index_Unlock(threshbysrc_index, hash);
+
+            Clean_IPC_Object(THRESH_BY_SRC);
+
             File_Lock(config->shm_thresh_by_src);
             pthread_mutex_lock(&Thresh_By_Src_Mutex);
+            IPC_Index_Lock(threshbysrc_index, hash);
+
+            locked = true;
 
-            memcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].ipsrc, ip_src_bits, sizeof(threshbysrc_ipc[counters_ipc->thresh_count_by_src].ipsrc));
-            strlcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].sid, rulestruct[rule_position].s_sid, sizeof(threshbysrc_ipc[counters_ipc->thresh_count_by_src].sid));
+            i = Thresh_By_Src_Find(rule_position, ip_src_bits, selector, hash);
+
+            if ( i == -1 && counters_ipc->thresh_count_by_src < IPC_Max(THRESH_BY_SRC) )
+                {
 
-            selector == NULL ? threshbysrc_ipc[counters_ipc->thresh_count_by_src].selector[0] = '\0' : strlcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].selector, selector, MAXSELECTOR);
+                    memcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].ipsrc, ip_src_bits, sizeof(threshbysrc_ipc[counters_ipc->thresh_count_by_src].ipsrc));
+                    strlcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].sid, rulestruct[rule_position].s_sid, sizeof(threshbysrc_ipc[counters_ipc->thresh_count_by_src].sid));
 
-            threshbysrc_ipc[counters_ipc->thresh_count_by_src].count = 1;
-            threshbysrc_ipc[counters_ipc->thresh_count_by_src].utime = atol(timet);
-            threshbysrc_ipc[counters_ipc->thresh_count_by_src].expire = rulestruct[rule_position].threshold_seconds;
+                    selector == NULL ? threshbysrc_ipc[counters_ipc->thresh_count_by_src].selector[0] = '\0' : strlcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].selector, selector, MAXSELECTOR);
 
-            strlcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].syslog_message, syslog_message, sizeof(threshbysrc_ipc[counters_ipc->thresh_count_by_src].syslog_message));
-            strlcpy(threshbysrc_ipc[counters_ipc->thresh_count_by_src].signature_msg, rulestruct[rule_position].s_msg, sizeof(threshbysrc_ipc[counters_ipc->thresh_count_by_src].signature_msg));
+                    threshbysrc_ipc[counters_ipc->thresh_count_by_src].count = 1;
+                    threshbysrc_ipc[counters_ipc->thresh_count_by_src].utime = utime;
+                    threshbysrc_ipc[counters_ipc->thresh_count_by_src].expire = rulestruct[rule_position].threshold_seconds;
+                    Thresh_Init(rule_position, &threshbysrc_state[counters_ipc->thresh_count_by_src]);
+
+                    threshbysrc_ipc[counters_ipc->thresh_count_by_src].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
+
+                    IPC_Index_Add(threshbysrc_index, hash, counters_ipc->thresh_count_by_src, utime + rulestruct[rule_position].threshold_seconds);
+                    counters_ipc->thresh_count_by_src++;
+
+                }
+
+        }
+
+    if ( i != -1 )
+        {
+
+            threshbysrc_ipc[i].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
+
+            if ( Thresh_Check(rule_position, &threshbysrc_ipc[i].count, &threshbysrc_ipc[i].utime, &threshbysrc_state[i], utime) )
+                {
+                    thresh_log_flag = true;
+
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "Threshold SID %s by source IP address. [%s]", threshbysrc_ipc[i].sid, ip_src);
+                        }
+
+                    __atomic_add_fetch(&counters->threshold_total, 1, __ATOMIC_RELAXED);
+                }
+
+        }
 
-            counters_ipc->thresh_count_by_src++;
+    IPC_Index_Unlock(threshbysrc_index, hash);
 
+    if ( locked == true )
+        {
             pthread_mutex_unlock(&Thresh_By_Src_Mutex);
             File_Unlock(config->shm_thresh_by_src);
         }
 
-    return(false);
+    return(thresh_log_flag);
 }
 
 /****************************/
 /* Threshold by destination */
 /****************************/
 
-bool Thresh_By_Dst ( int rule_position, char *ip_dst, unsigned char *ip_dst_bits, char *selector, char *syslog_message )
-{
-
-    time_t t;
-    struct tm *now;
-    char  timet[20];
+/* The threshold by destination record for the event,  or -1 */
 
-    bool thresh_log_flag = false;
-
-    uint64_t thresh_oldtime;
+static int Thresh_By_Dst_Find( int rule_position, unsigned char *ip_dst_bits, char *selector, uint32_t hash )
+{
 
     int i;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    uint32_t slot = 0;
 
-    /* Check array for matching dst / sid */
-
-    for (i = 0; i < counters_ipc->thresh_count_by_dst; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(threshbydst_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -204,98 +381,116 @@ bool Thresh_By_Dst ( int rule_position, char *ip_dst, unsigned char *ip_dst_bits
 
             if ( !memcmp(threshbydst_ipc[i].ipdst, ip_dst_bits, sizeof(threshbydst_ipc[i].ipdst)) && !strcmp(threshbydst_ipc[i].sid, rulestruct[rule_position].s_sid ))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_thresh_by_dst);
-                    pthread_mutex_lock(&Thresh_By_Dst_Mutex);
+    return(-1);
+}
 
-                    threshbydst_ipc[i].count++;
-                    thresh_oldtime = atol(timet) - threshbydst_ipc[i].utime;
+bool Thresh_By_Dst ( int rule_position, char *ip_dst, unsigned char *ip_dst_bits, char *selector, char *syslog_message )
+{
 
-                    threshbydst_ipc[i].utime = atol(timet);
+    uint64_t utime = time(NULL);
 
-                    strlcpy(threshbydst_ipc[i].syslog_message, syslog_message, sizeof(threshbydst_ipc[i].syslog_message));
-                    strlcpy(threshbydst_ipc[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(threshbydst_ipc[i].signature_msg));
+    bool thresh_log_flag = false;
 
-                    if ( thresh_oldtime > rulestruct[rule_position].threshold_seconds )
-                        {
+    int i;
 
-                            threshbydst_ipc[i].count=1;
-                            threshbydst_ipc[i].utime = atol(timet);
-                            thresh_log_flag = false;
+    uint32_t hash = 0;
 
-                        }
+    bool locked = false;
 
-                    if ( rulestruct[rule_position].threshold_count < threshbydst_ipc[i].count )
-                        {
+    /* Find the matching dst / sid via the hash index (see ipc.c) */
 
-                            thresh_log_flag = true;
+    hash = IPC_Index_Hash(ip_dst_bits, MAXIPBIT, rulestruct[rule_position].s_sid, selector);
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "Threshold SID %s by destination IP address. [%s]", threshbydst_ipc[i].sid, ip_dst);
-                                }
+    IPC_Index_Lock(threshbydst_index, hash);
 
-                            counters->threshold_total++;
-                        }
+    i = Thresh_By_Dst_Find(rule_position, ip_dst_bits, selector, hash);
 
-                    pthread_mutex_unlock(&Thresh_By_Dst_Mutex);
-                    File_Unlock(config->shm_thresh_by_dst);
+    /* If not found,  add it to the array.  See Thresh_By_Src() */
 
-                    return(thresh_log_flag);
-                }
-        }
+    if ( i == -1 )
+        {
 
-    /* If not found,  add it to the array */
+            IPC_Index_Unlock(threshbydst_index, hash);
 
-    if ( Clean_IPC_Object(THRESH_BY_DST) == 0 )
-        {
+            Clean_IPC_Object(THRESH_BY_DST);
 
             File_Lock(config->shm_thresh_by_dst);
             pthread_mutex_lock(&Thresh_By_Dst_Mutex);
+            IPC_Index_Lock(threshbydst_index, hash);
+
+            locked = true;
+
+            i = Thresh_By_Dst_Find(rule_position, ip_dst_bits, selector, hash);
+
+            if ( i == -1 && counters_ipc->thresh_count_by_dst < IPC_Max(THRESH_BY_DST) )
+                {
 
-            memcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].ipdst, ip_dst_bits, sizeof(threshbydst_ipc[counters_ipc->thresh_count_by_dst].ipdst));
-            strlcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].sid, rulestruct[rule_position].s_sid, sizeof(threshbydst_ipc[counters_ipc->thresh_count_by_dst].sid));
-            selector == NULL ? threshbydst_ipc[counters_ipc->thresh_count_by_dst].selector[0] = '\0' : strlcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].selector, selector, MAXSELECTOR);
-            threshbydst_ipc[counters_ipc->thresh_count_by_dst].count = 1;
-            threshbydst_ipc[counters_ipc->thresh_count_by_dst].utime = atol(timet);
-            threshbydst_ipc[counters_ipc->thresh_count_by_dst].expire = rulestruct[rule_position].threshold_seconds;
+                    memcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].ipdst, ip_dst_bits, sizeof(threshbydst_ipc[counters_ipc->thresh_count_by_dst].ipdst));
+                    strlcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].sid, rulestruct[rule_position].s_sid, sizeof(threshbydst_ipc[counters_ipc->thresh_count_by_dst].sid));
+                    selector == NULL ? threshbydst_ipc[counters_ipc->thresh_count_by_dst].selector[0] = '\0' : strlcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].selector, selector, MAXSELECTOR);
+                    threshbydst_ipc[counters_ipc->thresh_count_by_dst].count = 1;
+                    threshbydst_ipc[counters_ipc->thresh_count_by_dst].utime = utime;
+                    threshbydst_ipc[counters_ipc->thresh_count_by_dst].expire = rulestruct[rule_position].threshold_seconds;
+                    Thresh_Init(rule_position, &threshbydst_state[counters_ipc->thresh_count_by_dst]);
 
-            strlcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].syslog_message, syslog_message, sizeof(threshbydst_ipc[counters_ipc->thresh_count_by_dst].syslog_message));
-            strlcpy(threshbydst_ipc[counters_ipc->thresh_count_by_dst].signature_msg, rulestruct[rule_position].s_msg, sizeof(threshbydst_ipc[counters_ipc->thresh_count_by_dst].signature_msg));
+                    threshbydst_ipc[counters_ipc->thresh_count_by_dst].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
-            counters_ipc->thresh_count_by_dst++;
+                    IPC_Index_Add(threshbydst_index, hash, counters_ipc->thresh_count_by_dst, utime + rulestruct[rule_position].threshold_seconds);
+                    counters_ipc->thresh_count_by_dst++;
+
+                }
+
+        }
+
+    if ( i != -1 )
+        {
+
+            threshbydst_ipc[i].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
+
+            if ( Thresh_Check(rule_position, &threshbydst_ipc[i].count, &threshbydst_ipc[i].utime, &threshbydst_state[i], utime) )
+                {
 
+                    thresh_log_flag = true;
+
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "Threshold SID %s by destination IP address. [%s]", threshbydst_ipc[i].sid, ip_dst);
+                        }
+
+                    __atomic_add_fetch(&counters->threshold_total, 1, __ATOMIC_RELAXED);
+                }
+
+        }
+
+    IPC_Index_Unlock(threshbydst_index, hash);
+
+    if ( locked == true )
+        {
             pthread_mutex_unlock(&Thresh_By_Dst_Mutex);
             File_Unlock(config->shm_thresh_by_dst);
         }
 
-    return(false);
+    return(thresh_log_flag);
 }
 
 /*************************/
 /* Threshold by username */
 /*************************/
 
-bool Thresh_By_Username( int rule_position, char *normalize_username, char *selector, char *syslog_message )
-{
+/* The threshold by username record for the event,  or -1 */
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
-
-    bool thresh_log_flag = false;
-
-    uint64_t thresh_oldtime;
+static int Thresh_By_Username_Find( int rule_position, char *normalize_username, char *selector, uint32_t hash )
+{
 
     int i;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    uint32_t slot = 0;
 
-    /* Check array fror matching username / sid */
-
-    for (i = 0; i < counters_ipc->thresh_count_by_username; i++)
+    for ( slot = hash; ( i = IPC_Index_Next(threshbyusername_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -308,100 +503,127 @@ bool Thresh_By_Username( int rule_position, char *normalize_username, char *sele
                     continue;
                 }
 
-            if ( !strcmp(threshbyusername_ipc[rule_position].username, normalize_username) && !strcmp(threshbyusername_ipc[rule_position].sid, rulestruct[rule_position].s_sid ))
+            if ( !strcmp(threshbyusername_ipc[i].username, normalize_username) && !strcmp(threshbyusername_ipc[i].sid, rulestruct[rule_position].s_sid ))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_thresh_by_username);
-                    pthread_mutex_lock(&Thresh_By_Username_Mutex);
+    return(-1);
+}
 
-                    threshbyusername_ipc[rule_position].count++;
-                    thresh_oldtime = atol(timet) - threshbyusername_ipc[rule_position].utime;
-                    threshbyusername_ipc[rule_position].utime = atol(timet);
+bool Thresh_By_Username( int rule_position, char *normalize_username, char *selector, char *syslog_message )
+{
 
-                    strlcpy(threshbyusername_ipc[i].syslog_message, syslog_message, sizeof(threshbyusername_ipc[i].syslog_message));
-                    strlcpy(threshbyusername_ipc[i].signature_msg, rulestruct[rule_position].s_msg, sizeof(threshbyusername_ipc[i].signature_msg));
+    uint64_t utime = time(NULL);
 
+    bool thresh_log_flag = false;
 
-                    if ( thresh_oldtime > rulestruct[rule_position].threshold_seconds )
-                        {
-                            threshbyusername_ipc[rule_position].count=1;
-                            threshbyusername_ipc[rule_position].utime = atol(timet);
-                            thresh_log_flag = false;
-                        }
+    int i;
 
-                    if ( rulestruct[rule_position].threshold_count < threshbyusername_ipc[rule_position].count )
-                        {
+    uint32_t hash = 0;
 
-                            thresh_log_flag = true;
+    char username[sizeof(threshbyusername_ipc[0].username)] = { 0 };
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "Threshold SID %s by_username / by_string. [%s]", threshbyusername_ipc[rule_position].sid, normalize_username);
-                                }
+    bool locked = false;
 
-                            counters->threshold_total++;
-                        }
+    /* Hash,  compare and store the username as the record holds it.  A
+       longer one would hash to a different slot than the reaper finds */
 
-                    pthread_mutex_unlock(&Thresh_By_Username_Mutex);
-                    File_Unlock(config->shm_thresh_by_username);
+    strlcpy(username, normalize_username, sizeof(username));
+    normalize_username = username;
 
-                    return(thresh_log_flag);
+    /* Find the matching username / sid via the hash index (see ipc.c) */
 
-                }
-        }
+    hash = IPC_Index_Hash(normalize_username, strlen(normalize_username), rulestruct[rule_position].s_sid, selector);
+
+    IPC_Index_Lock(threshbyusername_index, hash);
+
+    i = Thresh_By_Username_Find(rule_position, normalize_username, selector, hash);
 
-    /* Username not found, add it to array */
+    /* If not found,  add it to the array.  See Thresh_By_Src() */
 
-    if ( Clean_IPC_Object(THRESH_BY_USERNAME) == 0 )
+    if ( i == -1 )
         {
 
+            IPC_Index_Unlock(threshbyusername_index, hash);
+
+            Clean_IPC_Object(THRESH_BY_USERNAME);
+
             File_Lock(config->shm_thresh_by_username);
             pthread_mutex_lock(&Thresh_By_Username_Mutex);
+            IPC_Index_Lock(threshbyusername_index, hash);
+
+            locked = true;
+
+            i = Thresh_By_Username_Find(rule_position, normalize_username, selector, hash);
 
-            strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].username, normalize_username, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].username));
-            strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].sid, rulestruct[rule_position].s_sid, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].sid));
-            selector == NULL ? threshbyusername_ipc[counters_ipc->thresh_count_by_username].selector[0] = '\0' : strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].selector, selector, MAXSELECTOR);
-            threshbyusername_ipc[counters_ipc->thresh_count_by_username].count = 1;
-            threshbyusername_ipc[counters_ipc->thresh_count_by_username].utime = atol(timet);
-            threshbyusername_ipc[counters_ipc->thresh_count_by_username].expire = rulestruct[rule_position].threshold_seconds;
+            if ( i == -1 && counters_ipc->thresh_count_by_username < IPC_Max(THRESH_BY_USERNAME) )
+                {
+
+                    strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].username, normalize_username, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].username));
+                    strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].sid, rulestruct[rule_position].s_sid, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].sid));
+                    selector == NULL ? threshbyusername_ipc[counters_ipc->thresh_count_by_username].selector[0] = '\0' : strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].selector, selector, MAXSELECTOR);
+                    threshbyusername_ipc[counters_ipc->thresh_count_by_username].count = 1;
+                    threshbyusername_ipc[counters_ipc->thresh_count_by_username].utime = utime;
+                    threshbyusername_ipc[counters_ipc->thresh_count_by_username].expire = rulestruct[rule_position].threshold_seconds;
+                    Thresh_Init(rule_position, &threshbyusername_state[counters_ipc->thresh_count_by_username]);
+
+                    threshbyusername_ipc[counters_ipc->thresh_count_by_username].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
+
+
+                    IPC_Index_Add(threshbyusername_index, hash, counters_ipc->thresh_count_by_username, utime + rulestruct[rule_position].threshold_seconds);
+                    counters_ipc->thresh_count_by_username++;
 
-            strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].syslog_message, syslog_message, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].syslog_message));
-            strlcpy(threshbyusername_ipc[counters_ipc->thresh_count_by_username].signature_msg, rulestruct[rule_position].s_msg, sizeof(threshbyusername_ipc[counters_ipc->thresh_count_by_username].signature_msg));
+                }
+
+        }
+
+    if ( i != -1 )
+        {
 
+            threshbyusername_ipc[i].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
-            counters_ipc->thresh_count_by_username++;
+            if ( Thresh_Check(rule_position, &threshbyusername_ipc[i].count, &threshbyusername_ipc[i].utime, &threshbyusername_state[i], utime) )
+                {
+
+                    thresh_log_flag = true;
+
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "Threshold SID %s by_username / by_string. [%s]", threshbyusername_ipc[i].sid, normalize_username);
+                        }
+
+                    __atomic_add_fetch(&counters->threshold_total, 1, __ATOMIC_RELAXED);
+                }
+
+        }
 
+    IPC_Index_Unlock(threshbyusername_index, hash);
+
+    if ( locked == true )
+        {
             pthread_mutex_unlock(&Thresh_By_Username_Mutex);
             File_Unlock(config->shm_thresh_by_username);
         }
 
-    return(false);
+    return(thresh_log_flag);
 }
 
 /*********************************/
 /* Threshold by destination port */
 /*********************************/
 
-bool Thresh_By_DstPort( int rule_position, uint32_t ip_dstport_u32, char *selector )
-{
+/* The threshold by destination port record for the event,  or -1 */
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
-
-    bool thresh_log_flag = false;
-
-    uint64_t thresh_oldtime;
+static int Thresh_By_DstPort_Find( int rule_position, uint32_t ip_dstport_u32, char *selector, uint32_t hash )
+{
 
     int i;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    uint32_t slot = 0;
 
-    /* Check array for matching dst port / sid */
-
-    for (i = 0; i < counters_ipc->thresh_count_by_dstport; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(threshbydstport_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -414,93 +636,113 @@ bool Thresh_By_DstPort( int rule_position, uint32_t ip_dstport_u32, char *select
                     continue;
                 }
 
-            if ( threshbydstport_ipc[rule_position].ipdstport == ip_dstport_u32 && !strcmp(threshbydstport_ipc[rule_position].sid, rulestruct[rule_position].s_sid ))
+            if ( threshbydstport_ipc[i].ipdstport == ip_dstport_u32 && !strcmp(threshbydstport_ipc[i].sid, rulestruct[rule_position].s_sid ))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_thresh_by_dstport);
-                    pthread_mutex_lock(&Thresh_By_Dst_Port_Mutex);
+    return(-1);
+}
 
-                    threshbydstport_ipc[rule_position].count++;
-                    thresh_oldtime = atol(timet) - threshbydstport_ipc[rule_position].utime;
-                    threshbydstport_ipc[rule_position].utime = atol(timet);
+bool Thresh_By_DstPort( int rule_position, uint32_t ip_dstport_u32, char *selector )
+{
 
-                    if ( thresh_oldtime > rulestruct[rule_position].threshold_seconds )
-                        {
+    uint64_t utime = time(NULL);
 
-                            threshbydstport_ipc[rule_position].count=1;
-                            threshbydstport_ipc[rule_position].utime = atol(timet);
-                            thresh_log_flag = false;
-                        }
+    bool thresh_log_flag = false;
 
-                    if ( rulestruct[rule_position].threshold_count < threshbydstport_ipc[rule_position].count )
-                        {
-                            thresh_log_flag = true;
+    int i;
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "Threshold SID %s by destination IP port. [%s]", threshbydstport_ipc[rule_position].sid, ip_dstport_u32);
-                                }
+    uint32_t hash = 0;
 
-                            counters->threshold_total++;
-                        }
+    bool locked = false;
 
-                    pthread_mutex_unlock(&Thresh_By_Dst_Port_Mutex);
-                    File_Unlock(config->shm_thresh_by_dstport);
+    /* Find the matching dst port / sid via the hash index (see ipc.c) */
 
-                    return(thresh_log_flag);
+    hash = IPC_Index_Hash(&ip_dstport_u32, sizeof(uint32_t), rulestruct[rule_position].s_sid, selector);
 
-                }
-        }
+    IPC_Index_Lock(threshbydstport_index, hash);
 
-    /* If not found,  add it to the array */
+    i = Thresh_By_DstPort_Find(rule_position, ip_dstport_u32, selector, hash);
 
-    if ( Clean_IPC_Object(THRESH_BY_DSTPORT) == 0 )
+    /* If not found,  add it to the array.  See Thresh_By_Src() */
+
+    if ( i == -1 )
         {
 
+            IPC_Index_Unlock(threshbydstport_index, hash);
+
+            Clean_IPC_Object(THRESH_BY_DSTPORT);
+
             File_Lock(config->shm_thresh_by_dstport);
             pthread_mutex_lock(&Thresh_By_Dst_Port_Mutex);
+            IPC_Index_Lock(threshbydstport_index, hash);
 
+            locked = true;
 
-            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].ipdstport = ip_dstport_u32;
-            strlcpy(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].sid, rulestruct[rule_position].s_sid, sizeof(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].sid));
-            selector == NULL ? threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].selector[0] = '\0' : strlcpy(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].selector, selector, MAXSELECTOR);
-            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].count = 1;
-            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].utime = atol(timet);
-            threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].expire = rulestruct[rule_position].threshold_seconds;
+            i = Thresh_By_DstPort_Find(rule_position, ip_dstport_u32, selector, hash);
+
+            if ( i == -1 && counters_ipc->thresh_count_by_dstport < IPC_Max(THRESH_BY_DSTPORT) )
+                {
 
-            counters_ipc->thresh_count_by_dstport++;
+                    threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].ipdstport = ip_dstport_u32;
+                    strlcpy(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].sid, rulestruct[rule_position].s_sid, sizeof(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].sid));
+                    selector == NULL ? threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].selector[0] = '\0' : strlcpy(threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].selector, selector, MAXSELECTOR);
+                    threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].count = 1;
+                    threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].utime = utime;
+                    threshbydstport_ipc[counters_ipc->thresh_count_by_dstport].expire = rulestruct[rule_position].threshold_seconds;
+                    Thresh_Init(rule_position, &threshbydstport_state[counters_ipc->thresh_count_by_dstport]);
+
+                    IPC_Index_Add(threshbydstport_index, hash, counters_ipc->thresh_count_by_dstport, utime + rulestruct[rule_position].threshold_seconds);
+                    counters_ipc->thresh_count_by_dstport++;
+
+                }
+
+        }
+
+    if ( i != -1 )
+        {
+
+            if ( Thresh_Check(rule_position, &threshbydstport_ipc[i].count, &threshbydstport_ipc[i].utime, &threshbydstport_state[i], utime) )
+                {
+                    thresh_log_flag = true;
 
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "Threshold SID %s by destination IP port. [%u]", threshbydstport_ipc[i].sid, ip_dstport_u32);
+                        }
+
+                    __atomic_add_fetch(&counters->threshold_total, 1, __ATOMIC_RELAXED);
+                }
+
+        }
+
+    IPC_Index_Unlock(threshbydstport_index, hash);
+
+    if ( locked == true )
+        {
             pthread_mutex_unlock(&Thresh_By_Dst_Port_Mutex);
             File_Unlock(config->shm_thresh_by_dstport);
         }
 
-    return(false);
+    return(thresh_log_flag);
 }
 
 /****************************/
 /* Threshold by source port */
 /****************************/
 
-bool Thresh_By_SrcPort( int rule_position, uint32_t ip_srcport_u32, char *selector )
-{
+/* The threshold by source port record for the event,  or -1 */
 
-    time_t t;
-    struct tm *now;
-    char  timet[20];
-
-    bool thresh_log_flag = false;
-
-    uint64_t thresh_oldtime;
+static int Thresh_By_SrcPort_Find( int rule_position, uint32_t ip_srcport_u32, char *selector, uint32_t hash )
+{
 
     int i;
 
-    t = time(NULL);
-    now=localtime(&t);
-    strftime(timet, sizeof(timet), "%s",  now);
+    uint32_t slot = 0;
 
-    /* Check array for matching src port / sid */
-
-    for (i = 0; i < counters_ipc->thresh_count_by_srcport; i++ )
+    for ( slot = hash; ( i = IPC_Index_Next(threshbysrcport_index, hash, &slot) ) != -1; )
         {
             /* Short circuit if no selector match */
 
@@ -513,66 +755,96 @@ bool Thresh_By_SrcPort( int rule_position, uint32_t ip_srcport_u32, char *select
                     continue;
                 }
 
-            if ( threshbysrcport_ipc[rule_position].ipsrcport == ip_srcport_u32 && !strcmp(threshbysrcport_ipc[rule_position].sid, rulestruct[rule_position].s_sid ))
+            if ( threshbysrcport_ipc[i].ipsrcport == ip_srcport_u32 && !strcmp(threshbysrcport_ipc[i].sid, rulestruct[rule_position].s_sid ))
                 {
+                    return(i);
+                }
+        }
 
-                    File_Lock(config->shm_thresh_by_srcport);
-                    pthread_mutex_lock(&Thresh_By_Src_Port_Mutex);
+    return(-1);
+}
 
-                    threshbysrcport_ipc[rule_position].count++;
-                    thresh_oldtime = atol(timet) - threshbysrcport_ipc[rule_position].utime;
-                    threshbysrcport_ipc[rule_position].utime = atol(timet);
+bool Thresh_By_SrcPort( int rule_position, uint32_t ip_srcport_u32, char *selector )
+{
 
-                    if ( thresh_oldtime > rulestruct[rule_position].threshold_seconds )
-                        {
+    uint64_t utime = time(NULL);
 
-                            threshbysrcport_ipc[rule_position].count=1;
-                            threshbysrcport_ipc[rule_position].utime = atol(timet);
-                            thresh_log_flag = false;
-                        }
+    bool thresh_log_flag = false;
 
-                    if ( rulestruct[rule_position].threshold_count < threshbysrcport_ipc[rule_position].count )
-                        {
-                            thresh_log_flag = true;
+    int i;
 
-                            if ( debug->debuglimits )
-                                {
-                                    Sagan_Log(NORMAL, "Threshold SID %s by source IP port. [%s]", threshbysrcport_ipc[rule_position].sid, ip_srcport_u32);
-                                }
+    uint32_t hash = 0;
 
-                            counters->threshold_total++;
-                        }
+    bool locked = false;
 
-                    pthread_mutex_unlock(&Thresh_By_Src_Port_Mutex);
-                    File_Unlock(config->shm_thresh_by_srcport);
+    /* Find the matching src port / sid via the hash index (see ipc.c) */
 
-                    return(thresh_log_flag);
+    hash = IPC_Index_Hash(&ip_srcport_u32, sizeof(uint32_t), rulestruct[rule_position].s_sid, selector);
 
-                }
-        }
+    IPC_Index_Lock(threshbysrcport_index, hash);
 
-    /* If not found,  add it to the array */
+    i = Thresh_By_SrcPort_Find(rule_position, ip_srcport_u32, selector, hash);
 
-    if ( Clean_IPC_Object(THRESH_BY_SRCPORT) == 0 )
+    /* If not found,  add it to the array.  See Thresh_By_Src() */
+
+    if ( i == -1 )
         {
 
+            IPC_Index_Unlock(threshbysrcport_index, hash);
+
+            Clean_IPC_Object(THRESH_BY_SRCPORT);
+
             File_Lock(config->shm_thresh_by_srcport);
             pthread_mutex_lock(&Thresh_By_Src_Port_Mutex);
+            IPC_Index_Lock(threshbysrcport_index, hash);
+
+            locked = true;
+
+            i = Thresh_By_SrcPort_Find(rule_position, ip_srcport_u32, selector, hash);
+
+            if ( i == -1 && counters_ipc->thresh_count_by_srcport < IPC_Max(THRESH_BY_SRCPORT) )
+                {
+
+                    threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].ipsrcport = ip_srcport_u32;
+                    strlcpy(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].sid, rulestruct[rule_position].s_sid, sizeof(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].sid));
+                    selector == NULL ? threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].selector[0] = '\0' : strlcpy(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].selector, selector, MAXSELECTOR);
+                    threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].count = 1;
+                    threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].utime = utime;
+                    threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].expire = rulestruct[rule_position].threshold_seconds;
+                    Thresh_Init(rule_position, &threshbysrcport_state[counters_ipc->thresh_count_by_srcport]);
+
+                    IPC_Index_Add(threshbysrcport_index, hash, counters_ipc->thresh_count_by_srcport, utime + rulestruct[rule_position].threshold_seconds);
+                    counters_ipc->thresh_count_by_srcport++;
+
+                }
+
+        }
+
+    if ( i != -1 )
+        {
 
+            if ( Thresh_Check(rule_position, &threshbysrcport_ipc[i].count, &threshbysrcport_ipc[i].utime, &threshbysrcport_state[i], utime) )
+                {
+                    thresh_log_flag = true;
 
-            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].ipsrcport = ip_srcport_u32;
-            strlcpy(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].sid, rulestruct[rule_position].s_sid, sizeof(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].sid));
-            selector == NULL ? threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].selector[0] = '\0' : strlcpy(threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].selector, selector, MAXSELECTOR);
-            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].count = 1;
-            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].utime = atol(timet);
-            threshbysrcport_ipc[counters_ipc->thresh_count_by_srcport].expire = rulestruct[rule_position].threshold_seconds;
+                    if ( debug->debuglimits )
+                        {
+                            Sagan_Log(NORMAL, "Threshold SID %s by source IP port. [%u]", threshbysrcport_ipc[i].sid, ip_srcport_u32);
+                        }
 
-            counters_ipc->thresh_count_by_srcport++;
+                    __atomic_add_fetch(&counters->threshold_total, 1, __ATOMIC_RELAXED);
+                }
 
+        }
+
+    IPC_Index_Unlock(threshbysrcport_index, hash);
+
+    if ( locked == true )
+        {
             pthread_mutex_unlock(&Thresh_By_Src_Port_Mutex);
             File_Unlock(config->shm_thresh_by_srcport);
         }
 
-    return(false);
+    return(thresh_log_flag);
 }
 
@@ -0,0 +1,459 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* util-ac.c
+ *
+ * Aho-Corasick automaton used to look for every rule's content at once.
+ * Patterns are added to a trie,  then Sagan_AC_Compile() lays the
+ * transitions out in flat arrays and computes the failure links.  After
+ * that the automaton is read only and can be searched by any number of
+ * threads.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "sagan.h"
+#include "util-ac.h"
+
+/****************************************************************************
+ * AC_New_State - Adds a (build time) state.  Returns its number.
+ ****************************************************************************/
+
+static uint32_t AC_New_State( _Sagan_AC *ac, unsigned char c )
+{
+
+    if ( ac->state_count == ac->state_max )
+        {
+
+            ac->state_max = ac->state_max * 2;
+
+            ac->first_child = realloc(ac->first_child, ac->state_max * sizeof(uint32_t));
+            ac->next_sibling = realloc(ac->next_sibling, ac->state_max * sizeof(uint32_t));
+            ac->c = realloc(ac->c, ac->state_max * sizeof(unsigned char));
+
+            if ( ac->first_child == NULL || ac->next_sibling == NULL || ac->c == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for Aho-Corasick states. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    ac->first_child[ac->state_count] = 0;
+    ac->next_sibling[ac->state_count] = 0;
+    ac->c[ac->state_count] = c;
+
+    return(ac->state_count++);
+}
+
+/****************************************************************************
+ * AC_Next - Follows the transition for "c" from "state".  Returns 0 (the
+ * root) if there isn't one.  Only valid after Sagan_AC_Compile().
+ ****************************************************************************/
+
+static inline uint32_t AC_Next( _Sagan_AC *ac, uint32_t state, unsigned char c )
+{
+
+    uint32_t lo = ac->states[state].edges;
+    uint32_t hi = lo + ac->states[state].edge_count;
+    uint32_t mid = 0;
+
+    if ( state == 0 )
+        {
+            return(ac->root[c]);
+        }
+
+    while ( lo < hi )
+        {
+
+            mid = ( lo + hi ) / 2;
+
+            if ( ac->edge_c[mid] == c )
+                {
+                    return(ac->edge_next[mid]);
+                }
+
+            if ( ac->edge_c[mid] < c )
+                {
+                    lo = mid + 1;
+                }
+            else
+                {
+                    hi = mid;
+                }
+        }
+
+    return(0);
+}
+
+/****************************************************************************
+ * Sagan_AC_Init - New,  empty,  automaton
+ ****************************************************************************/
+
+_Sagan_AC *Sagan_AC_Init( bool nocase )
+{
+
+    _Sagan_AC *ac = NULL;
+    int i = 0;
+
+    ac = calloc(1, sizeof(_Sagan_AC));
+
+    if ( ac == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for Aho-Corasick. Abort!", __FILE__, __LINE__);
+        }
+
+    for ( i = 0; i < 256; i++ )
+        {
+            ac->map[i] = nocase == true ? (unsigned char)tolower(i) : (unsigned char)i;
+        }
+
+    ac->state_max = 256;
+
+    ac->first_child = malloc(ac->state_max * sizeof(uint32_t));
+    ac->next_sibling = malloc(ac->state_max * sizeof(uint32_t));
+    ac->c = malloc(ac->state_max * sizeof(unsigned char));
+
+    if ( ac->first_child == NULL || ac->next_sibling == NULL || ac->c == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for Aho-Corasick states. Abort!", __FILE__, __LINE__);
+        }
+
+    (void)AC_New_State(ac, 0);		/* Root */
+
+    return(ac);
+}
+
+/****************************************************************************
+ * Sagan_AC_Add - Adds a pattern.  "id" is the bit set by Sagan_AC_Search()
+ * when the pattern is found.
+ ****************************************************************************/
+
+void Sagan_AC_Add( _Sagan_AC *ac, const char *pattern, size_t len, uint32_t id )
+{
+
+    uint32_t state = 0;
+    uint32_t child = 0;
+    unsigned char c = 0;
+    size_t i = 0;
+
+    /* An empty pattern ends up on the root and matches anything */
+
+    for ( i = 0; i < len; i++ )
+        {
+
+            c = ac->map[(unsigned char)pattern[i]];
+
+            for ( child = ac->first_child[state]; child != 0 && ac->c[child] != c; child = ac->next_sibling[child] );
+
+            if ( child == 0 )
+                {
+                    child = AC_New_State(ac, c);
+                    ac->next_sibling[child] = ac->first_child[state];
+                    ac->first_child[state] = child;
+                }
+
+            state = child;
+        }
+
+    if ( ac->pending_count == ac->pending_max )
+        {
+
+            ac->pending_max = ac->pending_max == 0 ? 256 : ac->pending_max * 2;
+
+            ac->pending_state = realloc(ac->pending_state, ac->pending_max * sizeof(uint32_t));
+            ac->pending_id = realloc(ac->pending_id, ac->pending_max * sizeof(uint32_t));
+
+            if ( ac->pending_state == NULL || ac->pending_id == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for Aho-Corasick patterns. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    ac->pending_state[ac->pending_count] = state;
+    ac->pending_id[ac->pending_count] = id;
+    ac->pending_count++;
+
+    ac->pattern_count++;
+
+}
+
+/****************************************************************************
+ * Sagan_AC_Compile - Flattens the trie and computes the failure links
+ ****************************************************************************/
+
+void Sagan_AC_Compile( _Sagan_AC *ac )
+{
+
+    uint32_t *queue = NULL;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+
+    uint32_t state = 0;
+    uint32_t child = 0;
+    uint32_t fail = 0;
+    uint32_t edge = 0;
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    unsigned char c = 0;
+    unsigned char tmp_c = 0;
+    uint32_t tmp_next = 0;
+
+    ac->states = calloc(ac->state_count, sizeof(_Sagan_AC_State));
+    ac->edge_c = malloc(ac->state_count * sizeof(unsigned char));
+    ac->edge_next = malloc(ac->state_count * sizeof(uint32_t));
+    ac->ids = malloc(( ac->pending_count + 1 ) * sizeof(uint32_t));
+    queue = malloc(ac->state_count * sizeof(uint32_t));
+
+    if ( ac->states == NULL || ac->edge_c == NULL || ac->edge_next == NULL || ac->ids == NULL || queue == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for Aho-Corasick. Abort!", __FILE__, __LINE__);
+        }
+
+    /* Transitions.  Every state but the root is someone's child,  so there
+       are state_count - 1 edges.  Each state's are sorted for searching */
+
+    for ( state = 0; state < ac->state_count; state++ )
+        {
+
+            ac->states[state].edges = edge;
+
+            for ( child = ac->first_child[state]; child != 0; child = ac->next_sibling[child] )
+                {
+
+                    ac->edge_c[edge] = ac->c[child];
+                    ac->edge_next[edge] = child;
+
+                    for ( j = edge; j > ac->states[state].edges && ac->edge_c[j - 1] > ac->edge_c[j]; j-- )
+                        {
+                            tmp_c = ac->edge_c[j];
+                            tmp_next = ac->edge_next[j];
+                            ac->edge_c[j] = ac->edge_c[j - 1];
+                            ac->edge_next[j] = ac->edge_next[j - 1];
+                            ac->edge_c[j - 1] = tmp_c;
+                            ac->edge_next[j - 1] = tmp_next;
+                        }
+
+                    edge++;
+                }
+
+            ac->states[state].edge_count = edge - ac->states[state].edges;
+        }
+
+    for ( i = 0; i < ac->states[0].edge_count; i++ )
+        {
+            ac->root[ac->edge_c[i]] = ac->edge_next[i];
+        }
+
+    /* Ids,  grouped by state */
+
+    for ( i = 0; i < ac->pending_count; i++ )
+        {
+            ac->states[ac->pending_state[i]].id_count++;
+        }
+
+    for ( state = 0, j = 0; state < ac->state_count; state++ )
+        {
+            ac->states[state].ids = j;
+            j += ac->states[state].id_count;
+            ac->states[state].id_count = 0;
+        }
+
+    for ( i = 0; i < ac->pending_count; i++ )
+        {
+            state = ac->pending_state[i];
+            ac->ids[ac->states[state].ids + ac->states[state].id_count++] = ac->pending_id[i];
+        }
+
+    ac->id_count = ac->pending_count;
+
+    /* Failure/output links,  breadth first */
+
+    for ( i = 0; i < ac->states[0].edge_count; i++ )
+        {
+            child = ac->edge_next[i];
+            ac->states[child].fail = 0;
+            ac->states[child].output = ac->states[child].id_count != 0 ? child : 0;
+            queue[tail++] = child;
+        }
+
+    while ( head < tail )
+        {
+
+            state = queue[head++];
+
+            for ( i = 0; i < ac->states[state].edge_count; i++ )
+                {
+
+                    c = ac->edge_c[ac->states[state].edges + i];
+                    child = ac->edge_next[ac->states[state].edges + i];
+
+                    fail = ac->states[state].fail;
+
+                    while ( fail != 0 && AC_Next(ac, fail, c) == 0 )
+                        {
+                            fail = ac->states[fail].fail;
+                        }
+
+                    fail = AC_Next(ac, fail, c);
+
+                    ac->states[child].fail = fail;
+                    ac->states[child].output = ac->states[child].id_count != 0 ? child : ac->states[fail].output;
+
+                    queue[tail++] = child;
+                }
+        }
+
+    free(queue);
+
+    free(ac->first_child);
+    free(ac->next_sibling);
+    free(ac->c);
+    free(ac->pending_state);
+    free(ac->pending_id);
+
+    ac->first_child = NULL;
+    ac->next_sibling = NULL;
+    ac->c = NULL;
+    ac->pending_state = NULL;
+    ac->pending_id = NULL;
+
+}
+
+/****************************************************************************
+ * Sagan_AC_Search - Scans "text" once and sets the bit of every pattern
+ * id found in it.
+ ****************************************************************************/
+
+void Sagan_AC_Search( _Sagan_AC *ac, const char *text, size_t len, uint64_t *bits )
+{
+
+    uint32_t state = 0;
+    uint32_t next = 0;
+    uint32_t output = 0;
+    uint32_t i = 0;
+    size_t pos = 0;
+
+    unsigned char c = 0;
+
+    for ( i = 0; i < ac->states[0].id_count; i++ )
+        {
+            bits[ac->ids[ac->states[0].ids + i] >> 6] |= 1ULL << ( ac->ids[ac->states[0].ids + i] & 63 );
+        }
+
+    for ( pos = 0; pos < len; pos++ )
+        {
+
+            c = ac->map[(unsigned char)text[pos]];
+
+            while ( ( next = AC_Next(ac, state, c) ) == 0 && state != 0 )
+                {
+                    state = ac->states[state].fail;
+                }
+
+            state = next;
+
+            for ( output = ac->states[state].output; output != 0; output = ac->states[ac->states[output].fail].output )
+                {
+                    for ( i = 0; i < ac->states[output].id_count; i++ )
+                        {
+                            bits[ac->ids[ac->states[output].ids + i] >> 6] |= 1ULL << ( ac->ids[ac->states[output].ids + i] & 63 );
+                        }
+                }
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_AC_Match - Returns true as soon as any pattern is found in "text"
+ ****************************************************************************/
+
+bool Sagan_AC_Match( _Sagan_AC *ac, const char *text, size_t len )
+{
+
+    uint32_t state = 0;
+    uint32_t next = 0;
+    size_t pos = 0;
+
+    unsigned char c = 0;
+
+    if ( ac->states[0].id_count != 0 )
+        {
+            return(true);
+        }
+
+    for ( pos = 0; pos < len; pos++ )
+        {
+
+            c = ac->map[(unsigned char)text[pos]];
+
+            while ( ( next = AC_Next(ac, state, c) ) == 0 && state != 0 )
+                {
+                    state = ac->states[state].fail;
+                }
+
+            state = next;
+
+            if ( ac->states[state].output != 0 )
+                {
+                    return(true);
+                }
+        }
+
+    return(false);
+
+}
+
+/****************************************************************************
+ * Sagan_AC_Free - Clean up
+ ****************************************************************************/
+
+void Sagan_AC_Free( _Sagan_AC *ac )
+{
+
+    if ( ac == NULL )
+        {
+            return;
+        }
+
+    free(ac->states);
+    free(ac->edge_c);
+    free(ac->edge_next);
+    free(ac->ids);
+
+    free(ac->first_child);
+    free(ac->next_sibling);
+    free(ac->c);
+    free(ac->pending_state);
+    free(ac->pending_id);
+
+    free(ac);
+
+}
+
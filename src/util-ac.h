@@ -0,0 +1,80 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Aho-Corasick multi-pattern matcher.  Patterns and text can be compared
+ * case insensitively.  The root state has a full 256 entry table.  Every
+ * other state keeps its transitions in a sorted array,  which keeps the
+ * automaton small with tens of thousands of patterns. */
+
+typedef struct _Sagan_AC_State _Sagan_AC_State;
+struct _Sagan_AC_State
+{
+    uint32_t fail;
+    uint32_t output;			/* Closest state (this or via fail) with ids.  0 == none */
+    uint32_t edges;			/* First transition in edge_c[]/edge_next[] */
+    uint32_t edge_count;
+    uint32_t ids;			/* First id in ids[] */
+    uint32_t id_count;
+};
+
+typedef struct _Sagan_AC _Sagan_AC;
+struct _Sagan_AC
+{
+    _Sagan_AC_State *states;
+    uint32_t state_count;
+
+    uint32_t root[256];
+    unsigned char map[256];		/* Applied to patterns & text (tolower() for nocase) */
+
+    unsigned char *edge_c;
+    uint32_t *edge_next;
+
+    uint32_t *ids;
+    uint32_t id_count;
+
+    /* Only used while building */
+
+    uint32_t state_max;
+    uint32_t *first_child;
+    uint32_t *next_sibling;
+    unsigned char *c;
+    uint32_t *pending_state;
+    uint32_t *pending_id;
+    uint32_t pending_count;
+    uint32_t pending_max;
+
+    uint32_t pattern_count;
+};
+
+_Sagan_AC *Sagan_AC_Init( bool nocase );
+void Sagan_AC_Add( _Sagan_AC *ac, const char *pattern, size_t len, uint32_t id );
+void Sagan_AC_Compile( _Sagan_AC *ac );
+void Sagan_AC_Search( _Sagan_AC *ac, const char *text, size_t len, uint64_t *bits );
+bool Sagan_AC_Match( _Sagan_AC *ac, const char *text, size_t len );
+void Sagan_AC_Free( _Sagan_AC *ac );
+
@@ -0,0 +1,161 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* util-arena.c
+ *
+ * Arena ("bump") allocator.  See util-arena.h.  An arena isn't thread safe.
+ * Whoever adds to it has to be the only one doing so,  but readers of what
+ * was already handed out don't need a lock.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "util-arena.h"
+
+/****************************************************************************
+ * Sagan_Arena_Init - Returns a new,  empty arena.  Blocks are allocated
+ * as needed.
+ ****************************************************************************/
+
+_Sagan_Arena *Sagan_Arena_Init( size_t block_size )
+{
+
+    _Sagan_Arena *arena = calloc(1, sizeof(_Sagan_Arena));
+
+    if ( arena == NULL )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Arena. Abort!", __FILE__, __LINE__);
+        }
+
+    arena->block_size = block_size != 0 ? block_size : ARENA_BLOCK_SIZE;
+
+    return(arena);
+}
+
+/****************************************************************************
+ * Sagan_Arena_Alloc - Returns "size" bytes of zeroed memory
+ ****************************************************************************/
+
+void *Sagan_Arena_Alloc( _Sagan_Arena *arena, size_t size )
+{
+
+    _Sagan_Arena_Block *block = arena->head;
+    size_t block_size = 0;
+    void *ptr = NULL;
+
+    size = ( size + ARENA_ALIGN - 1 ) & ~( (size_t)ARENA_ALIGN - 1 );
+
+    if ( block == NULL || block->size - block->used < size )
+        {
+
+            /* Anything bigger than a block gets a block of its own */
+
+            block_size = size > arena->block_size ? size : arena->block_size;
+
+            block = calloc(1, sizeof(_Sagan_Arena_Block) + block_size);
+
+            if ( block == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Arena_Block. Abort!", __FILE__, __LINE__);
+                }
+
+            block->size = block_size;
+
+            /* A block of its own is full right away.  Keep filling the
+               current one */
+
+            if ( size > arena->block_size && arena->head != NULL )
+                {
+                    block->next = arena->head->next;
+                    arena->head->next = block;
+                }
+            else
+                {
+                    block->next = arena->head;
+                    arena->head = block;
+                }
+        }
+
+    ptr = block->data + block->used;
+    block->used += size;
+    arena->total += size;
+
+    return(ptr);
+}
+
+/****************************************************************************
+ * Sagan_Arena_Memdup/Strdup - Copies into the arena
+ ****************************************************************************/
+
+void *Sagan_Arena_Memdup( _Sagan_Arena *arena, const void *src, size_t size )
+{
+
+    void *ptr = NULL;
+
+    if ( size == 0 )
+        {
+            return(NULL);
+        }
+
+    ptr = Sagan_Arena_Alloc(arena, size);
+    memcpy(ptr, src, size);
+
+    return(ptr);
+}
+
+char *Sagan_Arena_Strdup( _Sagan_Arena *arena, const char *str )
+{
+    return( Sagan_Arena_Memdup(arena, str, strlen(str) + 1) );
+}
+
+/****************************************************************************
+ * Sagan_Arena_Free - Frees the arena and everything handed out from it
+ ****************************************************************************/
+
+void Sagan_Arena_Free( _Sagan_Arena *arena )
+{
+
+    _Sagan_Arena_Block *block = NULL;
+    _Sagan_Arena_Block *next = NULL;
+
+    if ( arena == NULL )
+        {
+            return;
+        }
+
+    for ( block = arena->head; block != NULL; block = next )
+        {
+            next = block->next;
+            free(block);
+        }
+
+    free(arena);
+
+}
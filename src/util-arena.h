@@ -0,0 +1,56 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stddef.h>
+
+/* A simple "bump" allocator for data that lives as long as something else
+ * (like the loaded rules).  Memory comes from large blocks and is only
+ * given back all at once.  Blocks never move,  so pointers into an arena
+ * stay good while more is added to it. */
+
+#define ARENA_BLOCK_SIZE	65536		/* Default block size */
+#define ARENA_ALIGN		16
+
+typedef struct _Sagan_Arena_Block _Sagan_Arena_Block;
+struct _Sagan_Arena_Block
+{
+    _Sagan_Arena_Block *next;
+    size_t size;
+    size_t used;
+    unsigned char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+typedef struct _Sagan_Arena _Sagan_Arena;
+struct _Sagan_Arena
+{
+    _Sagan_Arena_Block *head;
+    size_t block_size;
+    size_t total;			/* Bytes handed out */
+};
+
+_Sagan_Arena *Sagan_Arena_Init( size_t block_size );
+void *Sagan_Arena_Alloc( _Sagan_Arena *arena, size_t size );
+void *Sagan_Arena_Memdup( _Sagan_Arena *arena, const void *src, size_t size );
+char *Sagan_Arena_Strdup( _Sagan_Arena *arena, const char *str );
+void Sagan_Arena_Free( _Sagan_Arena *arena );
@@ -0,0 +1,174 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+/* util-memo.c
+ *
+ * Remembers the answers to enrichment lookups for the event being
+ * processed.  When several rules fire on one event and ask about the same
+ * address (or hash,  URL,  etc),  only the first one pays for the lookup.
+ * Everything is thread local,  so no locking is needed.  Even the hit/miss
+ * counters are per thread and only added up when perfmon reports them.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sagan.h"
+#include "util-memo.h"
+
+static _Sagan_Memo_Stats *memo_stats_threads = NULL;
+
+static __thread struct _Sagan_Memo_Entry memo[MEMO_MAX_ENTRIES];
+static __thread int memo_count;
+static __thread _Sagan_Memo_Stats *memo_stats = NULL;
+
+/****************************************************************************
+ * Memo_Stats_Add - Only the owning thread writes its counters,  so there is
+ * no need for a locked add.  The first call from a thread adds its
+ * counters to the list Sagan_Memo_Stats() walks.
+ ****************************************************************************/
+
+static inline void Memo_Stats_Add( bool hit )
+{
+
+    _Sagan_Memo_Stats *stats = memo_stats;
+
+    if ( stats == NULL )
+        {
+
+            if ( posix_memalign((void **)&stats, 64, sizeof(_Sagan_Memo_Stats)) != 0 )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Memo_Stats. Abort!", __FILE__, __LINE__);
+                }
+
+            memset(stats, 0, sizeof(_Sagan_Memo_Stats));
+
+            /* Threads are never taken off the list,  so it can be walked
+               without a lock */
+
+            stats->next = __atomic_load_n(&memo_stats_threads, __ATOMIC_RELAXED);
+
+            while ( __atomic_compare_exchange_n(&memo_stats_threads, &stats->next, stats, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED) == false );
+
+            memo_stats = stats;
+        }
+
+    if ( hit == true )
+        {
+            __atomic_store_n(&stats->hits, stats->hits + 1, __ATOMIC_RELAXED);
+        }
+    else
+        {
+            __atomic_store_n(&stats->misses, stats->misses + 1, __ATOMIC_RELAXED);
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Memo_Stats - Adds up every thread's hits and misses
+ ****************************************************************************/
+
+void Sagan_Memo_Stats( uint64_t *hits, uint64_t *misses )
+{
+
+    _Sagan_Memo_Stats *stats = NULL;
+
+    *hits = 0;
+    *misses = 0;
+
+    for ( stats = __atomic_load_n(&memo_stats_threads, __ATOMIC_ACQUIRE); stats != NULL; stats = stats->next )
+        {
+            *hits += __atomic_load_n(&stats->hits, __ATOMIC_RELAXED);
+            *misses += __atomic_load_n(&stats->misses, __ATOMIC_RELAXED);
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Memo_Reset - Forget everything.  Called at the start of an event.
+ ****************************************************************************/
+
+void Sagan_Memo_Reset( void )
+{
+    memo_count = 0;
+}
+
+/****************************************************************************
+ * Sagan_Memo_Get - Returns true (and the answer in "result") if this
+ * lookup was already done for the event.
+ ****************************************************************************/
+
+bool Sagan_Memo_Get( unsigned char type, uint64_t variant, const void *key, size_t key_len, int *result )
+{
+
+    int i = 0;
+
+    if ( key_len > MEMO_MAX_KEY )
+        {
+            return(false);
+        }
+
+    for ( i = 0; i < memo_count; i++ )
+        {
+
+            if ( memo[i].type == type && memo[i].variant == variant &&
+                    memo[i].key_len == key_len && !memcmp(memo[i].key, key, key_len) )
+                {
+
+                    Memo_Stats_Add(true);
+
+                    *result = memo[i].result;
+                    return(true);
+                }
+        }
+
+    Memo_Stats_Add(false);
+
+    return(false);
+}
+
+/****************************************************************************
+ * Sagan_Memo_Set - Remembers a lookup's answer.  If the memo is full (or
+ * the key is too long) the answer just isn't kept.
+ ****************************************************************************/
+
+void Sagan_Memo_Set( unsigned char type, uint64_t variant, const void *key, size_t key_len, int result )
+{
+
+    if ( memo_count == MEMO_MAX_ENTRIES || key_len > MEMO_MAX_KEY )
+        {
+            return;
+        }
+
+    memo[memo_count].type = type;
+    memo[memo_count].variant = variant;
+    memo[memo_count].key_len = key_len;
+    memcpy(memo[memo_count].key, key, key_len);
+    memo[memo_count].result = result;
+
+    memo_count++;
+}
@@ -0,0 +1,69 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Per-thread,  per-event memo of enrichment lookups (GeoIP2,  blacklist,
+ * Bro Intel and Bluedot).  The key is the lookup type,  a "variant" for
+ * anything else the answer depends on,  and the IP bits or string looked
+ * up.  It is emptied at the start of every event. */
+
+#define MEMO_MAX_ENTRIES	32		/* Per event */
+#define MEMO_MAX_KEY		256		/* Longer keys aren't memorized */
+
+#define MEMO_GEOIP2		1
+#define MEMO_BLACKLIST		2
+#define MEMO_BLACKLIST_ALL	3
+#define MEMO_BROINTEL		4
+#define MEMO_BROINTEL_ALL	5
+#define MEMO_BROINTEL_MESSAGE	6		/* Domain,  file hash,  URL,  etc.  Variant is which */
+#define MEMO_BLUEDOT		8		/* Plus the Bluedot lookup type (BLUEDOT_LOOKUP_*) */
+
+typedef struct _Sagan_Memo_Entry _Sagan_Memo_Entry;
+struct _Sagan_Memo_Entry
+{
+    unsigned char type;
+    uint64_t variant;
+    size_t key_len;
+    unsigned char key[MEMO_MAX_KEY];
+    int result;
+};
+
+/* Hit/miss counters.  One per thread,  on their own cache line */
+
+typedef struct _Sagan_Memo_Stats _Sagan_Memo_Stats;
+struct _Sagan_Memo_Stats
+{
+    uint64_t hits;
+    uint64_t misses;
+    _Sagan_Memo_Stats *next;
+    char pad[40];
+};
+
+void Sagan_Memo_Reset( void );
+bool Sagan_Memo_Get( unsigned char type, uint64_t variant, const void *key, size_t key_len, int *result );
+void Sagan_Memo_Set( unsigned char type, uint64_t variant, const void *key, size_t key_len, int result );
+void Sagan_Memo_Stats( uint64_t *hits, uint64_t *misses );
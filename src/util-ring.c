@@ -0,0 +1,298 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* util-ring.c
+ *
+ * Lock-free bounded multi-producer/multi-consumer ring used to hand log
+ * lines from the input readers to the worker threads.  Based on Dmitry
+ * Vyukov's bounded MPMC queue.  Unlike the old "slot" stack, this keeps
+ * the lines in the order they were received and the queue depth is no
+ * longer tied to the number of worker threads.
+ *
+ * Producers and consumers never take a lock to move data.  The mutex and
+ * condition are only used to put idle workers to sleep when the ring is
+ * empty.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "sagan.h"
+#include "sagan-defs.h"
+#include "util-ring.h"
+
+#define RING_SPIN_COUNT		64		/* Spins before an idle worker sleeps */
+
+/****************************************************************************
+ * Sagan_Ring_Slot_At - Returns the slot for an absolute ring position.
+ ****************************************************************************/
+
+static inline _Sagan_Ring_Slot *Sagan_Ring_Slot_At( _Sagan_Ring *ring, uint64_t pos )
+{
+    return (_Sagan_Ring_Slot *)(ring->slots + ( pos & ring->mask ) * ring->slot_size);
+}
+
+/****************************************************************************
+ * Sagan_Ring_Init - Allocates a ring of at least "depth" slots. Each slot
+ * can hold "elem_size" bytes of data.  The depth is rounded up to the next
+ * power of two so positions can be masked rather than divided.
+ ****************************************************************************/
+
+_Sagan_Ring *Sagan_Ring_Init( uint64_t depth, size_t elem_size )
+{
+
+    _Sagan_Ring *ring = NULL;
+    _Sagan_Ring_Slot *slot = NULL;
+
+    uint64_t real_depth = 1;
+    uint64_t i = 0;
+
+    while ( real_depth < depth )
+        {
+            real_depth <<= 1;
+        }
+
+    if ( posix_memalign((void **)&ring, CACHE_LINE_SIZE, sizeof(_Sagan_Ring)) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for _Sagan_Ring. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(ring, 0, sizeof(_Sagan_Ring));
+
+    /* Round each slot up to a cache line so neighboring slots being
+       written/read by different threads don't share a line */
+
+    ring->slot_size = ( sizeof(_Sagan_Ring_Slot) + elem_size + CACHE_LINE_SIZE - 1 ) & ~( (size_t)CACHE_LINE_SIZE - 1 );
+    ring->depth = real_depth;
+    ring->mask = real_depth - 1;
+
+    if ( posix_memalign((void **)&ring->slots, CACHE_LINE_SIZE, ring->slot_size * real_depth) != 0 )
+        {
+            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for %" PRIu64 " ring slots. Abort!", __FILE__, __LINE__, real_depth);
+        }
+
+    memset(ring->slots, 0, ring->slot_size * real_depth);
+
+    for ( i = 0; i < real_depth; i++ )
+        {
+            slot = Sagan_Ring_Slot_At(ring, i);
+            slot->sequence = i;
+        }
+
+    pthread_mutex_init(&ring->wait_mutex, NULL);
+    pthread_cond_init(&ring->wait_cond, NULL);
+
+    return(ring);
+}
+
+/****************************************************************************
+ * Sagan_Ring_Enqueue_Claim - Reserves the next slot for a producer.  Returns
+ * NULL if the ring is full.  The caller fills slot->data and then calls
+ * Sagan_Ring_Enqueue_Commit() to make it visible to the workers.
+ ****************************************************************************/
+
+_Sagan_Ring_Slot *Sagan_Ring_Enqueue_Claim( _Sagan_Ring *ring )
+{
+
+    _Sagan_Ring_Slot *slot = NULL;
+
+    uint64_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    uint64_t seq = 0;
+    int64_t dif = 0;
+
+    for (;;)
+        {
+
+            slot = Sagan_Ring_Slot_At(ring, pos);
+            seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+            dif = (int64_t)seq - (int64_t)pos;
+
+            if ( dif == 0 )
+                {
+
+                    if ( __atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+                        {
+                            slot->position = pos;
+                            return(slot);
+                        }
+
+                }
+
+            else if ( dif < 0 )
+                {
+                    return(NULL);		/* Full */
+                }
+
+            else
+                {
+                    pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+                }
+
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Ring_Enqueue_Commit - Publishes a claimed slot and wakes a worker if
+ * one is sleeping.
+ ****************************************************************************/
+
+void Sagan_Ring_Enqueue_Commit( _Sagan_Ring *ring, _Sagan_Ring_Slot *slot )
+{
+
+    __atomic_store_n(&slot->sequence, slot->position + 1, __ATOMIC_SEQ_CST);
+
+    if ( __atomic_load_n(&ring->waiters, __ATOMIC_SEQ_CST) != 0 )
+        {
+            pthread_mutex_lock(&ring->wait_mutex);
+            pthread_cond_signal(&ring->wait_cond);
+            pthread_mutex_unlock(&ring->wait_mutex);
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Ring_Dequeue_Claim - Takes the oldest published slot.  Returns NULL
+ * if nothing is ready.  The slot is handed back to the producers with
+ * Sagan_Ring_Dequeue_Commit().
+ ****************************************************************************/
+
+_Sagan_Ring_Slot *Sagan_Ring_Dequeue_Claim( _Sagan_Ring *ring )
+{
+
+    _Sagan_Ring_Slot *slot = NULL;
+
+    uint64_t pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    uint64_t seq = 0;
+    int64_t dif = 0;
+
+    for (;;)
+        {
+
+            slot = Sagan_Ring_Slot_At(ring, pos);
+            seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+            dif = (int64_t)seq - (int64_t)(pos + 1);
+
+            if ( dif == 0 )
+                {
+
+                    if ( __atomic_compare_exchange_n(&ring->dequeue_pos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+                        {
+                            slot->position = pos;
+                            return(slot);
+                        }
+
+                }
+
+            else if ( dif < 0 )
+                {
+                    return(NULL);		/* Empty */
+                }
+
+            else
+                {
+                    pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+                }
+
+        }
+
+}
+
+/****************************************************************************
+ * Sagan_Ring_Dequeue_Commit - Releases a slot so producers can reuse it.
+ ****************************************************************************/
+
+void Sagan_Ring_Dequeue_Commit( _Sagan_Ring *ring, _Sagan_Ring_Slot *slot )
+{
+    __atomic_store_n(&slot->sequence, slot->position + ring->mask + 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************
+ * Sagan_Ring_Ready - Is the slot at the head of the ring published?
+ ****************************************************************************/
+
+static inline bool Sagan_Ring_Ready( _Sagan_Ring *ring )
+{
+
+    uint64_t pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_SEQ_CST);
+    _Sagan_Ring_Slot *slot = Sagan_Ring_Slot_At(ring, pos);
+
+    return( (int64_t)(__atomic_load_n(&slot->sequence, __ATOMIC_SEQ_CST) - (pos + 1)) >= 0 );
+}
+
+/****************************************************************************
+ * Sagan_Ring_Wait - Blocks a worker until there is something to dequeue.  We
+ * spin for a short while first since under load the ring is rarely empty
+ * for long.
+ ****************************************************************************/
+
+void Sagan_Ring_Wait( _Sagan_Ring *ring )
+{
+
+    int i = 0;
+
+    for ( i = 0; i < RING_SPIN_COUNT; i++ )
+        {
+
+            if ( Sagan_Ring_Ready(ring) )
+                {
+                    return;
+                }
+
+            sched_yield();
+        }
+
+    pthread_mutex_lock(&ring->wait_mutex);
+    __atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+
+    while ( !Sagan_Ring_Ready(ring) )
+        {
+            pthread_cond_wait(&ring->wait_cond, &ring->wait_mutex);
+        }
+
+    __atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ring->wait_mutex);
+
+}
+
+/****************************************************************************
+ * Sagan_Ring_Count - Approximate number of lines waiting in the ring.
+ ****************************************************************************/
+
+uint64_t Sagan_Ring_Count( _Sagan_Ring *ring )
+{
+
+    uint64_t enqueue_pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_ACQUIRE);
+    uint64_t dequeue_pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_ACQUIRE);
+
+    return( enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0 );
+}
+
@@ -0,0 +1,73 @@
+/*
+** Copyright (C) 2009-2018 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2009-2018 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "sagan-defs.h"
+
+/* A bounded multi-producer/multi-consumer ring.  Each slot carries a
+ * sequence number that tells producers and consumers whether the slot
+ * is free, published or being worked on.  The enqueue and dequeue
+ * positions live on their own cache lines so readers and workers don't
+ * bounce the same line between CPUs. */
+
+typedef struct _Sagan_Ring_Slot _Sagan_Ring_Slot;
+struct _Sagan_Ring_Slot
+{
+    uint64_t sequence;
+    uint64_t position;
+    unsigned char data[];
+};
+
+typedef struct _Sagan_Ring _Sagan_Ring;
+struct _Sagan_Ring
+{
+
+    uint64_t enqueue_pos;
+    unsigned char pad0[CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+    uint64_t dequeue_pos;
+    unsigned char pad1[CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+    uint32_t waiters;
+    pthread_mutex_t wait_mutex;
+    pthread_cond_t wait_cond;
+    unsigned char pad2[CACHE_LINE_SIZE];
+
+    uint64_t mask;
+    uint64_t depth;
+    size_t slot_size;
+    unsigned char *slots;
+
+};
+
+_Sagan_Ring *Sagan_Ring_Init( uint64_t depth, size_t elem_size );
+_Sagan_Ring_Slot *Sagan_Ring_Enqueue_Claim( _Sagan_Ring *ring );
+void Sagan_Ring_Enqueue_Commit( _Sagan_Ring *ring, _Sagan_Ring_Slot *slot );
+_Sagan_Ring_Slot *Sagan_Ring_Dequeue_Claim( _Sagan_Ring *ring );
+void Sagan_Ring_Dequeue_Commit( _Sagan_Ring *ring, _Sagan_Ring_Slot *slot );
+void Sagan_Ring_Wait( _Sagan_Ring *ring );
+uint64_t Sagan_Ring_Count( _Sagan_Ring *ring );
+
@@ -54,6 +54,7 @@
 #include "sagan-defs.h"
 #include "sagan-config.h"
 #include "lockfile.h"
+#include "input.h"
 
 #include "parsers/strstr-asm/strstr-hook.h"
 
@@ -96,6 +97,7 @@ void Droppriv(void)
     struct stat fifocheck;
     struct passwd *pw = NULL;
     int ret;
+    int i;
 
     pw = getpwnam(config->sagan_runas);
 
@@ -117,19 +119,24 @@ void Droppriv(void)
                  * Champ Clark (04/14/2015)
                  */
 
-            if ( config->sagan_is_file == false )  	/* Don't change ownsership/etc if we're processing a file */
+            for ( i = 0; i < config->input_count; i++ )
                 {
 
-                    ret = chown(config->sagan_fifo, (unsigned long)pw->pw_uid,(unsigned long)pw->pw_gid);
+                    if ( config->inputs[i].is_file == true )  	/* Don't change ownsership/etc if we're processing a file */
+                        {
+                            continue;
+                        }
+
+                    ret = chown(config->inputs[i].path, (unsigned long)pw->pw_uid,(unsigned long)pw->pw_gid);
 
                     if ( ret < 0 )
                         {
-                            Sagan_Log(ERROR, "[%s, line %d] Cannot change ownership of %s to username \"%s\" - %s", __FILE__, __LINE__, config->sagan_fifo, config->sagan_runas, strerror(errno));
+                            Sagan_Log(ERROR, "[%s, line %d] Cannot change ownership of %s to username \"%s\" - %s", __FILE__, __LINE__, config->inputs[i].path, config->sagan_runas, strerror(errno));
                         }
 
-                    if (stat(config->sagan_fifo, &fifocheck) != 0 )
+                    if (stat(config->inputs[i].path, &fifocheck) != 0 )
                         {
-                            Sagan_Log(ERROR, "[%s, line %d] Cannot open %s FIFO - %s!",  __FILE__, __LINE__, config->sagan_fifo, strerror(errno));
+                            Sagan_Log(ERROR, "[%s, line %d] Cannot open %s FIFO - %s!",  __FILE__, __LINE__, config->inputs[i].path, strerror(errno));
                         }
 
                 }
@@ -197,6 +204,55 @@ void To_LowerC(char *const s)
         }
 }
 
+/****************************************************************************
+ * Sagan_Message_Lower - Returns a lower case copy of the event's message.
+ * It's made the first time something asks for it and kept for the rest
+ * of the event,  so "nocase" searches don't each copy & convert the
+ * message.  The copy lives in a per thread buffer,  so it's only good
+ * while this thread works on this event.
+ ****************************************************************************/
+
+char *Sagan_Message_Lower( _Sagan_Proc_Syslog *SaganProcSyslog_LOCAL )
+{
+
+    static __thread char *message_lower = NULL;
+    static __thread size_t message_lower_size = 0;
+
+    const unsigned char *src = NULL;
+    size_t len = SaganProcSyslog_LOCAL->syslog_message_len;
+    size_t i = 0;
+
+    if ( SaganProcSyslog_LOCAL->syslog_message_lower != NULL )
+        {
+            return(SaganProcSyslog_LOCAL->syslog_message_lower);
+        }
+
+    if ( message_lower_size < len + 1 )
+        {
+
+            message_lower_size = len + 1 > MAX_SYSLOGMSG ? len + 1 : MAX_SYSLOGMSG;
+            message_lower = realloc(message_lower, message_lower_size);
+
+            if ( message_lower == NULL )
+                {
+                    Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for message_lower. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    src = (const unsigned char *)SaganProcSyslog_LOCAL->syslog_message;
+
+    for ( i = 0; i < len; i++ )
+        {
+            message_lower[i] = tolower(src[i]);
+        }
+
+    message_lower[i] = '\0';
+
+    SaganProcSyslog_LOCAL->syslog_message_lower = message_lower;
+
+    return(message_lower);
+}
+
 /******************************************************
  * Generic "sagan.log" style logging and screen output.
  *******************************************************/
@@ -1454,6 +1510,21 @@ int64_t FlowGetId( struct timeval tp )
            (int64_t)(tp.tv_usec & 0x0000FFFF);
 }
 
+/***************************************************************************
+ * Monotonic_NS - Nanoseconds from CLOCK_MONOTONIC.  Only good for
+ * measuring how long something took (it isn't the time of day)
+ ***************************************************************************/
+
+uint64_t Monotonic_NS( void )
+{
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return( (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec );
+}
+
 /***************************************************************************
  * Check_Content_Not - Simply returns true/false if a "not" (!) is present
  * in a string.  For example, content!"something";
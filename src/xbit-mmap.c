@@ -52,6 +52,7 @@ pthread_mutex_t Xbit_Mutex=PTHREAD_MUTEX_INITIALIZER;
 
 struct _Sagan_IPC_Counters *counters_ipc;
 struct _Sagan_IPC_Xbit *xbit_ipc;
+struct _Sagan_IPC_Index *xbit_index;
 
 /*****************************************************************************
  * Xbit_Condition - Used for testing "isset" & "isnotset".  Full
@@ -780,16 +781,9 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
     now=localtime(&t);
     strftime(timet, sizeof(timet), "%s",  now);
 
-    struct _Sagan_Xbit_Track *xbit_track;
+    /* At most one new xbit per xbit in the rule */
 
-    xbit_track = malloc(sizeof(_Sagan_Xbit_Track));
-
-    if ( xbit_track  == NULL )
-        {
-            Sagan_Log(ERROR, "[%s, line %d] Failed to allocate memory for xbit_track. Abort!", __FILE__, __LINE__);
-        }
-
-    memset(xbit_track, 0, sizeof(_Sagan_Xbit_Track));
+    struct _Sagan_Xbit_Track xbit_track[MAX_XBITS];
 
     int xbit_track_count = 0;
 
@@ -805,6 +799,12 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
             if ( rulestruct[rule_position].xbit_type[i] == 2 )
                 {
 
+                    /* The reaper moves records around underneath us,  so hold the
+                       lock across the whole scan and update */
+
+                    File_Lock(config->shm_xbit);
+                    pthread_mutex_lock(&Xbit_Mutex);
+
                     for (a = 0; a < counters_ipc->xbit_count; a++)
                         {
                             /* Short circuit if no selector match */
@@ -833,14 +833,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                 }
 
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = false;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -858,14 +852,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"both\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src, ip_dst);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = false;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -882,14 +870,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"by_src\"). (%s -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = false;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -906,14 +888,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = false;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -931,14 +907,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"reverse\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst, ip_src);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = false;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -954,14 +924,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"src_xbitdst\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -977,14 +941,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"dst_xbitsrc\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -1003,14 +961,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"both_p\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src, ip_dst);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -1028,14 +980,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"by_src_p\"). (%s -> any)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -1053,14 +999,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"by_dst\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -1080,14 +1020,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"reverse_p\"). (%s -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst, ip_src);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -1104,14 +1038,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"src_xbitdst_p\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_src);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -1128,14 +1056,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                                     Sagan_Log(DEBUG, "[%s, line %d] \"unset\" xbit \"%s\" (direction: \"dst_xbitsrc_p\"). (any -> %s)", __FILE__, __LINE__, xbit_ipc[a].xbit_name, ip_dst);
                                                 }
 
-                                            File_Lock(config->shm_xbit);
-                                            pthread_mutex_lock(&Xbit_Mutex);
-
                                             xbit_ipc[a].xbit_state = 0;
 
-                                            pthread_mutex_unlock(&Xbit_Mutex);
-                                            File_Unlock(config->shm_xbit);
-
                                             xbit_unset_match = 1;
 
                                         }
@@ -1143,6 +1065,9 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                 }
                         }
 
+                    pthread_mutex_unlock(&Xbit_Mutex);
+                    File_Unlock(config->shm_xbit);
+
                     if ( debug->debugxbit && xbit_unset_match == 0 )
                         {
                             Sagan_Log(DEBUG, "[%s, line %d] No xbit found to \"unset\" for %s.", __FILE__, __LINE__, rulestruct[rule_position].xbit_name[i]);
@@ -1157,6 +1082,9 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
             else if ( rulestruct[rule_position].xbit_type[i] == 1 )
                 {
 
+                    File_Lock(config->shm_xbit);
+                    pthread_mutex_lock(&Xbit_Mutex);
+
                     for (a = 0; a < counters_ipc->xbit_count; a++)
                         {
                             /* Short circuit if no selector match */
@@ -1180,14 +1108,10 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                 {
 
 
-                                    File_Lock(config->shm_xbit);
-                                    pthread_mutex_lock(&Xbit_Mutex);
-
                                     xbit_ipc[a].xbit_date = atol(timet);
                                     xbit_ipc[a].xbit_expire = atol(timet) + rulestruct[rule_position].xbit_timeout[i];
                                     xbit_ipc[a].xbit_state = true;
-                                    strlcpy(xbit_ipc[a].syslog_message, syslog_message, sizeof(xbit_ipc[a].syslog_message));
-                                    strlcpy(xbit_ipc[a].signature_msg, rulestruct[rule_position].s_msg, sizeof(xbit_ipc[a].signature_msg));
+                                    xbit_ipc[a].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
                                     strlcpy(xbit_ipc[a].sid, rulestruct[rule_position].s_sid, sizeof(xbit_ipc[a].sid));
 
 
@@ -1198,33 +1122,21 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
 
                                         }
 
-                                    pthread_mutex_unlock(&Xbit_Mutex);
-                                    File_Unlock(config->shm_xbit);
-
                                     xbit_match = true;
                                 }
 
                         }
 
+                    pthread_mutex_unlock(&Xbit_Mutex);
+                    File_Unlock(config->shm_xbit);
+
 
                     /* If the xbit isn't in memory,  store it to be created later */
 
                     if ( xbit_match == false )
                         {
 
-                            xbit_track = ( _Sagan_Xbit_Track * ) realloc(xbit_track, (xbit_track_count+1) * sizeof(_Sagan_Xbit_Track));
-
-                            if ( xbit_track == NULL )
-                                {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for xbit_track. Abort!", __FILE__, __LINE__);
-                                }
-
-                            memset(&xbit_track[xbit_track_count], 0, sizeof(_Sagan_Xbit_Track));
-
                             strlcpy(xbit_track[xbit_track_count].xbit_name, rulestruct[rule_position].xbit_name[i], sizeof(xbit_track[xbit_track_count].xbit_name));
-                            strlcpy(xbit_ipc[xbit_track_count].syslog_message, syslog_message, sizeof(xbit_ipc[xbit_track_count].syslog_message));
-                            strlcpy(xbit_ipc[xbit_track_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(xbit_ipc[xbit_track_count].signature_msg));
-                            strlcpy(xbit_ipc[xbit_track_count].sid, rulestruct[rule_position].s_sid, sizeof(xbit_ipc[xbit_track_count].sid));
 
                             xbit_track[xbit_track_count].xbit_timeout = rulestruct[rule_position].xbit_timeout[i];
                             xbit_track[xbit_track_count].xbit_srcport = config->sagan_port;
@@ -1244,6 +1156,9 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
 
                     xbit_match = false;
 
+                    File_Lock(config->shm_xbit);
+                    pthread_mutex_lock(&Xbit_Mutex);
+
                     for (a = 0; a < counters_ipc->xbit_count; a++)
                         {
                             /* Short circuit if no selector match */
@@ -1266,13 +1181,10 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                     xbit_ipc[a].dst_port == config->sagan_port )
                                 {
 
-                                    File_Lock(config->shm_xbit);
-                                    pthread_mutex_lock(&Xbit_Mutex);
-
                                     xbit_ipc[a].xbit_date = atol(timet);
                                     xbit_ipc[a].xbit_expire = atol(timet) + rulestruct[rule_position].xbit_timeout[i];
                                     xbit_ipc[a].xbit_state = true;
-                                    strlcpy(xbit_ipc[a].syslog_message, syslog_message, sizeof(xbit_ipc[a].syslog_message));
+                                    xbit_ipc[a].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
                                     if ( debug->debugxbit)
                                         {
@@ -1281,31 +1193,21 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
 
                                         }
 
-                                    pthread_mutex_unlock(&Xbit_Mutex);
-                                    File_Unlock(config->shm_xbit);
-
                                     xbit_match = true;
                                 }
 
                         }
 
+                    pthread_mutex_unlock(&Xbit_Mutex);
+                    File_Unlock(config->shm_xbit);
+
 
                     /* If the xbit isn't in memory,  store it to be created later */
 
                     if ( xbit_match == false )
                         {
 
-                            xbit_track = ( _Sagan_Xbit_Track * ) realloc(xbit_track, (xbit_track_count+1) * sizeof(_Sagan_Xbit_Track));
-
-                            if ( xbit_track == NULL )
-                                {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for xbit_track. Abort!", __FILE__, __LINE__);
-                                }
-
-                            memset(&xbit_track[xbit_track_count], 0, sizeof(_Sagan_Xbit_Track));
-
                             strlcpy(xbit_track[xbit_track_count].xbit_name, rulestruct[rule_position].xbit_name[i], sizeof(xbit_track[xbit_track_count].xbit_name));
-                            strlcpy(xbit_ipc[xbit_track_count].syslog_message, syslog_message, sizeof(xbit_ipc[xbit_track_count].syslog_message));
                             xbit_track[xbit_track_count].xbit_timeout = rulestruct[rule_position].xbit_timeout[i];
                             xbit_track[xbit_track_count].xbit_srcport = src_port;
                             xbit_track[xbit_track_count].xbit_dstport = config->sagan_port;
@@ -1324,6 +1226,9 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
 
                     xbit_match = false;
 
+                    File_Lock(config->shm_xbit);
+                    pthread_mutex_lock(&Xbit_Mutex);
+
                     for (a = 0; a < counters_ipc->xbit_count; a++)
                         {
                             /* Short circuit if no selector match */
@@ -1346,13 +1251,10 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                     xbit_ipc[a].dst_port == dst_port )
                                 {
 
-                                    File_Lock(config->shm_xbit);
-                                    pthread_mutex_lock(&Xbit_Mutex);
-
                                     xbit_ipc[a].xbit_date = atol(timet);
                                     xbit_ipc[a].xbit_expire = atol(timet) + rulestruct[rule_position].xbit_timeout[i];
                                     xbit_ipc[a].xbit_state = true;
-                                    strlcpy(xbit_ipc[a].syslog_message, syslog_message, sizeof(xbit_ipc[a].syslog_message));
+                                    xbit_ipc[a].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
                                     if ( debug->debugxbit)
                                         {
@@ -1361,31 +1263,21 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
 
                                         }
 
-                                    pthread_mutex_unlock(&Xbit_Mutex);
-                                    File_Unlock(config->shm_xbit);
-
                                     xbit_match = true;
                                 }
 
                         }
 
+                    pthread_mutex_unlock(&Xbit_Mutex);
+                    File_Unlock(config->shm_xbit);
+
 
                     /* If the xbit isn't in memory,  store it to be created later */
 
                     if ( xbit_match == false )
                         {
 
-                            xbit_track = ( _Sagan_Xbit_Track * ) realloc(xbit_track, (xbit_track_count+1) * sizeof(_Sagan_Xbit_Track));
-
-                            if ( xbit_track == NULL )
-                                {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for xbit_track. Abort!", __FILE__, __LINE__);
-                                }
-
-                            memset(&xbit_track[xbit_track_count], 0, sizeof(_Sagan_Xbit_Track));
-
                             strlcpy(xbit_track[xbit_track_count].xbit_name, rulestruct[rule_position].xbit_name[i], sizeof(xbit_track[xbit_track_count].xbit_name));
-                            strlcpy(xbit_ipc[xbit_track_count].syslog_message, syslog_message, sizeof(xbit_ipc[xbit_track_count].syslog_message));
                             xbit_track[xbit_track_count].xbit_timeout = rulestruct[rule_position].xbit_timeout[i];
                             xbit_track[xbit_track_count].xbit_srcport = config->sagan_port;
                             xbit_track[xbit_track_count].xbit_dstport = dst_port;
@@ -1404,6 +1296,9 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
 
                     xbit_match = false;
 
+                    File_Lock(config->shm_xbit);
+                    pthread_mutex_lock(&Xbit_Mutex);
+
                     for (a = 0; a < counters_ipc->xbit_count; a++)
                         {
                             /* Short circuit if no selector match */
@@ -1426,13 +1321,10 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                     xbit_ipc[a].dst_port == dst_port )
                                 {
 
-                                    File_Lock(config->shm_xbit);
-                                    pthread_mutex_lock(&Xbit_Mutex);
-
                                     xbit_ipc[a].xbit_date = atol(timet);
                                     xbit_ipc[a].xbit_expire = atol(timet) + rulestruct[rule_position].xbit_timeout[i];
                                     xbit_ipc[a].xbit_state = true;
-                                    strlcpy(xbit_ipc[a].syslog_message, syslog_message, sizeof(xbit_ipc[a].syslog_message));
+                                    xbit_ipc[a].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
                                     if ( debug->debugxbit)
                                         {
@@ -1441,33 +1333,21 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
 
                                         }
 
-                                    pthread_mutex_unlock(&Xbit_Mutex);
-                                    File_Unlock(config->shm_xbit);
-
                                     xbit_match = true;
                                 }
 
                         }
 
+                    pthread_mutex_unlock(&Xbit_Mutex);
+                    File_Unlock(config->shm_xbit);
+
 
                     /* If the xbit isn't in memory,  store it to be created later */
 
                     if ( xbit_match == false )
                         {
 
-                            xbit_track = ( _Sagan_Xbit_Track * ) realloc(xbit_track, (xbit_track_count+1) * sizeof(_Sagan_Xbit_Track));
-
-                            if ( xbit_track == NULL )
-                                {
-                                    Sagan_Log(ERROR, "[%s, line %d] Failed to reallocate memory for xbit_track. Abort!", __FILE__, __LINE__);
-                                }
-
-                            memset(&xbit_track[xbit_track_count], 0, sizeof(_Sagan_Xbit_Track));
-
                             strlcpy(xbit_track[xbit_track_count].xbit_name, rulestruct[rule_position].xbit_name[i], sizeof(xbit_track[xbit_track_count].xbit_name));
-                            strlcpy(xbit_ipc[xbit_track_count].syslog_message, syslog_message, sizeof(xbit_ipc[xbit_track_count].syslog_message));
-                            strlcpy(xbit_ipc[xbit_track_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(xbit_ipc[xbit_track_count].signature_msg));
-                            strlcpy(xbit_ipc[xbit_track_count].sid, rulestruct[rule_position].s_sid, sizeof(xbit_ipc[xbit_track_count].sid));
 
                             xbit_track[xbit_track_count].xbit_timeout = rulestruct[rule_position].xbit_timeout[i];
                             xbit_track[xbit_track_count].xbit_srcport = src_port;
@@ -1488,11 +1368,17 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
             for (i = 0; i < xbit_track_count; i++)
                 {
 
-                    if ( Clean_IPC_Object(XBIT) == 0 )
-                        {
+                    /* Make room if the table is full.  Another thread or Sagan
+                       might fill it up again before we have the lock,  so the
+                       count is checked again under it */
+
+                    Clean_IPC_Object(XBIT);
 
-                            File_Lock(config->shm_xbit);
-                            pthread_mutex_lock(&Xbit_Mutex);
+                    File_Lock(config->shm_xbit);
+                    pthread_mutex_lock(&Xbit_Mutex);
+
+                    if ( counters_ipc->xbit_count < IPC_Max(XBIT) )
+                        {
 
                             memcpy(xbit_ipc[counters_ipc->xbit_count].ip_src, ip_src, sizeof(xbit_ipc[counters_ipc->xbit_count].ip_src));
                             memcpy(xbit_ipc[counters_ipc->xbit_count].ip_dst, ip_dst, sizeof(xbit_ipc[counters_ipc->xbit_count].ip_dst));
@@ -1507,9 +1393,8 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                             xbit_ipc[counters_ipc->xbit_count].expire = xbit_track[i].xbit_timeout;
 
                             strlcpy(xbit_ipc[counters_ipc->xbit_count].xbit_name, xbit_track[i].xbit_name, sizeof(xbit_ipc[counters_ipc->xbit_count].xbit_name));
-                            strlcpy(xbit_ipc[counters_ipc->xbit_count].signature_msg, rulestruct[rule_position].s_msg, sizeof(xbit_ipc[counters_ipc->xbit_count].signature_msg));
                             strlcpy(xbit_ipc[counters_ipc->xbit_count].sid, rulestruct[rule_position].s_sid, sizeof(xbit_ipc[counters_ipc->xbit_count].sid));
-                            strlcpy(xbit_ipc[counters_ipc->xbit_count].syslog_message, syslog_message, sizeof(xbit_ipc[counters_ipc->xbit_count].syslog_message));
+                            xbit_ipc[counters_ipc->xbit_count].sample = IPC_Sample(rulestruct[rule_position].s_msg, syslog_message);
 
 
                             if ( debug->debugxbit)
@@ -1517,21 +1402,21 @@ void Xbit_Set_MMAP(int rule_position, char *ip_src, char *ip_dst, int src_port,
                                     Sagan_Log(DEBUG, "[%s, line %d] [%d] Created xbit \"%s\" via \"set, set_srcport, set_dstport, or set_ports\" [%s:%d -> %s:%d]", __FILE__, __LINE__, counters_ipc->xbit_count, xbit_ipc[counters_ipc->xbit_count].xbit_name, ip_src, xbit_track[i].xbit_srcport, ip_dst, xbit_track[i].xbit_dstport);
                                 }
 
+                            IPC_Wheel_Link(xbit_index, counters_ipc->xbit_count, xbit_ipc[counters_ipc->xbit_count].xbit_expire + xbit_ipc[counters_ipc->xbit_count].expire);
+
                             File_Lock(config->shm_counters);
 
                             counters_ipc->xbit_count++;
 
                             File_Unlock(config->shm_counters);
-                            File_Unlock(config->shm_xbit);
-
-                            pthread_mutex_unlock(&Xbit_Mutex);
 
                         }
+
+                    pthread_mutex_unlock(&Xbit_Mutex);
+                    File_Unlock(config->shm_xbit);
                 }
         }
 
-    free(xbit_track);
-
 } /* End of Xbit_Set */
 
 /*****************************************************************************
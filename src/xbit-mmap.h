@@ -52,9 +52,8 @@ struct _Sagan_IPC_Xbit
     uint64_t xbit_expire;
     int expire;
     char selector[MAXSELECTOR]; // No need to clean this, as we always set it when tracking
-    char syslog_message[MAX_SYSLOGMSG];
+    uint64_t sample;                    /* See IPC_Sample() */
     char sid[20];
-    char signature_msg[MAX_SAGAN_MSG];
 
 };
 
@@ -41,6 +41,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <arpa/inet.h>
 #include <string.h>
@@ -122,6 +123,60 @@ char *u32_time_to_human( uint64_t utime )
 
 }
 
+/****************************************************************************
+ * Sample_Get - The "last message" sample of a record,  if it's still
+ * there.  See _Sagan_IPC_Sample.
+ ****************************************************************************/
+
+struct _Sagan_IPC_Samples *samples_ipc = NULL;
+
+struct _Sagan_IPC_Sample no_sample = { 0, "", "(no sample)" };
+
+struct _Sagan_IPC_Sample *Sample_Get( uint64_t sequence )
+{
+
+    struct _Sagan_IPC_Sample *sample = NULL;
+
+    if ( samples_ipc == NULL || sequence == 0 || samples_ipc->max == 0 )
+        {
+            return(&no_sample);
+        }
+
+    sample = &samples_ipc->samples[sequence % samples_ipc->max];
+
+    if ( sample->sequence != sequence )
+        {
+            return(&no_sample);
+        }
+
+    return(sample);
+}
+
+/****************************************************************************
+ * Table_Map - Maps the first "count" records of a threshold,  after or
+ * xbit table.  The records follow the file's header (see
+ * _Sagan_IPC_Header).
+ ****************************************************************************/
+
+void *Table_Map( int shm, size_t record_size, int count )
+{
+
+    struct _Sagan_IPC_Header *header = NULL;
+
+    if (( header = mmap(0, sizeof(_Sagan_IPC_Header) + record_size * (size_t)count, PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+        {
+            return(MAP_FAILED);
+        }
+
+    if ( header->magic != IPC_MAGIC || header->version != IPC_VERSION || header->record_size != record_size )
+        {
+            fprintf(stderr, "Error.  The IPC objects were made by a different version of Sagan. Abort!\n");
+            exit(1);
+        }
+
+    return( (char *)header + sizeof(_Sagan_IPC_Header) );
+}
+
 /****************************************************************************
  * main - Pull data from shared memory and display it!
  ****************************************************************************/
@@ -175,6 +230,8 @@ int main(int argc, char **argv)
 
     char tmp_object_check[255];
 
+    struct stat samples_stat;
+
     char *ipc_directory = IPC_DIRECTORY;
 
     /* Get command line arg's */
@@ -270,6 +327,38 @@ int main(int argc, char **argv)
 
     close(shm_counters);
 
+    if ( counters_ipc->magic != IPC_MAGIC || counters_ipc->version != IPC_VERSION )
+        {
+            fprintf(stderr, "Error.  The IPC objects were made by a different version of Sagan. Abort!\n");
+            exit(1);
+        }
+
+    /* Message samples are optional ("samples: 0") */
+
+    snprintf(tmp_object_check, sizeof(tmp_object_check) - 1, "%s/%s", ipc_directory, SAMPLES_IPC_FILE);
+
+    if ( object_check(tmp_object_check) == true && ( shm = open(tmp_object_check, O_RDONLY ) ) != -1 )
+        {
+
+            if ( fstat(shm, &samples_stat) == 0 && samples_stat.st_size > (off_t)sizeof(_Sagan_IPC_Samples) )
+                {
+
+                    if (( samples_ipc = mmap(0, samples_stat.st_size, PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+                        {
+                            samples_ipc = NULL;
+                        }
+
+                    /* Sized by a different "samples" than the file */
+
+                    if ( samples_ipc != NULL && sizeof(_Sagan_IPC_Samples) + sizeof(_Sagan_IPC_Sample) * (uint64_t)samples_ipc->max > (uint64_t)samples_stat.st_size )
+                        {
+                            samples_ipc = NULL;
+                        }
+                }
+
+            close(shm);
+        }
+
     /*** Get "threshold by source" data ****/
 
     if ( type == ALL_TYPES || type == THRESHOLD_TYPE )
@@ -290,7 +379,7 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if (( threshbysrc_ipc = mmap(0, sizeof(thresh_by_src_ipc) + (sizeof(thresh_by_src_ipc) * counters_ipc->thresh_count_by_src), PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+            if (( threshbysrc_ipc = Table_Map(shm, sizeof(thresh_by_src_ipc), counters_ipc->thresh_count_by_src)) == MAP_FAILED )
                 {
                     fprintf(stderr, "[%s, line %d] Error allocating memory for thresh_by_src object! [%s]\n", __FILE__, __LINE__, strerror(errno));
                     exit(1);
@@ -322,8 +411,8 @@ int main(int argc, char **argv)
                                 }
 
                             printf("Source IP: %s\n", ip_src);
-                            printf("Signature: \"%s\" (%s)\n", threshbysrc_ipc[i].signature_msg, threshbysrc_ipc[i].sid);
-                            printf("Syslog Message: \"%s\"\n", threshbysrc_ipc[i].syslog_message);
+                            printf("Signature: \"%s\" (%s)\n", Sample_Get(threshbysrc_ipc[i].sample)->signature_msg, threshbysrc_ipc[i].sid);
+                            printf("Syslog Message: \"%s\"\n", Sample_Get(threshbysrc_ipc[i].sample)->syslog_message);
                             printf("Date added/modified: %s\n", time_buf);
                             printf("Counter: %d\n", threshbysrc_ipc[i].count);
                             printf("Expire Time: %d\n\n", threshbysrc_ipc[i].expire);
@@ -350,7 +439,7 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if (( threshbydst_ipc = mmap(0, sizeof(thresh_by_dst_ipc) + (sizeof(thresh_by_dst_ipc) * counters_ipc->thresh_count_by_dst) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+            if (( threshbydst_ipc = Table_Map(shm, sizeof(thresh_by_dst_ipc), counters_ipc->thresh_count_by_dst)) == MAP_FAILED )
                 {
                     fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
                     exit(1);
@@ -383,8 +472,8 @@ int main(int argc, char **argv)
                                 }
 
                             printf("Destination IP: %s\n", ip_dst);
-                            printf("Signature: \"%s\" (%s)\n", threshbydst_ipc[i].signature_msg, threshbydst_ipc[i].sid);
-                            printf("Syslog Message: \"%s\"\n", threshbydst_ipc[i].syslog_message);
+                            printf("Signature: \"%s\" (%s)\n", Sample_Get(threshbydst_ipc[i].sample)->signature_msg, threshbydst_ipc[i].sid);
+                            printf("Syslog Message: \"%s\"\n", Sample_Get(threshbydst_ipc[i].sample)->syslog_message);
                             printf("Date added/modified: %s\n", time_buf);
                             printf("Counter: %d\n", threshbydst_ipc[i].count);
                             printf("Expire Time: %d\n\n", threshbydst_ipc[i].expire);
@@ -411,7 +500,7 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if (( threshbyusername_ipc = mmap(0, sizeof(thresh_by_username_ipc) + (sizeof(thresh_by_username_ipc) *  counters_ipc->thresh_count_by_username ), PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+            if (( threshbyusername_ipc = Table_Map(shm, sizeof(thresh_by_username_ipc), counters_ipc->thresh_count_by_username)) == MAP_FAILED )
                 {
                     fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
                     exit(1);
@@ -442,8 +531,8 @@ int main(int argc, char **argv)
                                 }
 
                             printf("Username: %s\n", threshbyusername_ipc[i].username);
-                            printf("Signature: \"%s\" (%s)\n", threshbyusername_ipc[i].signature_msg, threshbyusername_ipc[i].sid);
-                            printf("Syslog Message: \"%s\"\n", threshbyusername_ipc[i].syslog_message);
+                            printf("Signature: \"%s\" (%s)\n", Sample_Get(threshbyusername_ipc[i].sample)->signature_msg, threshbyusername_ipc[i].sid);
+                            printf("Syslog Message: \"%s\"\n", Sample_Get(threshbyusername_ipc[i].sample)->syslog_message);
                             printf("Date added/modified: %s\n", time_buf);
                             printf("Counter: %d\n", threshbyusername_ipc[i].count);
                             printf("Expire Time: %d\n\n", threshbyusername_ipc[i].expire);
@@ -474,7 +563,7 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if (( afterbysrc_ipc = mmap(0, sizeof(after_by_src_ipc) + (sizeof(after_by_src_ipc) * counters_ipc->after_count_by_src ),  PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+            if (( afterbysrc_ipc = Table_Map(shm, sizeof(after_by_src_ipc), counters_ipc->after_count_by_src)) == MAP_FAILED )
                 {
                     fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
                     exit(1);
@@ -505,8 +594,8 @@ int main(int argc, char **argv)
                                 }
 
                             printf("Source IP: %s\n", ip_src);
-                            printf("Signature: \"%s\" (%s)\n", afterbysrc_ipc[i].signature_msg, afterbysrc_ipc[i].sid);
-                            printf("Syslog Message: \"%s\"\n", afterbysrc_ipc[i].syslog_message);
+                            printf("Signature: \"%s\" (%s)\n", Sample_Get(afterbysrc_ipc[i].sample)->signature_msg, afterbysrc_ipc[i].sid);
+                            printf("Syslog Message: \"%s\"\n", Sample_Get(afterbysrc_ipc[i].sample)->syslog_message);
                             printf("Date added/modified: %s\n", time_buf);
                             printf("Counter: %" PRIu64 "\n", afterbysrc_ipc[i].count);
                             printf("Expire Time: %d\n\n", afterbysrc_ipc[i].expire);
@@ -533,7 +622,7 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if (( afterbydst_ipc = mmap(0, sizeof(after_by_dst_ipc) + (sizeof(after_by_dst_ipc) * counters_ipc->after_count_by_dst ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+            if (( afterbydst_ipc = Table_Map(shm, sizeof(after_by_dst_ipc), counters_ipc->after_count_by_dst)) == MAP_FAILED )
                 {
                     fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
                     exit(1);
@@ -565,8 +654,8 @@ int main(int argc, char **argv)
                                 }
 
                             printf("Source IP: %s\n", ip_dst);
-                            printf("Signature: \"%s\" (%s)\n", afterbydst_ipc[i].signature_msg, afterbydst_ipc[i].sid);
-                            printf("Syslog Message: \"%s\"\n", afterbydst_ipc[i].syslog_message);
+                            printf("Signature: \"%s\" (%s)\n", Sample_Get(afterbydst_ipc[i].sample)->signature_msg, afterbydst_ipc[i].sid);
+                            printf("Syslog Message: \"%s\"\n", Sample_Get(afterbydst_ipc[i].sample)->syslog_message);
                             printf("Date added/modified: %s\n", time_buf);
                             printf("Counter: %d\n", afterbydst_ipc[i].count);
                             printf("Expire Time: %d\n\n", afterbydst_ipc[i].expire);
@@ -591,7 +680,7 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if (( afterbyusername_ipc = mmap(0, sizeof(after_by_username_ipc) + (sizeof(after_by_username_ipc) * counters_ipc->after_count_by_username ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+            if (( afterbyusername_ipc = Table_Map(shm, sizeof(after_by_username_ipc), counters_ipc->after_count_by_username)) == MAP_FAILED )
                 {
                     fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
                     exit(1);
@@ -623,8 +712,8 @@ int main(int argc, char **argv)
                                 }
 
                             printf("Username: %s\n", afterbyusername_ipc[i].username);
-                            printf("Signature: \"%s\" (%s)\n", afterbyusername_ipc[i].signature_msg, afterbyusername_ipc[i].sid);
-                            printf("Syslog Message: \"%s\"\n", afterbyusername_ipc[i].syslog_message);
+                            printf("Signature: \"%s\" (%s)\n", Sample_Get(afterbyusername_ipc[i].sample)->signature_msg, afterbyusername_ipc[i].sid);
+                            printf("Syslog Message: \"%s\"\n", Sample_Get(afterbyusername_ipc[i].sample)->syslog_message);
                             printf("Date added/modified: %s\n", time_buf);
                             printf("Counter: %" PRIu64 "\n", afterbyusername_ipc[i].count);
                             printf("Expire Time: %d\n\n", afterbyusername_ipc[i].expire);
@@ -655,7 +744,7 @@ int main(int argc, char **argv)
                     exit(1);
                 }
 
-            if (( xbit_ipc = mmap(0, sizeof(_Sagan_IPC_Xbit) + (sizeof(_Sagan_IPC_Xbit) * counters_ipc->xbit_count ) , PROT_READ, MAP_SHARED, shm, 0)) == MAP_FAILED )
+            if (( xbit_ipc = Table_Map(shm, sizeof(_Sagan_IPC_Xbit), counters_ipc->xbit_count)) == MAP_FAILED )
                 {
                     fprintf(stderr, "[%s, line %d] Error allocating memory object! [%s]\n", __FILE__, __LINE__, strerror(errno));
                     exit(1);
@@ -687,9 +776,9 @@ int main(int argc, char **argv)
                             printf("Xbit name: \"%s\"\n", xbit_ipc[i].xbit_name);
                             printf("State: %s\n", xbit_ipc[i].xbit_state == 1 ? "ACTIVE" : "INACTIVE");
                             printf("IP: %s:%d -> %s:%d\n", xbit_ipc[i].ip_src, xbit_ipc[i].src_port, xbit_ipc[i].ip_dst, xbit_ipc[i].dst_port);
-                            printf("Signature: \"%s\" (%s)\n", xbit_ipc[i].signature_msg, xbit_ipc[i].sid);
+                            printf("Signature: \"%s\" (%s)\n", Sample_Get(xbit_ipc[i].sample)->signature_msg, xbit_ipc[i].sid);
                             printf("Expire Time: %s (%d seconds)\n", time_buf, xbit_ipc[i].expire);
-                            printf("Syslog message: \"%s\"\n\n", xbit_ipc[i].syslog_message );
+                            printf("Syslog message: \"%s\"\n\n", Sample_Get(xbit_ipc[i].sample)->syslog_message );
 
                         }
                 }